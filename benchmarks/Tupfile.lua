@@ -62,6 +62,88 @@ link('nanolog_benchmark', {
   compile('nanolog_benchmark.cpp', 'nanolog_benchmark' .. OBJSUFFIX),
   libreckless
 })
+
+link('integer_format', {
+  compile('integer_format.cpp', 'integer_format' .. OBJSUFFIX),
+  libreckless
+})
+
+link('format_scan', {
+  compile('format_scan.cpp', 'format_scan' .. OBJSUFFIX),
+  libreckless
+})
+
+link('float_format', {
+  compile('float_format.cpp', 'float_format' .. OBJSUFFIX),
+  libreckless
+})
+
+link('binary_format', {
+  compile('binary_format.cpp', 'binary_format' .. OBJSUFFIX),
+  libreckless
+})
+
+link('utf8_transcode', {
+  compile('utf8_transcode.cpp', 'utf8_transcode' .. OBJSUFFIX),
+  libreckless
+})
+
+link('hex_dump', {
+  compile('hex_dump.cpp', 'hex_dump' .. OBJSUFFIX),
+  libreckless
+})
+
+link('brace_format', {
+  compile('brace_format.cpp', 'brace_format' .. OBJSUFFIX),
+  libreckless
+})
+
+link('clock_capture', {
+  compile('clock_capture.cpp', 'clock_capture' .. OBJSUFFIX),
+  libreckless
+})
+
+link('timestamp_format', {
+  compile('timestamp_format.cpp', 'timestamp_format' .. OBJSUFFIX),
+  libreckless
+})
+
+link('header_fields', {
+  compile('header_fields.cpp', 'header_fields' .. OBJSUFFIX),
+  libreckless
+})
+
+link('call_site', {
+  compile('call_site.cpp', 'call_site' .. OBJSUFFIX),
+  libreckless
+})
+
+link('severity_filter', {
+  compile('severity_filter.cpp', 'severity_filter' .. OBJSUFFIX),
+  libreckless
+})
+
+link('sampling', {
+  compile('sampling.cpp', 'sampling' .. OBJSUFFIX),
+  libreckless
+})
+
+link('duplicate_suppression', {
+  compile('duplicate_suppression.cpp', 'duplicate_suppression' .. OBJSUFFIX),
+  libreckless
+})
+
+link('header_layout', {
+  compile('header_layout.cpp', 'header_layout' .. OBJSUFFIX),
+  libreckless
+})
+
+if tup.getconfig('TUP_PLATFORM') == 'linux' then
+  link('pipe_throughput', {
+    compile('pipe_throughput.cpp', 'pipe_throughput' .. OBJSUFFIX),
+    libreckless
+  })
+end
 pop_options()
 
 SPDLOG = tup.getconfig('SPDLOG')
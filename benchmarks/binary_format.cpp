@@ -0,0 +1,134 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures the work done by the output worker for each record, for a
+// policy_log with a timestamp compared to a binary_log. The formatters are
+// called directly without the log around them, so this shows how much faster
+// the worker can drain its queue. Also reports the output size per record.
+//
+// Usage: binary_format [records per workload]
+#include <reckless/binary_log.hpp>
+#include <reckless/policy_log.hpp>
+#include <reckless/writer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <string>
+
+class counting_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        bytes += count;
+        return count;
+    }
+    std::uint64_t bytes = 0;
+};
+
+// Each record is its own frame, so that the buffer can be flushed when it
+// fills up.
+class benchmark_buffer : public reckless::output_buffer {
+public:
+    benchmark_buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+typedef reckless::policy_formatter<reckless::no_indent, ' ',
+    reckless::timestamp_field> text_formatter;
+
+struct result {
+    double nanoseconds;
+    double bytes;
+};
+
+template <class Format>
+result measure(std::size_t count, Format format)
+{
+    counting_writer writer;
+    benchmark_buffer buffer(&writer);
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i=0; i!=count; ++i) {
+        format(&buffer, i);
+        buffer.frame_end();
+    }
+    buffer.flush();
+    auto stop = std::chrono::steady_clock::now();
+    return {std::chrono::duration<double>(stop - start).count()*1e9/count,
+        static_cast<double>(writer.bytes)/count};
+}
+
+template <class Text, class Binary>
+void run(char const* name, std::size_t count, Text text, Binary binary)
+{
+    result best_text = {1e9, 0};
+    result best_binary = {1e9, 0};
+    for(int i=0; i!=5; ++i) {
+        result r = measure(count, text);
+        if(r.nanoseconds < best_text.nanoseconds)
+            best_text = r;
+        r = measure(count, binary);
+        if(r.nanoseconds < best_binary.nanoseconds)
+            best_binary = r;
+    }
+    std::cout << name << ": text " << best_text.nanoseconds << " ns "
+        << best_text.bytes << " B, binary " << best_binary.nanoseconds
+        << " ns " << best_binary.bytes << " B" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t count = argc > 1? std::atoi(argv[1]) : 2000000;
+    reckless::timestamp_field timestamp;
+    std::uint64_t binary_timestamp = reckless::detail::binary_timestamp();
+    std::string const user("mattias");
+
+    auto text_int = [&](reckless::output_buffer* pbuffer, std::size_t i) {
+        text_formatter::format(pbuffer, reckless::timestamp_field(timestamp),
+            reckless::no_indent(), "processed request %d in %d us",
+            static_cast<int>(i), static_cast<int>(i % 1000));
+    };
+    reckless::detail::binary_dictionary dictionary;
+    auto binary_int = [&](reckless::output_buffer* pbuffer, std::size_t i) {
+        reckless::detail::binary_formatter::format(pbuffer, &dictionary,
+            binary_timestamp, "processed request %d in %d us",
+            static_cast<int>(i), static_cast<int>(i % 1000));
+    };
+    run("integers", count, text_int, binary_int);
+
+    auto text_mixed = [&](reckless::output_buffer* pbuffer, std::size_t i) {
+        text_formatter::format(pbuffer, reckless::timestamp_field(timestamp),
+            reckless::no_indent(), "user %s order %d total %.2f ratio %g",
+            user, static_cast<int>(i), i*0.01, 1.0/(i + 1));
+    };
+    auto binary_mixed = [&](reckless::output_buffer* pbuffer, std::size_t i) {
+        reckless::detail::binary_formatter::format(pbuffer, &dictionary,
+            binary_timestamp, "user %s order %d total %.2f ratio %g",
+            user, static_cast<int>(i), i*0.01, 1.0/(i + 1));
+    };
+    run("mixed", count, text_mixed, binary_mixed);
+    return 0;
+}
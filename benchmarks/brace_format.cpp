@@ -0,0 +1,120 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures formatting of a typical record with brace_formatter, with the
+// format string parsed at run time and at compile time, without the log
+// around it. For comparison it also measures template_formatter with the
+// equivalent printf-style format string, and snprintf into a std::string as a
+// caller would otherwise do before logging the result with %s.
+//
+// Usage: brace_format [iterations]
+#include <reckless/brace_formatter.hpp>
+#include <reckless/output_buffer.hpp>
+#include <reckless/writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdio>   // snprintf
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <string>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+class benchmark_buffer : public reckless::output_buffer {
+public:
+    benchmark_buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+#define BRACE_FORMAT "request {} from {:>15} took {:.3f} ms, status {:04x}"
+#define PRINTF_FORMAT "request %d from %15s took %.3f ms, status %04x"
+
+// Returns nanoseconds per record.
+template <class Format>
+double measure(Format format, unsigned iterations)
+{
+    null_writer writer;
+    benchmark_buffer buffer(&writer);
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=iterations; ++i) {
+        format(&buffer, i);
+        buffer.frame_end();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count()*1e9/iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 1000000;
+    char const* address = "192.168.0.1";
+    double elapsed = 12.3456;
+
+    auto brace_runtime = [&](reckless::output_buffer* pbuffer, unsigned i)
+    {
+        reckless::brace_formatter::format(pbuffer, BRACE_FORMAT, i, address,
+            elapsed, 200u);
+    };
+    auto brace_compiled = [&](reckless::output_buffer* pbuffer, unsigned i)
+    {
+        reckless::brace_formatter::format(pbuffer,
+            RECKLESS_FORMAT(BRACE_FORMAT), i, address, elapsed, 200u);
+    };
+    auto printf_style = [&](reckless::output_buffer* pbuffer, unsigned i)
+    {
+        reckless::template_formatter::format(pbuffer, PRINTF_FORMAT, i,
+            address, elapsed, 200u);
+    };
+    auto caller_snprintf = [&](reckless::output_buffer* pbuffer, unsigned i)
+    {
+        char s[128];
+        std::snprintf(s, sizeof(s), PRINTF_FORMAT, i, address, elapsed, 200u);
+        std::string message(s);
+        reckless::template_formatter::format(pbuffer, "%s", message);
+    };
+
+    double best_runtime = 1e9;
+    double best_compiled = 1e9;
+    double best_printf = 1e9;
+    double best_snprintf = 1e9;
+    for(int i=0; i!=5; ++i) {
+        best_runtime = std::min(best_runtime, measure(brace_runtime, iterations));
+        best_compiled = std::min(best_compiled, measure(brace_compiled, iterations));
+        best_printf = std::min(best_printf, measure(printf_style, iterations));
+        best_snprintf = std::min(best_snprintf, measure(caller_snprintf, iterations));
+    }
+    std::cout << "brace (run time) " << best_runtime << " ns, "
+        << "brace (compile time) " << best_compiled << " ns, "
+        << "template_formatter " << best_printf << " ns, "
+        << "snprintf + %s " << best_snprintf << " ns" << std::endl;
+    return 0;
+}
@@ -0,0 +1,107 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures what writing a record to a severity_log costs the calling thread
+// when the format string, severity and source location are stored in the
+// record, and when they are replaced by a pointer to a static call site.
+// Input frames are rounded up to whole cache lines, so the smaller record
+// only pays off when it saves a cache line; the first record fits in one
+// cache line either way, and the second needs two lines unless it is written
+// through a call site.
+//
+// Usage: call_site [iterations]
+#include <reckless/severity_log.hpp>
+#include <reckless/call_site.hpp>
+#include <reckless/writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <iostream>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::severity_field, reckless::source_location_field> log_t;
+
+unsigned const BATCH = 10000;
+
+// Returns nanoseconds per record. The log is flushed between batches, outside
+// the measurement, so that the caller never waits for the worker.
+template <class Write>
+double measure(log_t& log, Write write, unsigned iterations)
+{
+    double elapsed = 0;
+    for(unsigned i=0; i<iterations; i+=BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned j=0; j!=BATCH; ++j)
+            write(log, j);
+        auto stop = std::chrono::steady_clock::now();
+        elapsed += std::chrono::duration<double>(stop - start).count();
+        log.flush();
+    }
+    return elapsed*1e9/iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 1000000;
+    null_writer writer;
+    log_t log(&writer, 4*1024*1024, 1024*1024);
+
+    auto stored = [](log_t& log, unsigned i)
+    {
+        log.info("request %d took %d ms", i, 15);
+    };
+    auto call_site = [](log_t& log, unsigned i)
+    {
+        RECKLESS_LOG(log, info, "request %d took %d ms", i, 15);
+    };
+    auto stored_long = [](log_t& log, unsigned i)
+    {
+        log.info("request %d took %d ms, %.1f/%.1f/%.1f", i, 15, 0.5, 1.5, 2.5);
+    };
+    auto call_site_long = [](log_t& log, unsigned i)
+    {
+        RECKLESS_LOG(log, info, "request %d took %d ms, %.1f/%.1f/%.1f", i,
+            15, 0.5, 1.5, 2.5);
+    };
+
+    double best[4] = {1e9, 1e9, 1e9, 1e9};
+    for(int i=0; i!=5; ++i) {
+        best[0] = std::min(best[0], measure(log, stored, iterations));
+        best[1] = std::min(best[1], measure(log, call_site, iterations));
+        best[2] = std::min(best[2], measure(log, stored_long, iterations));
+        best[3] = std::min(best[3], measure(log, call_site_long, iterations));
+    }
+    std::cout << "two arguments: stored fields " << best[0] << " ns, "
+        << "call site " << best[1] << " ns" << std::endl;
+    std::cout << "five arguments: stored fields " << best[2] << " ns, "
+        << "call site " << best[3] << " ns" << std::endl;
+    return 0;
+}
@@ -0,0 +1,72 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures what capturing a timestamp costs the calling thread with each
+// clock source, and what converting it costs the output worker.
+//
+// Usage: clock_capture [iterations]
+#include <reckless/clock.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <vector>
+
+template <class Clock>
+void run(char const* name, unsigned iterations)
+{
+    std::vector<std::uint64_t> raw(iterations);
+    double best_capture = 1e9;
+    double best_convert = 1e9;
+    std::uint64_t sum = 0;
+    // Get any initial calibration out of the way.
+    Clock::to_realtime(Clock::now());
+    for(int round=0; round!=5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned i=0; i!=iterations; ++i)
+            raw[i] = Clock::now();
+        auto middle = std::chrono::steady_clock::now();
+        for(unsigned i=0; i!=iterations; ++i)
+            sum += Clock::to_realtime(raw[i]);
+        auto stop = std::chrono::steady_clock::now();
+        best_capture = std::min(best_capture,
+            std::chrono::duration<double>(middle - start).count()*1e9/iterations);
+        best_convert = std::min(best_convert,
+            std::chrono::duration<double>(stop - middle).count()*1e9/iterations);
+    }
+    // Keep the result alive so the loop isn't optimized away.
+    if(sum == 0)
+        std::cout << "";
+    std::cout << name << ": capture " << best_capture << " ns, convert "
+        << best_convert << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 1000000;
+    run<reckless::coarse_realtime_clock>("coarse_realtime_clock", iterations);
+    run<reckless::realtime_clock>("realtime_clock", iterations);
+    run<reckless::monotonic_clock>("monotonic_clock", iterations);
+    run<reckless::tsc_clock>("tsc_clock", iterations);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures how long it takes to get a flood of identical records through the
+// log and into a file, with and without duplicate suppression, and what
+// suppression costs when the records all differ. The time saved is mostly in
+// the writer, so write to a real file rather than /dev/null.
+//
+// Usage: duplicate_suppression [iterations] [file]
+#include <reckless/policy_log.hpp>
+#include <reckless/file_writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <iostream>
+
+typedef reckless::policy_log<reckless::no_indent, ' ',
+    reckless::timestamp_field> log_t;
+
+// Returns nanoseconds per record, including the time for the worker to
+// catch up at the end.
+template <class Write>
+double measure(log_t& log, Write write, unsigned iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=iterations; ++i)
+        write(log, i);
+    log.flush();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count()*1e9/iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 1000000;
+    char const* path = argc > 2? argv[2] : "log.txt";
+    reckless::file_writer writer(path);
+    log_t log(&writer, 4*1024*1024, 1024*1024);
+
+    auto same = [](log_t& log, unsigned)
+    {
+        log.write("connection to %s:%d refused", "db.example.com", 5432);
+    };
+    auto different = [](log_t& log, unsigned i)
+    {
+        log.write("connection to %s:%d refused", "db.example.com", i);
+    };
+
+    double best[4] = {1e9, 1e9, 1e9, 1e9};
+    for(int i=0; i!=5; ++i) {
+        log.suppress_duplicates(0);
+        best[0] = std::min(best[0], measure(log, same, iterations));
+        best[1] = std::min(best[1], measure(log, different, iterations));
+        log.suppress_duplicates(1000);
+        best[2] = std::min(best[2], measure(log, same, iterations));
+        best[3] = std::min(best[3], measure(log, different, iterations));
+    }
+    std::cout << "identical records " << best[0] << " ns, suppressed "
+        << best[2] << " ns; distinct records " << best[1]
+        << " ns, suppression on " << best[3] << " ns" << std::endl;
+    return 0;
+}
@@ -0,0 +1,111 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures ftoa_base10_f and ftoa_base10_g on their own, without the log
+// around them. "prices" are values with a few decimals like the ones typical
+// of monetary amounts and latencies; "spread" draws values from a wide range
+// of magnitudes with full 17-digit significands.
+//
+// Usage: float_format [values per workload]
+#include <reckless/ntoa.hpp>
+#include <reckless/writer.hpp>
+
+#include <chrono>
+#include <cmath>    // pow
+#include <cstdint>
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <random>
+#include <vector>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+// Each formatted value is its own frame, so that the buffer can be flushed
+// when it fills up.
+class benchmark_buffer : public reckless::output_buffer {
+public:
+    benchmark_buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+typedef void (*conversion_function)(reckless::output_buffer*, double,
+    reckless::conversion_specification const&);
+
+double measure(std::vector<double> const& values, conversion_function convert,
+    reckless::conversion_specification const& cs)
+{
+    null_writer writer;
+    benchmark_buffer buffer(&writer);
+    auto start = std::chrono::steady_clock::now();
+    for(double v : values) {
+        convert(&buffer, v, cs);
+        buffer.frame_end();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count()*1e9/values.size();
+}
+
+void run(char const* name, std::vector<double> const& values)
+{
+    reckless::conversion_specification f;
+    reckless::conversion_specification g;
+    reckless::conversion_specification g17;
+    g17.precision = 17;
+    double best_f = 1e9;
+    double best_g = 1e9;
+    double best_g17 = 1e9;
+    for(int i=0; i!=5; ++i) {
+        best_f = std::min(best_f, measure(values, &reckless::ftoa_base10_f, f));
+        best_g = std::min(best_g, measure(values, &reckless::ftoa_base10_g, g));
+        best_g17 = std::min(best_g17, measure(values, &reckless::ftoa_base10_g, g17));
+    }
+    std::cout << name << ": %f " << best_f << " ns, %g " << best_g
+        << " ns, %.17g " << best_g17 << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t count = argc > 1? std::atoi(argv[1]) : 2000000;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> exponent(-5, 10);
+    std::vector<double> prices;
+    std::vector<double> spread;
+    for(std::size_t i=0; i!=count; ++i) {
+        std::uint64_t bits = rng();
+        prices.push_back(static_cast<double>(bits % 1000000)/100);
+        spread.push_back(std::pow(10.0, exponent(rng)));
+    }
+    // Warm up the CPU and fault in the output buffer before measuring.
+    measure(spread, &reckless::ftoa_base10_f, reckless::conversion_specification());
+    run("prices", prices);
+    run("spread", spread);
+    return 0;
+}
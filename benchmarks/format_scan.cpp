@@ -0,0 +1,92 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Compares the vectorized search for '%' used by template_formatter with the
+// byte-by-byte loop it replaced, for literal prefixes of different lengths.
+// Every string is tried at all 32 alignments, since the vector versions have
+// to mask off the part of the first block that precedes the string.
+//
+// Usage: format_scan [iterations]
+#include <reckless/template_formatter.hpp>
+
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <cstring>  // memset
+#include <iostream>
+#include <vector>
+
+// Keeps the compiler from optimizing away the searches.
+std::size_t volatile g_sink;
+
+char const* find_specifier_scalar(char const* s)
+{
+    char c = *s;
+    while(c != '%' && c != '\0')
+        c = *(++s);
+    return s;
+}
+
+template <class Function>
+double measure(Function f, std::vector<char const*> const& strings,
+    unsigned iterations, std::size_t& checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=iterations; ++i) {
+        for(char const* s : strings)
+            checksum += f(s) - s;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return seconds*1e9/(iterations*strings.size());
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 200000;
+    std::size_t const lengths[] = {0, 8, 16, 24, 40, 60, 80, 120, 200};
+    for(std::size_t length : lengths) {
+        std::vector<std::vector<char>> buffers;
+        std::vector<char const*> strings;
+        for(unsigned offset=0; offset!=32; ++offset) {
+            buffers.emplace_back(length + 128);
+            std::vector<char>& b = buffers.back();
+            std::memset(b.data(), 'x', b.size());
+            b[offset + length] = '%';
+            b[offset + length + 1] = 'd';
+            b[offset + length + 2] = '\0';
+            strings.push_back(b.data() + offset);
+        }
+        for(char const* s : strings) {
+            if(reckless::detail::find_specifier(s) != find_specifier_scalar(s)) {
+                std::cerr << "mismatch at length " << length << std::endl;
+                return 1;
+            }
+        }
+
+        std::size_t checksum = 0;
+        double scalar = measure(&find_specifier_scalar, strings, iterations, checksum);
+        double vector = measure(&reckless::detail::find_specifier, strings, iterations, checksum);
+        std::cout << "length " << length << ": scalar " << scalar << " ns, vector "
+            << vector << " ns (" << scalar/vector << "x)" << std::endl;
+        g_sink = checksum;
+    }
+    return 0;
+}
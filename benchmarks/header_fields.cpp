@@ -0,0 +1,83 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures what constructing the thread id, thread name and source location
+// header fields costs the calling thread, compared to a plain OS call for the
+// thread id.
+//
+// Usage: header_fields [iterations]
+#include <reckless/thread_field.hpp>
+#include <reckless/source_location.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>  // atoi
+#include <iostream>
+#if defined(__linux__)
+#include <sys/syscall.h>    // SYS_gettid
+#include <unistd.h>         // syscall
+#endif
+
+template <class Capture>
+void run(char const* name, unsigned iterations, Capture capture)
+{
+    double best = 1e9;
+    std::uintptr_t sum = 0;
+    for(int round=0; round!=5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned i=0; i!=iterations; ++i)
+            sum += capture();
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best,
+            std::chrono::duration<double>(stop - start).count()*1e9/iterations);
+    }
+    // Keep the result alive so the loop isn't optimized away.
+    if(sum == 0)
+        std::cout << "";
+    std::cout << name << ": " << best << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 10000000;
+    run("thread_id_field", iterations, []
+    {
+        return static_cast<std::uintptr_t>(reckless::current_thread_id());
+    });
+    run("thread_name_field", iterations, []
+    {
+        return reinterpret_cast<std::uintptr_t>(reckless::current_thread_name());
+    });
+    run("source_location_field", iterations, []
+    {
+        static reckless::source_location const location = {
+            __FILE__, __LINE__, __func__};
+        return reinterpret_cast<std::uintptr_t>(&location);
+    });
+#if defined(__linux__)
+    run("gettid", iterations, []
+    {
+        return static_cast<std::uintptr_t>(syscall(SYS_gettid));
+    });
+#endif
+    return 0;
+}
@@ -0,0 +1,138 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures what formatting a record costs the output worker, with header
+// fields that have a MAX_SIZE, so that policy_formatter reserves space for
+// all of them at once, compared to the same fields written one at a time.
+//
+// Usage: header_layout [iterations]
+#include <reckless/policy_log.hpp>
+#include <reckless/severity_log.hpp>    // severity_field
+#include <reckless/thread_field.hpp>
+#include <reckless/process_field.hpp>
+#include <reckless/writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <iostream>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+// Formats directly into an output buffer, the way the worker does.
+class buffer : public reckless::output_buffer {
+public:
+    buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+// Hides the MAX_SIZE of Field, so that it is written on its own.
+template <class Field>
+class one_at_a_time {
+public:
+    one_at_a_time(Field const& field) : field_(field)
+    {
+    }
+
+    void format(reckless::output_buffer* pbuffer)
+    {
+        field_.format(pbuffer);
+    }
+
+private:
+    Field field_;
+};
+
+template <class... Fields>
+using formatter = reckless::policy_formatter<reckless::no_indent,
+    ' ', Fields...>;
+
+template <class Format>
+void run(char const* name, unsigned iterations, Format format)
+{
+    null_writer writer;
+    buffer buffer(&writer);
+    double best = 1e9;
+    for(int round=0; round!=5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned i=0; i!=iterations; ++i) {
+            format(&buffer);
+            buffer.frame_end();
+        }
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best,
+            std::chrono::duration<double>(stop - start).count()*1e9/iterations);
+    }
+    std::cout << name << ": " << best << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 10000000;
+    // Renders the text for pid_field and app_name_field.
+    {
+        null_writer writer;
+        reckless::policy_log<> log(&writer);
+    }
+
+    reckless::timestamp_field timestamp;
+    reckless::severity_field severity('I');
+    reckless::thread_id_field thread_id;
+    reckless::pid_field pid;
+    reckless::app_name_field app_name;
+
+    run("fused", iterations, [&](reckless::output_buffer* pbuffer)
+    {
+        formatter<reckless::timestamp_field, reckless::severity_field,
+            reckless::thread_id_field, reckless::pid_field,
+            reckless::app_name_field>::format(pbuffer,
+                reckless::timestamp_field(timestamp),
+                reckless::severity_field(severity),
+                reckless::thread_id_field(thread_id),
+                reckless::pid_field(pid),
+                reckless::app_name_field(app_name),
+                reckless::no_indent(), "request done");
+    });
+    run("one at a time", iterations, [&](reckless::output_buffer* pbuffer)
+    {
+        typedef one_at_a_time<reckless::timestamp_field> timestamp_t;
+        typedef one_at_a_time<reckless::severity_field> severity_t;
+        typedef one_at_a_time<reckless::thread_id_field> thread_id_t;
+        typedef one_at_a_time<reckless::pid_field> process_id_t;
+        typedef one_at_a_time<reckless::app_name_field> app_name_t;
+        formatter<timestamp_t, severity_t, thread_id_t, process_id_t,
+            app_name_t>::format(pbuffer,
+                timestamp_t(timestamp), severity_t(severity),
+                thread_id_t(thread_id), process_id_t(pid), app_name_t(app_name),
+                reckless::no_indent(), "request done");
+    });
+    return 0;
+}
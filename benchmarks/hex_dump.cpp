@@ -0,0 +1,125 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures formatting of byte buffers with %x, "% x" and %#x, without the log
+// around it, and compares it to formatting a hex string with snprintf as a
+// caller would otherwise do before logging. "small" is a 64-byte buffer and
+// "packet" a 1500-byte one.
+//
+// Usage: hex_dump [iterations]
+#include <reckless/byte_buffer.hpp>
+#include <reckless/output_buffer.hpp>
+#include <reckless/writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdio>   // snprintf
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+class benchmark_buffer : public reckless::output_buffer {
+public:
+    benchmark_buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+// Returns nanoseconds per buffer.
+double measure(std::vector<unsigned char> const& data, char const* format,
+    unsigned iterations)
+{
+    null_writer writer;
+    benchmark_buffer buffer(&writer);
+    reckless::byte_view view(data.data(), data.size());
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=iterations; ++i) {
+        reckless::format(&buffer, format, view);
+        buffer.frame_end();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count()*1e9/iterations;
+}
+
+double measure_snprintf(std::vector<unsigned char> const& data,
+    unsigned iterations)
+{
+    std::size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=iterations; ++i) {
+        std::string s;
+        char digits[3];
+        for(unsigned char c : data) {
+            std::snprintf(digits, sizeof(digits), "%02x", c);
+            s += digits;
+        }
+        total += s.size();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    // Keep the result alive so the loop isn't optimized away.
+    if(total == 0)
+        std::cout << "";
+    return std::chrono::duration<double>(stop - start).count()*1e9/iterations;
+}
+
+void run(char const* name, std::size_t size, unsigned iterations)
+{
+    std::mt19937 rng;
+    std::vector<unsigned char> data(size);
+    for(auto& c : data)
+        c = static_cast<unsigned char>(rng());
+
+    double best_x = 1e9;
+    double best_spaced = 1e9;
+    double best_dump = 1e9;
+    double best_snprintf = 1e9;
+    for(int i=0; i!=5; ++i) {
+        best_x = std::min(best_x, measure(data, "x", iterations));
+        best_spaced = std::min(best_spaced, measure(data, " x", iterations));
+        best_dump = std::min(best_dump, measure(data, "#x", iterations));
+        best_snprintf = std::min(best_snprintf,
+            measure_snprintf(data, iterations));
+    }
+    std::cout << name << ": %x " << best_x << " ns, % x " << best_spaced
+        << " ns, %#x " << best_dump << " ns, snprintf %02x " << best_snprintf
+        << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 20000;
+    run("small", 64, iterations);
+    run("packet", 1500, iterations/10);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures itoa_base10 on its own, without the log around it, for integer
+// workloads of different widths. "mixed" draws the number of digits at
+// random for every value, which is what a typical log with ids, counters and
+// latencies looks like.
+//
+// Usage: integer_format [values per workload]
+#include <reckless/ntoa.hpp>
+#include <reckless/writer.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <random>
+#include <vector>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+// Each formatted value is its own frame, so that the buffer can be flushed
+// when it fills up.
+class benchmark_buffer : public reckless::output_buffer {
+public:
+    benchmark_buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+template <typename T>
+double measure(std::vector<T> const& values, reckless::conversion_specification const& cs)
+{
+    null_writer writer;
+    benchmark_buffer buffer(&writer);
+    auto start = std::chrono::steady_clock::now();
+    for(T v : values) {
+        reckless::itoa_base10(&buffer, v, cs);
+        buffer.frame_end();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count()*1e9/values.size();
+}
+
+template <typename T>
+void run(char const* name, std::vector<T> const& values)
+{
+    reckless::conversion_specification plain;
+    reckless::conversion_specification padded;
+    padded.minimum_field_width = 12;
+    double best_plain = 1e9;
+    double best_padded = 1e9;
+    for(int i=0; i!=5; ++i) {
+        best_plain = std::min(best_plain, measure(values, plain));
+        best_padded = std::min(best_padded, measure(values, padded));
+    }
+    std::cout << name << ": %d " << best_plain << " ns, %12d " << best_padded
+        << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t count = argc > 1? std::atoi(argv[1]) : 10000000;
+    std::mt19937_64 rng;
+    std::vector<int> small;
+    std::vector<long long> mixed;
+    std::vector<unsigned long long> large;
+    for(std::size_t i=0; i!=count; ++i) {
+        std::uint64_t bits = rng();
+        small.push_back(static_cast<int>(bits % 1000));
+        long long v = static_cast<long long>(bits >> (bits % 64));
+        mixed.push_back((bits & 0x100)? -v : v);
+        large.push_back(bits | (std::uint64_t(1) << 63));
+    }
+    // Warm up the CPU and fault in the output buffer before measuring.
+    measure(mixed, reckless::conversion_specification());
+    run("small (1-3 digits)", small);
+    run("mixed (1-19 digits)", mixed);
+    run("large (20 digits)", large);
+    return 0;
+}
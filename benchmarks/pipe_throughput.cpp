@@ -0,0 +1,121 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures how fast log output can be pushed through a pipe to a consumer
+// process, with and without moving the output buffer pages into the pipe
+// with vmsplice(). The consumer only reads and discards the data, as a
+// supervisor capturing stdout would.
+//
+// Usage: pipe_throughput [line length] [megabytes] [read|splice]
+//
+// With "splice" the consumer forwards the data with splice() instead of
+// reading it, which is where gifting the pages pays off the most since the
+// data is then never copied at all.
+#include <reckless/policy_log.hpp>
+#include <reckless/stdout_writer.hpp>
+
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>      // splice
+#include <sys/wait.h>
+#include <unistd.h>
+
+bool g_splice_consumer = false;
+
+std::size_t consume(int fd)
+{
+    std::size_t total = 0;
+    if(g_splice_consumer) {
+        // Move the data on to /dev/null without copying it, like a shipper
+        // that forwards the pipe to a file or socket with splice().
+        int null_fd = open("/dev/null", O_WRONLY);
+        while(true) {
+            ssize_t n = splice(fd, nullptr, null_fd, nullptr, 1024*1024, SPLICE_F_MOVE);
+            if(n <= 0)
+                break;
+            total += n;
+        }
+        close(null_fd);
+        return total;
+    }
+    char buffer[256*1024];
+    while(true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if(n <= 0)
+            break;
+        total += n;
+    }
+    return total;
+}
+
+double run(bool zero_copy, std::size_t line_length, std::size_t megabytes)
+{
+    int fds[2];
+    if(0 != pipe(fds))
+        std::exit(1);
+    pid_t child = fork();
+    if(child == 0) {
+        close(fds[1]);
+        consume(fds[0]);
+        _exit(0);
+    }
+    close(fds[0]);
+    int saved_stdout = dup(1);
+    dup2(fds[1], 1);
+    close(fds[1]);
+
+    std::string line(line_length - 1, 'x');
+    std::size_t lines = megabytes*1024*1024/line_length;
+    auto start = std::chrono::steady_clock::now();
+    {
+        reckless::stdout_writer writer;
+        writer.zero_copy_pipe(zero_copy);
+        reckless::policy_log<> log(&writer);
+        for(std::size_t i=0; i!=lines; ++i)
+            log.write("%s", line);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    dup2(saved_stdout, 1);
+    close(saved_stdout);
+    int status;
+    waitpid(child, &status, 0);
+
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    return lines*line_length/seconds;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t line_length = argc > 1? std::atoi(argv[1]) : 1024;
+    std::size_t megabytes = argc > 2? std::atoi(argv[2]) : 2048;
+    g_splice_consumer = argc > 3 && std::string(argv[3]) == "splice";
+    for(int i=0; i!=3; ++i) {
+        double copy = run(false, line_length, megabytes);
+        double splice = run(true, line_length, megabytes);
+        std::cout << "write: " << copy/(1024*1024) << " MiB/s  vmsplice: "
+            << splice/(1024*1024) << " MiB/s" << std::endl;
+    }
+    return 0;
+}
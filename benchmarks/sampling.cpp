@@ -0,0 +1,95 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures what a sampled call costs the calling thread when the sampler
+// discards it, compared to a call that is written.
+//
+// Usage: sampling [iterations]
+#include <reckless/severity_log.hpp>
+#include <reckless/sampling.hpp>
+#include <reckless/writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <iostream>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::severity_field> log_t;
+
+unsigned const BATCH = 10000;
+
+// Returns nanoseconds per call. The log is flushed between batches, outside
+// the measurement, so that the caller never waits for the worker.
+template <class Write>
+double measure(log_t& log, Write write, unsigned iterations)
+{
+    double elapsed = 0;
+    for(unsigned i=0; i<iterations; i+=BATCH) {
+        auto start = std::chrono::steady_clock::now();
+        for(unsigned j=0; j!=BATCH; ++j)
+            write(log, j);
+        auto stop = std::chrono::steady_clock::now();
+        elapsed += std::chrono::duration<double>(stop - start).count();
+        log.flush();
+    }
+    return elapsed*1e9/iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 1000000;
+    null_writer writer;
+    log_t log(&writer, 4*1024*1024, 1024*1024);
+
+    auto every_n = [](log_t& log, unsigned i)
+    {
+        RECKLESS_LOG_EVERY_N(log, 1000000, warn, "dropped packet %d", i);
+    };
+    auto rate_limited = [](log_t& log, unsigned i)
+    {
+        RECKLESS_LOG_RATE_LIMITED(log, 10, warn, "dropped packet %d", i);
+    };
+    auto unsampled = [](log_t& log, unsigned i)
+    {
+        RECKLESS_LOG(log, warn, "dropped packet %d", i);
+    };
+
+    double best[3] = {1e9, 1e9, 1e9};
+    for(int i=0; i!=5; ++i) {
+        best[0] = std::min(best[0], measure(log, every_n, iterations));
+        best[1] = std::min(best[1], measure(log, rate_limited, iterations));
+        best[2] = std::min(best[2], measure(log, unsampled, iterations));
+    }
+    std::cout << "every n " << best[0] << " ns, "
+        << "rate limited " << best[1] << " ns, "
+        << "unsampled " << best[2] << " ns" << std::endl;
+    return 0;
+}
@@ -0,0 +1,90 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures the output worker's cost of formatting timestamps for records
+// that arrive about a microsecond apart, with each timestamp format, and
+// compares it to calling localtime_r() for every record.
+//
+// Usage: timestamp_format [iterations]
+#include <reckless/timestamp_format.hpp>
+#include <reckless/clock.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdint>
+#include <cstdio>   // snprintf
+#include <cstdlib>  // atoi
+#include <ctime>    // localtime_r
+#include <iostream>
+
+struct localtime_format {
+    static std::size_t const MAX_SIZE = 32;
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        std::time_t seconds = static_cast<std::time_t>(time/1000000000u);
+        struct tm tm;
+        localtime_r(&seconds, &tm);
+        std::size_t size = std::strftime(p, MAX_SIZE, "%Y-%m-%d %H:%M:%S", &tm);
+        return p + size;
+    }
+};
+
+// Returns nanoseconds per timestamp.
+template <class Format>
+double measure(unsigned iterations)
+{
+    char buffer[Format::MAX_SIZE];
+    std::uint64_t time = reckless::realtime_clock::now();
+    std::size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=iterations; ++i) {
+        total += Format::write(buffer, time) - buffer;
+        time += 1013;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    // Keep the result alive so the loop isn't optimized away.
+    if(total == 0)
+        std::cout << "";
+    return std::chrono::duration<double>(stop - start).count()*1e9/iterations;
+}
+
+template <class Format>
+void run(char const* name, unsigned iterations)
+{
+    double best = 1e9;
+    for(int i=0; i!=5; ++i)
+        best = std::min(best, measure<Format>(iterations));
+    std::cout << name << ": " << best << " ns" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = argc > 1? std::atoi(argv[1]) : 1000000;
+    run<localtime_format>("localtime_r + strftime", iterations);
+    run<reckless::local_time_format<3>>("local_time_format<3>", iterations);
+    run<reckless::iso8601_format<6>>("iso8601_format<6>", iterations);
+    run<reckless::iso8601_utc_format<9>>("iso8601_utc_format<9>", iterations);
+    run<reckless::epoch_format<6>>("epoch_format<6>", iterations);
+    run<reckless::epoch_nanoseconds_format>("epoch_nanoseconds_format", iterations);
+    run<reckless::elapsed_format<6>>("elapsed_format<6>", iterations);
+    return 0;
+}
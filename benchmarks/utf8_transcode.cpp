@@ -0,0 +1,155 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Measures UTF-16 and UTF-32 to UTF-8 transcoding of wide string arguments,
+// without the log around it, and compares it to a plain scalar loop of the
+// kind a caller would otherwise run on its own thread before logging. "ascii"
+// is pure ASCII text, "latin" is ASCII with an accented letter every few
+// words, "cjk" is entirely three-byte characters and "emoji" is entirely
+// four-byte characters (surrogate pairs in UTF-16).
+//
+// Usage: utf8_transcode [string length]
+#include <reckless/detail/utf8.hpp>
+#include <reckless/output_buffer.hpp>
+#include <reckless/writer.hpp>
+
+#include <algorithm>    // min
+#include <chrono>
+#include <cstdlib>  // atoi
+#include <iostream>
+#include <random>
+#include <string>
+
+class null_writer : public reckless::writer {
+public:
+    std::size_t write(void const*, std::size_t count, std::error_code& ec) noexcept override
+    {
+        ec.clear();
+        return count;
+    }
+};
+
+class benchmark_buffer : public reckless::output_buffer {
+public:
+    benchmark_buffer(reckless::writer* pwriter) :
+        output_buffer(pwriter, 1024*1024)
+    {
+    }
+    using output_buffer::frame_end;
+};
+
+std::string scalar_utf8(std::u32string const& s)
+{
+    std::string result;
+    for(char32_t c : s) {
+        if(c < 0x80) {
+            result += static_cast<char>(c);
+        } else if(c < 0x800) {
+            result += static_cast<char>(0xc0 | (c >> 6));
+            result += static_cast<char>(0x80 | (c & 0x3f));
+        } else if(c < 0x10000) {
+            result += static_cast<char>(0xe0 | (c >> 12));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            result += static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            result += static_cast<char>(0xf0 | (c >> 18));
+            result += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+            result += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+            result += static_cast<char>(0x80 | (c & 0x3f));
+        }
+    }
+    return result;
+}
+
+unsigned const ITERATIONS = 2000;
+
+// Returns nanoseconds per code point.
+template <class String>
+double measure(String const& s, std::size_t code_points)
+{
+    null_writer writer;
+    benchmark_buffer buffer(&writer);
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=ITERATIONS; ++i) {
+        reckless::detail::write_utf8(&buffer, s.data(), s.size());
+        buffer.frame_end();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(stop - start).count()*1e9/
+        (ITERATIONS*code_points);
+}
+
+double measure_scalar(std::u32string const& s)
+{
+    std::size_t total = 0;
+    auto start = std::chrono::steady_clock::now();
+    for(unsigned i=0; i!=ITERATIONS; ++i)
+        total += scalar_utf8(s).size();
+    auto stop = std::chrono::steady_clock::now();
+    // Keep the result alive so the loop isn't optimized away.
+    if(total == 0)
+        std::cout << "";
+    return std::chrono::duration<double>(stop - start).count()*1e9/
+        (ITERATIONS*s.size());
+}
+
+void run(char const* name, std::u32string const& s32)
+{
+    std::u16string s16;
+    for(char32_t c : s32) {
+        if(c < 0x10000) {
+            s16 += static_cast<char16_t>(c);
+        } else {
+            s16 += static_cast<char16_t>(0xd800 + ((c - 0x10000) >> 10));
+            s16 += static_cast<char16_t>(0xdc00 + ((c - 0x10000) & 0x3ff));
+        }
+    }
+
+    double best16 = 1e9;
+    double best32 = 1e9;
+    double best_scalar = 1e9;
+    for(int i=0; i!=5; ++i) {
+        best16 = std::min(best16, measure(s16, s32.size()));
+        best32 = std::min(best32, measure(s32, s32.size()));
+        best_scalar = std::min(best_scalar, measure_scalar(s32));
+    }
+    std::cout << name << ": utf-16 " << best16 << " ns, utf-32 " << best32
+        << " ns, scalar " << best_scalar << " ns per code point" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t length = argc > 1? std::atoi(argv[1]) : 200;
+    std::mt19937 rng;
+    std::u32string ascii, latin, cjk, emoji;
+    for(std::size_t i=0; i!=length; ++i) {
+        char32_t letter = U'a' + rng() % 26;
+        ascii += i % 6 == 5? U' ' : letter;
+        latin += i % 6 == 5? U' ' : i % 23 == 0? U'é' : letter;
+        cjk += 0x4e00 + rng() % 0x5000;
+        emoji += 0x1f600 + rng() % 0x50;
+    }
+    run("ascii", ascii);
+    run("latin", latin);
+    run("cjk", cjk);
+    run("emoji", emoji);
+    return 0;
+}
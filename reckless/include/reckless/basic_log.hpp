@@ -32,6 +32,9 @@
 #include <thread>
 #include <functional>
 #include <tuple>
+#include <atomic>
+#include <memory>       // unique_ptr
+#include <cstdint>      // uint64_t
 #include <system_error> // system_error, error_code
 #include <exception>    // current_exception, exception_ptr
 #include <typeinfo>     // type_info
@@ -147,6 +150,17 @@ public:
         format_error_callback_ = move(callback);
     }
 
+    // Collapse runs of consecutive records with identical output, not
+    // counting volatile header fields such as timestamps, into the first record of the run followed
+    // by a line saying "last message repeated N times". That line is written
+    // when a different record comes along, or soon after timeout_ms
+    // milliseconds have passed since the first repeat. Pass 0 to turn this
+    // off again, which is the default.
+    void suppress_duplicates(unsigned timeout_ms)
+    {
+        duplicate_timeout_ms_.store(timeout_ms, std::memory_order_relaxed);
+    }
+
     using output_buffer::writer_error_callback;
     using output_buffer::temporary_error_policy;
     using output_buffer::permanent_error_policy;
@@ -177,6 +191,11 @@ public:
     using output_buffer::output_buffer_high_watermark;
 
 protected:
+    bool is_open()
+    {
+        return output_thread_.joinable();
+    }
+
     template <class Formatter, typename... Args>
     void write(Args&&... args)
     {
@@ -237,15 +256,14 @@ private:
     std::size_t process_frame(void* pframe);
     std::size_t skip_frame(void* pframe);
     void clear_frame(void* pframe, std::size_t frame_size);
+    void end_frame_suppressing_duplicates(unsigned timeout_ms);
+    void write_repeat_summary(bool before_frame);
+    void write_due_repeat_summary(bool force);
 
     void flush_output_buffer();
 
     [[noreturn]]
     void on_panic_flush_done();
-    bool is_open()
-    {
-        return output_thread_.joinable();
-    }
 
     detail::mpsc_ring_buffer input_buffer_;
     detail::spsc_event input_buffer_full_event_;
@@ -259,6 +277,15 @@ private:
     unsigned input_buffer_full_count_ = 0;
     std::size_t input_buffer_high_watermark_ = 0;
 
+    std::atomic<unsigned> duplicate_timeout_ms_{0};
+    // Duplicate suppression state, only used by the worker thread.
+    std::unique_ptr<char[]> previous_message_;
+    std::unique_ptr<char[]> current_message_;
+    std::size_t previous_message_size_ = 0;
+    bool has_previous_message_ = false;
+    unsigned repeat_count_ = 0;
+    std::uint64_t first_repeat_time_ = 0;
+
 #if defined(_POSIX_VERSION)
     pthread_t output_worker_native_handle_;
 #elif defined(_WIN32)
@@ -322,8 +349,9 @@ std::size_t input_frame_dispatch(dispatch_operation operation, void* arg1, void*
     using namespace detail;
     typedef std::tuple<Args...> args_t;
     std::size_t const args_align = alignof(args_t);
-    std::size_t const status_offset = sizeof(formatter_dispatch_function_t*);
-    std::size_t const args_offset = (status_offset + sizeof(frame_status) +
+    // This must agree with basic_log::write(), which places the arguments
+    // after the whole frame header including its tail padding.
+    std::size_t const args_offset = (sizeof(frame_header) +
         args_align-1)/args_align*args_align;
     std::size_t const frame_size_unaligned = args_offset + sizeof(args_t);
     std::size_t const frame_size = (frame_size_unaligned +
@@ -0,0 +1,431 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_BINARY_LOG_HPP
+#define RECKLESS_BINARY_LOG_HPP
+
+#include <reckless/basic_log.hpp>
+#include <reckless/output_buffer.hpp>
+#include <reckless/detail/utility.hpp>  // dependent_false
+
+#include <cstdint>
+#include <cstring>      // memcpy, strlen
+#include <functional>   // hash
+#include <set>
+#include <stdexcept>    // runtime_error
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>      // forward
+
+#if defined(__unix__)
+#include <time.h>       // clock_gettime
+#endif
+
+namespace reckless {
+
+// A binary_log writes a compact binary stream instead of text. The worker
+// thread does no text formatting; each record holds an id for the format
+// string, a timestamp and the raw argument values. Each format string and
+// the types of its arguments are written once, the first time they are used.
+// binary_log_decoder (or the decode_binary_log tool) renders the stream as
+// the same text that a
+//
+//     policy_log<no_indent, ' ', timestamp_field>
+//
+// would have produced. The stream uses the byte order and type sizes of the
+// machine that wrote it, and must be decoded on a compatible machine.
+//
+// Arguments may be of any arithmetic type, pointers, char const* and
+// std::string. Strings are copied into the record, so a %p conversion of a
+// string argument can't show its original address. Custom types are not
+// supported since their format() functions would have to run on the worker
+// thread.
+//
+// The stream is made up of records, each starting with a one-byte tag:
+//
+//     'H' "RKB" version:u8 byte_order_mark:u16
+//         Written when the log is opened. Resets the set of definitions.
+//     'D' id:u32 signature_size:u16 format_size:u32 signature format
+//         Defines a format string. The signature has one character per
+//         argument, see binary_argument.
+//     'R' id:u32 payload_size:u32 timestamp:u64 arguments...
+//         A log record. The timestamp is in nanoseconds since 1970-01-01 UTC.
+//
+// If writer errors cause data to be lost, the records that refer to a lost
+// definition can't be decoded. The decoder skips them and counts them in
+// binary_log_decoder::undefined_record_count().
+
+class decode_error : public std::runtime_error {
+public:
+    decode_error(char const* what) :
+        runtime_error(what)
+    {
+    }
+};
+
+namespace detail {
+
+std::uint8_t const BINARY_LOG_VERSION = 1;
+std::uint16_t const BINARY_LOG_BYTE_ORDER_MARK = 0x0102;
+std::size_t const BINARY_LOG_HEADER_SIZE = 1 + 3 + 1 + 2;
+
+inline char* write_binary(char* p, void const* pvalue, std::size_t size)
+{
+    std::memcpy(p, pvalue, size);
+    return p + size;
+}
+
+template <class T>
+char* write_binary(char* p, T value)
+{
+    return write_binary(p, &value, sizeof(value));
+}
+
+// Describes how an argument of type T is stored in a record: code is its
+// character in the signature, size() the number of bytes it takes and
+// write() stores it. The codes are
+//
+//     c, a, A     char, signed char, unsigned char
+//     i, I, q, Q  signed and unsigned 32- and 64-bit integers
+//     f, d        float, double (long double is stored as double)
+//     p           pointer, stored as a 64-bit integer
+//     s           string, stored as a 32-bit length followed by the characters
+template <class T, class Enable = void>
+struct binary_argument {
+    static_assert(dependent_false<T>::value,
+        "this type can't be written to a binary_log");
+};
+
+template <char Code, class Stored>
+struct fixed_size_binary_argument {
+    static char const code = Code;
+    template <class T>
+    static std::size_t size(T const&)
+    {
+        return sizeof(Stored);
+    }
+    template <class T>
+    static char* write(char* p, T const& value)
+    {
+        return write_binary(p, static_cast<Stored>(value));
+    }
+};
+
+template <>
+struct binary_argument<char> : fixed_size_binary_argument<'c', char> {
+};
+template <>
+struct binary_argument<signed char> : fixed_size_binary_argument<'a', signed char> {
+};
+template <>
+struct binary_argument<unsigned char> : fixed_size_binary_argument<'A', unsigned char> {
+};
+
+template <class T>
+struct is_binary_integer : std::integral_constant<bool,
+    std::is_integral<T>::value
+    && !std::is_same<T, char>::value
+    && !std::is_same<T, signed char>::value
+    && !std::is_same<T, unsigned char>::value
+    && !std::is_same<T, wchar_t>::value
+    && !std::is_same<T, char16_t>::value
+    && !std::is_same<T, char32_t>::value>
+{
+};
+
+template <class T>
+struct binary_argument<T, typename std::enable_if<
+    is_binary_integer<T>::value && std::is_signed<T>::value>::type> :
+    std::conditional<sizeof(T) <= 4,
+        fixed_size_binary_argument<'i', std::int32_t>,
+        fixed_size_binary_argument<'q', std::int64_t>>::type
+{
+};
+
+template <class T>
+struct binary_argument<T, typename std::enable_if<
+    is_binary_integer<T>::value && std::is_unsigned<T>::value>::type> :
+    std::conditional<sizeof(T) <= 4,
+        fixed_size_binary_argument<'I', std::uint32_t>,
+        fixed_size_binary_argument<'Q', std::uint64_t>>::type
+{
+};
+
+template <>
+struct binary_argument<float> : fixed_size_binary_argument<'f', float> {
+};
+template <>
+struct binary_argument<double> : fixed_size_binary_argument<'d', double> {
+};
+template <>
+struct binary_argument<long double> : fixed_size_binary_argument<'d', double> {
+};
+
+template <class T>
+struct binary_argument<T*> {
+    static char const code = 'p';
+    static std::size_t size(T*)
+    {
+        return sizeof(std::uint64_t);
+    }
+    static char* write(char* p, T* value)
+    {
+        return write_binary(p, static_cast<std::uint64_t>(
+            reinterpret_cast<std::uintptr_t>(value)));
+    }
+};
+
+struct string_binary_argument {
+    static char const code = 's';
+    static std::size_t size(char const* s)
+    {
+        return sizeof(std::uint32_t) + std::strlen(s);
+    }
+    static std::size_t size(std::string const& s)
+    {
+        return sizeof(std::uint32_t) + s.size();
+    }
+    static char* write(char* p, char const* s)
+    {
+        return write_string(p, s, std::strlen(s));
+    }
+    static char* write(char* p, std::string const& s)
+    {
+        return write_string(p, s.data(), s.size());
+    }
+
+private:
+    static char* write_string(char* p, char const* s, std::size_t size)
+    {
+        p = write_binary(p, static_cast<std::uint32_t>(size));
+        return write_binary(p, s, size);
+    }
+};
+
+template <>
+struct binary_argument<char const*> : string_binary_argument {
+};
+template <>
+struct binary_argument<char*> : string_binary_argument {
+};
+template <>
+struct binary_argument<std::string> : string_binary_argument {
+};
+
+template <class... Args>
+struct binary_signature {
+    static char const value[sizeof...(Args) + 1];
+};
+
+template <class... Args>
+char const binary_signature<Args...>::value[sizeof...(Args) + 1] = {
+    binary_argument<Args>::code..., '\0'};
+
+inline std::size_t binary_arguments_size()
+{
+    return 0;
+}
+
+template <class T, class... Args>
+std::size_t binary_arguments_size(T const& value, Args const&... args)
+{
+    typedef binary_argument<typename std::decay<T>::type> argument;
+    return argument::size(value) + binary_arguments_size(args...);
+}
+
+inline char* write_binary_arguments(char* p)
+{
+    return p;
+}
+
+template <class T, class... Args>
+char* write_binary_arguments(char* p, T const& value, Args const&... args)
+{
+    typedef binary_argument<typename std::decay<T>::type> argument;
+    p = argument::write(p, value);
+    return write_binary_arguments(p, args...);
+}
+
+// Keeps track of the format strings that have been defined in the stream.
+// Only accessed by the worker thread, or while it is not running.
+class binary_dictionary {
+public:
+    // Returns the id of the format string, writing its definition to the
+    // output buffer (and the stream header, if this is the first one) if it
+    // has not been defined yet.
+    std::uint32_t find_or_define(output_buffer* pbuffer, char const* pformat,
+        char const* psignature)
+    {
+        key k = {pformat, psignature};
+        auto it = ids_.find(k);
+        if(likely(it != ids_.end()))
+            return it->second;
+        return define(pbuffer, k);
+    }
+
+    // Forgets a definition whose output was discarded, so that it will be
+    // written again when it is used next time.
+    void undefine(char const* pformat, char const* psignature);
+
+    // Forgets all definitions, so that the next record starts a new stream.
+    void clear();
+
+private:
+    struct key {
+        char const* pformat;
+        char const* psignature;
+        bool operator==(key const& rhs) const
+        {
+            return pformat == rhs.pformat && psignature == rhs.psignature;
+        }
+    };
+    struct key_hash {
+        std::size_t operator()(key const& k) const
+        {
+            return std::hash<char const*>()(k.pformat)*31
+                + std::hash<char const*>()(k.psignature);
+        }
+    };
+
+    std::uint32_t define(output_buffer* pbuffer, key const& k);
+
+    std::unordered_map<key, std::uint32_t, key_hash> ids_;
+    std::uint32_t next_id_ = 0;
+    bool header_written_ = false;
+};
+
+// Captures the time in the calling thread, as nanoseconds since
+// 1970-01-01 UTC.
+std::uint64_t binary_timestamp();
+
+class binary_formatter {
+public:
+    template <typename... Args>
+    static void format(output_buffer* pbuffer, binary_dictionary* pdictionary,
+        std::uint64_t timestamp, char const* pformat, Args&&... args)
+    {
+        char const* psignature = binary_signature<
+            typename std::decay<Args>::type...>::value;
+        std::uint32_t id = pdictionary->find_or_define(pbuffer, pformat,
+            psignature);
+        std::size_t payload_size = sizeof(timestamp)
+            + binary_arguments_size(args...);
+        std::size_t size = 1 + 4 + 4 + payload_size;
+        char* p;
+        try {
+            p = pbuffer->reserve(size);
+        } catch(...) {
+            // If the definition was written in this frame then it is
+            // discarded along with the frame.
+            pdictionary->undefine(pformat, psignature);
+            throw;
+        }
+        *p = 'R';
+        p = write_binary(p + 1, id);
+        p = write_binary(p, static_cast<std::uint32_t>(payload_size));
+        p = write_binary(p, timestamp);
+        write_binary_arguments(p, args...);
+        pbuffer->commit(size);
+    }
+};
+
+}   // namespace detail
+
+class binary_log : public basic_log {
+public:
+    using basic_log::basic_log;
+    // The log must be closed before the dictionary is destroyed, since the
+    // worker thread uses it.
+    ~binary_log();
+
+    template <typename... Args>
+    void write(char const* fmt, Args&&... args)
+    {
+        basic_log::write<detail::binary_formatter>(
+            &dictionary_,
+            detail::binary_timestamp(),
+            fmt,
+            std::forward<Args>(args)...);
+    }
+
+    using basic_log::close;
+    void close(std::error_code& ec) noexcept override;
+
+private:
+    detail::binary_dictionary dictionary_;
+};
+
+// Renders a binary_log stream as text, to a writer.
+class binary_log_decoder {
+public:
+    binary_log_decoder(writer* pwriter,
+        std::size_t output_buffer_capacity = 1024*1024);
+
+    // Decode the complete records in [pdata, pdata+size) and return the number
+    // of bytes consumed. The bytes that were not consumed make up the start of
+    // an incomplete record, and should be passed again along with the data
+    // that follows them. Throws decode_error if the data is not a valid
+    // binary_log stream, and writer_error if the writer fails. Nothing of the
+    // record that caused the error is written.
+    std::size_t decode(void const* pdata, std::size_t size);
+
+    // Write all decoded text to the writer. Throws writer_error if it fails.
+    void flush();
+
+    // Number of records that could not be decoded because their format string
+    // was never defined.
+    unsigned undefined_record_count() const
+    {
+        return undefined_record_count_;
+    }
+
+private:
+    class decoder_buffer : public output_buffer {
+    public:
+        using output_buffer::output_buffer;
+        using output_buffer::frame_end;
+        using output_buffer::revert_frame;
+        using output_buffer::flush;
+    };
+
+    struct definition {
+        char const* pformat;
+        std::string signature;
+    };
+
+    std::size_t decode_record(char const* p, std::size_t size);
+    void format_record(definition const& def, char const* p, char const* pend);
+    void format_timestamp(std::uint64_t timestamp);
+
+    decoder_buffer buffer_;
+    bool header_seen_ = false;
+    std::unordered_map<std::uint32_t, definition> definitions_;
+    // The format strings need stable, unique addresses since the formatter
+    // caches what it learns about them by address. They are kept for the
+    // lifetime of the decoder, and identical strings share storage.
+    std::set<std::string> formats_;
+    unsigned undefined_record_count_ = 0;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_BINARY_LOG_HPP
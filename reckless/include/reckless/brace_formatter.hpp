@@ -0,0 +1,524 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_BRACE_FORMATTER_HPP
+#define RECKLESS_BRACE_FORMATTER_HPP
+
+#include <reckless/key_value.hpp>
+#include <reckless/template_formatter.hpp>  // invoke_custom_format
+#include <reckless/ntoa.hpp>                // conversion_specification
+#include <reckless/detail/utility.hpp>      // index_sequence
+
+#include <cstddef>      // size_t
+#include <type_traits>
+
+namespace reckless {
+
+// A format string that is parsed and checked at compile time. Create one with
+// RECKLESS_FORMAT("...").
+template <class String>
+struct brace_format_string {
+};
+
+// Wrap a string literal so that brace_log parses it at compile time, and
+// rejects malformed fields or references to missing arguments with a
+// compilation error.
+#define RECKLESS_FORMAT(s) \
+    [] { \
+        struct reckless_format_string { \
+            static constexpr char const* value() { return s; } \
+        }; \
+        return ::reckless::brace_format_string<reckless_format_string>(); \
+    }()
+
+namespace detail {
+
+// The parser below is written as C++11 constexpr functions so that it can run
+// both at compile time, for RECKLESS_FORMAT strings, and at run time on the
+// worker thread for ordinary format strings. Every function is therefore a
+// single return statement, and loops are recursion. Note that compilers limit
+// the recursion depth of constant expressions (512 calls by default in GCC
+// and clang), which limits the length of the literal text between two fields
+// in a RECKLESS_FORMAT string.
+
+unsigned const BRACE_NAMED_ARGUMENT = static_cast<unsigned>(-1);
+unsigned const BRACE_NO_PRECISION = static_cast<unsigned>(-1);
+
+enum class brace_segment_kind : unsigned char {
+    end,    // Literal text up to the end of the format string.
+    text,   // Literal text that ends with an escaped brace.
+    field,  // Literal text followed by a replacement field.
+    error   // Literal text that ends with a malformed field or a lone '}'.
+};
+
+// [[fill]align][sign]["#"]["0"][width]["." precision][type]
+struct brace_specification {
+    char fill;
+    char align;         // '<', '>', '^', or 0 for the default.
+    char sign;          // '+', ' ', or 0 for the default.
+    bool alternative_form;
+    bool zero_pad;
+    unsigned width;
+    unsigned precision; // BRACE_NO_PRECISION if not given.
+    char type;          // 0 for the default.
+};
+
+// A format string is a sequence of segments, each made up of literal text
+// followed by a replacement field, an escaped brace or the end of the string.
+// For escaped braces and errors, the brace itself is included in the literal
+// text.
+struct brace_segment {
+    std::size_t literal_begin;
+    std::size_t literal_end;
+    std::size_t end;            // Where the next segment begins.
+    brace_segment_kind kind;
+    unsigned argument_index;    // BRACE_NAMED_ARGUMENT for named fields.
+    std::size_t name_begin;
+    std::size_t name_end;
+    unsigned next_automatic_index;
+    brace_specification spec;
+};
+
+constexpr bool brace_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+constexpr bool brace_is_letter(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr bool brace_is_name_start(char c)
+{
+    return brace_is_letter(c) || c == '_';
+}
+
+constexpr bool brace_is_align(char c)
+{
+    return c == '<' || c == '>' || c == '^';
+}
+
+constexpr bool brace_is_sign(char c)
+{
+    return c == '+' || c == '-' || c == ' ';
+}
+
+constexpr std::size_t brace_skip_digits(char const* s, std::size_t pos)
+{
+    return brace_is_digit(s[pos])? brace_skip_digits(s, pos+1) : pos;
+}
+
+constexpr std::size_t brace_skip_name(char const* s, std::size_t pos)
+{
+    return brace_is_name_start(s[pos]) || brace_is_digit(s[pos])?
+        brace_skip_name(s, pos+1) : pos;
+}
+
+constexpr unsigned brace_parse_unsigned(char const* s, std::size_t pos,
+    unsigned value = 0)
+{
+    return brace_is_digit(s[pos])?
+        brace_parse_unsigned(s, pos+1, 10*value + (s[pos] - '0')) : value;
+}
+
+constexpr std::size_t brace_skip_if(char const* s, std::size_t pos, char c)
+{
+    return s[pos] == c? pos+1 : pos;
+}
+
+// Positions of the parts of a format specification starting at pos. Each part
+// may be empty.
+constexpr std::size_t brace_fill_align_size(char const* s, std::size_t pos)
+{
+    return s[pos] != '\0' && s[pos] != '{' && s[pos] != '}'
+            && brace_is_align(s[pos+1])? 2
+        : brace_is_align(s[pos])? 1
+        : 0;
+}
+
+constexpr std::size_t brace_sign_pos(char const* s, std::size_t pos)
+{
+    return pos + brace_fill_align_size(s, pos);
+}
+
+constexpr std::size_t brace_alternative_pos(char const* s, std::size_t pos)
+{
+    return brace_sign_pos(s, pos) + (brace_is_sign(s[brace_sign_pos(s, pos)])? 1 : 0);
+}
+
+constexpr std::size_t brace_zero_pos(char const* s, std::size_t pos)
+{
+    return brace_skip_if(s, brace_alternative_pos(s, pos), '#');
+}
+
+constexpr std::size_t brace_width_pos(char const* s, std::size_t pos)
+{
+    return brace_skip_if(s, brace_zero_pos(s, pos), '0');
+}
+
+constexpr std::size_t brace_precision_pos(char const* s, std::size_t pos)
+{
+    return brace_skip_digits(s, brace_width_pos(s, pos));
+}
+
+constexpr std::size_t brace_after_precision(char const* s, std::size_t pos)
+{
+    return s[pos] == '.'? brace_skip_digits(s, pos+1) : pos;
+}
+
+constexpr std::size_t brace_type_pos(char const* s, std::size_t pos)
+{
+    return brace_after_precision(s, brace_precision_pos(s, pos));
+}
+
+constexpr std::size_t brace_spec_end(char const* s, std::size_t pos)
+{
+    return brace_type_pos(s, pos) + (brace_is_letter(s[brace_type_pos(s, pos)])? 1 : 0);
+}
+
+constexpr bool brace_is_valid_spec(char const* s, std::size_t pos)
+{
+    return s[brace_spec_end(s, pos)] == '}' && !(
+        s[brace_precision_pos(s, pos)] == '.' &&
+        !brace_is_digit(s[brace_precision_pos(s, pos)+1]));
+}
+
+constexpr brace_specification brace_default_spec()
+{
+    return brace_specification{' ', 0, 0, false, false, 0, BRACE_NO_PRECISION, 0};
+}
+
+constexpr brace_specification brace_parse_spec(char const* s, std::size_t pos)
+{
+    return brace_specification{
+        brace_fill_align_size(s, pos) == 2? s[pos] : ' ',
+        brace_fill_align_size(s, pos) == 2? s[pos+1]
+            : brace_fill_align_size(s, pos) == 1? s[pos]
+            : static_cast<char>(0),
+        s[brace_sign_pos(s, pos)] == '+' || s[brace_sign_pos(s, pos)] == ' '?
+            s[brace_sign_pos(s, pos)] : static_cast<char>(0),
+        s[brace_alternative_pos(s, pos)] == '#',
+        s[brace_zero_pos(s, pos)] == '0',
+        brace_parse_unsigned(s, brace_width_pos(s, pos)),
+        s[brace_precision_pos(s, pos)] == '.'?
+            brace_parse_unsigned(s, brace_precision_pos(s, pos)+1)
+            : BRACE_NO_PRECISION,
+        brace_is_letter(s[brace_type_pos(s, pos)])?
+            s[brace_type_pos(s, pos)] : static_cast<char>(0)};
+}
+
+// The end of the argument id that starts at pos, which may be empty.
+constexpr std::size_t brace_id_end(char const* s, std::size_t pos)
+{
+    return brace_is_digit(s[pos])? brace_skip_digits(s, pos)
+        : brace_is_name_start(s[pos])? brace_skip_name(s, pos)
+        : pos;
+}
+
+constexpr unsigned brace_argument_index(char const* s, std::size_t id,
+    std::size_t id_end, unsigned automatic_index)
+{
+    return id == id_end? automatic_index
+        : brace_is_digit(s[id])? brace_parse_unsigned(s, id)
+        : BRACE_NAMED_ARGUMENT;
+}
+
+constexpr brace_segment brace_field_segment(char const* s,
+    std::size_t literal_begin, std::size_t brace, std::size_t id,
+    std::size_t id_end, unsigned automatic_index, std::size_t end,
+    brace_specification spec)
+{
+    return brace_segment{literal_begin, brace, end, brace_segment_kind::field,
+        brace_argument_index(s, id, id_end, automatic_index),
+        brace_is_name_start(s[id])? id : 0,
+        brace_is_name_start(s[id])? id_end : 0,
+        id == id_end? automatic_index + 1 : automatic_index,
+        spec};
+}
+
+constexpr brace_segment brace_literal_segment(std::size_t literal_begin,
+    std::size_t literal_end, std::size_t end, brace_segment_kind kind,
+    unsigned automatic_index)
+{
+    return brace_segment{literal_begin, literal_end, end, kind, 0, 0, 0,
+        automatic_index, brace_default_spec()};
+}
+
+constexpr brace_segment brace_parse_field(char const* s,
+    std::size_t literal_begin, std::size_t brace, std::size_t id_end,
+    unsigned automatic_index)
+{
+    return s[id_end] == '}'?
+            brace_field_segment(s, literal_begin, brace, brace+1, id_end,
+                automatic_index, id_end+1, brace_default_spec())
+        : s[id_end] == ':' && brace_is_valid_spec(s, id_end+1)?
+            brace_field_segment(s, literal_begin, brace, brace+1, id_end,
+                automatic_index, brace_spec_end(s, id_end+1)+1,
+                brace_parse_spec(s, id_end+1))
+        : brace_literal_segment(literal_begin, brace+1, brace+1,
+                brace_segment_kind::error, automatic_index);
+}
+
+// Parse the segment that starts at literal_begin, given the position of the
+// first brace or null character after it.
+constexpr brace_segment brace_parse_segment(char const* s,
+    std::size_t literal_begin, std::size_t brace, unsigned automatic_index)
+{
+    return s[brace] == '\0'?
+            brace_literal_segment(literal_begin, brace, brace,
+                brace_segment_kind::end, automatic_index)
+        : s[brace+1] == s[brace]?
+            brace_literal_segment(literal_begin, brace+1, brace+2,
+                brace_segment_kind::text, automatic_index)
+        : s[brace] == '}'?
+            brace_literal_segment(literal_begin, brace+1, brace+1,
+                brace_segment_kind::error, automatic_index)
+        : brace_parse_field(s, literal_begin, brace,
+                brace_id_end(s, brace+1), automatic_index);
+}
+
+constexpr std::size_t brace_find(char const* s, std::size_t pos)
+{
+    return s[pos] == '\0' || s[pos] == '{' || s[pos] == '}'?
+        pos : brace_find(s, pos+1);
+}
+
+constexpr brace_segment brace_next_segment(char const* s,
+    brace_segment const& previous)
+{
+    return brace_parse_segment(s, previous.end, brace_find(s, previous.end),
+        previous.next_automatic_index);
+}
+
+constexpr brace_segment brace_segment_at(char const* s, std::size_t index)
+{
+    return index == 0?
+        brace_parse_segment(s, 0, brace_find(s, 0), 0)
+        : brace_next_segment(s, brace_segment_at(s, index-1));
+}
+
+constexpr std::size_t brace_count_segments(char const* s,
+    brace_segment const& segment, std::size_t count)
+{
+    return segment.kind == brace_segment_kind::end? count
+        : brace_count_segments(s, brace_next_segment(s, segment), count+1);
+}
+
+constexpr std::size_t brace_segment_count(char const* s)
+{
+    return brace_count_segments(s, brace_segment_at(s, 0), 1);
+}
+
+enum class brace_format_error {
+    none,
+    malformed_field,
+    missing_argument
+};
+
+constexpr brace_format_error brace_check_segments(char const* s,
+    brace_segment const& segment, std::size_t argument_count)
+{
+    return segment.kind == brace_segment_kind::error?
+            brace_format_error::malformed_field
+        : segment.kind == brace_segment_kind::field
+            && segment.argument_index != BRACE_NAMED_ARGUMENT
+            && segment.argument_index >= argument_count?
+            brace_format_error::missing_argument
+        : segment.kind == brace_segment_kind::end?
+            brace_format_error::none
+        : brace_check_segments(s, brace_next_segment(s, segment),
+            argument_count);
+}
+
+constexpr brace_format_error brace_check_format(char const* s,
+    std::size_t argument_count)
+{
+    return brace_check_segments(s, brace_segment_at(s, 0), argument_count);
+}
+
+template <class String,
+    class Indices = typename make_index_sequence<
+        brace_segment_count(String::value())>::type>
+struct compiled_brace_format;
+
+template <class String, std::size_t... Indices>
+struct compiled_brace_format<String, index_sequence<Indices...>> {
+    static constexpr std::size_t size = sizeof...(Indices);
+    static constexpr brace_segment segments[sizeof...(Indices)] = {
+        brace_segment_at(String::value(), Indices)...};
+};
+
+template <class String, std::size_t... Indices>
+constexpr brace_segment
+    compiled_brace_format<String, index_sequence<Indices...>>::segments[
+        sizeof...(Indices)];
+
+// A type-erased reference to an argument. Numbers are converted directly by
+// ntoa, with padding, sign and alternative form from the field's format
+// specification. Everything else goes through its format() function with a
+// conversion specification made up of the type and precision, and is padded
+// by brace_formatter.
+struct brace_argument {
+    bool (*format_number)(output_buffer* pbuffer,
+        conversion_specification const& cs, char type, void const* pvalue);
+    char const* (*format)(output_buffer* pbuffer, char const* pspec,
+        void const* pvalue);
+    void const* pvalue;
+    char const* name;
+    char default_type;
+};
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, int value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, unsigned int value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, long value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, unsigned long value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, long long value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, unsigned long long value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, double value);
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, long double value);
+
+// Writes true or false by default, or 1 or 0 for integer conversions.
+char const* format_brace_bool(output_buffer* pbuffer, char const* pspec,
+    void const* pvalue);
+
+template <class T>
+bool erased_format_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, void const* pvalue)
+{
+    return format_brace_number(pbuffer, cs, type,
+        *static_cast<T const*>(pvalue));
+}
+
+template <class T>
+char const* erased_format(output_buffer* pbuffer, char const* pspec,
+    void const* pvalue)
+{
+    return invoke_custom_format(pbuffer, pspec, *static_cast<T const*>(pvalue));
+}
+
+template <class T>
+struct is_character : std::integral_constant<bool,
+    std::is_same<T, char>::value || std::is_same<T, signed char>::value ||
+    std::is_same<T, unsigned char>::value || std::is_same<T, wchar_t>::value ||
+    std::is_same<T, char16_t>::value || std::is_same<T, char32_t>::value>
+{
+};
+
+template <class T>
+struct is_brace_number : std::integral_constant<bool,
+    std::is_arithmetic<T>::value && !is_character<T>::value &&
+    !std::is_same<T, bool>::value>
+{
+};
+
+template <class T>
+brace_argument make_brace_argument(T const& value, std::true_type)
+{
+    return brace_argument{&erased_format_number<T>, nullptr, &value, nullptr,
+        std::is_floating_point<T>::value? 'g' : 'd'};
+}
+
+template <class T>
+brace_argument make_brace_argument(T const& value, std::false_type)
+{
+    typedef typename std::remove_cv<
+        typename std::remove_pointer<T>::type>::type pointee;
+    return brace_argument{nullptr, &erased_format<T>, &value, nullptr,
+        std::is_pointer<T>::value && !is_character<pointee>::value? 'p' : 's'};
+}
+
+template <class T>
+brace_argument make_brace_argument(T const& value)
+{
+    return make_brace_argument(value, is_brace_number<T>());
+}
+
+inline brace_argument make_brace_argument(bool const& value)
+{
+    return brace_argument{nullptr, &format_brace_bool, &value, nullptr, 's'};
+}
+
+template <class T>
+brace_argument make_brace_argument(key_value<T> const& named)
+{
+    brace_argument argument = make_brace_argument(named.value);
+    argument.name = named.key;
+    return argument;
+}
+
+void format_brace_segments(output_buffer* pbuffer, char const* pformat,
+    brace_segment const* psegments, std::size_t segment_count,
+    brace_argument const* parguments, std::size_t argument_count);
+
+void format_brace_string(output_buffer* pbuffer, char const* pformat,
+    brace_argument const* parguments, std::size_t argument_count);
+
+}   // namespace detail
+
+// Formats "{}"-style format strings, with the same syntax as std::format
+// (positional, automatic and named fields, fill, alignment, sign, width,
+// precision and type), except that width and precision can't be given as
+// nested fields. Numbers are converted by ntoa, and other arguments by the
+// same format() functions as for template_formatter, with the field's type
+// and precision as conversion specification.
+class brace_formatter {
+public:
+    template <typename... Args>
+    static void format(output_buffer* pbuffer, char const* pformat,
+            Args&&... args)
+    {
+        // The extra element avoids an array of size zero.
+        detail::brace_argument arguments[] = {
+            detail::make_brace_argument(args)..., detail::brace_argument()};
+        detail::format_brace_string(pbuffer, pformat, arguments,
+            sizeof...(Args));
+    }
+
+    template <class String, typename... Args>
+    static void format(output_buffer* pbuffer, brace_format_string<String>,
+            Args&&... args)
+    {
+        static_assert(detail::brace_check_format(String::value(),
+                sizeof...(Args)) != detail::brace_format_error::malformed_field,
+            "malformed replacement field in format string");
+        static_assert(detail::brace_check_format(String::value(),
+                sizeof...(Args)) != detail::brace_format_error::missing_argument,
+            "format string refers to an argument that was not passed");
+        using compiled = detail::compiled_brace_format<String>;
+        detail::brace_argument arguments[] = {
+            detail::make_brace_argument(args)..., detail::brace_argument()};
+        detail::format_brace_segments(pbuffer, String::value(),
+            compiled::segments, compiled::size, arguments, sizeof...(Args));
+    }
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_BRACE_FORMATTER_HPP
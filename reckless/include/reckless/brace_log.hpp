@@ -0,0 +1,68 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_BRACE_LOG_HPP
+#define RECKLESS_BRACE_LOG_HPP
+
+#include <reckless/policy_log.hpp>
+#include <reckless/brace_formatter.hpp>
+
+#include <utility>  // forward
+
+namespace reckless {
+
+// Like policy_log, but with "{}"-style format strings. Format strings wrapped
+// in RECKLESS_FORMAT are parsed and checked at compile time; others are
+// parsed on the worker thread. Arguments wrapped in kv() can be referred to
+// by name.
+template <class IndentPolicy = no_indent, char FieldSeparator = ' ', class... HeaderFields>
+class brace_log : public basic_log {
+public:
+    using basic_log::basic_log;
+
+    template <typename... Args>
+    void write(char const* fmt, Args&&... args)
+    {
+        basic_log::write<formatter>(
+                HeaderFields()...,
+                IndentPolicy(),
+                fmt,
+                std::forward<Args>(args)...);
+    }
+
+    template <class String, typename... Args>
+    void write(brace_format_string<String> fmt, Args&&... args)
+    {
+        basic_log::write<formatter>(
+                HeaderFields()...,
+                IndentPolicy(),
+                fmt,
+                std::forward<Args>(args)...);
+    }
+
+private:
+    typedef detail::basic_policy_formatter<brace_formatter, IndentPolicy,
+        FieldSeparator, HeaderFields...> formatter;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_BRACE_LOG_HPP
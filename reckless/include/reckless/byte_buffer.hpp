@@ -0,0 +1,105 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_BYTE_BUFFER_HPP
+#define RECKLESS_BYTE_BUFFER_HPP
+
+#include <cstddef>  // size_t
+#include <cstring>  // memcpy
+#include <memory>   // unique_ptr
+
+namespace reckless {
+
+class output_buffer;
+
+// Binary data for formatting in hexadecimal with template_formatter. Use
+// bytes() to create one. Only the pointer is captured, so the data must stay
+// alive until the log has formatted it, as with char const* arguments. Use
+// copy_bytes() otherwise.
+class byte_view {
+public:
+    byte_view(void const* data, std::size_t size) :
+        data_(static_cast<unsigned char const*>(data)),
+        size_(size)
+    {
+    }
+
+    unsigned char const* data() const
+    {
+        return data_;
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    unsigned char const* data_;
+    std::size_t size_;
+};
+
+// Like byte_view, but owns a copy of the data.
+class byte_buffer {
+public:
+    byte_buffer(void const* data, std::size_t size) :
+        data_(new unsigned char[size]),
+        size_(size)
+    {
+        if(size != 0)
+            std::memcpy(data_.get(), data, size);
+    }
+
+    unsigned char const* data() const
+    {
+        return data_.get();
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    std::unique_ptr<unsigned char[]> data_;
+    std::size_t size_;
+};
+
+inline byte_view bytes(void const* data, std::size_t size)
+{
+    return byte_view(data, size);
+}
+
+inline byte_buffer copy_bytes(void const* data, std::size_t size)
+{
+    return byte_buffer(data, size);
+}
+
+// Supported conversions are %x and %X for a string of hexadecimal digits,
+// "% x" to separate the bytes with spaces, and %#x for a multi-line dump in
+// the format of hexdump -C. A precision limits the number of bytes that are
+// formatted, e.g. %.64x.
+char const* format(output_buffer* pbuffer, char const* pformat, byte_view const& v);
+char const* format(output_buffer* pbuffer, char const* pformat, byte_buffer const& v);
+
+}   // namespace reckless
+
+#endif  // RECKLESS_BYTE_BUFFER_HPP
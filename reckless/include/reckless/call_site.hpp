@@ -0,0 +1,267 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_CALL_SITE_HPP
+#define RECKLESS_CALL_SITE_HPP
+
+#include <reckless/source_location.hpp>
+#include <reckless/category.hpp>
+#include <reckless/template_formatter.hpp>
+
+#include <cstdint>  // uint64_t
+#include <utility>  // forward
+
+// Calls to debug, info, warn and error below this severity are removed at
+// compile time. Define it as 'I', 'W' or 'E' before including reckless, or on
+// the compiler command line. Use RECKLESS_LOG so that the arguments are not
+// evaluated either.
+#ifndef RECKLESS_MIN_SEVERITY
+#define RECKLESS_MIN_SEVERITY 'D'
+#endif
+
+namespace reckless {
+
+// Everything about a log call that is the same every time it runs. The
+// RECKLESS_LOG, RECKLESS_LOG_CATEGORY and RECKLESS_WRITE macros create one as
+// a static object at each call site, and the record stores a pointer to it
+// instead of the format string, severity, source location and category.
+// Since the format string is always the same literal, the worker's format
+// cache always hits for it.
+struct call_site {
+    source_location location;
+    char const* format;
+    // 'D', 'I', 'W' or 'E' for the severity_log functions, or 0 for write().
+    char severity;
+    // Null unless written with RECKLESS_LOG_CATEGORY.
+    category const* pcategory;
+};
+
+namespace detail {
+// Maps the name of a log function to the severity it writes, for
+// RECKLESS_LOG.
+struct call_site_severity {
+    static constexpr char write = 0;
+    static constexpr char debug = 'D';
+    static constexpr char info = 'I';
+    static constexpr char warn = 'W';
+    static constexpr char error = 'E';
+};
+
+// Severities in increasing order. Anything that isn't one of the four
+// severities, e.g. the 0 used for write(), ranks above all of them so that
+// it is never filtered.
+constexpr unsigned severity_rank(char severity)
+{
+    return severity == 'D'? 0 :
+        severity == 'I'? 1 :
+        severity == 'W'? 2 :
+        severity == 'E'? 3 : 4;
+}
+
+// A mask with bit n set for each severity of rank n that is enabled, when
+// the minimum severity is min_severity.
+unsigned const ALL_SEVERITIES = 0x1f;
+constexpr unsigned severity_mask(char min_severity)
+{
+    return ALL_SEVERITIES & ~((1u << severity_rank(min_severity)) - 1);
+}
+
+constexpr bool severity_compiled_in(char severity)
+{
+    return severity_rank(severity) >= severity_rank(RECKLESS_MIN_SEVERITY);
+}
+
+// Asks a log whether it currently accepts a severity, for logs that filter
+// at run time. Other logs accept everything.
+template <class Log>
+auto severity_enabled(Log const& log, char severity, int)
+    -> decltype(log.severity_enabled(severity))
+{
+    return log.severity_enabled(severity);
+}
+
+template <class Log>
+bool severity_enabled(Log const&, char, long)
+{
+    return true;
+}
+
+// A rule for the category takes precedence over the log, so that a category
+// can be made more verbose than the rest of the log.
+template <class Log>
+bool call_site_enabled(Log const& log, category const* pcategory,
+    char severity)
+{
+    if(pcategory) {
+        unsigned mask = pcategory->mask();
+        if(mask & CATEGORY_HAS_RULE)
+            return (mask & (1u << severity_rank(severity))) != 0;
+    }
+    return severity_enabled(log, severity, 0);
+}
+
+// The number of calls from a call site that were suppressed by sampling
+// since the last record that was written from it. See sampling.hpp.
+struct suppressed_count {
+    std::uint64_t count;
+};
+
+// Passed by the RECKLESS_LOG macros, which have already checked that the
+// severity is compiled in and enabled, so that a log which would otherwise
+// check it again can skip that. Logs that don't check the severity take it as
+// a plain call site pointer.
+struct checked_call_site {
+    call_site const* psite;
+
+    operator call_site const*() const
+    {
+        return psite;
+    }
+};
+
+// Takes the place of template_formatter in records written through a call
+// site.
+class call_site_formatter {
+public:
+    template <typename... Args>
+    static void format(output_buffer* pbuffer, call_site const* psite,
+        Args&&... args)
+    {
+        template_formatter::format(pbuffer, psite->format,
+            std::forward<Args>(args)...);
+    }
+
+    // Records written through a sampler start with the number of calls
+    // that it suppressed, which is appended to the message.
+    template <typename... Args>
+    static void format(output_buffer* pbuffer, call_site const* psite,
+        suppressed_count suppressed, Args&&... args)
+    {
+        template_formatter::format(pbuffer, psite->format,
+            std::forward<Args>(args)...);
+        if(suppressed.count != 0) {
+            template_formatter::format(pbuffer, " (%d suppressed)",
+                suppressed.count);
+        }
+    }
+};
+
+// Header fields that only depend on the call site are replaced with empty
+// placeholders in records written through a call site, and formatted from
+// the call site by the worker. This maps each header field to the type that
+// is stored in the record.
+template <class HeaderField>
+struct call_site_header_field {
+    typedef HeaderField type;
+};
+
+class call_site_location_field {
+};
+
+template <>
+struct call_site_header_field<source_location_field> {
+    typedef call_site_location_field type;
+};
+
+template <class Field, class Format>
+void format_header_field(output_buffer* pbuffer, Field& field, Format const&)
+{
+    field.format(pbuffer);
+}
+
+// For fields with a MAX_SIZE; see basic_policy_formatter.
+template <class Field, class Format>
+char* format_header_field(char* p, Field& field, Format const&)
+{
+    return field.format(p);
+}
+
+inline void format_header_field(output_buffer* pbuffer,
+    call_site_location_field, call_site const* psite)
+{
+    source_location_field(&psite->location).format(pbuffer);
+}
+
+class call_site_category_field {
+};
+
+template <>
+struct call_site_header_field<category_field> {
+    typedef call_site_category_field type;
+};
+
+inline void format_header_field(output_buffer* pbuffer,
+    call_site_category_field, call_site const* psite)
+{
+    category_field(psite->pcategory).format(pbuffer);
+}
+
+#if defined(_MSC_VER) && (!defined(_MSVC_TRADITIONAL) || _MSVC_TRADITIONAL)
+#define RECKLESS_DETAIL_EXPAND(x) x
+#define RECKLESS_DETAIL_FIRST(...) \
+    RECKLESS_DETAIL_EXPAND(RECKLESS_DETAIL_FIRST_(__VA_ARGS__, unused))
+#else
+#define RECKLESS_DETAIL_FIRST(...) RECKLESS_DETAIL_FIRST_(__VA_ARGS__, unused)
+#endif
+#define RECKLESS_DETAIL_FIRST_(first, ...) first
+}   // namespace detail
+
+// Call a write function on a log through a static call site, e.g.
+//
+//     RECKLESS_LOG(g_log, info, "connected to %s", host);
+//
+// function is write, debug, info, warn or error. This works with policy_log,
+// severity_log and structured_log. The format string must be a string
+// literal, since it is stored in the call site the first time the call runs.
+// If the severity is below RECKLESS_MIN_SEVERITY or disabled in the log, the
+// arguments are not evaluated.
+#define RECKLESS_LOG(log, function, ...) \
+    RECKLESS_DETAIL_LOG(log, nullptr, function, __VA_ARGS__)
+
+// The same as RECKLESS_LOG, but through a category, which must be a static
+// object. If the category has a minimum severity, it is used instead of the
+// log's.
+#define RECKLESS_LOG_CATEGORY(log, category, function, ...) \
+    RECKLESS_DETAIL_LOG(log, &(category), function, __VA_ARGS__)
+
+#define RECKLESS_DETAIL_LOG(log, pcategory, function, ...) \
+    do { \
+        if(::reckless::detail::severity_compiled_in( \
+                ::reckless::detail::call_site_severity::function) \
+            && ::reckless::detail::call_site_enabled((log), pcategory, \
+                ::reckless::detail::call_site_severity::function)) \
+        { \
+            static ::reckless::call_site const reckless_call_site = { \
+                {__FILE__, __LINE__, __func__}, \
+                "" RECKLESS_DETAIL_FIRST(__VA_ARGS__), \
+                ::reckless::detail::call_site_severity::function, \
+                pcategory}; \
+            (log).function( \
+                ::reckless::detail::checked_call_site{&reckless_call_site}, \
+                __VA_ARGS__); \
+        } \
+    } while(false)
+
+#define RECKLESS_WRITE(log, ...) RECKLESS_LOG(log, write, __VA_ARGS__)
+
+}   // namespace reckless
+
+#endif  // RECKLESS_CALL_SITE_HPP
@@ -0,0 +1,124 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_CATEGORY_HPP
+#define RECKLESS_CATEGORY_HPP
+
+#include <reckless/detail/platform.hpp> // atomic_load_relaxed, likely
+
+#include <cstdint>  // uint64_t
+#include <string>
+#include <vector>
+
+namespace reckless {
+
+class output_buffer;
+
+namespace detail {
+// Incremented whenever the category rules change, so that each category can
+// tell whether its cached mask is out of date. Kept on a cache line of its
+// own, since it is read on every call through a category and rarely written.
+struct category_generation_t {
+    char padding1[RECKLESS_CACHE_LINE_SIZE];
+    std::uint64_t value;
+    char padding2[RECKLESS_CACHE_LINE_SIZE - sizeof(std::uint64_t)];
+};
+extern category_generation_t category_generation;
+
+// Set in a category's mask if a rule applies to it. Otherwise the category
+// has no opinion and the log decides.
+unsigned const CATEGORY_HAS_RULE = 0x80;
+}
+
+// A named subsystem that writes to a log, e.g. "net.tcp.retransmit". The dots
+// make up a hierarchy: a minimum severity set for "net" applies to every
+// category below it, unless a more specific one is set for "net.tcp". The
+// minimum severities can be changed at any time with
+// set_category_min_severity.
+//
+// Categories are meant to be static objects, and are used with the
+// RECKLESS_LOG_CATEGORY macro in call_site.hpp. The name is not copied, so it
+// should be a string literal.
+class category {
+public:
+    explicit category(char const* name);
+    ~category();
+
+    category(category const&) = delete;
+    category& operator=(category const&) = delete;
+
+    char const* name() const
+    {
+        return name_;
+    }
+
+    // Returns a mask with bit n set for the severities of rank n that are
+    // enabled, and CATEGORY_HAS_RULE if any rule applies to this category.
+    unsigned mask() const
+    {
+        std::uint64_t state = detail::atomic_load_relaxed(&state_);
+        std::uint64_t generation = detail::atomic_load_relaxed(
+            &detail::category_generation.value);
+        if(detail::likely(state >> 8 == generation))
+            return static_cast<unsigned>(state & 0xff);
+        return refresh();
+    }
+
+private:
+    unsigned refresh() const;
+
+    char const* name_;
+    // The generation in the upper bits, and the mask that was computed for
+    // it in the lowest 8 bits.
+    mutable std::uint64_t state_;
+};
+
+// Discard records below severity ('D', 'I', 'W' or 'E') from the category with
+// the given name and the categories below it, regardless of the minimum
+// severity of the log. The name doesn't need to belong to a registered
+// category.
+void set_category_min_severity(char const* name, char severity);
+
+// Remove the minimum severity that was set for the given name, so that its
+// categories follow the next less specific rule, or the log if there is none.
+void clear_category_min_severity(char const* name);
+
+// The names of all categories that currently exist.
+std::vector<std::string> category_names();
+
+// Writes the name of the category that a record was written through, or '-'
+// for records that weren't written through RECKLESS_LOG_CATEGORY.
+class category_field {
+public:
+    category_field(category const* pcategory = nullptr) :
+        pcategory_(pcategory)
+    {
+    }
+
+    void format(output_buffer* pbuffer) const;
+
+private:
+    category const* pcategory_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_CATEGORY_HPP
@@ -0,0 +1,226 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_CLOCK_HPP
+#define RECKLESS_CLOCK_HPP
+
+#include <reckless/detail/platform.hpp> // rdtsc, likely, RECKLESS_TLS
+
+#include <cstdint>  // uint64_t
+#include <time.h>   // clock_gettime
+
+namespace reckless {
+
+// Clock sources for timestamp fields. A clock source captures a raw time
+// value in the calling thread with now(), and the output worker converts it
+// to nanoseconds since 1970-01-01 UTC with to_realtime(). now() runs on every
+// call to write(), so the clocks differ mainly in what that costs and what
+// resolution you get for it.
+
+#if defined(_WIN32)
+namespace detail {
+extern "C" {
+    void __stdcall GetSystemTimeAsFileTime(void* lpSystemTimeAsFileTime);
+    void __stdcall GetSystemTimePreciseAsFileTime(void* lpSystemTimeAsFileTime);
+    int __stdcall QueryPerformanceCounter(std::int64_t* lpPerformanceCount);
+    int __stdcall QueryPerformanceFrequency(std::int64_t* lpFrequency);
+    unsigned long long __stdcall GetTickCount64();
+}
+
+// FILETIME counts 100-nanosecond intervals since 1601-01-01.
+inline std::uint64_t filetime_to_realtime(std::uint64_t intervals)
+{
+    std::uint64_t const epoch_difference = 116444736000000000u;
+    return (intervals - epoch_difference)*100;
+}
+}
+#endif
+
+// The system's wall-clock time, at the resolution of the scheduler tick
+// (1-4 ms on Linux, 0.5-16 ms on Windows). This is the cheapest clock, but
+// records written in a burst will get the same timestamp.
+class coarse_realtime_clock {
+public:
+    static std::uint64_t now()
+    {
+#if defined(__unix__)
+        struct timespec ts;
+#if defined(__linux__)
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+#else
+        clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+        return static_cast<std::uint64_t>(ts.tv_sec)*1000000000u + ts.tv_nsec;
+#elif defined(_WIN32)
+        std::uint64_t intervals;
+        detail::GetSystemTimeAsFileTime(&intervals);
+        return detail::filetime_to_realtime(intervals);
+#else
+        static_assert(false, "coarse_realtime_clock is not implemented for this OS")
+#endif
+    }
+
+    static std::uint64_t to_realtime(std::uint64_t raw)
+    {
+        return raw;
+    }
+};
+
+// The system's wall-clock time at full resolution.
+class realtime_clock {
+public:
+    static std::uint64_t now()
+    {
+#if defined(__unix__)
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return static_cast<std::uint64_t>(ts.tv_sec)*1000000000u + ts.tv_nsec;
+#elif defined(_WIN32)
+        std::uint64_t intervals;
+        detail::GetSystemTimePreciseAsFileTime(&intervals);
+        return detail::filetime_to_realtime(intervals);
+#else
+        static_assert(false, "realtime_clock is not implemented for this OS")
+#endif
+    }
+
+    static std::uint64_t to_realtime(std::uint64_t raw)
+    {
+        return raw;
+    }
+};
+
+namespace detail {
+// Calibration of a clock against the wall clock, kept per output worker. The
+// worker converts raw time t to realtime + (t - raw)*ns_per_tick, and
+// recalibrates when it sees a raw time past recalibrate_at.
+struct clock_calibration {
+    std::uint64_t raw;
+    std::uint64_t realtime;
+    std::uint64_t monotonic;
+    double ns_per_tick;
+    std::uint64_t recalibrate_at;
+};
+
+void calibrate_monotonic_clock(clock_calibration* pcalibration);
+void calibrate_tsc_clock(clock_calibration* pcalibration);
+
+extern RECKLESS_TLS clock_calibration monotonic_calibration;
+extern RECKLESS_TLS clock_calibration tsc_calibration;
+
+inline std::uint64_t convert_calibrated(clock_calibration const& calibration,
+    std::uint64_t raw)
+{
+    // Records may have been captured before the last calibration, so the
+    // difference can be negative.
+    std::int64_t ticks = static_cast<std::int64_t>(raw - calibration.raw);
+    return calibration.realtime + static_cast<std::int64_t>(
+        static_cast<double>(ticks)*calibration.ns_per_tick);
+}
+
+inline std::uint64_t monotonic_now()
+{
+#if defined(__unix__)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::uint64_t>(ts.tv_sec)*1000000000u + ts.tv_nsec;
+#elif defined(_WIN32)
+    std::int64_t count;
+    detail::QueryPerformanceCounter(&count);
+    return static_cast<std::uint64_t>(count);
+#else
+    static_assert(false, "monotonic_clock is not implemented for this OS")
+#endif
+}
+
+// Nanoseconds on a monotonic clock at scheduler-tick resolution, for
+// measuring intervals in the calling thread where precision doesn't matter.
+inline std::uint64_t coarse_monotonic_now()
+{
+#if defined(__unix__)
+    struct timespec ts;
+#if defined(__linux__)
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return static_cast<std::uint64_t>(ts.tv_sec)*1000000000u + ts.tv_nsec;
+#elif defined(_WIN32)
+    return static_cast<std::uint64_t>(detail::GetTickCount64())*1000000u;
+#else
+    static_assert(false, "coarse_monotonic_now is not implemented for this OS")
+#endif
+}
+}   // namespace detail
+
+// A clock that never jumps, even if the wall clock is set. The worker keeps
+// track of its offset from the wall clock and updates it every second, so a
+// step in the wall clock shows up in timestamps within a second.
+class monotonic_clock {
+public:
+    static std::uint64_t now()
+    {
+        return detail::monotonic_now();
+    }
+
+    static std::uint64_t to_realtime(std::uint64_t raw)
+    {
+        detail::clock_calibration& calibration = detail::monotonic_calibration;
+        if(detail::unlikely(raw >= calibration.recalibrate_at))
+            detail::calibrate_monotonic_clock(&calibration);
+        return detail::convert_calibrated(calibration, raw);
+    }
+};
+
+// The processor's time-stamp counter. Reading it is cheaper than a precise
+// clock_gettime() even through the vDSO, and its resolution is a fraction of
+// a nanosecond. It requires an invariant TSC,
+// i.e. one that runs at constant rate and is synchronized across cores,
+// which is the case on x86 processors from the last decade.
+//
+// The worker measures the TSC frequency against the monotonic clock, and
+// anchors it to the wall clock. Both are redone every second, which tracks
+// frequency drift and NTP slews, and picks up steps in the wall clock. The
+// first conversion in a worker takes about 10 ms for the initial measurement.
+// On other architectures than x86 this is the same as monotonic_clock.
+class tsc_clock {
+public:
+    static std::uint64_t now()
+    {
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+        return detail::rdtsc();
+#else
+        return detail::monotonic_now();
+#endif
+    }
+
+    static std::uint64_t to_realtime(std::uint64_t raw)
+    {
+        detail::clock_calibration& calibration = detail::tsc_calibration;
+        if(detail::unlikely(raw >= calibration.recalibrate_at))
+            detail::calibrate_tsc_clock(&calibration);
+        return detail::convert_calibrated(calibration, raw);
+    }
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_CLOCK_HPP
@@ -0,0 +1,108 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_DATAGRAM_WRITER_HPP
+#define RECKLESS_DATAGRAM_WRITER_HPP
+
+#include <reckless/writer.hpp>
+
+#include <string>
+
+namespace reckless {
+
+// Sends each log line as a separate datagram, e.g. to a local syslog daemon
+// over a Unix datagram socket or to a log collector over UDP. The lines in a
+// flushed output buffer are sent in batches with sendmmsg(), without copying
+// them out of the buffer. The trailing newline of each line is not sent.
+//
+// This writer is only available on Linux.
+class datagram_writer : public writer {
+public:
+    // Facility and severity values from RFC 5424, section 6.2.1.
+    enum facility {
+        facility_user = 1,
+        facility_daemon = 3,
+        facility_local0 = 16,
+        facility_local1 = 17,
+        facility_local2 = 18,
+        facility_local3 = 19,
+        facility_local4 = 20,
+        facility_local5 = 21,
+        facility_local6 = 22,
+        facility_local7 = 23
+    };
+    enum severity {
+        severity_emergency = 0,
+        severity_alert = 1,
+        severity_critical = 2,
+        severity_error = 3,
+        severity_warning = 4,
+        severity_notice = 5,
+        severity_informational = 6,
+        severity_debug = 7
+    };
+
+    // Connect to a Unix datagram socket, e.g. "/dev/log".
+    explicit datagram_writer(char const* socket_path);
+    // Send UDP datagrams to the given host and port.
+    datagram_writer(char const* host, unsigned short port);
+    ~datagram_writer();
+
+    // Lines that are longer than this, including any RFC 5424 header, are
+    // truncated. The default is 2048 bytes, which is what RFC 5424 says that
+    // all receivers should accept. Throws std::invalid_argument if the size
+    // leaves no room for the line after the header.
+    void max_datagram_size(std::size_t size);
+
+    // Prefix each datagram with an RFC 5424 header. The timestamp in the
+    // header is the time when the datagram was sent, which may be slightly
+    // later than the time the log line was written. Call this before the
+    // writer is passed to a log. Throws std::invalid_argument if the header
+    // leaves no room for the line within max_datagram_size.
+    void rfc5424_framing(char const* app_name,
+        facility fac = facility_user,
+        severity sev = severity_informational);
+
+    std::size_t write(void const* pbuffer, std::size_t count,
+            std::error_code& ec) noexcept override;
+
+private:
+    datagram_writer(datagram_writer const&) = delete;
+    datagram_writer& operator=(datagram_writer const&) = delete;
+
+    std::size_t format_header(char* pheader);
+    bool reconnect();
+
+    int fd_ = -1;
+    std::string socket_path_;
+    std::size_t max_datagram_size_ = 2048;
+    bool rfc5424_ = false;
+    unsigned priority_ = 0;
+    std::string header_suffix_;     // " HOSTNAME APP-NAME PROCID - - "
+    // The start of a line whose end has not been passed to write() yet,
+    // which happens when the output buffer is flushed in the middle of a
+    // record. It is sent together with the rest of the line.
+    std::string partial_line_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_DATAGRAM_WRITER_HPP
@@ -37,11 +37,31 @@ public:
 
     std::size_t write(void const* pbuffer, std::size_t count, std::error_code& ec) noexcept override;
 
+#if defined(__linux__)
+    // When enabled and the file descriptor is a pipe, the output buffer
+    // pages are moved into the pipe with vmsplice() instead of being copied
+    // by write(). The output buffer has to replace every page it gives away,
+    // and the page faults for that cost about as much as the copy did, so
+    // this is off by default; see benchmarks/pipe_throughput.cpp. Call this
+    // before the writer is passed to a log.
+    void zero_copy_pipe(bool enable)
+    {
+        zero_copy_pipe_ = enable;
+    }
+    bool enable_page_gifts() noexcept override;
+#endif
+
 #if defined(__unix__)
     int fd_;
 #elif defined(_WIN32)
     void* handle_;
 #endif
+
+#if defined(__linux__)
+private:
+    bool zero_copy_pipe_ = false;
+    bool page_gifts_ = false;
+#endif
 };
 
 }   // namespace detail
@@ -0,0 +1,79 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_DETAIL_SHM_RING_HPP
+#define RECKLESS_DETAIL_SHM_RING_HPP
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+
+namespace reckless {
+namespace detail {
+
+// Layout of the first page of the shared-memory ring used by shm_writer and
+// shm_reader. The data area follows on the next page and is mapped twice in
+// a row, so that any range of up to capacity bytes starting anywhere in the
+// ring can be accessed as one contiguous block. The positions are 64-bit
+// counters that never wrap, just like in mpsc_ring_buffer.
+//
+// The writer and reader may be different processes, possibly built with
+// different compilers, so everything in here must be lock-free atomics or
+// plain integers of fixed size.
+struct shm_ring_header {
+    static std::uint64_t const MAGIC = 0x676e69726b636572ull;  // "reckring"
+    static std::uint32_t const VERSION = 1;
+
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t header_size;
+    std::uint64_t capacity;
+    std::atomic<std::uint32_t> writer_closed;
+
+    // Written by the producer.
+    alignas(64) std::atomic<std::uint64_t> write_position;
+    // Incremented after every write. Used as a futex word so the reader can
+    // sleep until there is more data.
+    std::atomic<std::uint32_t> write_sequence;
+
+    // Written by the consumer.
+    alignas(64) std::atomic<std::uint64_t> read_position;
+    std::atomic<std::uint32_t> reader_waiting;
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+    "shm_ring_header requires lock-free 64-bit atomics");
+
+// Map a ring of the given capacity (a multiple of the page size) from the
+// shared-memory object fd. Returns the header; the data area starts at
+// header_size bytes from it. Throws std::system_error on failure.
+shm_ring_header* map_shm_ring(int fd, std::size_t header_size,
+    std::size_t capacity);
+void unmap_shm_ring(shm_ring_header* pheader);
+
+void shm_ring_wake(std::atomic<std::uint32_t>* pword);
+void shm_ring_wait(std::atomic<std::uint32_t>* pword, std::uint32_t value,
+    unsigned milliseconds);
+
+}   // namespace detail
+}   // namespace reckless
+
+#endif  // RECKLESS_DETAIL_SHM_RING_HPP
@@ -0,0 +1,44 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_DETAIL_UTF8_HPP
+#define RECKLESS_DETAIL_UTF8_HPP
+
+#include <cstddef>  // size_t
+
+namespace reckless {
+class output_buffer;
+
+namespace detail {
+
+// Transcode a UTF-16 or UTF-32 string of the given length to UTF-8 and write
+// it to the output buffer. Unpaired surrogates and values that are not valid
+// code points are written as the replacement character U+FFFD. wchar_t
+// strings are treated as UTF-16 if wchar_t is two bytes wide (as on Windows),
+// and as UTF-32 otherwise.
+void write_utf8(output_buffer* pbuffer, char16_t const* s, std::size_t size);
+void write_utf8(output_buffer* pbuffer, char32_t const* s, std::size_t size);
+void write_utf8(output_buffer* pbuffer, wchar_t const* s, std::size_t size);
+
+}   // namespace detail
+}   // namespace reckless
+
+#endif  // RECKLESS_DETAIL_UTF8_HPP
@@ -93,6 +93,26 @@ struct make_index_sequence
     typedef typename make_index_sequence_helper<0, N>::type type;
 };
 
+// For static_assert in templates that must not be instantiated.
+template <class T>
+struct dependent_false : std::false_type
+{
+};
+
+template <bool... Values>
+struct all_of;
+
+template <>
+struct all_of<> : std::true_type
+{
+};
+
+template <bool Value, bool... Remaining>
+struct all_of<Value, Remaining...> :
+    std::integral_constant<bool, Value && all_of<Remaining...>::value>
+{
+};
+
 }
 }
 
@@ -24,8 +24,31 @@
 
 #include "detail/fd_writer.hpp"
 
+#include <atomic>
+#include <cstdint>  // uint64_t
+#include <memory>   // unique_ptr
+
 namespace reckless {
 
+// How a file_writer makes sure that data reaches stable storage. The syncing
+// is done by a helper thread owned by the writer, so neither the threads that
+// write to the log nor the log's output worker wait for the disk. Each sync
+// covers everything that was written since the previous one.
+enum class durability {
+    // Never sync; leave it to the operating system (the default).
+    none,
+    // Sync at a fixed interval, if anything was written since the last sync.
+    periodic,
+    // Sync every time the given number of bytes has been written.
+    every_n_bytes,
+    // Start writeback of every chunk of the given number of bytes as soon as
+    // it has been written, using sync_file_range() on Linux, to avoid
+    // building up large amounts of dirty pages. This does not flush file
+    // metadata or the disk's write cache, so it makes no durability
+    // guarantee. On other platforms it behaves like every_n_bytes.
+    background_writeback
+};
+
 class file_writer : public detail::fd_writer {
 public:
     file_writer(char const* path);
@@ -33,7 +56,45 @@ public:
     file_writer(wchar_t const* path);
 #endif
 
+    // Does a final sync of any remaining data, unless the policy is
+    // durability::none.
     ~file_writer();
+
+    // Set the durability policy. This must be done before the writer is
+    // passed to a log. interval_ms applies to durability::periodic and
+    // byte_threshold to the other modes.
+    void durability_policy(durability policy, unsigned interval_ms = 1000,
+        std::size_t byte_threshold = 1024*1024);
+
+    // The file offset up to which data has been written by this writer. The
+    // offsets start at the size of the file when it was opened.
+    std::uint64_t written_offset() const
+    {
+        return written_offset_.load(std::memory_order_acquire);
+    }
+
+    // The file offset up to which data is known to have reached stable
+    // storage (or, with durability::background_writeback, has been written
+    // back to the disk). Always less than or equal to written_offset().
+    std::uint64_t durable_offset() const
+    {
+        return durable_offset_.load(std::memory_order_acquire);
+    }
+
+    std::size_t write(void const* pbuffer, std::size_t count,
+            std::error_code& ec) noexcept override;
+
+private:
+    class syncer;
+
+    file_writer(file_writer const&) = delete;
+    file_writer& operator=(file_writer const&) = delete;
+
+    void init_offsets();
+
+    std::unique_ptr<syncer> psyncer_;
+    std::atomic<std::uint64_t> written_offset_{0};
+    std::atomic<std::uint64_t> durable_offset_{0};
 };
 
 }   // namespace reckless
@@ -0,0 +1,60 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_KEY_VALUE_HPP
+#define RECKLESS_KEY_VALUE_HPP
+
+#include <type_traits>  // decay, false_type, true_type
+#include <utility>      // forward
+
+namespace reckless {
+
+// A key and a value, for structured_log and for named fields in brace_log.
+// Use kv() to create one. The value is captured the same way as arguments to
+// policy_log::write, i.e. by copy, so that formatting can happen on the worker
+// thread.
+template <class T>
+struct key_value {
+    char const* key;
+    T value;
+};
+
+template <class T>
+key_value<typename std::decay<T>::type> kv(char const* key, T&& value)
+{
+    return {key, std::forward<T>(value)};
+}
+
+namespace detail {
+
+template <class T>
+struct is_key_value : std::false_type {
+};
+
+template <class T>
+struct is_key_value<key_value<T>> : std::true_type {
+};
+
+}   // namespace detail
+
+}   // namespace reckless
+
+#endif  // RECKLESS_KEY_VALUE_HPP
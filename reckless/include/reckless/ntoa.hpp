@@ -66,6 +66,7 @@ void itoa_base16(output_buffer* pbuffer, long long value, conversion_specificati
 void itoa_base16(output_buffer* pbuffer, unsigned long long value, conversion_specification const& cs);
 
 void ftoa_base10_f(output_buffer* pbuffer, double value, conversion_specification const& cs);
+void ftoa_base10_e(output_buffer* pbuffer, double value, conversion_specification const& cs);
 void ftoa_base10_g(output_buffer* pbuffer, double value, conversion_specification const& cs);
 
 namespace detail
@@ -120,6 +120,58 @@ public:
         commit(1);
     }
 
+    // Allow everything written so far during the current frame to be sent to
+    // the writer before the frame is complete. A formatter can call this
+    // between chunks of output to produce more than fits in the buffer. If
+    // the formatter fails afterwards, only the output since the last call is
+    // discarded.
+    void partial_frame_end()
+    {
+        pframe_end_ = pcommit_end_;
+        partial_frame_ = true;
+    }
+
+    // Leave the output between the offsets begin and end, measured like
+    // frame_size(), out when duplicate suppression (see
+    // basic_log::suppress_duplicates) compares the current record with the
+    // previous one. Header fields that differ between otherwise identical
+    // records, such as timestamps, are excluded this way.
+    void exclude_from_comparison(std::size_t begin, std::size_t end)
+    {
+        if(excluded_count_ < MAX_EXCLUDED_RANGES) {
+            excluded_[excluded_count_].begin = begin;
+            excluded_[excluded_count_].end = end;
+        }
+        // Once there are more ranges than we can store, the record is never
+        // considered a duplicate.
+        if(excluded_count_ <= MAX_EXCLUDED_RANGES)
+            ++excluded_count_;
+    }
+
+    // The number of bytes written since the start of the current frame, or
+    // since the last call to partial_frame_end(). Formatters can use this to
+    // measure what they wrote even if the buffer was flushed in between.
+    std::size_t frame_size() const
+    {
+        return pcommit_end_ - pframe_end_;
+    }
+
+    // What has been written during the current frame, or since the last call
+    // to partial_frame_end(). It is frame_size() bytes long and stays valid
+    // until the next call to reserve() or write().
+    char const* frame_data() const
+    {
+        return pframe_end_;
+    }
+
+    // Discard what has been written during the current frame after the first
+    // size bytes.
+    void truncate_frame(std::size_t size)
+    {
+        assert(size <= frame_size());
+        pcommit_end_ = pframe_end_ + size;
+    }
+
     unsigned output_buffer_full_count() const
     {
         return detail::atomic_load_relaxed(&output_buffer_full_count_);
@@ -139,6 +191,8 @@ protected:
     void frame_end()
     {
         pframe_end_ = pcommit_end_;
+        excluded_count_ = 0;
+        partial_frame_ = false;
     }
     // Notify that an input frame was lost because of a flush error.
     void lost_frame()
@@ -151,8 +205,23 @@ protected:
     {
         // Undo everything that has been written during the current input frame.
         pcommit_end_ = pframe_end_;
+        excluded_count_ = 0;
+        partial_frame_ = false;
     }
 
+    // Copy what has been written during the current input frame to p, except
+    // for the ranges passed to exclude_from_comparison(), and store the number
+    // of bytes copied in *psize. Returns false without copying everything if
+    // it would take more than capacity bytes, or if the frame can't be
+    // compared because some of it may already have been sent to the writer.
+    bool copy_frame_for_comparison(char* p, std::size_t capacity,
+        std::size_t* psize) const;
+
+    // Write s so that it ends up before everything that has been written
+    // during the current input frame. If some of the frame may already have
+    // been sent to the writer, s is written after it instead.
+    void insert_before_frame(char const* s, std::size_t size);
+
     bool has_complete_frame() const
     {
         return pframe_end_ != pbuffer_;
@@ -210,6 +279,8 @@ private:
     output_buffer(output_buffer const&) = delete;
     output_buffer& operator=(output_buffer const&) = delete;
 
+    static char* allocate_buffer(std::size_t& capacity, bool page_gifts);
+    void free_buffer() noexcept;
     char* reserve_slow_path(std::size_t size);
     void increment_output_buffer_full_count()
     {
@@ -221,6 +292,16 @@ private:
     char* pframe_end_ = nullptr;
     char* pcommit_end_ = nullptr;
     char* pbuffer_end_ = nullptr;
+    bool page_gifts_ = false;   // The writer takes ownership of written pages.
+    // Ranges passed to exclude_from_comparison() for the current frame.
+    static unsigned const MAX_EXCLUDED_RANGES = 4;
+    struct excluded_range {
+        std::size_t begin;
+        std::size_t end;
+    };
+    excluded_range excluded_[MAX_EXCLUDED_RANGES];
+    unsigned excluded_count_ = 0;
+    bool partial_frame_ = false;    // partial_frame_end() was called during the current frame.
     unsigned lost_input_frames_ = 0;
     std::error_code initial_error_;         // Keeps track of the first error that caused lost_input_frames_ to become non-zero.
     std::mutex writer_error_callback_mutex_;
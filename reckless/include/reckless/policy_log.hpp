@@ -24,145 +24,59 @@
 
 #include <reckless/basic_log.hpp>
 #include <reckless/template_formatter.hpp>
+#include <reckless/clock.hpp>
+#include <reckless/timestamp_format.hpp>
+#include <reckless/source_location.hpp>
+#include <reckless/call_site.hpp>
 #include <reckless/detail/platform.hpp> // RECKLESS_TLS
-#include <reckless/ntoa.hpp>    // detail::decimal_digits
 #include <utility>  // forward
+#include <type_traits>  // decay, integral_constant
 #include <cstring>  // memset
 #include <cstdlib>  // size_t
-#include <time.h>   // clock_gettime
+#include <cstdint>  // uint64_t
 
 namespace reckless {
 
-#if defined(_WIN32)
-namespace detail {
-extern "C" {
-    void __stdcall GetSystemTimeAsFileTime(void* lpSystemTimeAsFileTime);
-    int __stdcall FileTimeToLocalFileTime(void const* lpFileTime, void* lpLocalFileTime);
-    int __stdcall FileTimeToSystemTime(void const* lpFileTime, void* lpSystemTime);
-}
-}
-#endif
-
-class timestamp_field {
+// Writes the time at which the record was written. The time is captured with
+// Clock in the calling thread, and converted by the output worker; see
+// clock.hpp for the choice of clocks and timestamp_format.hpp for the choice
+// of formats.
+template <class Clock, class Format = local_time_format<3>>
+class basic_timestamp_field {
 public:
-#if defined(__unix__)
-    timestamp_field()
+    basic_timestamp_field() : raw_(Clock::now())
     {
-#if defined(__linux__)
-        clock_gettime(CLOCK_REALTIME_COARSE, &ts_);
-#else
-        clock_gettime(CLOCK_REALTIME, , &ts_);
-#endif
     }
 
+    static std::size_t const MAX_SIZE = Format::MAX_SIZE;
+
     bool format(output_buffer* pbuffer)
     {
-        struct tm tm;
-        localtime_r(&ts_.tv_sec, &tm);
-
-        format_timestamp(pbuffer,
-            tm.tm_year + 1900,
-            tm.tm_mon + 1,
-            tm.tm_mday,
-            tm.tm_hour,
-            tm.tm_min,
-            tm.tm_sec,
-            static_cast<unsigned short>(ts_.tv_nsec/1000000u));
-
+        char* p = pbuffer->reserve(MAX_SIZE);
+        pbuffer->commit(format(p) - p);
         return true;
     }
 
-private:
-    struct timespec ts_;
-
-#elif defined(_WIN32)
-
-    timestamp_field()
-    {
-        reckless::detail::GetSystemTimeAsFileTime(&ft_);
-    }
-
-    bool format(output_buffer* pbuffer)
+    char* format(char* p)
     {
-#pragma pack(push, 8)
-        struct SYSTEMTIME {
-            unsigned short wYear;
-            unsigned short wMonth;
-            unsigned short wDayOfWeek;
-            unsigned short wDay;
-            unsigned short wHour;
-            unsigned short wMinute;
-            unsigned short wSecond;
-            unsigned short wMilliseconds;
-        };
-#pragma pack(pop)
-        filetime ft_local;
-        reckless::detail::FileTimeToLocalFileTime(&ft_, &ft_local);
-        SYSTEMTIME st;
-        reckless::detail::FileTimeToSystemTime(&ft_local, &st);
-        format_timestamp(pbuffer,
-            st.wYear,
-            st.wMonth,
-            st.wDay,
-            st.wHour,
-            st.wMinute,
-            st.wSecond,
-            st.wMilliseconds);
-        return true;
+        return Format::write(p, Clock::to_realtime(raw_));
     }
 
 private:
-#pragma pack(push, 8)
-    struct filetime {
-        unsigned long dwLowDateTime;
-        unsigned long dwHighDateTime;
-    };
-#pragma pack(pop)
-    filetime ft_;
-#else
-    static_assert(false, "timestamp_field is not implemented for this OS")
-#endif
+    std::uint64_t raw_;
+};
 
+typedef basic_timestamp_field<coarse_realtime_clock> timestamp_field;
 
-    static void write_digit_pair(char* ptarget, std::size_t i,
-        unsigned short digits)
-    {
-        ptarget[i] = reckless::detail::decimal_digits[2*digits];
-        ptarget[i+1] = reckless::detail::decimal_digits[2*digits+1];
-    }
+// Header fields whose output differs between records that are otherwise the
+// same. Duplicate suppression (see basic_log::suppress_duplicates) doesn't
+// compare them. Specialize this for your own fields of that kind.
+template <class Field>
+struct volatile_field : std::false_type {
+};
 
-    static void format_timestamp(output_buffer* pbuffer,
-        unsigned short year, unsigned short month, unsigned short day,
-        unsigned short hour, unsigned short minute, unsigned short second,
-        unsigned short milliseconds)
-    {
-        // YYYY-MM-DD HH:MM:SS.FFF
-        char* p = pbuffer->reserve(4+1+2+1+2 + 1 + 2+1+2+1+2 + 1 + 3);
-
-        unsigned short century = year / 100;
-        year -= 100*century;
-
-        write_digit_pair(p, 0, century);
-        write_digit_pair(p, 2, year);
-        p[4] = '-';
-        write_digit_pair(p, 5, month);
-        p[7] = '-';
-        write_digit_pair(p, 8, day);
-        p[10] = ' ';
-
-        write_digit_pair(p, 11, hour);
-        p[13] = ':';
-        write_digit_pair(p, 14, minute);
-        p[16] = ':';
-        write_digit_pair(p, 17, second);
-        p[19] = '.';
-
-        unsigned short centiseconds = milliseconds/10;
-        milliseconds -= 10*centiseconds;
-        write_digit_pair(p, 20, centiseconds);
-        p[22] = reckless::detail::decimal_digits[2*milliseconds+1];
-        pbuffer->commit(23);
-    }
+template <class Clock, class Format>
+struct volatile_field<basic_timestamp_field<Clock, Format>> : std::true_type {
 };
 
 class scoped_indent
@@ -218,16 +132,72 @@ private:
     unsigned level_;
 };
 
-template <class IndentPolicy, char Separator, class... Fields>
-class policy_formatter {
+namespace detail {
+template <class T>
+struct void_type {
+    typedef void type;
+};
+
+// Header fields that have a MAX_SIZE also have a char* format(char* p), which
+// writes at most that many characters and returns the end of what it wrote.
+template <class Field, class = void>
+struct has_max_size : std::false_type {
+};
+
+template <class Field>
+struct has_max_size<Field, typename void_type<decltype(Field::MAX_SIZE)>::type> :
+    std::true_type
+{
+};
+
+// Whether the first of Fields has a MAX_SIZE.
+template <class... Fields>
+struct starts_with_fixed_field : std::false_type {
+};
+
+template <class Field, class... Remaining>
+struct starts_with_fixed_field<Field, Remaining...> :
+    has_max_size<typename std::decay<Field>::type>
+{
+};
+
+// The space needed for the fields with a MAX_SIZE at the start of Fields,
+// with a separator after each.
+template <class... Fields>
+struct fixed_fields_size : std::integral_constant<std::size_t, 0> {
+};
+
+template <bool Fixed, class Field, class... Remaining>
+struct fixed_fields_size_helper : std::integral_constant<std::size_t, 0> {
+};
+
+template <class Field, class... Remaining>
+struct fixed_fields_size_helper<true, Field, Remaining...> :
+    std::integral_constant<std::size_t, Field::MAX_SIZE + 1 +
+        fixed_fields_size<Remaining...>::value>
+{
+};
+
+template <class Field, class... Remaining>
+struct fixed_fields_size<Field, Remaining...> : fixed_fields_size_helper<
+    has_max_size<Field>::value, Field, Remaining...>
+{
+};
+
+// Writes the header fields and indentation, and then the message using
+// MessageFormatter. Shared by policy_log and brace_log, which differ only in
+// the syntax of their format strings.
+template <class MessageFormatter, class IndentPolicy, char Separator, class... Fields>
+class basic_policy_formatter {
 public:
-    template <typename... Args>
+    template <typename Format, typename... Args>
     static void format(output_buffer* pbuffer, Fields&&... fields,
-        IndentPolicy indent, char const* pformat, Args&&... args)
+        IndentPolicy indent, Format&& fmt, Args&&... args)
     {
-        format_fields(pbuffer, fields...);
+        format_fields(pbuffer, fmt, fields...);
         indent.apply(pbuffer);
-        template_formatter::format(pbuffer, pformat, std::forward<Args>(args)...);
+        MessageFormatter::format(pbuffer, std::forward<Format>(fmt),
+            std::forward<Args>(args)...);
 #if defined(_WIN32)
         auto p = pbuffer->reserve(2);
         p[0] = '\r';
@@ -241,19 +211,114 @@ public:
     }
 
 private:
-    template <class Field, class... Remaining>
-    static void format_fields(output_buffer* pbuffer, Field&& field, Remaining&&... remaining)
+    // The format is passed along so that fields can be formatted from the
+    // call site, when there is one.
+    template <class Format, class Field, class... Remaining>
+    static void format_fields(output_buffer* pbuffer, Format const& fmt,
+        Field&& field, Remaining&&... remaining)
+    {
+        format_field(pbuffer, fmt, starts_with_fixed_field<Field>(), field,
+            remaining...);
+    }
+    template <class Format>
+    static void format_fields(output_buffer*, Format const&)
+    {
+    }
+
+    template <class Format, class Field, class... Remaining>
+    static void format_field(output_buffer* pbuffer, Format const& fmt,
+        std::false_type, Field& field, Remaining&... remaining)
     {
-        field.format(pbuffer);
+        std::size_t begin = pbuffer->frame_size();
+        format_header_field(pbuffer, field, fmt);
+        if(volatile_field<typename std::decay<Field>::type>::value)
+            pbuffer->exclude_from_comparison(begin, pbuffer->frame_size());
         char* p = pbuffer->reserve(1);
         *p = Separator;
         pbuffer->commit(1);
-        format_fields(pbuffer, std::forward<Remaining>(remaining)...);
+        format_fields(pbuffer, fmt, remaining...);
+    }
+
+    // Consecutive fields with a MAX_SIZE are written with a single reserve()
+    // and commit() between them, rather than one for each field and
+    // separator.
+    template <class Format, class Field, class... Remaining>
+    static void format_field(output_buffer* pbuffer, Format const& fmt,
+        std::true_type, Field& field, Remaining&... remaining)
+    {
+        char* pstart = pbuffer->reserve(fixed_fields_size<
+            typename std::decay<Field>::type,
+            typename std::decay<Remaining>::type...>::value);
+        format_fixed_fields(pbuffer, pstart, pstart, fmt, field,
+            remaining...);
+    }
+
+    template <class Format, class Field, class... Remaining>
+    static void format_fixed_fields(output_buffer* pbuffer, char* pstart,
+        char* p, Format const& fmt, Field& field, Remaining&... remaining)
+    {
+        char* pfield = p;
+        p = format_header_field(p, field, fmt);
+        if(volatile_field<typename std::decay<Field>::type>::value) {
+            // Nothing has been committed since pstart was reserved.
+            std::size_t offset = pbuffer->frame_size();
+            pbuffer->exclude_from_comparison(offset + (pfield - pstart),
+                offset + (p - pstart));
+        }
+        *p++ = Separator;
+        next_fixed_field(pbuffer, pstart, p, fmt,
+            starts_with_fixed_field<Remaining...>(), remaining...);
+    }
+
+    template <class Format, class... Remaining>
+    static void next_fixed_field(output_buffer* pbuffer, char* pstart,
+        char* p, Format const& fmt, std::true_type, Remaining&... remaining)
+    {
+        format_fixed_fields(pbuffer, pstart, p, fmt, remaining...);
     }
-    static void format_fields(output_buffer*)
+
+    template <class Format, class... Remaining>
+    static void next_fixed_field(output_buffer* pbuffer, char* pstart,
+        char* p, Format const& fmt, std::false_type, Remaining&... remaining)
     {
+        pbuffer->commit(p - pstart);
+        format_fields(pbuffer, fmt, remaining...);
     }
 };
+}   // namespace detail
+
+namespace detail {
+// Header fields are default-constructed in the calling thread, except for
+// those that need something from the write call itself. Those have a
+// specialization of this (or of the two-argument version in
+// severity_log.hpp). psite is null for records that weren't written through a
+// call site.
+template <class HeaderField>
+HeaderField construct_header_field(call_site const*)
+{
+     return HeaderField();
+}
+
+template <>
+inline source_location_field construct_header_field<source_location_field>(
+    call_site const* psite)
+{
+     return source_location_field(psite? &psite->location : nullptr);
+}
+
+template <>
+inline category_field construct_header_field<category_field>(
+    call_site const* psite)
+{
+     return category_field(psite? psite->pcategory : nullptr);
+}
+}   // namespace detail
+
+template <class IndentPolicy, char Separator, class... Fields>
+class policy_formatter : public detail::basic_policy_formatter<
+    template_formatter, IndentPolicy, Separator, Fields...>
+{
+};
 
 template <class IndentPolicy = no_indent, char FieldSeparator = ' ', class... HeaderFields>
 class policy_log : public basic_log {
@@ -269,6 +334,35 @@ public:
                 fmt,
                 std::forward<Args>(args)...);
     }
+
+    // Write through a static call site, which is stored in the record in
+    // place of the format string and source location. Use the
+    // RECKLESS_WRITE macro rather than calling these directly.
+    template <typename... Args>
+    void write(call_site const* psite, char const*, Args&&... args)
+    {
+        write_call_site(psite, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void write(call_site const* psite, detail::suppressed_count suppressed,
+        char const*, Args&&... args)
+    {
+        write_call_site(psite, suppressed, std::forward<Args>(args)...);
+    }
+
+private:
+    template <typename... Args>
+    void write_call_site(call_site const* psite, Args&&... args)
+    {
+        basic_log::write<detail::basic_policy_formatter<
+            detail::call_site_formatter, IndentPolicy, FieldSeparator,
+            typename detail::call_site_header_field<HeaderFields>::type...>>(
+                typename detail::call_site_header_field<HeaderFields>::type()...,
+                IndentPolicy(),
+                psite,
+                std::forward<Args>(args)...);
+    }
 };
 
 }   // namespace reckless
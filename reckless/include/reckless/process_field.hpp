@@ -0,0 +1,118 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_PROCESS_FIELD_HPP
+#define RECKLESS_PROCESS_FIELD_HPP
+
+#include <reckless/output_buffer.hpp>
+
+#include <atomic>
+#include <cstddef>  // size_t
+#include <cstring>  // memcpy
+
+namespace reckless {
+
+// Header fields that are the same for every record from the process. Their
+// text is rendered when a log is opened, the first time in each process, and
+// then copied into every record.
+
+namespace detail {
+struct process_field_text {
+    std::size_t size;
+    char text[64];
+};
+
+extern process_field_text pid_text;
+extern process_field_text hostname_text;
+// set_app_name() may be called while workers format records, so it publishes
+// a new immutable text rather than changing the one they may be reading. Old
+// texts are never freed.
+extern std::atomic<process_field_text const*> app_name_text;
+
+// Called by basic_log::open(). Renders the text again in a child process
+// after fork(), since the process id differs there.
+void render_process_fields();
+
+inline char* write_process_field(char* p, process_field_text const& text)
+{
+    std::memcpy(p, text.text, text.size);
+    return p + text.size;
+}
+}   // namespace detail
+
+// Writes the process id.
+class pid_field {
+public:
+    static std::size_t const MAX_SIZE = sizeof(detail::process_field_text::text);
+
+    void format(output_buffer* pbuffer) const
+    {
+        pbuffer->write(detail::pid_text.text, detail::pid_text.size);
+    }
+
+    char* format(char* p) const
+    {
+        return detail::write_process_field(p, detail::pid_text);
+    }
+};
+
+// Writes the host name, cut off after 64 characters.
+class hostname_field {
+public:
+    static std::size_t const MAX_SIZE = sizeof(detail::process_field_text::text);
+
+    void format(output_buffer* pbuffer) const
+    {
+        pbuffer->write(detail::hostname_text.text, detail::hostname_text.size);
+    }
+
+    char* format(char* p) const
+    {
+        return detail::write_process_field(p, detail::hostname_text);
+    }
+};
+
+// Writes the name given to set_app_name(), or else the name of the
+// executable. It is cut off after 64 characters.
+class app_name_field {
+public:
+    static std::size_t const MAX_SIZE = sizeof(detail::process_field_text::text);
+
+    void format(output_buffer* pbuffer) const
+    {
+        auto ptext = detail::app_name_text.load(std::memory_order_acquire);
+        pbuffer->write(ptext->text, ptext->size);
+    }
+
+    char* format(char* p) const
+    {
+        return detail::write_process_field(p,
+            *detail::app_name_text.load(std::memory_order_acquire));
+    }
+};
+
+// Set the name written by app_name_field. Records that are formatted after
+// the call use the new name.
+void set_app_name(char const* name);
+
+}   // namespace reckless
+
+#endif  // RECKLESS_PROCESS_FIELD_HPP
@@ -0,0 +1,196 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_SAMPLING_HPP
+#define RECKLESS_SAMPLING_HPP
+
+#include <reckless/call_site.hpp>
+#include <reckless/clock.hpp>   // coarse_monotonic_now
+
+#include <atomic>
+#include <cstdint>  // uint64_t
+
+namespace reckless {
+
+// Samplers decide which calls from a call site are written, for call sites
+// that may fire often enough to flood the log. Each is meant to be a static
+// object at the call site, created by one of the macros below, and is shared
+// by all threads that call through it.
+//
+// sample() returns true if the call should be written, and then sets
+// *psuppressed to the number of calls that were discarded since the last one
+// that was written. The macros append that number to the message.
+
+// Writes the first n calls, and then every m:th call. m must be at least 1.
+class first_n_then_every_m_sampler {
+public:
+    constexpr first_n_then_every_m_sampler(std::uint64_t n, std::uint64_t m) :
+        n_(n),
+        m_(m),
+        calls_(0),
+        next_(n + m - 1)
+    {
+    }
+
+    bool sample(std::uint64_t* psuppressed)
+    {
+        std::uint64_t call = calls_.fetch_add(1, std::memory_order_relaxed);
+        if(call < n_) {
+            *psuppressed = 0;
+            return true;
+        }
+        // Rather than dividing, each written call sets the number of the
+        // next one to write. If several threads reach it before it is
+        // updated, only one of them writes.
+        std::uint64_t next = next_.load(std::memory_order_relaxed);
+        if(detail::likely(call < next))
+            return false;
+        if(!next_.compare_exchange_strong(next, call + m_,
+            std::memory_order_relaxed))
+        {
+            return false;
+        }
+        // next - m is the number of the previous call that was written.
+        *psuppressed = call - (next - m_) - 1;
+        return true;
+    }
+
+private:
+    std::uint64_t const n_;
+    std::uint64_t const m_;
+    std::atomic<std::uint64_t> calls_;
+    std::atomic<std::uint64_t> next_;
+};
+
+// Writes the first call and every n:th call after it.
+class every_n_sampler : public first_n_then_every_m_sampler {
+public:
+    constexpr explicit every_n_sampler(std::uint64_t n) :
+        first_n_then_every_m_sampler(1, n)
+    {
+    }
+};
+
+// Writes at most per_second calls per second on average, in bursts of at
+// most per_second calls. This is a token bucket that holds per_second tokens
+// and is refilled at per_second tokens per second. It is implemented as the
+// equivalent "virtual scheduling" algorithm, which only needs to keep the
+// time at which the bucket will be full again, so that a single
+// compare-and-swap updates it. The time comes from a clock at scheduler-tick
+// resolution, which is cheap to read.
+//
+// A rate of 0 suppresses every call. Rates above one call per nanosecond are
+// treated as one call per nanosecond.
+class rate_limit_sampler {
+public:
+    constexpr explicit rate_limit_sampler(std::uint64_t per_second) :
+        interval_(interval_for(clamp_rate(per_second))),
+        // With an interval of 1 ns and a burst of 0, every call for a rate of
+        // 0 ends up more than a burst away from the current time.
+        burst_(interval_for(clamp_rate(per_second))*clamp_rate(per_second)),
+        full_at_(0),
+        suppressed_(0)
+    {
+    }
+
+    bool sample(std::uint64_t* psuppressed)
+    {
+        std::uint64_t now = detail::coarse_monotonic_now();
+        std::uint64_t full_at = full_at_.load(std::memory_order_relaxed);
+        std::uint64_t next_full_at;
+        do {
+            next_full_at = (full_at > now? full_at : now) + interval_;
+            if(next_full_at - now > burst_) {
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while(!full_at_.compare_exchange_weak(full_at, next_full_at,
+            std::memory_order_relaxed));
+        *psuppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static constexpr std::uint64_t clamp_rate(std::uint64_t per_second)
+    {
+        return per_second < 1000000000u? per_second : 1000000000u;
+    }
+
+    static constexpr std::uint64_t interval_for(std::uint64_t per_second)
+    {
+        return per_second == 0? 1 : 1000000000u/per_second;
+    }
+
+    std::uint64_t const interval_;
+    std::uint64_t const burst_;
+    std::atomic<std::uint64_t> full_at_;
+    std::atomic<std::uint64_t> suppressed_;
+};
+
+// Like RECKLESS_LOG, but only writes the first call and every n:th call after
+// it. For example,
+//
+//     RECKLESS_LOG_EVERY_N(g_log, 1000, warn, "dropped packet from %s", host);
+//
+// Calls that are discarded because of their severity are not counted. These
+// work with policy_log and severity_log.
+#define RECKLESS_LOG_EVERY_N(log, n, function, ...) \
+    RECKLESS_DETAIL_LOG_SAMPLED(log, ::reckless::every_n_sampler, (n), \
+        function, __VA_ARGS__)
+
+// Like RECKLESS_LOG, but only writes the first n calls and then every m:th
+// call.
+#define RECKLESS_LOG_FIRST_N_THEN_EVERY_M(log, n, m, function, ...) \
+    RECKLESS_DETAIL_LOG_SAMPLED(log, \
+        ::reckless::first_n_then_every_m_sampler, (n, m), function, \
+        __VA_ARGS__)
+
+// Like RECKLESS_LOG, but writes at most per_second calls per second.
+#define RECKLESS_LOG_RATE_LIMITED(log, per_second, function, ...) \
+    RECKLESS_DETAIL_LOG_SAMPLED(log, ::reckless::rate_limit_sampler, \
+        (per_second), function, __VA_ARGS__)
+
+#define RECKLESS_DETAIL_LOG_SAMPLED(log, sampler, sampler_arguments, function, ...) \
+    do { \
+        if(::reckless::detail::severity_compiled_in( \
+                ::reckless::detail::call_site_severity::function) \
+            && ::reckless::detail::call_site_enabled((log), nullptr, \
+                ::reckless::detail::call_site_severity::function)) \
+        { \
+            static sampler reckless_sampler sampler_arguments; \
+            std::uint64_t reckless_suppressed; \
+            if(reckless_sampler.sample(&reckless_suppressed)) { \
+                static ::reckless::call_site const reckless_call_site = { \
+                    {__FILE__, __LINE__, __func__}, \
+                    "" RECKLESS_DETAIL_FIRST(__VA_ARGS__), \
+                    ::reckless::detail::call_site_severity::function, \
+                    nullptr}; \
+                (log).function( \
+                    ::reckless::detail::checked_call_site{&reckless_call_site}, \
+                    ::reckless::detail::suppressed_count{reckless_suppressed}, \
+                    __VA_ARGS__); \
+            } \
+        } \
+    } while(false)
+
+}   // namespace reckless
+
+#endif  // RECKLESS_SAMPLING_HPP
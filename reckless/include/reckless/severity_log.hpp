@@ -27,6 +27,8 @@
 namespace reckless {
 class severity_field {
 public:
+    static std::size_t const MAX_SIZE = 1;
+
     severity_field(char severity) : severity_(severity) {}
 
     void format(output_buffer* poutput_buffer) const
@@ -36,22 +38,51 @@ public:
         poutput_buffer->commit(1);
     }
 
+    char* format(char* p) const
+    {
+        *p = severity_;
+        return p + 1;
+    }
+
 private:
     char severity_;
 };
 
 namespace detail {
     template <class HeaderField>
-    HeaderField construct_header_field(char)
+    HeaderField construct_header_field(char, call_site const* psite)
     {
-         return HeaderField();
+         return construct_header_field<HeaderField>(psite);
     }
 
     template <>
-    inline severity_field construct_header_field<severity_field>(char severity)
+    inline severity_field construct_header_field<severity_field>(char severity,
+        call_site const*)
     {
          return severity_field(severity);
     }
+
+    class call_site_severity_field {
+    public:
+        static std::size_t const MAX_SIZE = severity_field::MAX_SIZE;
+    };
+
+    template <>
+    struct call_site_header_field<severity_field> {
+        typedef call_site_severity_field type;
+    };
+
+    inline void format_header_field(output_buffer* pbuffer,
+        call_site_severity_field, call_site const* psite)
+    {
+        severity_field(psite->severity).format(pbuffer);
+    }
+
+    inline char* format_header_field(char* p, call_site_severity_field,
+        call_site const* psite)
+    {
+        return severity_field(psite->severity).format(p);
+    }
 }
 
 template <class IndentPolicy, char FieldSeparator, class... HeaderFields>
@@ -59,37 +90,152 @@ class severity_log : public basic_log {
 public:
     using basic_log::basic_log;
 
+    // Discard records below the given severity ('D', 'I', 'W' or 'E'). This
+    // can be changed at any time, and takes effect in other threads soon
+    // after. All severities are enabled by default.
+    void set_min_severity(char severity)
+    {
+        detail::atomic_store_relaxed(&severity_mask_,
+            detail::severity_mask(severity));
+    }
+
+    bool severity_enabled(char severity) const
+    {
+        return (detail::atomic_load_relaxed(&severity_mask_)
+            & (1u << detail::severity_rank(severity))) != 0;
+    }
+
     template <typename... Args>
     void debug(char const* fmt, Args&&... args)
     {
-        write('D', fmt, std::forward<Args>(args)...);
+        write('D', nullptr, fmt, std::forward<Args>(args)...);
     }
     template <typename... Args>
     void info(char const* fmt, Args&&... args)
     {
-        write('I', fmt, std::forward<Args>(args)...);
+        write('I', nullptr, fmt, std::forward<Args>(args)...);
     }
     template <typename... Args>
     void warn(char const* fmt, Args&&... args)
     {
-        write('W', fmt, std::forward<Args>(args)...);
+        write('W', nullptr, fmt, std::forward<Args>(args)...);
     }
     template <typename... Args>
     void error(char const* fmt, Args&&... args)
     {
-        write('E', fmt, std::forward<Args>(args)...);
+        write('E', nullptr, fmt, std::forward<Args>(args)...);
+    }
+
+    // Write through a static call site, which is stored in the record in
+    // place of the format string, severity and source location. Use the
+    // RECKLESS_LOG macro rather than calling these directly. The arguments are
+    // the format string and its arguments, optionally preceded by a
+    // suppressed_count.
+    template <typename... Args>
+    void debug(call_site const* psite, Args&&... args)
+    {
+        write_call_site(psite, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void info(call_site const* psite, Args&&... args)
+    {
+        write_call_site(psite, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void warn(call_site const* psite, Args&&... args)
+    {
+        write_call_site(psite, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void error(call_site const* psite, Args&&... args)
+    {
+        write_call_site(psite, std::forward<Args>(args)...);
+    }
+
+    // Called by the RECKLESS_LOG macro, which has already checked the
+    // severity, so that it is only loaded and tested once per call.
+    template <typename... Args>
+    void debug(detail::checked_call_site site, Args&&... args)
+    {
+        write(site.psite, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void info(detail::checked_call_site site, Args&&... args)
+    {
+        write(site.psite, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void warn(detail::checked_call_site site, Args&&... args)
+    {
+        write(site.psite, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void error(detail::checked_call_site site, Args&&... args)
+    {
+        write(site.psite, std::forward<Args>(args)...);
     }
 
 private:
     template <typename... Args>
-    void write(char severity, char const* fmt, Args&&... args)
+    void write(char severity, call_site const* psite, char const* fmt,
+        Args&&... args)
     {
+        if(!detail::severity_compiled_in(severity)
+            || detail::unlikely(!severity_enabled(severity)))
+        {
+            return;
+        }
         basic_log::write<policy_formatter<IndentPolicy, FieldSeparator, HeaderFields...>>(
-                detail::construct_header_field<HeaderFields>(severity)...,
+                detail::construct_header_field<HeaderFields>(severity, psite)...,
                 IndentPolicy(),
                 fmt,
                 std::forward<Args>(args)...);
     }
+
+    template <typename... Args>
+    void write_call_site(call_site const* psite, Args&&... args)
+    {
+        if(!detail::severity_compiled_in(psite->severity)
+            || detail::unlikely(!detail::call_site_enabled(*this,
+                psite->pcategory, psite->severity)))
+        {
+            return;
+        }
+        write(psite, std::forward<Args>(args)...);
+    }
+
+    // The format string is already in the call site, so these drop it and
+    // write the record without checking the severity.
+    template <typename... Args>
+    void write(call_site const* psite, char const*, Args&&... args)
+    {
+        write_unchecked(psite, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void write(call_site const* psite, detail::suppressed_count suppressed,
+        char const*, Args&&... args)
+    {
+        write_unchecked(psite, suppressed, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    void write_unchecked(call_site const* psite, Args&&... args)
+    {
+        basic_log::write<detail::basic_policy_formatter<
+            detail::call_site_formatter, IndentPolicy, FieldSeparator,
+            typename detail::call_site_header_field<HeaderFields>::type...>>(
+                typename detail::call_site_header_field<HeaderFields>::type()...,
+                IndentPolicy(),
+                psite,
+                std::forward<Args>(args)...);
+    }
+
+    // See detail::severity_mask. Kept on a cache line of its own, since it
+    // is read on every call and rarely written.
+    char padding1_[RECKLESS_CACHE_LINE_SIZE];
+    unsigned severity_mask_ = detail::ALL_SEVERITIES;
+    char padding2_[RECKLESS_CACHE_LINE_SIZE - sizeof(unsigned)];
 };
 
 }   // namespace reckless
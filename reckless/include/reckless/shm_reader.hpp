@@ -0,0 +1,85 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_SHM_READER_HPP
+#define RECKLESS_SHM_READER_HPP
+
+#include <cstddef>  // size_t
+
+namespace reckless {
+namespace detail {
+    struct shm_ring_header;
+}
+
+// Consumer side of a shared-memory ring created by shm_writer. The data is
+// read in place: peek() returns a pointer straight into the shared mapping,
+// and the space is handed back to the writer with consume() once the caller
+// is done with it. A typical shipper loop looks like this:
+//
+//     reckless::shm_reader reader("/myapp-log");
+//     while(true) {
+//         char const* p;
+//         std::size_t size = reader.peek(&p);
+//         if(size == 0) {
+//             if(reader.writer_closed())
+//                 break;
+//             reader.wait(100);
+//             continue;
+//         }
+//         ship(p, size);
+//         reader.consume(size);
+//     }
+//
+// Since the writer only publishes whole output buffers, the data always ends
+// on a line boundary unless the ring was too full to hold an entire buffer.
+//
+// This class is only available on Linux.
+class shm_reader {
+public:
+    // Open an existing ring. Throws std::system_error if it does not exist or
+    // is not a ring created by a compatible shm_writer.
+    explicit shm_reader(char const* name);
+    ~shm_reader();
+
+    // Set *ppdata to the oldest unconsumed data in the ring and return the
+    // number of bytes available there, which may be 0.
+    std::size_t peek(char const** ppdata) const;
+    // Release the first count bytes returned by peek() to the writer.
+    void consume(std::size_t count);
+    // Wait for data to become available. Returns true if there is data to
+    // read, false on timeout or if the writer has closed the ring.
+    bool wait(unsigned milliseconds);
+    // True once the writer has been destroyed. There may still be data left
+    // to read.
+    bool writer_closed() const;
+
+private:
+    shm_reader(shm_reader const&) = delete;
+    shm_reader& operator=(shm_reader const&) = delete;
+
+    detail::shm_ring_header* pheader_;
+    char const* pdata_;
+    std::size_t capacity_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_SHM_READER_HPP
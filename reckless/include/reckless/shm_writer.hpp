@@ -0,0 +1,72 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_SHM_WRITER_HPP
+#define RECKLESS_SHM_WRITER_HPP
+
+#include <reckless/writer.hpp>
+
+#include <string>
+
+namespace reckless {
+namespace detail {
+    struct shm_ring_header;
+}
+
+// Publishes log output into a named shared-memory ring (see shm_open(3)) that
+// is consumed by another process, typically a log shipper that uses
+// shm_reader. Compared to having the shipper tail a log file this saves a
+// write() and a read() system call per flush, and keeps the data out of the
+// page cache.
+//
+// There is exactly one producer and one consumer per ring. If the consumer
+// falls behind so that the ring fills up, write() puts as much as fits into
+// the ring and reports writer::temporary_failure for the rest, and the log's
+// temporary_error_policy decides what happens next.
+//
+// This writer is only available on Linux.
+class shm_writer : public writer {
+public:
+    // Create the shared-memory object with the given name (which should
+    // start with a slash), replacing any existing object with the same name.
+    // The capacity is rounded up to a multiple of the page size.
+    shm_writer(char const* name, std::size_t capacity = 1024*1024);
+    // Marks the ring as closed so that the reader knows that no more data is
+    // coming, and removes the name. A reader that has the ring open can
+    // still read what is left in it.
+    ~shm_writer();
+
+    std::size_t write(void const* pbuffer, std::size_t count,
+            std::error_code& ec) noexcept override;
+
+private:
+    shm_writer(shm_writer const&) = delete;
+    shm_writer& operator=(shm_writer const&) = delete;
+
+    std::string name_;
+    detail::shm_ring_header* pheader_;
+    char* pdata_;
+    std::size_t capacity_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_SHM_WRITER_HPP
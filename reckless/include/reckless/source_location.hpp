@@ -0,0 +1,56 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_SOURCE_LOCATION_HPP
+#define RECKLESS_SOURCE_LOCATION_HPP
+
+namespace reckless {
+
+class output_buffer;
+
+// A place in the source code. The RECKLESS_LOG and RECKLESS_WRITE macros in
+// call_site.hpp create one as part of a static object per call site, so that
+// a record only needs to carry a pointer to it.
+struct source_location {
+    char const* file;
+    unsigned line;
+    char const* function;
+};
+
+// Writes file:line:function for the call site of a record, with the file
+// name stripped of its directory. Records that were written without
+// RECKLESS_WRITE or RECKLESS_LOG have no call site, and get a '?'.
+class source_location_field {
+public:
+    source_location_field(source_location const* plocation = nullptr) :
+        plocation_(plocation)
+    {
+    }
+
+    void format(output_buffer* pbuffer) const;
+
+private:
+    source_location const* plocation_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_SOURCE_LOCATION_HPP
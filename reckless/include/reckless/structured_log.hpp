@@ -0,0 +1,407 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_STRUCTURED_LOG_HPP
+#define RECKLESS_STRUCTURED_LOG_HPP
+
+#include <reckless/basic_log.hpp>
+#include <reckless/key_value.hpp>
+#include <reckless/policy_log.hpp>      // timestamp_field
+#include <reckless/severity_log.hpp>    // severity_field, construct_header_field
+#include <reckless/thread_field.hpp>
+#include <reckless/process_field.hpp>
+#include <reckless/source_location.hpp>
+#include <reckless/call_site.hpp>
+#include <reckless/category.hpp>
+#include <reckless/detail/utility.hpp>  // dependent_false, all_of
+
+#include <cstring>      // strlen, memcpy
+#include <string>
+#include <type_traits>
+#include <utility>      // forward
+
+namespace reckless {
+
+// The key used for a header field in a structured_log. Specialize this to use
+// your own header fields.
+template <class Field>
+struct field_key {
+    static_assert(detail::dependent_false<Field>::value,
+        "specialize field_key to use this field in a structured_log");
+};
+
+template <class Clock, class Format>
+struct field_key<basic_timestamp_field<Clock, Format>> {
+    static char const* name()
+    {
+        return "time";
+    }
+};
+
+template <>
+struct field_key<severity_field> {
+    static char const* name()
+    {
+        return "level";
+    }
+};
+
+template <>
+struct field_key<thread_id_field> {
+    static char const* name()
+    {
+        return "tid";
+    }
+};
+
+template <>
+struct field_key<thread_name_field> {
+    static char const* name()
+    {
+        return "thread";
+    }
+};
+
+template <>
+struct field_key<source_location_field> {
+    static char const* name()
+    {
+        return "source";
+    }
+};
+
+template <>
+struct field_key<category_field> {
+    static char const* name()
+    {
+        return "category";
+    }
+};
+
+template <>
+struct field_key<pid_field> {
+    static char const* name()
+    {
+        return "pid";
+    }
+};
+
+template <>
+struct field_key<hostname_field> {
+    static char const* name()
+    {
+        return "host";
+    }
+};
+
+template <>
+struct field_key<app_name_field> {
+    static char const* name()
+    {
+        return "app";
+    }
+};
+
+// An encoder decides how the records of a structured_log are written. Only
+// the static functions below are required, so you may write your own. The
+// output of header fields is passed to string(), like string values.
+//
+// Writes one JSON object per line.
+class json_encoder {
+public:
+    static void begin_record(output_buffer* pbuffer);
+    static void key(output_buffer* pbuffer, char const* key, bool first);
+    static void string(output_buffer* pbuffer, char const* s, std::size_t size);
+    static void integer(output_buffer* pbuffer, long long value);
+    static void integer(output_buffer* pbuffer, unsigned long long value);
+    // Non-finite values are written as null.
+    static void floating(output_buffer* pbuffer, double value,
+        unsigned significant_digits);
+    static void boolean(output_buffer* pbuffer, bool value);
+    static void end_record(output_buffer* pbuffer);
+};
+
+// Writes key=value pairs separated by spaces, one record per line. Values
+// that contain spaces, '=', quotes or control characters are quoted.
+class logfmt_encoder {
+public:
+    static void begin_record(output_buffer* pbuffer);
+    static void key(output_buffer* pbuffer, char const* key, bool first);
+    static void string(output_buffer* pbuffer, char const* s, std::size_t size);
+    static void integer(output_buffer* pbuffer, long long value);
+    static void integer(output_buffer* pbuffer, unsigned long long value);
+    static void floating(output_buffer* pbuffer, double value,
+        unsigned significant_digits);
+    static void boolean(output_buffer* pbuffer, bool value);
+    static void end_record(output_buffer* pbuffer);
+};
+
+namespace detail {
+
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, char const* value)
+{
+    Encoder::string(pbuffer, value, std::strlen(value));
+}
+
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, std::string const& value)
+{
+    Encoder::string(pbuffer, value.data(), value.size());
+}
+
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, char value)
+{
+    Encoder::string(pbuffer, &value, 1);
+}
+
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, bool value)
+{
+    Encoder::boolean(pbuffer, value);
+}
+
+template <class Encoder, class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+encode_value(output_buffer* pbuffer, T value)
+{
+    Encoder::integer(pbuffer, static_cast<long long>(value));
+}
+
+template <class Encoder, class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+encode_value(output_buffer* pbuffer, T value)
+{
+    Encoder::integer(pbuffer, static_cast<unsigned long long>(value));
+}
+
+// Enough significant digits to read back the same value.
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, float value)
+{
+    Encoder::floating(pbuffer, value, 9);
+}
+
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, double value)
+{
+    Encoder::floating(pbuffer, value, 17);
+}
+
+template <class Encoder>
+void encode_value(output_buffer* pbuffer, long double value)
+{
+    Encoder::floating(pbuffer, static_cast<double>(value), 17);
+}
+
+// Header fields write to the output buffer themselves, so to have their
+// output escaped we move it to a scratch area and write it again as a string
+// value. begin is the frame_size() from before the field was written.
+template <class Encoder>
+void encode_header_field(output_buffer* pbuffer, std::size_t begin)
+{
+    std::size_t size = pbuffer->frame_size() - begin;
+    char scratch[256];
+    std::string large_scratch;
+    char const* s;
+    if(likely(size <= sizeof(scratch))) {
+        std::memcpy(scratch, pbuffer->frame_data() + begin, size);
+        s = scratch;
+    } else {
+        large_scratch.assign(pbuffer->frame_data() + begin, size);
+        s = large_scratch.data();
+    }
+    pbuffer->truncate_frame(begin);
+    Encoder::string(pbuffer, s, size);
+}
+
+}   // namespace detail
+
+template <class Encoder, class... Fields>
+class structured_formatter {
+public:
+    template <typename... KeyValues>
+    static void format(output_buffer* pbuffer, Fields&&... fields,
+        char const* message, KeyValues&&... key_values)
+    {
+        Encoder::begin_record(pbuffer);
+        bool first = true;
+        encode_fields(pbuffer, first, fields...);
+        Encoder::key(pbuffer, "msg", first);
+        detail::encode_value<Encoder>(pbuffer, message);
+        encode_key_values(pbuffer, key_values...);
+        Encoder::end_record(pbuffer);
+    }
+
+private:
+    template <class Field, class... Remaining>
+    static void encode_fields(output_buffer* pbuffer, bool& first,
+        Field& field, Remaining&... remaining)
+    {
+        Encoder::key(pbuffer, field_key<typename std::decay<Field>::type>::name(),
+            first);
+        first = false;
+        std::size_t begin = pbuffer->frame_size();
+        field.format(pbuffer);
+        detail::encode_header_field<Encoder>(pbuffer, begin);
+        if(volatile_field<typename std::decay<Field>::type>::value)
+            pbuffer->exclude_from_comparison(begin, pbuffer->frame_size());
+        encode_fields(pbuffer, first, remaining...);
+    }
+    static void encode_fields(output_buffer*, bool&)
+    {
+    }
+
+    template <class T, class... Remaining>
+    static void encode_key_values(output_buffer* pbuffer,
+        key_value<T> const& kv, Remaining const&... remaining)
+    {
+        Encoder::key(pbuffer, kv.key, false);
+        detail::encode_value<Encoder>(pbuffer, kv.value);
+        encode_key_values(pbuffer, remaining...);
+    }
+    static void encode_key_values(output_buffer*)
+    {
+    }
+};
+
+// A log that writes records made up of a message and a list of keys and
+// values, e.g.
+//
+//     g_log.info("request done", kv("path", path), kv("status", 200));
+//
+// The header fields are written first, with the keys given by field_key. With
+// json_encoder and a timestamp_field and severity_field as header fields, the
+// above becomes
+//
+//     {"time":"2020-03-14 15:09:26.535","level":"I","msg":"request done","path":"/","status":200}
+//
+// write() can only be used if all header fields are default-constructible,
+// and debug(), info(), warn() and error() require a severity_field.
+template <class Encoder = json_encoder, class... HeaderFields>
+class structured_log : public basic_log {
+public:
+    using basic_log::basic_log;
+
+    template <typename... KeyValues>
+    void write(char const* message, KeyValues&&... key_values)
+    {
+        check_key_values<KeyValues...>();
+        basic_log::write<structured_formatter<Encoder, HeaderFields...>>(
+                HeaderFields()...,
+                message,
+                std::forward<KeyValues>(key_values)...);
+    }
+
+    // Write through a static call site, for source_location_field and
+    // category_field. Use the RECKLESS_WRITE macro rather than calling this
+    // directly.
+    template <typename... KeyValues>
+    void write(call_site const* psite, char const* message,
+        KeyValues&&... key_values)
+    {
+        check_key_values<KeyValues...>();
+        basic_log::write<structured_formatter<Encoder, HeaderFields...>>(
+                detail::construct_header_field<HeaderFields>(psite)...,
+                message,
+                std::forward<KeyValues>(key_values)...);
+    }
+
+    template <typename... KeyValues>
+    void debug(char const* message, KeyValues&&... key_values)
+    {
+        write_severity('D', nullptr, message, std::forward<KeyValues>(key_values)...);
+    }
+    template <typename... KeyValues>
+    void info(char const* message, KeyValues&&... key_values)
+    {
+        write_severity('I', nullptr, message, std::forward<KeyValues>(key_values)...);
+    }
+    template <typename... KeyValues>
+    void warn(char const* message, KeyValues&&... key_values)
+    {
+        write_severity('W', nullptr, message, std::forward<KeyValues>(key_values)...);
+    }
+    template <typename... KeyValues>
+    void error(char const* message, KeyValues&&... key_values)
+    {
+        write_severity('E', nullptr, message, std::forward<KeyValues>(key_values)...);
+    }
+
+    // Write through a static call site, for source_location_field and
+    // category_field. Use the RECKLESS_LOG macro rather than calling these
+    // directly.
+    template <typename... KeyValues>
+    void debug(call_site const* psite, char const* message,
+        KeyValues&&... key_values)
+    {
+        write_severity('D', psite, message,
+            std::forward<KeyValues>(key_values)...);
+    }
+    template <typename... KeyValues>
+    void info(call_site const* psite, char const* message,
+        KeyValues&&... key_values)
+    {
+        write_severity('I', psite, message,
+            std::forward<KeyValues>(key_values)...);
+    }
+    template <typename... KeyValues>
+    void warn(call_site const* psite, char const* message,
+        KeyValues&&... key_values)
+    {
+        write_severity('W', psite, message,
+            std::forward<KeyValues>(key_values)...);
+    }
+    template <typename... KeyValues>
+    void error(call_site const* psite, char const* message,
+        KeyValues&&... key_values)
+    {
+        write_severity('E', psite, message,
+            std::forward<KeyValues>(key_values)...);
+    }
+
+private:
+    template <typename... KeyValues>
+    void write_severity(char severity, call_site const* psite,
+        char const* message, KeyValues&&... key_values)
+    {
+        check_key_values<KeyValues...>();
+        if(!detail::severity_compiled_in(severity))
+            return;
+        basic_log::write<structured_formatter<Encoder, HeaderFields...>>(
+                detail::construct_header_field<HeaderFields>(severity, psite)...,
+                message,
+                std::forward<KeyValues>(key_values)...);
+    }
+
+    template <typename... KeyValues>
+    static void check_key_values()
+    {
+        static_assert(detail::all_of<detail::is_key_value<
+            typename std::decay<KeyValues>::type>::value...>::value,
+            "arguments after the message must be created with kv()");
+    }
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_STRUCTURED_LOG_HPP
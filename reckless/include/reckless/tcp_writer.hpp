@@ -0,0 +1,107 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_TCP_WRITER_HPP
+#define RECKLESS_TCP_WRITER_HPP
+
+#include <reckless/writer.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>  // uint64_t
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace reckless {
+
+// Streams log output to a collector over TCP. write() never waits for the
+// network: whatever the socket does not accept immediately, and everything
+// that is written while the connection is down, is appended to a bounded
+// spool file on local disk. A helper thread reconnects with non-blocking
+// connects and drains the spool to the peer, while new log output keeps
+// being appended behind it. Data is sent in the order it was written.
+//
+// Only when the spool file is full does write() report a temporary error, at
+// which point the temporary_error_policy of the log decides what happens.
+//
+// If the connection breaks, data that the kernel had accepted but not yet
+// delivered is lost, so the collector may see a partial line at the point
+// where the connection was broken.
+//
+// This writer is only available on Unix systems.
+class tcp_writer : public writer {
+public:
+    struct tcp_statistics {
+        std::uint64_t sent_bytes;       // Bytes handed to the socket.
+        std::uint64_t spooled_bytes;    // Bytes that had to go through the spool file.
+        std::uint64_t spool_size;       // Bytes currently waiting in the spool file.
+        unsigned connects;              // Number of successful connection attempts.
+        unsigned connect_failures;      // Number of failed connection attempts.
+        bool connected;                 // A connection is currently established.
+    };
+
+    // The spool file is created or truncated. spool_capacity is the maximum
+    // amount of data that is kept in it.
+    tcp_writer(char const* host, unsigned short port, char const* spool_path,
+        std::size_t spool_capacity = 64*1024*1024);
+    // Tries to send what is left in the spool before returning, but gives up
+    // if the connection is down or stops making progress.
+    ~tcp_writer();
+
+    tcp_statistics statistics() const;
+
+    std::size_t write(void const* pbuffer, std::size_t count,
+            std::error_code& ec) noexcept override;
+
+private:
+    tcp_writer(tcp_writer const&) = delete;
+    tcp_writer& operator=(tcp_writer const&) = delete;
+
+    void run();
+    int connect_to_peer();
+    std::size_t send_from_spool(int fd, std::uint64_t position,
+        std::size_t count, bool& error);
+    std::size_t append_to_spool(char const* pdata, std::size_t count);
+    void disconnect();
+    std::size_t spool_used() const
+    {
+        return static_cast<std::size_t>(spool_write_position_ - spool_read_position_);
+    }
+
+    std::string address_;       // The peer's sockaddr, as raw bytes.
+    int address_family_;
+    int spool_fd_;
+    std::size_t const spool_capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable spool_changed_;
+    int socket_fd_ = -1;                        // access synchronized by mutex_
+    std::uint64_t spool_read_position_ = 0;     // access synchronized by mutex_
+    std::uint64_t spool_write_position_ = 0;    // access synchronized by mutex_
+    tcp_statistics statistics_;                 // access synchronized by mutex_
+    std::atomic<bool> shutdown_{false};
+    std::thread thread_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_TCP_WRITER_HPP
@@ -0,0 +1,96 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_TEE_WRITER_HPP
+#define RECKLESS_TEE_WRITER_HPP
+
+#include <reckless/writer.hpp>
+#include <reckless/output_buffer.hpp>   // error_policy
+
+#include <cstdint>  // uint64_t
+#include <memory>   // unique_ptr
+#include <vector>
+
+namespace reckless {
+
+// Forwards everything that is written to it to several child writers. Each
+// child writer ("sink") has its own bounded buffer and a helper thread that
+// writes from that buffer, so the sinks are written in parallel and a slow or
+// failing sink does not hold up the others. What happens when the buffer of a
+// sink fills up is decided by the policy given to add_sink():
+//
+// * error_policy::block makes write() wait until there is room in the buffer,
+//   which eventually applies back-pressure to the log.
+// * error_policy::ignore discards the data for that sink, and accounts for it
+//   in the sink's statistics.
+//
+// A temporary error from a child writer is retried until the writer recovers
+// (the sink buffer fills up in the meantime). After a permanent error the sink
+// is disabled and everything that is written to it is discarded.
+class tee_writer : public writer {
+public:
+    struct sink_statistics {
+        std::uint64_t written_bytes;    // Bytes successfully written by the child writer.
+        std::uint64_t dropped_bytes;    // Bytes discarded because the buffer was full or the sink failed.
+        std::uint64_t delay_microseconds;   // Total time write() spent waiting for buffer space.
+        unsigned dropped_writes;        // Number of write() calls that were discarded.
+        unsigned delayed_writes;        // Number of write() calls that had to wait for buffer space.
+        unsigned temporary_errors;      // Number of temporary errors returned by the child writer.
+        bool failed;                    // The child writer returned a permanent error.
+    };
+
+    tee_writer();
+    ~tee_writer();
+
+    // Add a child writer. This must be done before the tee_writer is passed
+    // to a log. buffer_capacity is the maximum number of bytes the sink may
+    // lag behind. Since the tee_writer receives whole output buffers from the
+    // log, it should be at least as large as the output buffer or every write
+    // will be split (in block mode) or discarded (in ignore mode).
+    void add_sink(writer* pwriter, std::size_t buffer_capacity = 256*1024,
+        error_policy full_buffer_policy = error_policy::block);
+
+    std::size_t sink_count() const
+    {
+        return sinks_.size();
+    }
+
+    sink_statistics statistics(std::size_t sink_index) const;
+
+    // Block until every sink has either written all of its buffered data or
+    // failed permanently.
+    void drain();
+
+    std::size_t write(void const* pbuffer, std::size_t count,
+            std::error_code& ec) noexcept override;
+
+private:
+    class sink;
+
+    tee_writer(tee_writer const&) = delete;
+    tee_writer& operator=(tee_writer const&) = delete;
+
+    std::vector<std::unique_ptr<sink>> sinks_;
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_TEE_WRITER_HPP
@@ -33,6 +33,10 @@ namespace detail {
     template <typename T>
     char const* invoke_custom_format(output_buffer* pbuffer,
         char const* pformat, T&& v);
+
+    // Returns a pointer to the first '%' or terminating null character in
+    // the string.
+    char const* find_specifier(char const* s);
 }
 
 class template_formatter {
@@ -43,18 +47,32 @@ public:
     static void format(output_buffer* pbuffer, char const* pformat,
             T&& value, Args&&... args)
     {
-        pformat = next_specifier(pbuffer, pformat);
+        pformat = format_argument(pbuffer, pformat, std::forward<T>(value));
         if(!pformat)
             return;
+        return template_formatter::format(pbuffer, pformat,
+                std::forward<Args>(args)...);
+    }
+
+    // Format the literal text up to the next conversion specification, and
+    // then the value using that specification. Returns a pointer to the rest
+    // of the format string, or nullptr if it contained no more conversion
+    // specifications. This is for formatting arguments whose types are only
+    // known at run time; otherwise format() does the same thing.
+    template <typename T>
+    static char const* format_argument(output_buffer* pbuffer,
+            char const* pformat, T&& value)
+    {
+        pformat = next_specifier(pbuffer, pformat);
+        if(!pformat)
+            return nullptr;
 
         char const* pnext_format = detail::invoke_custom_format(pbuffer,
                 pformat, std::forward<T>(value));
         if(pnext_format)
-            pformat = pnext_format;
-        else
-            append_percent(pbuffer);
-        return template_formatter::format(pbuffer, pformat,
-                std::forward<Args>(args)...);
+            return pnext_format;
+        append_percent(pbuffer);
+        return pformat;
     }
 
 private:
@@ -85,6 +103,12 @@ char const* format(output_buffer* pbuffer, char const* pformat, long double v);
 
 char const* format(output_buffer* pbuffer, char const* pformat, char const* v);
 char const* format(output_buffer* pbuffer, char const* pformat, std::string const& v);
+char const* format(output_buffer* pbuffer, char const* pformat, wchar_t const* v);
+char const* format(output_buffer* pbuffer, char const* pformat, char16_t const* v);
+char const* format(output_buffer* pbuffer, char const* pformat, char32_t const* v);
+char const* format(output_buffer* pbuffer, char const* pformat, std::wstring const& v);
+char const* format(output_buffer* pbuffer, char const* pformat, std::u16string const& v);
+char const* format(output_buffer* pbuffer, char const* pformat, std::u32string const& v);
 
 char const* format(output_buffer* pbuffer, char const* pformat, void const* p);
 
@@ -0,0 +1,133 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_THREAD_FIELD_HPP
+#define RECKLESS_THREAD_FIELD_HPP
+
+#include <reckless/detail/platform.hpp> // RECKLESS_TLS, likely
+#include <reckless/timestamp_format.hpp>    // write_decimal, MAX_DECIMAL_SIZE
+
+#include <cstdint>  // uint64_t
+#include <cstring>  // memcpy
+
+namespace reckless {
+
+class output_buffer;
+
+namespace detail {
+// Room for a thread name in the OS, including the terminator:
+// TASK_COMM_LEN on Linux and MAXTHREADNAMESIZE on macOS. Elsewhere the
+// name is the thread id.
+#if defined(__linux__)
+std::size_t const THREAD_NAME_SIZE = 16;
+#elif defined(__APPLE__)
+std::size_t const THREAD_NAME_SIZE = 64;
+#else
+std::size_t const THREAD_NAME_SIZE = MAX_DECIMAL_SIZE + 1;
+#endif
+
+// The id and OS name are looked up the first time a thread needs them, and
+// then kept in thread-local storage. A zero id or empty name means "not
+// yet". log_thread_name is what set_log_thread_name() was called with, if
+// anything.
+extern RECKLESS_TLS std::uint64_t thread_id;
+extern RECKLESS_TLS char os_thread_name[THREAD_NAME_SIZE];
+extern RECKLESS_TLS char const* log_thread_name;
+
+std::uint64_t lookup_thread_id();
+void lookup_os_thread_name();
+}
+
+// The OS identifier of the calling thread: gettid() on Linux,
+// pthread_threadid_np() on macOS and GetCurrentThreadId() on Windows.
+inline std::uint64_t current_thread_id()
+{
+    std::uint64_t id = detail::thread_id;
+    if(detail::likely(id != 0))
+        return id;
+    return detail::lookup_thread_id();
+}
+
+// The name that was given to the calling thread with set_log_thread_name().
+// If it hasn't been given one, this is the name that the thread has in the OS
+// (where available) or else its id. The returned string stays valid for as
+// long as the thread runs.
+inline char const* current_thread_name()
+{
+    char const* name = detail::log_thread_name;
+    if(name)
+        return name;
+    if(detail::unlikely(detail::os_thread_name[0] == '\0'))
+        detail::lookup_os_thread_name();
+    return detail::os_thread_name;
+}
+
+// Give the calling thread a name for thread_name_field. Records that refer
+// to the name may still be waiting in a log after the thread has ended, so
+// it is kept for the lifetime of the process. Identical names share storage,
+// so a pool that names its threads "worker-1", "worker-2" and so on only
+// stores each name once. It does not change the thread's name in the OS.
+void set_log_thread_name(char const* name);
+
+// Writes the OS identifier of the thread that wrote the record.
+class thread_id_field {
+public:
+    static std::size_t const MAX_SIZE = detail::MAX_DECIMAL_SIZE;
+
+    thread_id_field() : id_(current_thread_id())
+    {
+    }
+
+    void format(output_buffer* pbuffer) const;
+
+    char* format(char* p) const
+    {
+        return detail::write_decimal(p, id_);
+    }
+
+private:
+    std::uint64_t id_;
+};
+
+// Writes the name of the thread that wrote the record. The OS name is
+// copied into the record, since nothing keeps it alive once the thread has
+// ended.
+class thread_name_field {
+public:
+    thread_name_field() : plog_name_(detail::log_thread_name)
+    {
+        if(plog_name_)
+            return;
+        if(detail::unlikely(detail::os_thread_name[0] == '\0'))
+            detail::lookup_os_thread_name();
+        std::memcpy(os_name_, detail::os_thread_name, sizeof(os_name_));
+    }
+
+    void format(output_buffer* pbuffer) const;
+
+private:
+    char const* plog_name_;
+    char os_name_[detail::THREAD_NAME_SIZE];
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_THREAD_FIELD_HPP
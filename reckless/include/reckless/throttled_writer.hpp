@@ -0,0 +1,93 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_THROTTLED_WRITER_HPP
+#define RECKLESS_THROTTLED_WRITER_HPP
+
+#include <reckless/writer.hpp>
+#include <reckless/output_buffer.hpp>   // error_policy
+
+#include <chrono>
+#include <cstdint>  // uint64_t
+#include <mutex>
+
+namespace reckless {
+
+// Caps the rate at which data is passed on to another writer, using a token
+// bucket: tokens accumulate at bytes_per_second up to burst_bytes, and each
+// byte written consumes one token. What happens to data in excess of the cap
+// is decided by the policy given to the constructor:
+//
+// * error_policy::block paces the output: write() waits until enough tokens
+//   have accumulated and then passes the data on, in pieces that end with
+//   complete lines. A line that is longer than burst_bytes is passed on
+//   whole once the bucket is full, and the next wait makes up for it. While
+//   it waits, the log's output worker is stalled, so excess data is held in
+//   the log's queues until they fill up and the threads that write to the
+//   log start to block.
+// * error_policy::ignore sheds the excess: write() passes on as many
+//   complete lines as there are tokens for, and discards the rest.
+//
+// Errors from the wrapped writer are passed through unchanged, and any bytes
+// that it didn't write give their tokens back.
+class throttled_writer : public writer {
+public:
+    struct throttle_statistics {
+        std::uint64_t written_bytes;        // Bytes passed on to the wrapped writer.
+        std::uint64_t shed_bytes;           // Bytes discarded in error_policy::ignore mode.
+        std::uint64_t delay_microseconds;   // Total time write() spent waiting for tokens.
+        unsigned delayed_writes;            // Number of write() calls that had to wait.
+        unsigned shed_writes;               // Number of write() calls that discarded data.
+    };
+
+    throttled_writer(writer* pwriter, std::uint64_t bytes_per_second,
+        std::size_t burst_bytes, error_policy excess_policy = error_policy::block);
+
+    throttle_statistics statistics() const;
+
+    std::size_t write(void const* pbuffer, std::size_t count,
+            std::error_code& ec) noexcept override;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    throttled_writer(throttled_writer const&) = delete;
+    throttled_writer& operator=(throttled_writer const&) = delete;
+
+    void refill();
+    std::size_t forward(char const* p, std::size_t count, std::error_code& ec);
+
+    writer* const pwriter_;
+    double const bytes_per_second_;
+    double const burst_bytes_;
+    error_policy const excess_policy_;
+
+    // Only accessed from write(), i.e. by the log's output worker.
+    double tokens_;
+    clock::time_point last_refill_;
+
+    mutable std::mutex statistics_mutex_;
+    throttle_statistics statistics_;    // access synchronized by statistics_mutex_
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_THROTTLED_WRITER_HPP
@@ -0,0 +1,148 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef RECKLESS_TIMESTAMP_FORMAT_HPP
+#define RECKLESS_TIMESTAMP_FORMAT_HPP
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+
+namespace reckless {
+
+// Timestamp formats for basic_timestamp_field. A format has a MAX_SIZE and a
+// write() function that writes a time, given in nanoseconds since 1970-01-01
+// UTC, and returns the end of what it wrote.
+//
+// The date and time of day are rendered once per second and then copied, and
+// the local UTC offset is only looked up once per hour, so that most records
+// only need their sub-second digits rendered. The caches are per thread, i.e.
+// per output worker.
+
+namespace detail {
+std::uint64_t const NANOSECONDS_PER_SECOND = 1000000000u;
+
+// Writes YYYY-MM-DD?HH:MM:SS with the given separator between date and time.
+char* write_date_time(char* p, std::uint64_t seconds, bool local,
+    char separator);
+// Writes the UTC offset of the local time zone as +HH:MM.
+char* write_utc_offset(char* p, std::uint64_t seconds);
+// Writes a decimal point and the first digits of the fraction, or nothing if
+// digits is zero.
+char* write_fraction(char* p, std::uint32_t nanoseconds, unsigned digits);
+char* write_decimal(char* p, std::uint64_t value);
+// The time when the program started, in nanoseconds since 1970-01-01 UTC.
+std::uint64_t start_time();
+
+std::size_t const MAX_DECIMAL_SIZE = 20;
+}   // namespace detail
+
+// YYYY-MM-DD HH:MM:SS.fff in local time, with Digits decimals.
+template <unsigned Digits = 3>
+struct local_time_format {
+    static_assert(Digits <= 9, "at most 9 decimals are available");
+    static std::size_t const MAX_SIZE = 19 + (Digits == 0? 0 : Digits + 1);
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        p = detail::write_date_time(p, time/detail::NANOSECONDS_PER_SECOND,
+            true, ' ');
+        return detail::write_fraction(p, static_cast<std::uint32_t>(
+            time%detail::NANOSECONDS_PER_SECOND), Digits);
+    }
+};
+
+// ISO 8601 in local time with UTC offset: YYYY-MM-DDTHH:MM:SS.ffffff+HH:MM.
+template <unsigned Digits = 6>
+struct iso8601_format {
+    static_assert(Digits <= 9, "at most 9 decimals are available");
+    static std::size_t const MAX_SIZE = 19 + (Digits == 0? 0 : Digits + 1) + 6;
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        std::uint64_t seconds = time/detail::NANOSECONDS_PER_SECOND;
+        p = detail::write_date_time(p, seconds, true, 'T');
+        p = detail::write_fraction(p, static_cast<std::uint32_t>(
+            time%detail::NANOSECONDS_PER_SECOND), Digits);
+        return detail::write_utc_offset(p, seconds);
+    }
+};
+
+// ISO 8601 in UTC: YYYY-MM-DDTHH:MM:SS.ffffffZ.
+template <unsigned Digits = 6>
+struct iso8601_utc_format {
+    static_assert(Digits <= 9, "at most 9 decimals are available");
+    static std::size_t const MAX_SIZE = 19 + (Digits == 0? 0 : Digits + 1) + 1;
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        p = detail::write_date_time(p, time/detail::NANOSECONDS_PER_SECOND,
+            false, 'T');
+        p = detail::write_fraction(p, static_cast<std::uint32_t>(
+            time%detail::NANOSECONDS_PER_SECOND), Digits);
+        *p = 'Z';
+        return p + 1;
+    }
+};
+
+// Seconds since 1970-01-01 UTC, with Digits decimals.
+template <unsigned Digits = 0>
+struct epoch_format {
+    static_assert(Digits <= 9, "at most 9 decimals are available");
+    static std::size_t const MAX_SIZE = detail::MAX_DECIMAL_SIZE +
+        (Digits == 0? 0 : Digits + 1);
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        p = detail::write_decimal(p, time/detail::NANOSECONDS_PER_SECOND);
+        return detail::write_fraction(p, static_cast<std::uint32_t>(
+            time%detail::NANOSECONDS_PER_SECOND), Digits);
+    }
+};
+
+// Nanoseconds since 1970-01-01 UTC, as an integer.
+struct epoch_nanoseconds_format {
+    static std::size_t const MAX_SIZE = detail::MAX_DECIMAL_SIZE;
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        return detail::write_decimal(p, time);
+    }
+};
+
+// Seconds since the program started, with Digits decimals.
+template <unsigned Digits = 6>
+struct elapsed_format {
+    static_assert(Digits <= 9, "at most 9 decimals are available");
+    static std::size_t const MAX_SIZE = detail::MAX_DECIMAL_SIZE +
+        (Digits == 0? 0 : Digits + 1);
+
+    static char* write(char* p, std::uint64_t time)
+    {
+        std::uint64_t start = detail::start_time();
+        // A record can be captured before the start time is read.
+        std::uint64_t elapsed = time > start? time - start : 0;
+        return epoch_format<Digits>::write(p, elapsed);
+    }
+};
+
+}   // namespace reckless
+
+#endif  // RECKLESS_TIMESTAMP_FORMAT_HPP
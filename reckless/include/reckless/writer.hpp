@@ -42,6 +42,21 @@ public:
     virtual ~writer() = 0;
     virtual std::size_t write(void const* pbuffer, std::size_t count,
             std::error_code& ec) noexcept = 0;
+
+    // Called by output_buffer before the first write. A writer that returns
+    // true takes ownership of every complete memory page passed to write()
+    // that it reports as written: the buffer passed to write() is
+    // page-aligned, and once write() returns, output_buffer never reads or
+    // modifies those pages again but replaces them with fresh ones. It keeps
+    // using a page that was only partly written, so the writer must not hold
+    // on to that one. This lets the writer hand the pages to
+    // the kernel without copying them, e.g. with vmsplice(). A writer that
+    // forwards data to other writers must not forward this call, since it
+    // can't make the same promise to them.
+    virtual bool enable_page_gifts() noexcept
+    {
+        return false;
+    }
 };
 
 inline std::error_condition make_error_condition(writer::errc ec)
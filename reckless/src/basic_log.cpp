@@ -23,9 +23,14 @@
 
 #include <reckless/basic_log.hpp>
 #include <reckless/detail/platform.hpp>
+#include <reckless/clock.hpp>   // coarse_monotonic_now
+#include <reckless/process_field.hpp>   // render_process_fields
 
 #include <vector>
+#include <cstdio>       // snprintf
+#include <cstring>      // memcmp
 #include <algorithm>    // max, min
+#include <utility>      // swap
 #include <thread>       // sleep_for
 #include <sstream>      // ostringstream
 #include <chrono>       // hours
@@ -42,6 +47,11 @@ namespace {
 unsigned max_input_buffer_poll_period_ms = 1000u;
 unsigned input_buffer_poll_period_inverse_growth_factor = 4;
 
+// Duplicate suppression keeps a copy of the previous record, to compare the
+// next one with. Records longer than this are never suppressed, which bounds
+// the memory used for it.
+std::size_t const max_duplicate_message_size = 1024;
+
 #ifdef RECKLESS_ENABLE_TRACE_LOG
 struct output_worker_start_event :
     public detail::timestamped_trace_event
@@ -176,6 +186,7 @@ void basic_log::open(writer* pwriter,
     std::size_t output_buffer_capacity)
 {
     assert(!is_open());
+    detail::render_process_fields();
 
     // We used to use the page size for input buffer capacity.
     // However, after introducing the new ring buffer for Windows
@@ -378,7 +389,7 @@ void basic_log::output_worker()
     output_worker_native_id_ = GetCurrentThreadId();
 #endif
 
-    set_thread_name("reckless output worker");
+    detail::set_thread_name("reckless output worker");
 
     frame_status status = frame_status::uninitialized;
     while(likely(status < frame_status::shutdown_marker)) {
@@ -442,9 +453,13 @@ void basic_log::output_worker()
                 batch_end = batch_start + batch_size;
             }
         } while(unlikely(panic_flush));
+        if(repeat_count_ != 0)
+            write_due_repeat_summary(false);
         RECKLESS_TRACE(process_batch_finish_event);
     }
 
+    if(repeat_count_ != 0)
+        write_due_repeat_summary(true);
     if(output_buffer::has_complete_frame()) {
         // Can't do much here if there is a flush error here since we are
         // shutting down. The error code will be checked by close() when
@@ -472,6 +487,9 @@ std::size_t basic_log::wait_for_input()
     while(true) {
         input_buffer_empty_event_.notify_all();
 
+        if(repeat_count_ != 0)
+            write_due_repeat_summary(false);
+
         // The output buffer is flushed at least once before waiting for more
         // input. This makes sure that data gets sent to the writer immediately
         // whenever there's a pause in incoming log messages. If this flush
@@ -537,7 +555,12 @@ std::size_t basic_log::process_frame(void* pframe)
     try {
         frame_size = (*pdispatch)(invoke_formatter,
                 static_cast<output_buffer*>(this), pframe);
-        output_buffer::frame_end();
+        auto timeout_ms = duplicate_timeout_ms_.load(
+            std::memory_order_relaxed);
+        if(likely(timeout_ms == 0 && repeat_count_ == 0))
+            output_buffer::frame_end();
+        else
+            end_frame_suppressing_duplicates(timeout_ms);
     } catch(flush_error const&) {
         // A flush error occurs here if there was not enough space in
         // the output buffer and it had to be flushed to make room, but
@@ -571,6 +594,84 @@ std::size_t basic_log::skip_frame(void* pframe)
     return (*pdispatch)(get_typeid, &pti, nullptr);
 }
 
+// Called instead of frame_end() when duplicate suppression is on, or when it
+// was turned off with repeats that are yet to be reported.
+void basic_log::end_frame_suppressing_duplicates(unsigned timeout_ms)
+{
+    std::size_t size = 0;
+    bool comparable = false;
+    if(timeout_ms != 0) {
+        if(!previous_message_) {
+            previous_message_.reset(new char[max_duplicate_message_size]);
+            current_message_.reset(new char[max_duplicate_message_size]);
+        }
+        comparable = output_buffer::copy_frame_for_comparison(
+            current_message_.get(), max_duplicate_message_size, &size);
+    }
+    if(comparable && has_previous_message_ && size == previous_message_size_
+        && std::memcmp(current_message_.get(), previous_message_.get(),
+            size) == 0)
+    {
+        // The timeout is checked between batches, so that we don't have to
+        // read the clock for every repeat.
+        output_buffer::revert_frame();
+        if(repeat_count_ == 0)
+            first_repeat_time_ = detail::coarse_monotonic_now();
+        ++repeat_count_;
+        return;
+    }
+
+    // Keep this record to compare the next one with.
+    has_previous_message_ = comparable;
+    if(comparable) {
+        std::swap(previous_message_, current_message_);
+        previous_message_size_ = size;
+    }
+    if(repeat_count_ != 0)
+        write_repeat_summary(true);
+    output_buffer::frame_end();
+}
+
+void basic_log::write_repeat_summary(bool before_frame)
+{
+    char summary[64];
+#if defined(_WIN32)
+    char const* format = "last message repeated %u time%s\r\n";
+#else
+    char const* format = "last message repeated %u time%s\n";
+#endif
+    int size = std::snprintf(summary, sizeof(summary), format, repeat_count_,
+        repeat_count_ == 1? "" : "s");
+    if(before_frame) {
+        output_buffer::insert_before_frame(summary, size);
+    } else {
+        output_buffer::write(summary, size);
+        output_buffer::frame_end();
+    }
+    repeat_count_ = 0;
+}
+
+// Write the summary of repeated records if the timeout has passed since the
+// first repeat, or regardless of that if force is true. This is called
+// between frames.
+void basic_log::write_due_repeat_summary(bool force)
+{
+    auto timeout_ms = duplicate_timeout_ms_.load(std::memory_order_relaxed);
+    auto elapsed = detail::coarse_monotonic_now() - first_repeat_time_;
+    if(!force && timeout_ms != 0 &&
+            elapsed < timeout_ms*std::uint64_t(1000000))
+    {
+        return;
+    }
+    try {
+        write_repeat_summary(false);
+    } catch(flush_error const&) {
+        // Whatever was written before the flush failed is incomplete, so
+        // drop it. The summary is tried again later.
+        output_buffer::revert_frame();
+    }
+}
+
 void basic_log::clear_frame(void* pframe, std::size_t frame_size)
 {
     using namespace detail;
@@ -599,6 +700,8 @@ void basic_log::flush_output_buffer()
 
 void basic_log::on_panic_flush_done()
 {
+    if(repeat_count_ != 0)
+        write_due_repeat_summary(true);
     if(output_buffer::has_complete_frame()) {
         // We get one chance to flush what remains in the output buffer. If it
         // fails now then we'll just have to live with that and crash.
@@ -0,0 +1,342 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/binary_log.hpp>
+#include <reckless/template_formatter.hpp>
+#include <reckless/clock.hpp>
+#include <reckless/timestamp_format.hpp>
+
+#include <cassert>
+
+namespace reckless {
+namespace detail {
+
+void binary_dictionary::undefine(char const* pformat, char const* psignature)
+{
+    key k = {pformat, psignature};
+    ids_.erase(k);
+}
+
+void binary_dictionary::clear()
+{
+    ids_.clear();
+    next_id_ = 0;
+    header_written_ = false;
+}
+
+std::uint32_t binary_dictionary::define(output_buffer* pbuffer, key const& k)
+{
+    std::size_t signature_size = std::strlen(k.psignature);
+    std::size_t format_size = std::strlen(k.pformat);
+    std::size_t header_size = header_written_? 0 : BINARY_LOG_HEADER_SIZE;
+    std::size_t size = header_size + 1 + 4 + 2 + 4 + signature_size
+        + format_size;
+    char* p = pbuffer->reserve(size);
+    if(!header_written_) {
+        *p = 'H';
+        p = write_binary(p + 1, "RKB", 3);
+        p = write_binary(p, BINARY_LOG_VERSION);
+        p = write_binary(p, BINARY_LOG_BYTE_ORDER_MARK);
+    }
+    std::uint32_t id = next_id_;
+    *p = 'D';
+    p = write_binary(p + 1, id);
+    p = write_binary(p, static_cast<std::uint16_t>(signature_size));
+    p = write_binary(p, static_cast<std::uint32_t>(format_size));
+    p = write_binary(p, k.psignature, signature_size);
+    write_binary(p, k.pformat, format_size);
+    pbuffer->commit(size);
+
+    ids_.emplace(k, id);
+    ++next_id_;
+    header_written_ = true;
+    return id;
+}
+
+std::uint64_t binary_timestamp()
+{
+    return coarse_realtime_clock::now();
+}
+
+}   // namespace detail
+
+namespace {
+template <class T>
+char const* read_binary(char const* p, char const* pend, T* pvalue)
+{
+    if(static_cast<std::size_t>(pend - p) < sizeof(T))
+        throw decode_error("truncated binary_log record");
+    std::memcpy(pvalue, p, sizeof(T));
+    return p + sizeof(T);
+}
+}   // anonymous namespace
+
+binary_log::~binary_log()
+{
+    if(is_open()) {
+        std::error_code error;
+        close(error);
+    }
+}
+
+void binary_log::close(std::error_code& ec) noexcept
+{
+    basic_log::close(ec);
+    // The worker thread has exited, so we can safely touch the dictionary. If
+    // the log is opened again it will start a new stream.
+    dictionary_.clear();
+}
+
+binary_log_decoder::binary_log_decoder(writer* pwriter,
+        std::size_t output_buffer_capacity) :
+    buffer_(pwriter, output_buffer_capacity)
+{
+}
+
+std::size_t binary_log_decoder::decode(void const* pdata, std::size_t size)
+{
+    char const* p = static_cast<char const*>(pdata);
+    std::size_t consumed = 0;
+    try {
+        while(true) {
+            std::size_t record_size = decode_record(p + consumed,
+                size - consumed);
+            if(record_size == 0)
+                break;
+            consumed += record_size;
+        }
+    } catch(flush_error const& e) {
+        throw writer_error(e.code());
+    }
+    return consumed;
+}
+
+void binary_log_decoder::flush()
+{
+    try {
+        buffer_.flush();
+    } catch(flush_error const& e) {
+        throw writer_error(e.code());
+    }
+}
+
+// Returns the size of the record at p, or 0 if it is incomplete.
+std::size_t binary_log_decoder::decode_record(char const* p, std::size_t size)
+{
+    using namespace detail;
+    if(size == 0)
+        return 0;
+    char tag = *p;
+    char const* pend = p + size;
+    if(tag == 'H') {
+        if(size < BINARY_LOG_HEADER_SIZE)
+            return 0;
+        std::uint8_t version;
+        std::uint16_t byte_order_mark;
+        read_binary(p + 4, pend, &version);
+        read_binary(p + 5, pend, &byte_order_mark);
+        if(std::memcmp(p + 1, "RKB", 3) != 0)
+            throw decode_error("not a binary_log stream");
+        if(byte_order_mark != BINARY_LOG_BYTE_ORDER_MARK)
+            throw decode_error("binary_log stream has a different byte order");
+        if(version != BINARY_LOG_VERSION)
+            throw decode_error("unsupported binary_log version");
+        definitions_.clear();
+        header_seen_ = true;
+        return BINARY_LOG_HEADER_SIZE;
+    }
+
+    if(!header_seen_)
+        throw decode_error("not a binary_log stream");
+
+    if(tag == 'D') {
+        std::size_t const fixed_size = 1 + 4 + 2 + 4;
+        if(size < fixed_size)
+            return 0;
+        std::uint32_t id;
+        std::uint16_t signature_size;
+        std::uint32_t format_size;
+        char const* pnext = read_binary(p + 1, pend, &id);
+        pnext = read_binary(pnext, pend, &signature_size);
+        pnext = read_binary(pnext, pend, &format_size);
+        std::size_t record_size = fixed_size + signature_size + format_size;
+        if(size < record_size)
+            return 0;
+        definition& def = definitions_[id];
+        def.signature.assign(pnext, signature_size);
+        pnext += signature_size;
+        def.pformat = formats_.emplace(pnext, format_size).first->c_str();
+        return record_size;
+    }
+
+    if(tag == 'R') {
+        std::size_t const fixed_size = 1 + 4 + 4;
+        if(size < fixed_size)
+            return 0;
+        std::uint32_t id;
+        std::uint32_t payload_size;
+        char const* pnext = read_binary(p + 1, pend, &id);
+        pnext = read_binary(pnext, pend, &payload_size);
+        std::size_t record_size = fixed_size + payload_size;
+        if(size < record_size)
+            return 0;
+        auto it = definitions_.find(id);
+        if(it == definitions_.end()) {
+            ++undefined_record_count_;
+        } else {
+            // Don't leave half a line in the output if the record turns out
+            // to be corrupt.
+            try {
+                format_record(it->second, pnext, pnext + payload_size);
+            } catch(...) {
+                buffer_.revert_frame();
+                throw;
+            }
+            buffer_.frame_end();
+        }
+        return record_size;
+    }
+
+    throw decode_error("corrupt binary_log stream");
+}
+
+void binary_log_decoder::format_record(definition const& def, char const* p,
+        char const* pend)
+{
+    std::uint64_t timestamp;
+    p = read_binary(p, pend, &timestamp);
+    format_timestamp(timestamp);
+    buffer_.write(' ');
+
+    // Once the format string runs out of conversion specifications the
+    // remaining arguments are ignored, like template_formatter does. We still
+    // need to read them to validate the record.
+    char const* pformat = def.pformat;
+    std::string string_argument;
+    for(char code : def.signature) {
+        switch(code) {
+        case 'c': {
+            char v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'a': {
+            signed char v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'A': {
+            unsigned char v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'i': {
+            std::int32_t v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'I': {
+            std::uint32_t v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'q': {
+            std::int64_t v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'Q': {
+            std::uint64_t v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'f': {
+            float v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'd': {
+            double v;
+            p = read_binary(p, pend, &v);
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, v);
+            break;
+        }
+        case 'p': {
+            std::uint64_t v;
+            p = read_binary(p, pend, &v);
+            void const* pointer = reinterpret_cast<void const*>(
+                static_cast<std::uintptr_t>(v));
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat, pointer);
+            break;
+        }
+        case 's': {
+            std::uint32_t length;
+            p = read_binary(p, pend, &length);
+            if(static_cast<std::size_t>(pend - p) < length)
+                throw decode_error("truncated binary_log record");
+            string_argument.assign(p, length);
+            p += length;
+            if(pformat)
+                pformat = template_formatter::format_argument(&buffer_, pformat,
+                    string_argument);
+            break;
+        }
+        default:
+            throw decode_error("unknown argument type in binary_log stream");
+        }
+    }
+    if(pformat)
+        template_formatter::format(&buffer_, pformat);
+
+#if defined(_WIN32)
+    buffer_.write("\r\n", 2);
+#else
+    buffer_.write('\n');
+#endif
+}
+
+// Same layout as timestamp_field: YYYY-MM-DD HH:MM:SS.FFF in local time.
+void binary_log_decoder::format_timestamp(std::uint64_t timestamp)
+{
+    typedef local_time_format<3> format;
+    char* p = buffer_.reserve(format::MAX_SIZE);
+    buffer_.commit(format::write(p, timestamp) - p);
+}
+
+}   // namespace reckless
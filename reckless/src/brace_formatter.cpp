@@ -0,0 +1,311 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/brace_formatter.hpp>
+#include <reckless/output_buffer.hpp>
+#include <reckless/ntoa.hpp>
+
+#include <cstring>  // memmove, memset, strncmp
+
+namespace reckless {
+namespace detail {
+namespace {
+    // Conversion specifications must stay at the same address for as long as
+    // they have the same contents, because template_formatter caches parsed
+    // specifications by address. So single-character specifications are
+    // taken from here rather than built on the stack.
+    char const SINGLE_CHARACTER_SPECS[] =
+        "a\0b\0c\0d\0e\0f\0g\0h\0i\0j\0k\0l\0m\0n\0o\0p\0q\0r\0s\0t\0u\0v\0w\0x\0y\0z\0"
+        "A\0B\0C\0D\0E\0F\0G\0H\0I\0J\0K\0L\0M\0N\0O\0P\0Q\0R\0S\0T\0U\0V\0W\0X\0Y\0Z";
+
+    char const* single_character_spec(char type)
+    {
+        if(type >= 'a' && type <= 'z')
+            return SINGLE_CHARACTER_SPECS + 2*(type - 'a');
+        else
+            return SINGLE_CHARACTER_SPECS + 2*(26 + type - 'A');
+    }
+
+    char* write_unsigned(char* p, unsigned value)
+    {
+        char digits[10];
+        unsigned count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while(value != 0);
+        while(count != 0)
+            *p++ = digits[--count];
+        return p;
+    }
+
+    template <typename T>
+    bool format_integer(output_buffer* pbuffer, conversion_specification cs,
+        char type, T value)
+    {
+        if(type == 'd') {
+            itoa_base10(pbuffer, value, cs);
+        } else if(type == 'x' || type == 'X') {
+            cs.uppercase = type == 'X';
+            itoa_base16(pbuffer, value, cs);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    brace_argument const* find_argument(char const* pformat,
+        brace_segment const& segment, brace_argument const* parguments,
+        std::size_t argument_count)
+    {
+        if(segment.argument_index != BRACE_NAMED_ARGUMENT) {
+            if(segment.argument_index < argument_count)
+                return &parguments[segment.argument_index];
+            return nullptr;
+        }
+
+        char const* pname = pformat + segment.name_begin;
+        std::size_t length = segment.name_end - segment.name_begin;
+        for(std::size_t i=0; i!=argument_count; ++i) {
+            char const* candidate = parguments[i].name;
+            if(candidate && std::strncmp(candidate, pname, length) == 0
+                    && candidate[length] == '\0')
+            {
+                return &parguments[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Pad the last size bytes of output to the width of the field.
+    void pad(output_buffer* pbuffer, std::size_t size,
+        brace_specification const& spec, char default_align)
+    {
+        if(size >= spec.width)
+            return;
+        std::size_t padding = spec.width - size;
+        char align = spec.align? spec.align : default_align;
+        std::size_t before;
+        if(align == '<')
+            before = 0;
+        else if(align == '^')
+            before = padding/2;
+        else
+            before = padding;
+
+        // If reserve() has to flush, it keeps the bytes of the current frame,
+        // so the field is still right before the reserved space.
+        char* p = pbuffer->reserve(padding);
+        char* pfield = p - size;
+        std::memmove(pfield + before, pfield, size);
+        std::memset(pfield, spec.fill, before);
+        std::memset(pfield + before + size, spec.fill, padding - before);
+        pbuffer->commit(padding);
+    }
+
+    bool format_number_field(output_buffer* pbuffer,
+        brace_specification const& spec, brace_argument const& argument)
+    {
+        conversion_specification cs;
+        cs.precision = spec.precision == BRACE_NO_PRECISION?
+            UNSPECIFIED_PRECISION : spec.precision;
+        cs.plus_sign = spec.sign;
+        cs.alternative_form = spec.alternative_form;
+        char type = spec.type? spec.type : argument.default_type;
+
+        // ntoa can pad with spaces to either side, or with zeroes after the
+        // sign. Anything else is padded afterwards.
+        bool ntoa_pads = spec.fill == ' ' && spec.align != '^';
+        if(ntoa_pads) {
+            cs.minimum_field_width = spec.width;
+            cs.left_justify = spec.align == '<';
+            cs.pad_with_zeroes = spec.zero_pad && !spec.align;
+            return argument.format_number(pbuffer, cs, type, argument.pvalue);
+        }
+
+        std::size_t start = pbuffer->frame_size();
+        if(!argument.format_number(pbuffer, cs, type, argument.pvalue))
+            return false;
+        std::size_t end = pbuffer->frame_size();
+        if(end >= start)
+            pad(pbuffer, end - start, spec, '>');
+        return true;
+    }
+
+    bool format_other_field(output_buffer* pbuffer,
+        brace_specification const& spec, brace_argument const& argument)
+    {
+        char type = spec.type? spec.type : argument.default_type;
+        char const* pspec;
+        char buffer[16];
+        if(spec.precision == BRACE_NO_PRECISION) {
+            pspec = single_character_spec(type);
+        } else {
+            char* p = buffer;
+            *p++ = '.';
+            p = write_unsigned(p, spec.precision);
+            *p++ = type;
+            *p = '\0';
+            pspec = buffer;
+        }
+
+        std::size_t start = pbuffer->frame_size();
+        if(!argument.format(pbuffer, pspec, argument.pvalue))
+            return false;
+        std::size_t end = pbuffer->frame_size();
+        // A formatter that streams its output with partial_frame_end() may
+        // have been flushed, in which case we can't measure it.
+        if(end >= start)
+            pad(pbuffer, end - start, spec, '<');
+        return true;
+    }
+
+    void format_segment(output_buffer* pbuffer, char const* pformat,
+        brace_segment const& segment, brace_argument const* parguments,
+        std::size_t argument_count)
+    {
+        pbuffer->write(pformat + segment.literal_begin,
+            segment.literal_end - segment.literal_begin);
+        if(segment.kind != brace_segment_kind::field)
+            return;
+
+        brace_argument const* pargument = find_argument(pformat, segment,
+            parguments, argument_count);
+        bool success;
+        if(!pargument)
+            success = false;
+        else if(pargument->format_number)
+            success = format_number_field(pbuffer, segment.spec, *pargument);
+        else
+            success = format_other_field(pbuffer, segment.spec, *pargument);
+
+        // Like template_formatter, we write the field as it is if it can't
+        // be formatted, so that the mistake shows in the log.
+        if(!success) {
+            pbuffer->write(pformat + segment.literal_end,
+                segment.end - segment.literal_end);
+        }
+    }
+
+    std::size_t find_brace(char const* s, std::size_t pos)
+    {
+        while(s[pos] != '\0' && s[pos] != '{' && s[pos] != '}')
+            ++pos;
+        return pos;
+    }
+}   // anonymous namespace
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, int value)
+{
+    return format_integer(pbuffer, cs, type, value);
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, unsigned int value)
+{
+    return format_integer(pbuffer, cs, type, value);
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, long value)
+{
+    return format_integer(pbuffer, cs, type, value);
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, unsigned long value)
+{
+    return format_integer(pbuffer, cs, type, value);
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, long long value)
+{
+    return format_integer(pbuffer, cs, type, value);
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, unsigned long long value)
+{
+    return format_integer(pbuffer, cs, type, value);
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, double value)
+{
+    conversion_specification ucs = cs;
+    ucs.uppercase = type == 'F' || type == 'E' || type == 'G';
+    if(type == 'f' || type == 'F')
+        ftoa_base10_f(pbuffer, value, ucs);
+    else if(type == 'e' || type == 'E')
+        ftoa_base10_e(pbuffer, value, ucs);
+    else if(type == 'g' || type == 'G')
+        ftoa_base10_g(pbuffer, value, ucs);
+    else
+        return false;
+    return true;
+}
+
+bool format_brace_number(output_buffer* pbuffer,
+    conversion_specification const& cs, char type, long double value)
+{
+    return format_brace_number(pbuffer, cs, type, static_cast<double>(value));
+}
+
+char const* format_brace_bool(output_buffer* pbuffer, char const* pspec,
+    void const* pvalue)
+{
+    bool value = *static_cast<bool const*>(pvalue);
+    if(pspec[0] == 's' && pspec[1] == '\0') {
+        pbuffer->write(value? "true" : "false");
+        return pspec + 1;
+    }
+    return format(pbuffer, pspec, value? 1 : 0);
+}
+
+void format_brace_segments(output_buffer* pbuffer, char const* pformat,
+    brace_segment const* psegments, std::size_t segment_count,
+    brace_argument const* parguments, std::size_t argument_count)
+{
+    for(std::size_t i=0; i!=segment_count; ++i)
+        format_segment(pbuffer, pformat, psegments[i], parguments,
+            argument_count);
+}
+
+void format_brace_string(output_buffer* pbuffer, char const* pformat,
+    brace_argument const* parguments, std::size_t argument_count)
+{
+    std::size_t pos = 0;
+    unsigned automatic_index = 0;
+    while(true) {
+        brace_segment segment = brace_parse_segment(pformat, pos,
+            find_brace(pformat, pos), automatic_index);
+        format_segment(pbuffer, pformat, segment, parguments, argument_count);
+        if(segment.kind == brace_segment_kind::end)
+            return;
+        pos = segment.end;
+        automatic_index = segment.next_automatic_index;
+    }
+}
+
+}   // namespace detail
+}   // namespace reckless
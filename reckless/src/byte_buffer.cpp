@@ -0,0 +1,311 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/byte_buffer.hpp>
+#include <reckless/output_buffer.hpp>
+
+#include <algorithm>    // min
+#include <cstdint>
+#include <cstring>    // memcmp, memset
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RECKLESS_BYTE_BUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace reckless {
+namespace {
+
+// Buffers larger than this are formatted in chunks of this size, marking the
+// end of each chunk with partial_frame_end() so that the output can be larger
+// than the output buffer. A chunk gives at most about 5 KiB of output.
+std::size_t const STREAM_CHUNK_SIZE = 1024;
+
+// Offset, separators, hex and characters for a single line of a dump, plus a
+// leading newline.
+std::size_t const MAX_DUMP_LINE_SIZE = 1 + 16 + 2 + 50 + 1 + 16 + 1;
+
+char const LOWERCASE_DIGITS[] = "0123456789abcdef";
+char const UPPERCASE_DIGITS[] = "0123456789ABCDEF";
+
+inline void hex_byte(char* p, unsigned char c, char const* digits)
+{
+    p[0] = digits[c >> 4];
+    p[1] = digits[c & 0x0f];
+}
+
+#if defined(RECKLESS_BYTE_BUFFER_SSE2)
+inline __m128i nibbles_to_ascii(__m128i v, bool uppercase)
+{
+    // '0' + v, plus the distance from '9'+1 to 'a' (or 'A') for v > 9.
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(9)),
+        _mm_set1_epi8(uppercase? 'A' - '0' - 10 : 'a' - '0' - 10));
+    return _mm_add_epi8(_mm_add_epi8(v, _mm_set1_epi8('0')), letter);
+}
+
+// Write 16 bytes from s as 32 hexadecimal digits.
+inline void hex_16(char* p, unsigned char const* s, bool uppercase)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    __m128i low = _mm_and_si128(v, mask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+        nibbles_to_ascii(_mm_unpacklo_epi8(high, low), uppercase));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16),
+        nibbles_to_ascii(_mm_unpackhi_epi8(high, low), uppercase));
+}
+
+// Store the four 32-bit lanes of v at p, p+3, p+6 and p+9.
+inline void store_triples(char* p, __m128i v)
+{
+    for(unsigned i=0; i!=4; ++i) {
+        std::uint32_t lane = static_cast<std::uint32_t>(_mm_cvtsi128_si32(v));
+        std::memcpy(p + 3*i, &lane, 4);
+        v = _mm_srli_si128(v, 4);
+    }
+}
+
+// Write 16 bytes from s as pairs of hexadecimal digits, each followed by a
+// space, in two groups of eight with extra_space bytes between the groups.
+// This writes a space to the byte after the last pair too.
+inline void spaced_hex_16(char* p, unsigned char const* s, bool uppercase,
+        unsigned extra_space)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+    __m128i low = _mm_and_si128(v, mask);
+    __m128i first = nibbles_to_ascii(_mm_unpacklo_epi8(high, low), uppercase);
+    __m128i second = nibbles_to_ascii(_mm_unpackhi_epi8(high, low), uppercase);
+    __m128i spaces = _mm_set1_epi8(' ');
+    store_triples(p, _mm_unpacklo_epi16(first, spaces));
+    store_triples(p + 12, _mm_unpackhi_epi16(first, spaces));
+    p += 24 + extra_space;
+    store_triples(p, _mm_unpacklo_epi16(second, spaces));
+    store_triples(p + 12, _mm_unpackhi_epi16(second, spaces));
+}
+
+// Write 16 bytes from s as characters, with '.' in place of anything that is
+// not printable ASCII.
+inline void printable_16(char* p, unsigned char const* s)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+    // The comparisons are signed, so bytes from 0x80 up are below 0x20.
+    __m128i printable = _mm_and_si128(
+        _mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+        _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+    __m128i result = _mm_or_si128(_mm_and_si128(printable, v),
+        _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), result);
+}
+#else
+inline void hex_16(char* p, unsigned char const* s, bool uppercase)
+{
+    char const* digits = uppercase? UPPERCASE_DIGITS : LOWERCASE_DIGITS;
+    for(unsigned i=0; i!=16; ++i)
+        hex_byte(p + 2*i, s[i], digits);
+}
+
+inline void spaced_hex_16(char* p, unsigned char const* s, bool uppercase,
+        unsigned extra_space)
+{
+    char const* digits = uppercase? UPPERCASE_DIGITS : LOWERCASE_DIGITS;
+    for(unsigned i=0; i!=16; ++i) {
+        char* pbyte = p + 3*i + (i >= 8? extra_space : 0);
+        hex_byte(pbyte, s[i], digits);
+        pbyte[2] = ' ';
+    }
+    for(unsigned i=0; i!=extra_space; ++i)
+        p[24 + i] = ' ';
+    p[48 + extra_space] = ' ';
+}
+
+inline void printable_16(char* p, unsigned char const* s)
+{
+    for(unsigned i=0; i!=16; ++i)
+        p[i] = (s[i] >= 0x20 && s[i] < 0x7f)? static_cast<char>(s[i]) : '.';
+}
+#endif
+
+void write_hex(output_buffer* pbuffer, unsigned char const* s,
+        std::size_t size, bool uppercase, bool spaced)
+{
+    char const* digits = uppercase? UPPERCASE_DIGITS : LOWERCASE_DIGITS;
+    unsigned char const* pend = s + size;
+    bool stream = size > STREAM_CHUNK_SIZE;
+    while(s != pend) {
+        std::size_t n = std::min(static_cast<std::size_t>(pend - s),
+                STREAM_CHUNK_SIZE);
+        std::size_t i = 0;
+        if(!spaced) {
+            char* p = pbuffer->reserve(2*n);
+            for(; i+16 <= n; i+=16)
+                hex_16(p + 2*i, s + i, uppercase);
+            for(; i != n; ++i)
+                hex_byte(p + 2*i, s[i], digits);
+            pbuffer->commit(2*n);
+        } else {
+            // Every byte is followed by a space, except the very last one.
+            // spaced_hex_16 writes one byte past the end.
+            char* p = pbuffer->reserve(3*n + 1);
+            for(; i+16 <= n; i+=16) {
+                spaced_hex_16(p + 3*i, s + i, uppercase, 0);
+            }
+            for(; i != n; ++i) {
+                hex_byte(p + 3*i, s[i], digits);
+                p[3*i+2] = ' ';
+            }
+            pbuffer->commit(s + n == pend? 3*n - 1 : 3*n);
+        }
+        s += n;
+        if(stream)
+            pbuffer->partial_frame_end();
+    }
+}
+
+char* write_offset(char* p, std::uint64_t offset, char const* digits)
+{
+    unsigned count = 8;
+    while(count != 16 && (offset >> 4*count) != 0)
+        ++count;
+    for(unsigned i=count; i!=0; --i) {
+        p[i-1] = digits[offset & 0x0f];
+        offset >>= 4;
+    }
+    return p + count;
+}
+
+// Write one line in hexdump -C format: the offset, the bytes in hex in two
+// groups of eight, and the bytes as characters between bars.
+char* write_dump_line(char* p, std::uint64_t offset, unsigned char const* s,
+        std::size_t n, bool uppercase)
+{
+    char const* digits = uppercase? UPPERCASE_DIGITS : LOWERCASE_DIGITS;
+    *p++ = '\n';
+    p = write_offset(p, offset, digits);
+    *p++ = ' ';
+    *p++ = ' ';
+    if(n == 16) {
+        // With the byte that spaced_hex_16 writes past the end, this fills
+        // all 50 columns.
+        spaced_hex_16(p, s, uppercase, 1);
+        p += 50;
+        *p++ = '|';
+        printable_16(p, s);
+        p += 16;
+    } else {
+        std::memset(p, ' ', 50);
+        for(unsigned i=0; i!=n; ++i)
+            hex_byte(p + 3*i + (i >= 8), s[i], digits);
+        p += 50;
+        *p++ = '|';
+        for(unsigned i=0; i!=n; ++i) {
+            *p++ = (s[i] >= 0x20 && s[i] < 0x7f)?
+                static_cast<char>(s[i]) : '.';
+        }
+    }
+    *p++ = '|';
+    return p;
+}
+
+void write_dump(output_buffer* pbuffer, unsigned char const* s,
+        std::size_t size, bool uppercase)
+{
+    if(size == 0)
+        return;
+    // Like hexdump, print a single "*" in place of lines that are identical
+    // to the one before them.
+    bool stream = size > STREAM_CHUNK_SIZE;
+    bool squeezing = false;
+    std::size_t offset = 0;
+    while(offset != size) {
+        std::size_t n = std::min(size - offset, static_cast<std::size_t>(16));
+        unsigned char const* pline = s + offset;
+        if(n == 16 && offset != 0 && std::memcmp(pline - 16, pline, 16) == 0) {
+            if(!squeezing)
+                pbuffer->write("\n*", 2);
+            squeezing = true;
+        } else {
+            squeezing = false;
+            char* pstart = pbuffer->reserve(MAX_DUMP_LINE_SIZE);
+            char* p = write_dump_line(pstart, offset, pline, n, uppercase);
+            pbuffer->commit(p - pstart);
+        }
+        offset += n;
+        if(stream && offset % STREAM_CHUNK_SIZE == 0)
+            pbuffer->partial_frame_end();
+    }
+    char* pstart = pbuffer->reserve(1 + 16);
+    char* p = pstart;
+    *p++ = '\n';
+    p = write_offset(p, offset, uppercase? UPPERCASE_DIGITS : LOWERCASE_DIGITS);
+    pbuffer->commit(p - pstart);
+}
+
+char const* format_bytes(output_buffer* pbuffer, char const* pformat,
+        unsigned char const* s, std::size_t size)
+{
+    bool dump = false;
+    bool spaced = false;
+    while(true) {
+        if(*pformat == '#')
+            dump = true;
+        else if(*pformat == ' ')
+            spaced = true;
+        else
+            break;
+        ++pformat;
+    }
+    if(*pformat == '.') {
+        ++pformat;
+        std::size_t precision = 0;
+        while(*pformat >= '0' && *pformat <= '9') {
+            precision = 10*precision + (*pformat - '0');
+            ++pformat;
+        }
+        size = std::min(size, precision);
+    }
+
+    char conversion = *pformat;
+    if(conversion != 'x' && conversion != 'X')
+        return nullptr;
+    bool uppercase = conversion == 'X';
+    if(dump)
+        write_dump(pbuffer, s, size, uppercase);
+    else
+        write_hex(pbuffer, s, size, uppercase, spaced);
+    return pformat + 1;
+}
+
+}   // anonymous namespace
+
+char const* format(output_buffer* pbuffer, char const* pformat, byte_view const& v)
+{
+    return format_bytes(pbuffer, pformat, v.data(), v.size());
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, byte_buffer const& v)
+{
+    return format_bytes(pbuffer, pformat, v.data(), v.size());
+}
+
+}   // namespace reckless
@@ -0,0 +1,142 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/category.hpp>
+#include <reckless/call_site.hpp>   // severity_mask
+#include <reckless/output_buffer.hpp>
+
+#include <algorithm>    // find
+#include <map>
+#include <mutex>
+
+namespace reckless {
+namespace detail {
+category_generation_t category_generation = {{}, 1, {}};
+}
+
+namespace {
+    struct registry {
+        std::mutex mutex;
+        std::vector<category const*> categories;
+        // Maps a name to the mask that applies to it and the names below it.
+        std::map<std::string, unsigned> rules;
+    };
+
+    // Categories register in their constructors, so this is constructed
+    // before and destroyed after any category.
+    registry& get_registry()
+    {
+        static registry r;
+        return r;
+    }
+
+    // Finds the most specific rule for a name, i.e. the rule for the name
+    // itself or for the longest prefix of it that ends before a dot. Must be
+    // called with the registry locked.
+    unsigned find_rule(registry const& r, char const* name)
+    {
+        if(r.rules.empty())
+            return 0;
+        std::string prefix(name);
+        while(true) {
+            auto it = r.rules.find(prefix);
+            if(it != r.rules.end())
+                return it->second | detail::CATEGORY_HAS_RULE;
+            auto dot = prefix.rfind('.');
+            if(dot == std::string::npos)
+                return 0;
+            prefix.resize(dot);
+        }
+    }
+
+    // Must be called with the registry locked.
+    void bump_generation()
+    {
+        detail::atomic_store_relaxed(&detail::category_generation.value,
+            detail::category_generation.value + 1);
+    }
+}
+
+category::category(char const* name) :
+    name_(name),
+    state_(0)
+{
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.categories.push_back(this);
+}
+
+category::~category()
+{
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.categories.erase(std::find(r.categories.begin(), r.categories.end(),
+        this));
+}
+
+unsigned category::refresh() const
+{
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    // The generation only changes with the registry locked, so the mask
+    // computed here is the right one for it.
+    std::uint64_t generation = detail::category_generation.value;
+    unsigned mask = find_rule(r, name_);
+    detail::atomic_store_relaxed(&state_, generation << 8 | mask);
+    return mask;
+}
+
+void set_category_min_severity(char const* name, char severity)
+{
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.rules[name] = detail::severity_mask(severity);
+    bump_generation();
+}
+
+void clear_category_min_severity(char const* name)
+{
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if(r.rules.erase(name) != 0)
+        bump_generation();
+}
+
+std::vector<std::string> category_names()
+{
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::string> names;
+    names.reserve(r.categories.size());
+    for(category const* pcategory : r.categories)
+        names.push_back(pcategory->name());
+    return names;
+}
+
+void category_field::format(output_buffer* pbuffer) const
+{
+    if(pcategory_)
+        pbuffer->write(pcategory_->name());
+    else
+        pbuffer->write('-');
+}
+
+}   // namespace reckless
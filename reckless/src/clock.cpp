@@ -0,0 +1,107 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/clock.hpp>
+
+namespace reckless {
+namespace detail {
+
+RECKLESS_TLS clock_calibration monotonic_calibration;
+RECKLESS_TLS clock_calibration tsc_calibration;
+
+namespace {
+    std::uint64_t const NANOSECONDS_PER_SECOND = 1000000000u;
+    // How long the initial measurement of the TSC frequency takes.
+    std::uint64_t const INITIAL_CALIBRATION_TIME = 10000000u;
+
+    double monotonic_ns_per_tick()
+    {
+#if defined(_WIN32)
+        std::int64_t frequency;
+        QueryPerformanceFrequency(&frequency);
+        return static_cast<double>(NANOSECONDS_PER_SECOND)/frequency;
+#else
+        return 1.0;
+#endif
+    }
+
+    // Reads the TSC together with the monotonic clock (in nanoseconds) and
+    // the wall clock. Of a few attempts, we keep the one where the TSC reads
+    // are closest together, since it was least likely to be interrupted.
+    void sample_tsc(clock_calibration* psample, double monotonic_scale)
+    {
+        std::uint64_t best_duration = ~std::uint64_t(0);
+        for(int i=0; i!=3; ++i) {
+            std::uint64_t before = tsc_clock::now();
+            std::uint64_t monotonic = monotonic_now();
+            std::uint64_t realtime = realtime_clock::now();
+            std::uint64_t after = tsc_clock::now();
+            if(after - before < best_duration) {
+                best_duration = after - before;
+                psample->raw = before + (after - before)/2;
+                psample->monotonic = static_cast<std::uint64_t>(
+                    static_cast<double>(monotonic)*monotonic_scale);
+                psample->realtime = realtime;
+            }
+        }
+    }
+}   // anonymous namespace
+
+void calibrate_monotonic_clock(clock_calibration* pcalibration)
+{
+    pcalibration->ns_per_tick = monotonic_ns_per_tick();
+    pcalibration->raw = monotonic_now();
+    pcalibration->realtime = realtime_clock::now();
+    pcalibration->monotonic = pcalibration->raw;
+    pcalibration->recalibrate_at = pcalibration->raw + static_cast<std::uint64_t>(
+        NANOSECONDS_PER_SECOND/pcalibration->ns_per_tick);
+}
+
+void calibrate_tsc_clock(clock_calibration* pcalibration)
+{
+    double monotonic_scale = monotonic_ns_per_tick();
+    clock_calibration sample;
+    sample_tsc(&sample, monotonic_scale);
+
+    if(pcalibration->ns_per_tick == 0) {
+        clock_calibration first = sample;
+        do {
+            sample_tsc(&sample, monotonic_scale);
+        } while(sample.monotonic - first.monotonic < INITIAL_CALIBRATION_TIME);
+        sample.ns_per_tick = static_cast<double>(sample.monotonic - first.monotonic)/
+            static_cast<double>(sample.raw - first.raw);
+    } else if(sample.raw > pcalibration->raw
+            && sample.monotonic > pcalibration->monotonic) {
+        // The monotonic clock runs at the rate that NTP is slewing the wall
+        // clock to, so measuring against it tracks both drift and slews.
+        sample.ns_per_tick = static_cast<double>(sample.monotonic - pcalibration->monotonic)/
+            static_cast<double>(sample.raw - pcalibration->raw);
+    } else {
+        sample.ns_per_tick = pcalibration->ns_per_tick;
+    }
+
+    sample.recalibrate_at = sample.raw + static_cast<std::uint64_t>(
+        NANOSECONDS_PER_SECOND/sample.ns_per_tick);
+    *pcalibration = sample;
+}
+
+}   // namespace detail
+}   // namespace reckless
@@ -0,0 +1,410 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/datagram_writer.hpp>
+
+#include <algorithm>    // min
+#include <cassert>
+#include <cstdio>       // snprintf
+#include <cstring>      // memchr, memcpy, strlen
+#include <stdexcept>    // invalid_argument
+#include <system_error>
+
+#include <errno.h>
+#include <netdb.h>      // getaddrinfo
+#include <sys/socket.h> // socket, connect, sendmmsg
+#include <sys/un.h>     // sockaddr_un
+#include <time.h>       // clock_gettime, gmtime_r
+#include <unistd.h>     // close, gethostname, getpid
+
+namespace {
+    // Same idea as the error category in fd_writer.cpp, but with the errors
+    // that a datagram socket may report when the receiver is temporarily
+    // unavailable or busy.
+    class error_category : public std::error_category {
+    public:
+        char const* name() const noexcept override
+        {
+            return "reckless::datagram_writer";
+        }
+        std::error_condition default_error_condition(int code) const noexcept override
+        {
+            return std::system_category().default_error_condition(code);
+        }
+        bool equivalent(int code, std::error_condition const& condition) const noexcept override
+        {
+            if(condition.category() == reckless::writer::error_category())
+                return datagram_writer_to_writer_category(code) == condition.value();
+            else
+                return std::system_category().equivalent(code, condition);
+        }
+        bool equivalent(std::error_code const& code, int condition) const noexcept override
+        {
+            if(code.category() == reckless::writer::error_category())
+                return datagram_writer_to_writer_category(condition) == code.value();
+            else
+                return std::system_category().equivalent(code, condition);
+        }
+        std::string message(int condition) const override
+        {
+            return std::system_category().message(condition);
+        }
+    private:
+        int datagram_writer_to_writer_category(int code) const
+        {
+            switch(code) {
+            case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+            case EWOULDBLOCK:
+#endif
+            case ENOBUFS:
+            case ENOMEM:
+            case ECONNREFUSED:
+            case ENOTCONN:
+            case ENOENT:
+            case EHOSTUNREACH:
+            case ENETUNREACH:
+            case ENETDOWN:
+                return reckless::writer::temporary_failure;
+            default:
+                return reckless::writer::permanent_failure;
+            }
+        }
+    };
+
+    error_category const& get_error_category()
+    {
+        static error_category cat;
+        return cat;
+    }
+
+    void close_socket(int fd)
+    {
+        while(-1 == close(fd)) {
+            if(errno != EINTR)
+                break;
+        }
+    }
+
+    int connect_unix_socket(char const* path)
+    {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::size_t length = std::strlen(path);
+        if(length >= sizeof(address.sun_path))
+            throw std::system_error(ENAMETOOLONG, std::system_category());
+        std::memcpy(address.sun_path, path, length);
+
+        int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if(fd == -1)
+            throw std::system_error(errno, std::system_category());
+        if(-1 == connect(fd, reinterpret_cast<sockaddr const*>(&address),
+                    sizeof(address)))
+        {
+            int error = errno;
+            close_socket(fd);
+            throw std::system_error(error, std::system_category());
+        }
+        return fd;
+    }
+
+    int connect_udp_socket(char const* host, unsigned short port)
+    {
+        addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = AI_NUMERICSERV;
+        char service[8];
+        std::snprintf(service, sizeof(service), "%u", port);
+
+        addrinfo* paddresses;
+        int result = getaddrinfo(host, service, &hints, &paddresses);
+        if(result != 0) {
+            if(result == EAI_SYSTEM)
+                throw std::system_error(errno, std::system_category());
+            throw std::system_error(EADDRNOTAVAIL, std::system_category(),
+                gai_strerror(result));
+        }
+
+        int error = EADDRNOTAVAIL;
+        int fd = -1;
+        for(addrinfo* p = paddresses; p != nullptr; p = p->ai_next) {
+            fd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
+            if(fd == -1) {
+                error = errno;
+                continue;
+            }
+            if(0 == connect(fd, p->ai_addr, p->ai_addrlen))
+                break;
+            error = errno;
+            close_socket(fd);
+            fd = -1;
+        }
+        freeaddrinfo(paddresses);
+        if(fd == -1)
+            throw std::system_error(error, std::system_category());
+        return fd;
+    }
+
+    // Number of datagrams handed to the kernel in a single sendmmsg() call.
+    std::size_t const BATCH_SIZE = 64;
+
+    // Upper bound for the RFC 5424 header. rfc5424_framing() truncates the
+    // host and application names to the lengths permitted by the RFC, so the
+    // header always fits.
+    std::size_t const MAX_HEADER_SIZE = 512;
+
+    // The longest "<PRI>1 TIMESTAMP" that format_header() writes before the
+    // rest of the header.
+    std::size_t const MAX_HEADER_PREFIX_SIZE =
+        sizeof("<191>1 9999-12-31T23:59:59.999999Z") - 1;
+
+    // The largest header that format_header() writes with the given suffix.
+    std::size_t max_header_size(std::string const& header_suffix)
+    {
+        return MAX_HEADER_PREFIX_SIZE + header_suffix.size();
+    }
+}
+
+namespace reckless {
+
+datagram_writer::datagram_writer(char const* socket_path) :
+    fd_(connect_unix_socket(socket_path)),
+    socket_path_(socket_path)
+{
+    // write() is noexcept, so make sure it never has to allocate.
+    partial_line_.reserve(max_datagram_size_);
+}
+
+datagram_writer::datagram_writer(char const* host, unsigned short port) :
+    fd_(connect_udp_socket(host, port))
+{
+    partial_line_.reserve(max_datagram_size_);
+}
+
+datagram_writer::~datagram_writer()
+{
+    if(fd_ != -1)
+        close_socket(fd_);
+}
+
+void datagram_writer::max_datagram_size(std::size_t size)
+{
+    std::size_t header_size = rfc5424_? max_header_size(header_suffix_) : 0;
+    if(size <= header_size)
+        throw std::invalid_argument("datagram size leaves no room for the message");
+    partial_line_.reserve(size);
+    max_datagram_size_ = size;
+}
+
+void datagram_writer::rfc5424_framing(char const* app_name, facility fac,
+    severity sev)
+{
+    // RFC 5424 section 6.2: HOSTNAME is at most 255 characters, APP-NAME at
+    // most 48. PROCID is the process id, and MSGID and STRUCTURED-DATA are
+    // left out ("-").
+    char hostname[256];
+    if(0 != gethostname(hostname, sizeof(hostname)) || hostname[0] == '\0')
+        std::strcpy(hostname, "-");
+    hostname[sizeof(hostname)-1] = '\0';
+    std::string app(app_name && *app_name? app_name : "-");
+    if(app.size() > 48)
+        app.resize(48);
+
+    std::string suffix = " ";
+    suffix += hostname;
+    suffix += ' ';
+    suffix += app;
+    suffix += ' ';
+    suffix += std::to_string(getpid());
+    suffix += " - - ";
+    if(max_datagram_size_ <= max_header_size(suffix))
+        throw std::invalid_argument("RFC 5424 header leaves no room for the message");
+
+    priority_ = static_cast<unsigned>(fac)*8 + static_cast<unsigned>(sev);
+    header_suffix_ = suffix;
+    rfc5424_ = true;
+}
+
+// Format "<PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID - - " with the current
+// time as a UTC timestamp with microsecond precision.
+std::size_t datagram_writer::format_header(char* pheader)
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    tm utc;
+    gmtime_r(&ts.tv_sec, &utc);
+    int length = std::snprintf(pheader, MAX_HEADER_SIZE,
+        "<%u>1 %04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+        priority_, utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+        utc.tm_hour, utc.tm_min, utc.tm_sec, ts.tv_nsec/1000);
+    assert(length > 0 && length + header_suffix_.size() < MAX_HEADER_SIZE);
+    std::memcpy(pheader + length, header_suffix_.data(), header_suffix_.size());
+    return length + header_suffix_.size();
+}
+
+bool datagram_writer::reconnect()
+{
+    // A local syslog daemon that restarts creates a new socket at the same
+    // path, so our connection to the old one is dead. UDP sockets have no
+    // connection that can go stale.
+    if(socket_path_.empty())
+        return false;
+    int fd;
+    try {
+        fd = connect_unix_socket(socket_path_.c_str());
+    } catch(std::system_error const&) {
+        return false;
+    }
+    close_socket(fd_);
+    fd_ = fd;
+    return true;
+}
+
+std::size_t datagram_writer::write(void const* pbuffer, std::size_t count,
+    std::error_code& ec) noexcept
+{
+    char const* const pstart = static_cast<char const*>(pbuffer);
+    char const* const pend = pstart + count;
+    char const* p = pstart;
+
+    char header[MAX_HEADER_SIZE];
+    std::size_t header_size = 0;
+    if(rfc5424_)
+        header_size = format_header(header);
+    // max_datagram_size() and rfc5424_framing() make sure of this.
+    assert(header_size < max_datagram_size_);
+    std::size_t max_payload = max_datagram_size_ - header_size;
+
+    mmsghdr messages[BATCH_SIZE];
+    iovec iovecs[BATCH_SIZE][3];
+    // Position just past the newline of each line in the batch, so we know
+    // how far into the buffer we got if only some of the datagrams are sent.
+    char const* line_ends[BATCH_SIZE];
+    bool reconnected = false;
+
+    ec.clear();
+    while(p != pend) {
+        // Gather a batch of lines. Empty lines are skipped since there is no
+        // point in sending empty datagrams.
+        unsigned batch = 0;
+        bool continues_line = false;
+        char const* pnext = p;
+        while(batch != BATCH_SIZE && pnext != pend) {
+            char const* pline = pnext;
+            auto pnewline = static_cast<char const*>(
+                std::memchr(pline, '\n', pend - pline));
+            if(!pnewline) {
+                // The output buffer was flushed in the middle of a record.
+                // Keep what we have of the line until the rest of it comes.
+                // Wait until the lines before it have been sent, so that it
+                // isn't kept twice if they fail and are passed to us again.
+                if(batch == 0) {
+                    std::size_t room = max_payload -
+                        std::min(partial_line_.size(), max_payload);
+                    partial_line_.append(pline, std::min(
+                        static_cast<std::size_t>(pend - pline), room));
+                    pnext = pend;
+                }
+                break;
+            }
+            pnext = pnewline + 1;
+            // The first line may be the end of one that we kept from the
+            // previous call.
+            std::size_t prefix = pline == pstart?
+                std::min(partial_line_.size(), max_payload) : 0;
+            std::size_t length = std::min(
+                static_cast<std::size_t>(pnewline - pline),
+                max_payload - prefix);
+            if(prefix + length == 0)
+                continue;
+
+            iovec* piov = iovecs[batch];
+            unsigned iovlen = 0;
+            if(header_size != 0) {
+                piov[iovlen].iov_base = header;
+                piov[iovlen].iov_len = header_size;
+                ++iovlen;
+            }
+            if(prefix != 0) {
+                piov[iovlen].iov_base = const_cast<char*>(partial_line_.data());
+                piov[iovlen].iov_len = prefix;
+                ++iovlen;
+                continues_line = true;
+            }
+            piov[iovlen].iov_base = const_cast<char*>(pline);
+            piov[iovlen].iov_len = length;
+            ++iovlen;
+
+            mmsghdr& message = messages[batch];
+            std::memset(&message, 0, sizeof(message));
+            message.msg_hdr.msg_iov = piov;
+            message.msg_hdr.msg_iovlen = iovlen;
+            line_ends[batch] = pnext;
+            ++batch;
+        }
+
+        if(batch == 0) {
+            // Only empty lines, or the start of a line, remained.
+            p = pnext;
+            break;
+        }
+
+        unsigned sent = 0;
+        while(sent != batch) {
+            int result = sendmmsg(fd_, messages + sent, batch - sent, 0);
+            if(result == -1) {
+                int error = errno;
+                if(error == EINTR)
+                    continue;
+                if((error == ECONNREFUSED || error == ENOTCONN) && !reconnected) {
+                    reconnected = true;
+                    if(reconnect())
+                        continue;
+                }
+                // Report everything up to the last line that was sent as
+                // written. The output buffer keeps the rest and retries it
+                // according to its error policy.
+                if(sent != 0)
+                    p = line_ends[sent-1];
+                // A continued line is always the first in its batch. If it
+                // wasn't sent we drop the start of it, since we can't tell
+                // whether the output buffer will pass us the rest again or
+                // discard it, and in the latter case the start would be glued
+                // onto an unrelated line. A retry sends the rest on its own.
+                if(continues_line)
+                    partial_line_.clear();
+                ec.assign(error, get_error_category());
+                return p - pstart;
+            }
+            sent += static_cast<unsigned>(result);
+        }
+        if(continues_line)
+            partial_line_.clear();
+        // This also consumes any empty lines following the last datagram.
+        p = pnext;
+    }
+    return p - pstart;
+}
+
+}   // namespace reckless
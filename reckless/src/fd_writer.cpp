@@ -25,6 +25,15 @@
 #include <errno.h>      // errno, EINTR
 #include <unistd.h>     // write
 
+#if defined(__linux__)
+#include <reckless/detail/platform.hpp> // page_size
+
+#include <cstdint>      // uintptr_t
+#include <fcntl.h>      // vmsplice
+#include <sys/stat.h>   // fstat
+#include <sys/uio.h>    // iovec
+#endif
+
 #elif defined(_WIN32)
 #define NOMINMAX
 #include <Windows.h>
@@ -120,13 +129,58 @@ namespace reckless {
 namespace detail {
 
 #if defined(__unix__)
+#if defined(__linux__)
+bool fd_writer::enable_page_gifts() noexcept
+{
+    struct stat st;
+    page_gifts_ = zero_copy_pipe_ && 0 == fstat(fd_, &st) && S_ISFIFO(st.st_mode);
+    return page_gifts_;
+}
+#endif
+
 std::size_t fd_writer::write(void const* pbuffer, std::size_t count, std::error_code& ec) noexcept
 {
     char const* p = static_cast<char const*>(pbuffer);
     char const* pend = p + count;
     ec.clear();
+#if defined(__linux__)
+    // Move all complete pages into the pipe, and write() whatever is left in
+    // the last, partial page. The output buffer gives us ownership of the
+    // complete pages that we write, so we can let the pipe keep referencing
+    // them after we return. It keeps using the partial page, so that one
+    // must only be copied.
+    std::uintptr_t page_mask = page_size - 1;
+    if(page_gifts_ && (reinterpret_cast<std::uintptr_t>(p) & page_mask) == 0) {
+        char const* ppages_end = p + (count & ~page_mask);
+        while(p != ppages_end) {
+            iovec iov;
+            iov.iov_base = const_cast<char*>(p);
+            iov.iov_len = ppages_end - p;
+            ssize_t spliced = vmsplice(fd_, &iov, 1, SPLICE_F_GIFT);
+            if(spliced == -1) {
+                if(errno == EINTR)
+                    continue;
+                if(errno == EINVAL || errno == ENOSYS) {
+                    // Not supported here after all; just use write().
+                    page_gifts_ = false;
+                    break;
+                }
+                ec.assign(errno, get_error_category());
+                return p - static_cast<char const*>(pbuffer);
+            }
+            p += spliced;
+            // The kernel takes whole pages, so this shouldn't happen. But if
+            // it stopped in the middle of a page, the output buffer would not
+            // know that the pipe references it unless we finish the page, so
+            // write() everything from here on. Splicing the rest would make
+            // the pipe reference each remaining page twice.
+            if((reinterpret_cast<std::uintptr_t>(p) & page_mask) != 0)
+                break;
+        }
+    }
+#endif
     while(p != pend) {
-        ssize_t written = ::write(fd_, p, count);
+        ssize_t written = ::write(fd_, p, pend - p);
         if(written == -1) {
             if(errno != EINTR) {
                 ec.assign(errno, get_error_category());
@@ -20,17 +20,23 @@
  * SOFTWARE.
  */
 #include "reckless/file_writer.hpp"
+#include "reckless/detail/platform.hpp" // set_thread_name
 
 #include <system_error>
+#include <algorithm>    // max
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <limits>   // numeric_limits
+#include <mutex>
+#include <thread>
 
 #if defined(__unix__)
 #include <sys/stat.h>   // open
 #include <sys/types.h>  // open, lseek
-#include <fcntl.h>      // open
+#include <fcntl.h>      // open, sync_file_range
 #include <errno.h>      // errno
-#include <unistd.h>     // lseek, close
+#include <unistd.h>     // lseek, close, fdatasync
 
 #elif defined(_WIN32)
 
@@ -58,10 +64,20 @@ int open_file(char const* path)
 reckless::file_writer::file_writer(char const* path) :
     fd_writer(open_file(path))
 {
+    init_offsets();
+}
+
+void reckless::file_writer::init_offsets()
+{
+    off_t size = lseek(fd_, 0, SEEK_END);
+    if(size == -1)
+        size = 0;
+    written_offset_ = durable_offset_ = static_cast<std::uint64_t>(size);
 }
 
 reckless::file_writer::~file_writer()
 {
+    psyncer_.reset();
     if(fd_ != -1) {
         while(-1 == close(fd_)) {
             if(errno != EINTR)
@@ -97,16 +113,187 @@ namespace {
 reckless::file_writer::file_writer(char const* path) :
     fd_writer(createfile_generic(CreateFileA, path))
 {
+    init_offsets();
 }
 
 reckless::file_writer::file_writer(wchar_t const* path) :
     fd_writer(createfile_generic(CreateFileW, path))
 {
+    init_offsets();
+}
+
+void reckless::file_writer::init_offsets()
+{
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(handle_, &size))
+        size.QuadPart = 0;
+    written_offset_ = durable_offset_ = static_cast<std::uint64_t>(size.QuadPart);
 }
 
 reckless::file_writer::~file_writer()
 {
+    psyncer_.reset();
     CloseHandle(handle_);
 }
 
 #endif
+
+namespace reckless {
+
+// Performs the syncing for a file_writer in a thread of its own. write()
+// publishes the new written_offset_ and, when enough data has accumulated,
+// wakes the thread. A sync then covers everything up to the written offset
+// that was observed before it started, so any number of writes are committed
+// together by a single sync.
+class file_writer::syncer {
+public:
+    syncer(file_writer* pwriter, durability policy, unsigned interval_ms,
+            std::size_t byte_threshold) :
+        pwriter_(pwriter),
+        policy_(policy),
+        interval_(interval_ms),
+        byte_threshold_(byte_threshold),
+        triggered_offset_(pwriter->written_offset()),
+        writeback_offset_(pwriter->written_offset())
+    {
+        thread_ = std::thread(&syncer::run, this);
+    }
+
+    ~syncer()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            shutdown_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    // Called by file_writer::write() with the new written offset. This is the
+    // only cost that the writing side pays for syncing; the condition
+    // variable is only touched once per byte_threshold bytes.
+    void written(std::uint64_t offset)
+    {
+        if(policy_ == durability::periodic)
+            return;
+        if(offset - triggered_offset_ < byte_threshold_)
+            return;
+        triggered_offset_ = offset;
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            pending_ = true;
+        }
+        wake_.notify_one();
+    }
+
+private:
+    void run()
+    {
+        detail::set_thread_name("reckless sync");
+        std::unique_lock<std::mutex> lk(mutex_);
+        while(true) {
+            if(policy_ == durability::periodic)
+                wake_.wait_for(lk, interval_, [this] { return shutdown_; });
+            else
+                wake_.wait(lk, [this] { return pending_ || shutdown_; });
+            pending_ = false;
+            bool shutdown = shutdown_;
+            lk.unlock();
+            if(shutdown) {
+                sync();
+                return;
+            }
+            if(policy_ == durability::background_writeback)
+                writeback();
+            else
+                sync();
+            lk.lock();
+        }
+    }
+
+    void sync()
+    {
+        std::uint64_t written = pwriter_->written_offset();
+        if(written == pwriter_->durable_offset())
+            return;
+        // If the sync fails we leave durable_offset_ where it is and try
+        // again next time. The next write to the file will most likely
+        // fail too, and that is reported through the log's error policy.
+#if defined(__unix__)
+        int result;
+        do {
+            result = fdatasync(pwriter_->fd_);
+        } while(result == -1 && errno == EINTR);
+        if(result == -1)
+            return;
+#elif defined(_WIN32)
+        if(!FlushFileBuffers(pwriter_->handle_))
+            return;
+#endif
+        pwriter_->durable_offset_.store(written, std::memory_order_release);
+    }
+
+    void writeback()
+    {
+#if defined(__linux__)
+        // Start asynchronous writeback of what has been written since last
+        // time, then wait for the writeback we started last time to finish.
+        // That way there is at most two chunks' worth of dirty data, and we
+        // (almost) never have to wait for the disk.
+        std::uint64_t written = pwriter_->written_offset();
+        std::uint64_t durable = pwriter_->durable_offset();
+        std::uint64_t started = writeback_offset_;
+        if(written != started) {
+            sync_file_range(pwriter_->fd_, started, written - started,
+                SYNC_FILE_RANGE_WRITE);
+        }
+        if(started != durable) {
+            if(0 == sync_file_range(pwriter_->fd_, durable, started - durable,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE
+                        | SYNC_FILE_RANGE_WAIT_AFTER))
+            {
+                pwriter_->durable_offset_.store(started, std::memory_order_release);
+            }
+        }
+        writeback_offset_ = written;
+#else
+        sync();
+#endif
+    }
+
+    file_writer* const pwriter_;
+    durability const policy_;
+    std::chrono::milliseconds const interval_;
+    std::size_t const byte_threshold_;
+    std::uint64_t triggered_offset_;    // Only accessed by the writing thread.
+    std::uint64_t writeback_offset_;    // Only accessed by the sync thread.
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool pending_ = false;      // access synchronized by mutex_
+    bool shutdown_ = false;     // access synchronized by mutex_
+    std::thread thread_;
+};
+
+void file_writer::durability_policy(durability policy, unsigned interval_ms,
+    std::size_t byte_threshold)
+{
+    psyncer_.reset();
+    if(policy != durability::none) {
+        psyncer_.reset(new syncer(this, policy, interval_ms,
+            std::max<std::size_t>(byte_threshold, 1)));
+    }
+}
+
+std::size_t file_writer::write(void const* pbuffer, std::size_t count,
+    std::error_code& ec) noexcept
+{
+    std::size_t written = fd_writer::write(pbuffer, count, ec);
+    std::uint64_t offset = written_offset_.load(std::memory_order_relaxed) + written;
+    written_offset_.store(offset, std::memory_order_release);
+    if(psyncer_)
+        psyncer_->written(offset);
+    return written;
+}
+
+}   // namespace reckless
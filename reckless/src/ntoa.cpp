@@ -27,8 +27,13 @@
 #include <algorithm>    // max, min
 #include <type_traits>  // is_unsigned
 #include <cassert>
-#include <cstring>      // memset
-#include <cmath>        // lrint, llrint, frexp
+#include <cstring>      // memset, memcpy
+#include <cstdint>
+#include <cmath>        // floor, signbit, fpclassify
+
+#if defined(_MSC_VER)
+#include <intrin.h>     // _umul128
+#endif
 
 namespace reckless {
 namespace detail {
@@ -69,6 +74,7 @@ std::uint64_t const power_lut[19] = {
 }   // namespace detail
 
 namespace {
+using detail::likely;
 
 template <typename T>
 typename std::make_unsigned<T>::type unsigned_cast(T v)
@@ -85,65 +91,6 @@ typename std::make_unsigned<T>::type unsigned_cast(T v)
 //    detail::prefetch(power_lut, sizeof(power_lut));
 //}
 
-template <typename Unsigned>
-typename std::enable_if<std::is_unsigned<Unsigned>::value, unsigned>::type
-utoa_generic_base10_preallocated(char* str, unsigned pos, Unsigned value)
-{
-    using detail::decimal_digits;
-
-    if(value == 0)
-        return pos;
-    // FIXME is this right? What if value /= 100 yields 0 here? Do we get an
-    // additional unnecessary 0?
-    while(value >= 100) {
-        Unsigned remainder = value % 100;
-        value /= 100;
-        std::size_t offset = 2*static_cast<std::size_t>(remainder);
-        char d1 = decimal_digits[offset];
-        char d2 = decimal_digits[offset+1];
-        str[pos-1] = d2;
-        str[pos-2] = d1;
-        pos -= 2;
-    }
-    if(value < 10) {
-        --pos;
-        str[pos] = '0' + static_cast<char>(unsigned_cast(value));
-    } else {
-        std::size_t offset = static_cast<std::size_t>(2*value);
-        char d1 = decimal_digits[offset];
-        char d2 = decimal_digits[offset+1];
-        pos -= 2;
-        str[pos+1] = d2;
-        str[pos] = d1;
-    }
-    return pos;
-}
-
-template <typename Unsigned>
-typename std::enable_if<std::is_unsigned<Unsigned>::value, Unsigned>::type
-utoa_generic_base10_preallocated(char* str, unsigned pos, Unsigned value, unsigned digits)
-{
-    using detail::decimal_digits;
-
-    while(digits >= 2) {
-        Unsigned remainder = value % 100;
-        value /= 100;
-        std::size_t offset = 2*static_cast<std::size_t>(remainder);
-        char d1 = decimal_digits[offset];
-        char d2 = decimal_digits[offset+1];
-        str[pos-1] = d2;
-        str[pos-2] = d1;
-        pos -= 2;
-        digits -= 2;
-    }
-    if(digits == 1) {
-        --pos;
-        str[pos] = '0' + static_cast<char>(unsigned_cast(value % 10));
-        value /= 10;
-    }
-    return value;
-}
-
 template <bool Uppercase, typename Unsigned>
 typename std::enable_if<std::is_unsigned<Unsigned>::value, unsigned>::type
 utoa_generic_base16_preallocated(char* str, unsigned pos, Unsigned value)
@@ -398,6 +345,83 @@ log16(Unsigned v)
     return log2(v)/4;
 }
 
+// Number of decimal digits in a nonzero value, i.e. log10(value) + 1. The
+// count is estimated from the bit length (1233/4096 is just above log10(2))
+// and then corrected with a single comparison, which avoids the
+// hard-to-predict branches of log10() when the values vary in size.
+unsigned const MAX_UINT64_DIGITS = 20;
+std::uint64_t const digit_count_thresholds[MAX_UINT64_DIGITS] = {
+    0, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+    1000000000, 10000000000, 100000000000, 1000000000000, 10000000000000,
+    100000000000000, 1000000000000000, 10000000000000000,
+    100000000000000000, 1000000000000000000, 10000000000000000000u
+};
+
+template <typename Unsigned>
+typename std::enable_if<std::is_unsigned<Unsigned>::value, unsigned>::type
+decimal_digit_count(Unsigned value)
+{
+    assert(value != 0);
+    std::uint64_t v = value;
+    unsigned bits;
+#if defined(__GNUC__)
+    bits = 64 - __builtin_clzll(v);
+#else
+    bits = log2(v) + 1;
+#endif
+    unsigned t = (bits*1233) >> 12;
+    return t + (v >= digit_count_thresholds[t]);
+}
+
+// Writes the four decimal digits of value < 10000 to str. The division by 100
+// is done as a multiply and shift, which is exact for values below 43699.
+inline void write_4_digits(char* str, std::uint32_t value)
+{
+    using detail::decimal_digits;
+    std::uint32_t high = (value*5243) >> 19;
+    std::uint32_t low = value - high*100;
+    std::memcpy(str, decimal_digits + 2*high, 2);
+    std::memcpy(str + 2, decimal_digits + 2*low, 2);
+}
+
+// Writes all MAX_UINT64_DIGITS digits of value to str, including leading
+// zeroes. Always doing the same work regardless of magnitude avoids the
+// mispredicted branches that a digit-by-digit loop suffers from when the
+// values vary in size. Eight-digit chunks are split off with a single
+// division each, and the four-digit halves of a chunk are converted
+// independently of each other.
+inline void write_20_digits(char* str, std::uint64_t value)
+{
+    std::uint64_t high = value / 100000000u;
+    std::uint32_t low = static_cast<std::uint32_t>(value - high*100000000u);
+    std::uint32_t top = static_cast<std::uint32_t>(high / 100000000u);
+    std::uint32_t middle = static_cast<std::uint32_t>(high - std::uint64_t(top)*100000000u);
+    write_4_digits(str, top);
+    write_4_digits(str + 4, middle / 10000);
+    write_4_digits(str + 8, middle % 10000);
+    write_4_digits(str + 12, low / 10000);
+    write_4_digits(str + 16, low % 10000);
+}
+
+inline void write_8_digits(char* str, std::uint32_t value)
+{
+    write_4_digits(str, value / 10000);
+    write_4_digits(str + 4, value % 10000);
+}
+
+// Writes the digits of value to str[pos-digits, pos).
+inline void write_decimal_digits(char* str, unsigned pos, std::uint64_t value, unsigned digits)
+{
+    char buffer[MAX_UINT64_DIGITS];
+    if(digits <= 8) {
+        write_8_digits(buffer, static_cast<std::uint32_t>(value));
+        std::memcpy(str + pos - digits, buffer + 8 - digits, digits);
+    } else {
+        write_20_digits(buffer, value);
+        std::memcpy(str + pos - digits, buffer + MAX_UINT64_DIGITS - digits, digits);
+    }
+}
+
 template <typename Unsigned>
 void itoa_generic_base10(output_buffer* pbuffer, bool negative, Unsigned value, conversion_specification const& cs)
 {
@@ -419,7 +443,23 @@ void itoa_generic_base10(output_buffer* pbuffer, bool negative, Unsigned value,
     //                  [---precision---]
     // [--------------size--------------]
     // depending on if it's left-justified or not.
-    unsigned digits = value? log10(value) + 1 : 0;
+    unsigned digits = value? decimal_digit_count(value) : 0;
+    if(likely(sign == 0 && cs.minimum_field_width == 0
+            && cs.precision == UNSPECIFIED_PRECISION))
+    {
+        // Plain %d, so there is no padding to worry about and a zero value
+        // needs a single digit. The digits are copied with a fixed-size
+        // memcpy to avoid branching on the size, so we reserve room for the
+        // whole copy but only commit the digits.
+        digits += !digits;
+        char buffer[2*MAX_UINT64_DIGITS];
+        write_20_digits(buffer, value);
+        char* str = pbuffer->reserve(MAX_UINT64_DIGITS);
+        std::memcpy(str, buffer + MAX_UINT64_DIGITS - digits, MAX_UINT64_DIGITS);
+        pbuffer->commit(digits);
+        return;
+    }
+
     unsigned precision = (cs.precision == UNSPECIFIED_PRECISION? 1 : cs.precision);
     unsigned zeroes = precision>digits? precision - digits : 0;
     unsigned content_size = !!sign + zeroes + digits;
@@ -438,7 +478,8 @@ void itoa_generic_base10(output_buffer* pbuffer, bool negative, Unsigned value,
         pos -= padding;
         std::memset(str+pos, ' ', padding);
     }
-    pos = utoa_generic_base10_preallocated(str, pos, value);
+    write_decimal_digits(str, pos, value, digits);
+    pos -= digits;
     pos -= zeroes;
     std::memset(str+pos, '0', zeroes);
     if(sign)
@@ -542,200 +583,6 @@ itoa_generic_base16(output_buffer* pbuffer, Integer value, conversion_specificat
     itoa_generic_base16(pbuffer, false, value, cs);
 }
 
-#if defined(__GNUC__)
-template <typename Float>
-Float fxtract(Float v, Float* exp)
-{
-    Float significand;
-    asm("fxtract" : "=t"(significand), "=u"(*exp) : "0"(v));
-    return significand;
-}
-#elif defined(_MSC_VER)
-
-double fxtract(long double v, long double* exp)
-{
-    // So here's what you might think we can do.
-    //  long double significand;
-    //  long double exp;
-    //  __asm {
-    //      fld [v]
-    //      fxtract
-    //      fstp [exp]
-    //      fstp [significand]
-    //  }
-    //
-    // But MSVC does not support inline asm on x64, and don't have fxtract as
-    // an intrinsic, so we're kinda screwed. Additionally, they decided they
-    // don't need no 80-bit long double any longer, so we're even more screwed.
-    // I'm not sure how they expect anyone to be able to do this kind of stuff
-    // with the same quality and speed as e.g. gcc, but... their call. Instead
-    // we'll just extract the bits from the in-memory representation.
-
-    int iexp;
-    auto significand = std::frexp(v, &iexp);
-    *exp = iexp - 1;
-    return static_cast<double>(2*significand);
-
-    //std::uint16_t const* pv = reinterpret_cast<std::uint16_t const*>(&v);
-    //// Highest 16 bits is seeeeeee eeeemmmm. We want the e part which is the
-    //// exponent.
-    //unsigned exponent = pv[3];
-    //exponent = (exponent >> 4) & 0x7ff;
-    //*exp = static_cast<int>(exponent) - 1023;
-}
-
-#else
-static_assert(false, "fxtract is not implemented for this compiler")
-#endif
-
-template <typename Float>
-inline std::uint_fast64_t u64_rint(Float value)
-{
-    if(std::is_convertible<std::uint64_t, long>::value)
-        return static_cast<std::uint_fast64_t>(std::lrint(value));
-    else
-        return static_cast<std::uint_fast64_t>(std::llrint(value));
-}
-
-struct decimal18
-{
-    bool sign;
-    std::uint64_t mantissa;
-    int exponent;
-};
-
-decimal18 binary64_to_decimal18(double v)
-{
-    if(v == 0)
-        return {std::signbit(v), 0, 0};
-
-    long double e2;
-    long double m2 = fxtract(static_cast<long double>(v), &e2);
-
-    // We have
-    //   v = m2 * 2^e2  [1 <= m2 < 2] (1)
-    // and want a new representation
-    //   v = m10 * 10^e10  [1 <= m10 < 10].
-    //
-    // (1) can be rewritten as
-    //   m2 * 10^(C*e2)  [C = log(2)/log(10)] =
-    //   m2 * 10^(e10i + e10f)  [e10i = trunc(C*e2), e10f=frac(C*e2)] =
-    //   m2 * 10^e10i * 10^e10f.
-    //
-    // If m2 * 10^e10f turns out to be in the range [1, 10) then this gives us
-    // a value for m10 (and consequently for e10=C*e2i). But assuming e2f is a
-    // positive fraction, we have
-    //   0 <= e2f < 1
-    //   1 <= 10^e2f < 10.
-    //   1 <= m2 * 10^e2f < 20.
-    //
-    // We can adjust for m2 * 10^e2f >= 10 by dividing m2 by 10 and increasing
-    // e10 by one. Hence, with D = e2*log(2)/log(10) we have
-    //   m10 = m2 * 10^(frac(D))
-    //   e10 = trunc(D).
-    // when m2*10^(frac(D)) < 10, or
-    //   m10 = m2 * 10^(frac(D)) / 10
-    //   e10 = trunc(D) + 1.
-    // when m2*10^(frac(D)) >= 10, i.e. normalization requires at most a shift
-    // to the right by 1 digit.
-    //
-    // If e2f is a negative fraction we get
-    //   -1 < e2f <= 0
-    //   0.1 <= 10^e2f <= 1.
-    //   0.1 <= m2 * 10^e2f < 2.
-    // Note that this is the range obtained for a positive exponent except
-    // divided by 10. If we multiply this by 10 and subtract 1 from the
-    // exponent then we get the same situation as above, i.e.
-    //   1 <= 10 * m2 * 10^e2f < 20.
-
-    long double d = e2;
-    d *=  0.30102999566398119521L;
-    long double e10i;
-    long double e10f = std::modf(d, &e10i);
-    long double m10;
-    if(e2 < 0) {
-        e10f += 1;
-        e10i -= 1;
-    }
-
-    m10 = m2*powl(10, e10f + 16);
-    std::uint64_t mantissa = static_cast<std::uint64_t>(std::llrint(std::abs(m10)));
-    if(mantissa < 100000000000000000u)
-        mantissa *= 10;
-    else
-        e10i += 1.0L;
-    // TODO rounding of m10 might cause it to overflow, right?. We need to
-    // adjust again in that case. But try to reproduce this scenario first so
-    // we know it's needed.
-
-    return {std::signbit(v), mantissa, static_cast<int>(e10i)};
-}
-
-std::uint64_t rounded_divide(bool sign, std::uint64_t value, std::uint64_t divisor)
-{
-    if(!sign) {
-        // +divisor/2 to turn truncation into rounding.
-        return (value + divisor/2) / divisor;
-    } else {
-        // This is the same rounding as above but we must pretend that the
-        // value is negative and reproduce the corresponding behavior.
-        // Adding divisor-1 turns the flooring behavior of integer division
-        // into a ceiling behavior.
-        return (value + (divisor-1) - divisor/2) / divisor;
-    }
-}
-std::uint64_t rounded_rshift(bool sign, std::uint64_t value, unsigned digits)
-{
-    return rounded_divide(sign, value, detail::power_lut[digits]);
-}
-
-unsigned count_trailing_zeroes(decimal18 const& dv, unsigned truncated_digits)
-{
-    std::uint64_t mantissa = rounded_rshift(dv.sign, dv.mantissa, truncated_digits);
-    unsigned low = 0;
-    unsigned high = 18u-truncated_digits;
-    // Find the lowest x such that mantissa % 10^x != 0.
-    // Then the number of trailing zeroes is x-1.
-    while(low < high) {
-        unsigned pos = (low + high)/2;
-        if(mantissa % detail::power_lut[pos] == 0)
-            low = pos + 1;
-        else
-            high = pos;
-    }
-
-    return low-1;
-}
-
-unsigned count_trailing_zeroes_after_dot(decimal18 const& dv)
-{
-    // We need to get rid of the least significant digit because a double can't
-    // always represent a zero digit at that position.
-    // (e.g. 123.456 becomes 123.456000000000003).
-    std::uint64_t mantissa = rounded_divide(dv.sign, dv.mantissa, 10);
-    unsigned digits_before_dot = unsigned_cast(std::max(0, dv.exponent+1));
-    if(digits_before_dot>17) {
-        // All significant digits are in front of the dots. No trailing zeroes
-        return 0;
-    }
-    unsigned max_trailing_zeroes = unsigned_cast(17 - digits_before_dot);
-    unsigned low = 0;
-    unsigned high = max_trailing_zeroes+1;
-    // Find the lowest x such that mantissa % 10^x != 0.
-    // Then the number of trailing zeroes is x-1.
-    while(low < high) {
-        unsigned pos = (low + high)/2;
-        if(mantissa % detail::power_lut[pos] == 0)
-            low = pos + 1;
-        else
-            high = pos;
-    }
-
-    // +1 because we always treat the least significant digit (that we stripped
-    // at function entry) as if it were zero.
-    return low-1 + 1;
-}
-
 void write_special_category(output_buffer* pbuffer, double value, conversion_specification const& cs, char const* category)
 {
     char sign = std::signbit(value)? '-' : cs.plus_sign;
@@ -762,212 +609,667 @@ void write_special_category(output_buffer* pbuffer, double value, conversion_spe
 
 void write_nan(output_buffer* pbuffer, double value, conversion_specification const& cs)
 {
-    return write_special_category(pbuffer, value, cs, "nan");
+    return write_special_category(pbuffer, value, cs, cs.uppercase? "NAN" : "nan");
 }
 
 void write_inf(output_buffer* pbuffer, double value, conversion_specification const& cs)
 {
-    return write_special_category(pbuffer, value, cs, "inf");
+    return write_special_category(pbuffer, value, cs, cs.uppercase? "INF" : "inf");
 }
 
-void ftoa_base10_f_normal(output_buffer* pbuffer, decimal18 dv, unsigned precision, conversion_specification const& cs)
+// Multiplies two 64-bit values and returns the low half of the product,
+// storing the high half in *phigh.
+inline std::uint64_t multiply_64x64(std::uint64_t a, std::uint64_t b, std::uint64_t* phigh)
 {
-    // [sign] [digits_before_dot] [zeroes_before_dot] [dot] [zeroes_after_dot] [digits_after_dot] [suffix_zeroes]
-    char sign = dv.sign? '-' : cs.plus_sign;
-    unsigned digits_before_dot;
-    unsigned zeroes_before_dot;
-    unsigned zeroes_after_dot;
-    unsigned digits_after_dot;
-
-    if(dv.exponent>=17) {
-        // All digits from the mantissa are on the left-hand side of the dot.
-        digits_before_dot = 18;
-        zeroes_before_dot = unsigned_cast(dv.exponent)+1 - 18;
-        zeroes_after_dot = precision;
-        digits_after_dot = 0;
-    } else if(dv.exponent < 0) {
-        // All digits from the mantissa are on the right-hand side of the dot.
-        // We set zeroes_before_dot=1 to generate a zero on the left-hand side,
-        // since this is what people expect and it's what stdio does.
-        digits_before_dot = 0;
-        zeroes_before_dot = 1;
-        zeroes_after_dot = std::min(unsigned_cast(-dv.exponent)-1, precision);
-        digits_after_dot = std::min(18u, precision - zeroes_after_dot);
-    } else {
-        // There are digits from the mantissa both on the left- and right-hand
-        // sides of the dot.
-        if(dv.mantissa == 0) {
-            // Special case for +-0: utoa_generic_base10_preallocated does not
-            // output any digits for a zero value, so we need to fake it in by
-            // using zeroes_before_dot instead.
-            digits_before_dot = 0;
-            zeroes_before_dot = 1;
-            zeroes_after_dot = 0;
-            digits_after_dot = 0;
-        } else {
-            digits_before_dot = unsigned_cast(dv.exponent+1);
-            zeroes_before_dot = 0;
-            zeroes_after_dot = 0;
-            digits_after_dot = std::min(18 - digits_before_dot, precision);
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a)*b;
+    *phigh = static_cast<std::uint64_t>(product >> 64);
+    return static_cast<std::uint64_t>(product);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return _umul128(a, b, phigh);
+#else
+    std::uint64_t a_low = a & 0xffffffffu, a_high = a >> 32;
+    std::uint64_t b_low = b & 0xffffffffu, b_high = b >> 32;
+    std::uint64_t low = a_low*b_low;
+    std::uint64_t middle1 = a_high*b_low;
+    std::uint64_t middle2 = a_low*b_high;
+    std::uint64_t high = a_high*b_high;
+    std::uint64_t middle = (low >> 32) + (middle1 & 0xffffffffu) + (middle2 & 0xffffffffu);
+    *phigh = high + (middle1 >> 32) + (middle2 >> 32) + (middle >> 32);
+    return (middle << 32) | (low & 0xffffffffu);
+#endif
+}
+
+// Unsigned integer with a fixed maximum size, for the cases where the
+// decimal digits can't be determined from a 128-bit approximation. The
+// largest value we need is m*10^1074 (a 53-bit significand scaled to show
+// every fractional digit of the smallest subnormal), which is about 3620
+// bits.
+class bignum {
+public:
+    explicit bignum(std::uint64_t value = 0) :
+        size_(0)
+    {
+        while(value) {
+            limbs_[size_++] = static_cast<std::uint32_t>(value);
+            value >>= 32;
+        }
+    }
+
+    bool is_zero() const
+    {
+        return size_ == 0;
+    }
+
+    bool is_odd() const
+    {
+        return size_ != 0 && (limbs_[0] & 1) != 0;
+    }
+
+    unsigned bit_length() const
+    {
+        if(size_ == 0)
+            return 0;
+        unsigned bits = 32*(size_ - 1);
+        for(std::uint32_t top = limbs_[size_ - 1]; top != 0; top >>= 1)
+            ++bits;
+        return bits;
+    }
+
+    bool test_bit(unsigned index) const
+    {
+        unsigned limb = index/32;
+        return limb < size_ && ((limbs_[limb] >> (index%32)) & 1) != 0;
+    }
+
+    // True if any of the bits below index are set.
+    bool any_bits_below(unsigned index) const
+    {
+        unsigned limb = index/32;
+        for(unsigned i=0; i!=std::min(limb, size_); ++i) {
+            if(limbs_[i] != 0)
+                return true;
         }
+        return limb < size_ && (limbs_[limb] & ((std::uint32_t(1) << (index%32)) - 1)) != 0;
     }
-    unsigned suffix_zeroes = precision - (zeroes_after_dot + digits_after_dot);
-
-    bool dot = cs.alternative_form
-        || (zeroes_after_dot + digits_after_dot + suffix_zeroes != 0);
-
-    // Reduce the mantissa part to the requested number of digits.
-    auto mantissa_digits = digits_before_dot + digits_after_dot;
-    std::uint64_t mantissa = rounded_rshift(dv.sign, dv.mantissa, 18-mantissa_digits);
-    auto order = detail::power_lut[mantissa_digits];
-    bool carry = mantissa >= order;
-    if(carry) {
-        // When reducing the mantissa, rounding caused it to overflow. For
-        // example, when formatting 0.095 with precision=2, we have
-        // zeroes_before_dot=1, zeroes_after_dot=1, mantissa_digits=1 and
-        // suffix_zeroes=0. When trying to reduce the mantissa to 1 digit we
-        // end up not with 9, but with 10 due to rounding. In this case we need
-        // to make room for an extra digit from the mantissa, which we'll take
-        // from zeroes_after_dot or by increasing digits_before_dot.
-        //
-        // Logically this can only happen if there are actual digits from the
-        // mantissa on the right-hand side of the dot. If all the digits are on
-        // the left-hand side then no reduction will take place, because only
-        // the number of fractional digits are user-controllable. So, if
-        // zeroes_before_dot is nonzero then that's only to generate a filler
-        // zero (see if clause above where dv.exponent < 0). If the overflow
-        // now produces a digit on the left-hand side of the dot then we must
-        // cancel out that zero by setting zeroes_before_dot=0.
-        if(zeroes_after_dot) {
-            --zeroes_after_dot;
-            ++digits_after_dot;
+
+    void set_bit(unsigned index)
+    {
+        unsigned limb = index/32;
+        assert(limb < MAX_LIMBS);
+        while(size_ <= limb)
+            limbs_[size_++] = 0;
+        limbs_[limb] |= std::uint32_t(1) << (index%32);
+    }
+
+    std::uint64_t low_64_bits(unsigned limb) const
+    {
+        std::uint64_t low = limb < size_? limbs_[limb] : 0;
+        std::uint64_t high = limb + 1 < size_? limbs_[limb + 1] : 0;
+        return low | (high << 32);
+    }
+
+    void increment()
+    {
+        for(unsigned i=0; i!=size_; ++i) {
+            if(++limbs_[i] != 0)
+                return;
+        }
+        assert(size_ < MAX_LIMBS);
+        limbs_[size_++] = 1;
+    }
+
+    void multiply(std::uint32_t factor)
+    {
+        std::uint64_t carry = 0;
+        for(unsigned i=0; i!=size_; ++i) {
+            std::uint64_t product = std::uint64_t(limbs_[i])*factor + carry;
+            limbs_[i] = static_cast<std::uint32_t>(product);
+            carry = product >> 32;
+        }
+        if(carry) {
+            assert(size_ < MAX_LIMBS);
+            limbs_[size_++] = static_cast<std::uint32_t>(carry);
+        }
+    }
+
+    void multiply_pow10(unsigned exponent)
+    {
+        while(exponent >= 9) {
+            multiply(1000000000u);
+            exponent -= 9;
+        }
+        multiply(static_cast<std::uint32_t>(detail::power_lut[exponent]));
+    }
+
+    // Divides by a small divisor and returns the remainder.
+    std::uint32_t divide(std::uint32_t divisor)
+    {
+        std::uint64_t remainder = 0;
+        for(unsigned i=size_; i--!=0;) {
+            std::uint64_t v = (remainder << 32) | limbs_[i];
+            limbs_[i] = static_cast<std::uint32_t>(v/divisor);
+            remainder = v % divisor;
+        }
+        trim();
+        return static_cast<std::uint32_t>(remainder);
+    }
+
+    void shift_left(unsigned bits)
+    {
+        if(size_ == 0)
+            return;
+        unsigned limbs = bits/32;
+        unsigned shift = bits%32;
+        assert(size_ + limbs + 1 <= MAX_LIMBS);
+        if(shift == 0) {
+            for(unsigned i=size_; i--!=0;)
+                limbs_[i + limbs] = limbs_[i];
         } else {
-            ++digits_before_dot;
-            zeroes_before_dot = 0;
+            limbs_[size_ + limbs] = limbs_[size_ - 1] >> (32 - shift);
+            for(unsigned i=size_ - 1; i!=0; --i)
+                limbs_[i + limbs] = (limbs_[i] << shift) | (limbs_[i - 1] >> (32 - shift));
+            limbs_[limbs] = limbs_[0] << shift;
+            ++size_;
         }
-        ++mantissa_digits;
+        for(unsigned i=0; i!=limbs; ++i)
+            limbs_[i] = 0;
+        size_ += limbs;
+        trim();
     }
 
-    unsigned content_size = !!sign + digits_before_dot + zeroes_before_dot
-        + dot + zeroes_after_dot + digits_after_dot + suffix_zeroes;
-    unsigned size = std::max(cs.minimum_field_width, content_size);
-    unsigned padding = size - content_size;
-    unsigned pad_zeroes = 0;
-    if(cs.pad_with_zeroes && !cs.left_justify) {
-        pad_zeroes = padding;
-        padding = 0;
+    // Divides by 2^bits, discarding the remainder.
+    void shift_right(unsigned bits)
+    {
+        unsigned limbs = bits/32;
+        unsigned shift = bits%32;
+        if(limbs >= size_) {
+            size_ = 0;
+            return;
+        }
+        for(unsigned i=0; i!=size_ - limbs; ++i) {
+            std::uint32_t v = limbs_[i + limbs] >> shift;
+            if(shift != 0 && i + limbs + 1 < size_)
+                v |= limbs_[i + limbs + 1] << (32 - shift);
+            limbs_[i] = v;
+        }
+        size_ -= limbs;
+        trim();
     }
 
-    char* str = pbuffer->reserve(size);
-    unsigned pos = size;
-    if(cs.left_justify) {
-        pos -= padding;
-        std::memset(str+pos, ' ', padding);
+    // Divides by 2^bits, rounding to nearest with ties to even.
+    void shift_right_rounded(unsigned bits)
+    {
+        if(bits == 0)
+            return;
+        bool half = test_bit(bits - 1);
+        bool above_half = half && any_bits_below(bits - 1);
+        shift_right(bits);
+        if(above_half || (half && is_odd()))
+            increment();
     }
 
-    if(dot) {
-        pos -= suffix_zeroes;
-        std::memset(str+pos, '0', suffix_zeroes);
-        mantissa = utoa_generic_base10_preallocated(str, pos, mantissa,
-                digits_after_dot);
-        pos -= digits_after_dot;
+    void subtract(bignum const& rhs)
+    {
+        assert(compare(*this, rhs) >= 0);
+        std::int64_t borrow = 0;
+        for(unsigned i=0; i!=size_; ++i) {
+            std::int64_t v = static_cast<std::int64_t>(limbs_[i]) - borrow
+                - (i < rhs.size_? rhs.limbs_[i] : 0);
+            borrow = v < 0;
+            limbs_[i] = static_cast<std::uint32_t>(v + (borrow << 32));
+        }
+        trim();
+    }
 
-        pos -= zeroes_after_dot;
-        std::memset(str+pos, '0', zeroes_after_dot);
-        str[--pos] = '.';
+    friend int compare(bignum const& lhs, bignum const& rhs)
+    {
+        if(lhs.size_ != rhs.size_)
+            return lhs.size_ < rhs.size_? -1 : 1;
+        for(unsigned i=lhs.size_; i--!=0;) {
+            if(lhs.limbs_[i] != rhs.limbs_[i])
+                return lhs.limbs_[i] < rhs.limbs_[i]? -1 : 1;
+        }
+        return 0;
     }
 
-    pos -= zeroes_before_dot;
-    std::memset(str+pos, '0', zeroes_before_dot);
-    pos = utoa_generic_base10_preallocated(str, pos, mantissa);
-    pos -= pad_zeroes;
-    std::memset(str+pos, '0', pad_zeroes);
-    if(sign)
-        str[--pos] = sign;
+    // Writes the decimal digits of the value, without leading zeroes, and
+    // returns how many there are. Destroys the value.
+    unsigned to_decimal(char* str)
+    {
+        std::uint32_t chunks[MAX_LIMBS*32/29 + 1];
+        unsigned count = 0;
+        while(!is_zero())
+            chunks[count++] = divide(1000000000u);
+        if(count == 0)
+            return 0;
+        unsigned length = decimal_digit_count(chunks[count - 1]);
+        write_decimal_digits(str, length, chunks[count - 1], length);
+        for(unsigned i=count - 1; i--!=0;) {
+            length += 9;
+            write_decimal_digits(str, length, chunks[i], 9);
+        }
+        return length;
+    }
 
-    if(!cs.left_justify) {
-        pos -= padding;
-        std::memset(str+pos, ' ', padding);
+private:
+    static unsigned const MAX_LIMBS = 120;
+
+    void trim()
+    {
+        while(size_ != 0 && limbs_[size_ - 1] == 0)
+            --size_;
     }
-    pbuffer->commit(size);
-    assert(pos == 0);
+
+    std::uint32_t limbs_[MAX_LIMBS];
+    unsigned size_;
+};
+
+// Long division. Leaves the remainder in numerator and returns the quotient.
+bignum divide(bignum& numerator, bignum const& denominator)
+{
+    bignum quotient;
+    unsigned numerator_bits = numerator.bit_length();
+    unsigned denominator_bits = denominator.bit_length();
+    if(numerator_bits < denominator_bits)
+        return quotient;
+    unsigned shift = numerator_bits - denominator_bits;
+    bignum d = denominator;
+    d.shift_left(shift);
+    for(unsigned i=shift + 1; i--!=0;) {
+        if(compare(numerator, d) >= 0) {
+            numerator.subtract(d);
+            quotient.set_bit(i);
+        }
+        d.shift_right(1);
+    }
+    return quotient;
 }
 
-void ftoa_base10_e_normal(output_buffer* pbuffer, decimal18 dv,
-        unsigned precision, conversion_specification const& cs)
+// 10^k is approximated as (high:low) * 2^exponent, where the 128-bit
+// significand is normalized and truncated, i.e. the true value lies in
+// [significand, significand + 1) * 2^exponent. It is exact when the
+// truncated bits are all zero, which is the case for 0 <= k <= 55.
+struct power_of_ten {
+    std::uint64_t high;
+    std::uint64_t low;
+    int exponent;
+    bool exact;
+};
+
+// Range of k in 10^k for which we have 128-bit approximations. This covers
+// the scaling needed for up to 19 significant digits of any double.
+int const MIN_CACHED_POWER = -310;
+int const MAX_CACHED_POWER = 345;
+
+struct power_of_ten_table {
+    power_of_ten_table()
+    {
+        for(int k=MIN_CACHED_POWER; k<=MAX_CACHED_POWER; ++k) {
+            power_of_ten& p = powers[k - MIN_CACHED_POWER];
+            bignum significand(1);
+            if(k >= 0) {
+                significand.multiply_pow10(static_cast<unsigned>(k));
+                int bits = static_cast<int>(significand.bit_length());
+                p.exponent = bits - 128;
+                if(bits <= 128) {
+                    significand.shift_left(static_cast<unsigned>(128 - bits));
+                    p.exact = true;
+                } else {
+                    p.exact = !significand.any_bits_below(static_cast<unsigned>(bits - 128));
+                    significand.shift_right(static_cast<unsigned>(bits - 128));
+                }
+            } else {
+                // 2^(127+bits) / 10^-k lies in (2^127, 2^128).
+                bignum divisor(1);
+                divisor.multiply_pow10(static_cast<unsigned>(-k));
+                unsigned bits = divisor.bit_length();
+                bignum numerator(1);
+                numerator.shift_left(127 + bits);
+                significand = divide(numerator, divisor);
+                p.exponent = -static_cast<int>(127 + bits);
+                p.exact = false;
+            }
+            p.low = significand.low_64_bits(0);
+            p.high = significand.low_64_bits(2);
+        }
+    }
+
+    power_of_ten powers[MAX_CACHED_POWER - MIN_CACHED_POWER + 1];
+};
+
+// The table is computed the first time a floating-point value is formatted,
+// which takes a few milliseconds.
+power_of_ten const& cached_power_of_ten(int k)
 {
-    // We have either
-    // [sign] [digit] [dot] [digits_after_dot] [e] [exponent sign] [exponent_digits]
-    // or
-    // [padding] [sign] [zero_padding] [digit] [dot] [digits_after_dot] [e] [exponent sign] [exponent_digits]
-    // depending on if it's left-justified or not.
+    static power_of_ten_table const table;
+    return table.powers[k - MIN_CACHED_POWER];
+}
 
-    char exponent_sign;
-    unsigned exponent;
-    if(dv.exponent < 0) {
-        exponent_sign = '-';
-        exponent = unsigned_cast(-dv.exponent);
+// Returns 64 bits of the 192-bit value w, starting at bit position pos.
+inline std::uint64_t extract_64_bits(std::uint64_t const (&w)[3], unsigned pos)
+{
+    unsigned limb = pos/64;
+    unsigned shift = pos%64;
+    std::uint64_t low = limb < 3? w[limb] >> shift : 0;
+    std::uint64_t high = (shift != 0 && limb + 1 < 3)? w[limb + 1] << (64 - shift) : 0;
+    return low | high;
+}
+
+// Tries to compute round(m * 2^e2 * 10^k), with ties to even, from the
+// 128-bit approximation of 10^k. Gives up and returns false if the result
+// doesn't fit in 64 bits, or if the error in the approximation makes it
+// impossible to tell which way to round. That only happens when the value
+// is extremely close to halfway between two integers.
+bool round_scaled_fast(std::uint64_t m, int e2, int k, std::uint64_t* presult)
+{
+    if(k < MIN_CACHED_POWER || k > MAX_CACHED_POWER)
+        return false;
+    power_of_ten const& c = cached_power_of_ten(k);
+
+    // The exact value is w * 2^-shift + error, where 0 <= error < m*2^-shift,
+    // and the error is zero if the power of ten is exact.
+    std::uint64_t w[3];
+    std::uint64_t carry;
+    w[0] = multiply_64x64(m, c.low, &carry);
+    w[1] = multiply_64x64(m, c.high, &w[2]);
+    w[1] += carry;
+    w[2] += w[1] < carry;
+    int shift = -(e2 + c.exponent);
+    // The product has at least 180 significant bits, so if shift is less
+    // than 116 then the integer part doesn't fit in 64 bits.
+    if(shift < 116)
+        return false;
+    if(shift >= 194) {
+        // The value is less than 2^-2 + m*2^-194, which rounds to zero.
+        *presult = 0;
+        return true;
+    }
+    if(shift >= 192)
+        return false;
+    unsigned ushift = static_cast<unsigned>(shift);
+    if(ushift + 64 < 192 && extract_64_bits(w, ushift + 64) != 0)
+        return false;
+
+    std::uint64_t integer = extract_64_bits(w, ushift);
+    // The top 64 bits of the fraction, i.e. fraction*2^64.
+    std::uint64_t fraction = extract_64_bits(w, ushift - 64);
+    std::uint64_t const half = std::uint64_t(1) << 63;
+    bool round_up;
+    if(c.exact) {
+        if(fraction != half) {
+            round_up = fraction > half;
+        } else {
+            bool below = false;
+            unsigned low_bits = ushift - 64;
+            for(unsigned i=0; i!=low_bits/64; ++i)
+                below = below || w[i] != 0;
+            if(low_bits%64 != 0)
+                below = below || (w[low_bits/64] & ((std::uint64_t(1) << (low_bits%64)) - 1)) != 0;
+            round_up = below || (integer & 1) != 0;
+        }
     } else {
-        exponent_sign = '+';
-        exponent = unsigned_cast(dv.exponent);
-    }
-    unsigned digits_after_dot = precision;
-    int dot = digits_after_dot!=0 || cs.alternative_form;
-
-    int exponent_digits;
-    // Apparently stdio never prints less than two digits for the exponent,
-    // so we'll do the same to stay consistent. Maximum value of the exponent
-    // in a double is 308 so we won't get more than 3 digits.
-    if(exponent < 100)
-        exponent_digits = 2;
-    else
-        exponent_digits = 3;
+        // The error in units of the fraction's last bit, rounded up. Since
+        // shift >= 116 this is less than 2^(53-52) + 1. For very small
+        // exponents the shift is 64 or more, which a single shift can't do.
+        std::uint64_t error = (ushift - 64 < 64? m >> (ushift - 64) : 0) + 2;
+        if(fraction >= half)
+            round_up = true;    // The true value is strictly greater.
+        else if(fraction + error <= half)
+            round_up = false;
+        else
+            return false;
+    }
+    if(round_up) {
+        if(++integer == 0)
+            return false;
+    }
+    *presult = integer;
+    return true;
+}
 
-    char sign = dv.sign? '-' : cs.plus_sign;
-    unsigned content_size = !!sign + 1 + dot + digits_after_dot + 1 + 1 + exponent_digits;
-    unsigned size = std::max(cs.minimum_field_width, content_size);
-    unsigned padding = size - content_size;
-    unsigned pad_zeroes = 0;
-    if(cs.pad_with_zeroes && !cs.left_justify) {
-        pad_zeroes = padding;
-        padding = 0;
+// Computes round(m * 2^e2 * 10^k), with ties to even, using exact
+// arithmetic. Writes the digits of the result to str and returns how many
+// there are.
+unsigned round_scaled_exact(std::uint64_t m, int e2, int k, char* str)
+{
+    bignum value(m);
+    if(k >= 0) {
+        value.multiply_pow10(static_cast<unsigned>(k));
+        if(e2 >= 0)
+            value.shift_left(static_cast<unsigned>(e2));
+        else
+            value.shift_right_rounded(static_cast<unsigned>(-e2));
+    } else {
+        bignum divisor(1);
+        divisor.multiply_pow10(static_cast<unsigned>(-k));
+        if(e2 >= 0)
+            value.shift_left(static_cast<unsigned>(e2));
+        else
+            divisor.shift_left(static_cast<unsigned>(-e2));
+        bignum quotient = divide(value, divisor);
+        value.shift_left(1);
+        int c = compare(value, divisor);
+        if(c > 0 || (c == 0 && quotient.is_odd()))
+            quotient.increment();
+        value = quotient;
+    }
+    return value.to_decimal(str);
+}
+
+// Large enough for the digits of any double scaled by up to 10^1074, i.e.
+// all of its fractional digits.
+unsigned const MAX_DECIMAL_DIGITS = 1100;
+
+// The digits of round(|v| * 10^k) for a finite, nonzero v. There are no
+// leading zeroes, and count may be zero if the value rounds to zero. The
+// digits are followed by another trailing_zeroes zeroes; we don't need to
+// compute those because a double has no nonzero digits past 10^-1074.
+struct scaled_decimal {
+    char digits[MAX_DECIMAL_DIGITS];
+    unsigned count;
+    unsigned trailing_zeroes;
+
+    unsigned size() const
+    {
+        return count + trailing_zeroes;
     }
 
-    // Get rid of digits we don't want in the mantissa.
-    std::uint64_t mantissa = rounded_rshift(dv.sign, dv.mantissa,
-            18-(digits_after_dot+1));
+    char digit(unsigned index) const
+    {
+        return index < count? digits[index] : '0';
+    }
+};
 
-    char* str = pbuffer->reserve(size);
+void decompose(double v, std::uint64_t* pm, int* pe2)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    std::uint64_t fraction = bits & ((std::uint64_t(1) << 52) - 1);
+    unsigned biased_exponent = static_cast<unsigned>(bits >> 52) & 0x7ff;
+    if(biased_exponent == 0) {
+        *pm = fraction;
+        *pe2 = -1074;
+    } else {
+        *pm = fraction | (std::uint64_t(1) << 52);
+        *pe2 = static_cast<int>(biased_exponent) - 1075;
+    }
+}
 
-    unsigned pos = size;
-    if(cs.left_justify) {
-        pos -= padding;
-        std::memset(str+pos, ' ', padding);
+void scale_to_decimal(std::uint64_t m, int e2, int k, scaled_decimal* pd)
+{
+    // Past 10^-max(-e2, 0) all digits are zero, so there's no need to scale
+    // further than that.
+    int max_k = std::max(-e2, 0);
+    pd->trailing_zeroes = 0;
+    if(k > max_k) {
+        pd->trailing_zeroes = static_cast<unsigned>(k - max_k);
+        k = max_k;
+    }
+    std::uint64_t integer;
+    if(round_scaled_fast(m, e2, k, &integer)) {
+        if(integer == 0) {
+            pd->count = 0;
+        } else {
+            pd->count = decimal_digit_count(integer);
+            write_decimal_digits(pd->digits, pd->count, integer, pd->count);
+        }
+    } else {
+        pd->count = round_scaled_exact(m, e2, k, pd->digits);
     }
+}
 
-    utoa_generic_base10_preallocated(str, pos, exponent, exponent_digits);
-    pos -= exponent_digits;
-    str[--pos] = exponent_sign;
-    str[--pos] = 'e';
+// Rounds a finite, nonzero value to the given number of significant digits,
+// and returns the decimal exponent of the first digit. The result always
+// has exactly that many digits (including trailing zeroes).
+int round_to_significant_digits(double v, unsigned significant_digits, scaled_decimal* pd)
+{
+    std::uint64_t m;
+    int e2;
+    decompose(v, &m, &e2);
+    // An estimate of floor(log10(v)) that is either correct or one too low.
+    int binary_exponent = e2 + static_cast<int>(log2(m));
+    int exponent = static_cast<int>(std::floor(binary_exponent*0.30102999566398120));
+    while(true) {
+        int k = static_cast<int>(significant_digits) - 1 - exponent;
+        scale_to_decimal(m, e2, k, pd);
+        if(pd->size() <= significant_digits)
+            return exponent;
+        // Either the estimate was too low, or rounding carried into a new
+        // digit (e.g. 9.96 -> 10.0). Try again one digit to the left.
+        ++exponent;
+    }
+}
 
-    mantissa = utoa_generic_base10_preallocated(str, pos, mantissa, digits_after_dot);
-    pos -= digits_after_dot;
+// Writes the range [first, last) of digits from d to str. Positions past
+// the computed digits are zeroes.
+char* copy_digits(char* str, scaled_decimal const& d, unsigned first, unsigned last)
+{
+    unsigned computed_last = std::min(last, d.count);
+    if(first < computed_last) {
+        std::memcpy(str, d.digits + first, computed_last - first);
+        str += computed_last - first;
+        first = computed_last;
+    }
+    if(first < last) {
+        std::memset(str, '0', last - first);
+        str += last - first;
+    }
+    return str;
+}
 
+// Number of trailing zeroes among the first size digits.
+unsigned count_trailing_zeroes(scaled_decimal const& d, unsigned size)
+{
+    unsigned zeroes = 0;
+    while(zeroes != size && d.digit(size - 1 - zeroes) == '0')
+        ++zeroes;
+    return zeroes;
+}
+
+char* write_field_start(char* str, char sign, unsigned padding, conversion_specification const& cs)
+{
+    bool pad_with_zeroes = cs.pad_with_zeroes && !cs.left_justify;
+    if(!cs.left_justify && !pad_with_zeroes) {
+        std::memset(str, ' ', padding);
+        str += padding;
+    }
+    if(sign)
+        *str++ = sign;
+    if(pad_with_zeroes) {
+        std::memset(str, '0', padding);
+        str += padding;
+    }
+    return str;
+}
+
+void write_field_end(char* str, unsigned padding, conversion_specification const& cs)
+{
+    if(cs.left_justify)
+        std::memset(str, ' ', padding);
+}
+
+// Writes the first size digits of d as a fixed-point number with
+// fraction_digits digits after the decimal point.
+void write_fixed(output_buffer* pbuffer, char sign, scaled_decimal const& d,
+    unsigned size, unsigned fraction_digits, conversion_specification const& cs)
+{
+    unsigned integer_digits = size > fraction_digits? size - fraction_digits : 1;
+    bool dot = fraction_digits != 0 || cs.alternative_form;
+    unsigned content_size = !!sign + integer_digits + dot + fraction_digits;
+    unsigned field_size = std::max(cs.minimum_field_width, content_size);
+    unsigned padding = field_size - content_size;
+
+    char* str = pbuffer->reserve(field_size);
+    char* p = write_field_start(str, sign, padding, cs);
+    if(size > fraction_digits) {
+        p = copy_digits(p, d, 0, integer_digits);
+        if(dot)
+            *p++ = '.';
+        p = copy_digits(p, d, integer_digits, size);
+    } else {
+        *p++ = '0';
+        if(dot)
+            *p++ = '.';
+        std::memset(p, '0', fraction_digits - size);
+        p += fraction_digits - size;
+        p = copy_digits(p, d, 0, size);
+    }
+    write_field_end(p, padding, cs);
+    pbuffer->commit(field_size);
+}
+
+// Writes the first size digits of d in scientific notation.
+void write_scientific(output_buffer* pbuffer, char sign, scaled_decimal const& d,
+    unsigned size, int exponent, conversion_specification const& cs)
+{
+    char exponent_sign = exponent < 0? '-' : '+';
+    unsigned exponent_value = static_cast<unsigned>(exponent < 0? -exponent : exponent);
+    // Like stdio, we always print at least two digits for the exponent.
+    unsigned exponent_digits = exponent_value < 100? 2 : 3;
+    bool dot = size > 1 || cs.alternative_form;
+    unsigned content_size = !!sign + size + dot + 2 + exponent_digits;
+    unsigned field_size = std::max(cs.minimum_field_width, content_size);
+    unsigned padding = field_size - content_size;
+
+    char* str = pbuffer->reserve(field_size);
+    char* p = write_field_start(str, sign, padding, cs);
+    *p++ = d.digit(0);
     if(dot)
-        str[--pos] = '.';
+        *p++ = '.';
+    p = copy_digits(p, d, 1, size);
+    *p++ = cs.uppercase? 'E' : 'e';
+    *p++ = exponent_sign;
+    write_decimal_digits(p, exponent_digits, exponent_value, exponent_digits);
+    p += exponent_digits;
+    write_field_end(p, padding, cs);
+    pbuffer->commit(field_size);
+}
 
-    str[--pos] = '0' + static_cast<char>(mantissa);
+unsigned float_precision(conversion_specification const& cs)
+{
+    return cs.precision == UNSPECIFIED_PRECISION? 6 : cs.precision;
+}
 
-    pos -= pad_zeroes;
-    std::memset(str+pos, '0', pad_zeroes);
-    if(sign)
-        str[0] = sign;
+char float_sign(double value, conversion_specification const& cs)
+{
+    return std::signbit(value)? '-' : cs.plus_sign;
+}
 
-    if(!cs.left_justify) {
-        pos -= padding;
-        std::memset(str+pos, ' ', padding);
+// Returns false if value is not a finite number, after writing it as inf or
+// nan.
+bool write_if_special(output_buffer* pbuffer, double value, conversion_specification const& cs)
+{
+    auto category = std::fpclassify(value);
+    if(category == FP_NAN) {
+        write_nan(pbuffer, value, cs);
+        return true;
+    } else if(category == FP_INFINITE) {
+        write_inf(pbuffer, value, cs);
+        return true;
+    } else {
+        return false;
     }
-    pbuffer->commit(size);
 }
 
 }   // anonymous namespace
@@ -1034,19 +1336,33 @@ void itoa_base16(output_buffer* pbuffer, unsigned long long value, conversion_sp
 
 void ftoa_base10_f(output_buffer* pbuffer, double value, conversion_specification const& cs)
 {
-    // TODO measure if these prefetches help
-    //prefetch_digits();
-    //prefetch_power_lut();
-    auto category = std::fpclassify(value);
-    if(category == FP_NAN) {
-        return write_nan(pbuffer, value, cs);
-    } else if(category == FP_INFINITE) {
-        return write_inf(pbuffer, value, cs);
-    } else {
-        decimal18 dv = binary64_to_decimal18(value);
-        int p = cs.precision == UNSPECIFIED_PRECISION? 6 : cs.precision;
-        return ftoa_base10_f_normal(pbuffer, dv, p, cs);
+    if(write_if_special(pbuffer, value, cs))
+        return;
+    unsigned precision = float_precision(cs);
+    scaled_decimal d;
+    d.count = 0;
+    d.trailing_zeroes = 0;
+    if(value != 0) {
+        std::uint64_t m;
+        int e2;
+        decompose(value, &m, &e2);
+        scale_to_decimal(m, e2, static_cast<int>(precision), &d);
     }
+    write_fixed(pbuffer, float_sign(value, cs), d, d.size(), precision, cs);
+}
+
+void ftoa_base10_e(output_buffer* pbuffer, double value, conversion_specification const& cs)
+{
+    if(write_if_special(pbuffer, value, cs))
+        return;
+    unsigned significant_digits = float_precision(cs) + 1;
+    scaled_decimal d;
+    d.count = 0;
+    d.trailing_zeroes = 0;
+    int exponent = 0;
+    if(value != 0)
+        exponent = round_to_significant_digits(value, significant_digits, &d);
+    write_scientific(pbuffer, float_sign(value, cs), d, significant_digits, exponent, cs);
 }
 
 void ftoa_base10_g(output_buffer* pbuffer, double value, conversion_specification const& cs)
@@ -1061,52 +1377,34 @@ void ftoa_base10_g(output_buffer* pbuffer, double value, conversion_specificatio
     // alternative mode is requested. Alternative mode also means that the period
     // stays, no matter if there are any fractional decimals remaining or
     // not.
-    //prefetch_digits();
-    //prefetch_power_lut();
-    auto category = std::fpclassify(value);
-    if(category == FP_NAN) {
-        return write_nan(pbuffer, value, cs);
-    } else if(category == FP_INFINITE) {
-        return write_inf(pbuffer, value, cs);
-    } else {
-        int const minimum_exponent = -4;
-        decimal18 dv = binary64_to_decimal18(value);
-
-        int p;
-        if(cs.precision == UNSPECIFIED_PRECISION)
-            p = 6;
-        else if(cs.precision == 0)
-            p = 1;
-        else {
-            p = cs.precision;
-            if(!cs.alternative_form) {
-                // We are supposed to remove trailing zeroes, so we can't ever
-                // get more than 18 digits because the rest will be zero
-                // anyway, as this is the number of digits in the mantissa.
-                p = std::min(p, 18);
-            }
-        }
-        unsigned truncated_digits = 18 - p;
-
-        if(p > dv.exponent && dv.exponent >= minimum_exponent) {
-            unsigned trailing_zeroes = 0;
-            if(!cs.alternative_form) {
-                trailing_zeroes = count_trailing_zeroes_after_dot(dv);
-                if(trailing_zeroes > truncated_digits)
-                    trailing_zeroes -= truncated_digits;
-                else
-                    trailing_zeroes = 0;
-            }
-            p = p - 1 - dv.exponent - trailing_zeroes;
-            p = std::max(0, p);
-            return ftoa_base10_f_normal(pbuffer, dv, p, cs);
-        } else {
-            unsigned trailing_zeroes = 0;
-            if(!cs.alternative_form)
-                trailing_zeroes = count_trailing_zeroes(dv, truncated_digits);
-            p = p - 1 - trailing_zeroes;
-            return ftoa_base10_e_normal(pbuffer, dv, p, cs);
+    if(write_if_special(pbuffer, value, cs))
+        return;
+    unsigned significant_digits = float_precision(cs);
+    if(significant_digits == 0)
+        significant_digits = 1;
+    scaled_decimal d;
+    d.count = 0;
+    d.trailing_zeroes = 0;
+    int exponent = 0;
+    if(value != 0)
+        exponent = round_to_significant_digits(value, significant_digits, &d);
+
+    int const minimum_exponent = -4;
+    char sign = float_sign(value, cs);
+    unsigned size = significant_digits;
+    if(static_cast<int>(significant_digits) > exponent && exponent >= minimum_exponent) {
+        unsigned fraction_digits = static_cast<unsigned>(
+            static_cast<int>(significant_digits) - 1 - exponent);
+        if(!cs.alternative_form) {
+            unsigned zeroes = std::min(count_trailing_zeroes(d, size), fraction_digits);
+            size -= zeroes;
+            fraction_digits -= zeroes;
         }
+        write_fixed(pbuffer, sign, d, size, fraction_digits, cs);
+    } else {
+        if(!cs.alternative_form)
+            size -= std::min(count_trailing_zeroes(d, size), size - 1);
+        write_scientific(pbuffer, sign, d, size, exponent, cs);
     }
 }
 
@@ -1119,13 +1417,15 @@ void ftoa_base10_g(output_buffer* pbuffer, double value, conversion_specificatio
 #include <sstream>  // istringstream, ostringstream
 #include <iomanip>  // iomanip
 #include <random>
-#include <algorithm>    // mismatch
+#include <algorithm>    // mismatch, remove
+#include <cstdio>       // snprintf
 
 namespace reckless {
 namespace detail {
 class whitebox_output_buffer : public output_buffer {
 public:
     using output_buffer::output_buffer;
+    using output_buffer::frame_end;
     using output_buffer::flush;
 };
 
@@ -1344,6 +1644,70 @@ public:
         TEST(convert(1000, cs) == "01000");
     }
 
+    void digit_boundaries()
+    {
+        std::uint64_t power = 1;
+        for(unsigned i=0; i!=20; ++i) {
+            TEST(convert(power) == std::to_string(power));
+            TEST(convert(power - 1) == std::to_string(power - 1));
+            TEST(convert(power + 1) == std::to_string(power + 1));
+            if(i != 19)
+                power *= 10;
+        }
+        TEST(convert(std::numeric_limits<unsigned long long>::max()) == std::to_string(std::numeric_limits<unsigned long long>::max()));
+        TEST(convert(std::numeric_limits<unsigned int>::max()) == std::to_string(std::numeric_limits<unsigned int>::max()));
+        TEST(convert(std::numeric_limits<int>::min()) == std::to_string(std::numeric_limits<int>::min()));
+    }
+
+    void random()
+    {
+        // Compare against snprintf for values of all magnitudes, with random
+        // combinations of field width, precision and flags.
+        std::mt19937_64 rng;
+        for(unsigned i=0; i!=1000000; ++i) {
+            std::uint64_t bits = rng();
+            std::uint64_t uv = bits >> (bits % 64);
+            long long sv = static_cast<long long>(uv);
+            if(bits & 0x100)
+                sv = -sv;
+
+            conversion_specification cs;
+            std::uint64_t flags = rng();
+            std::string format = "%";
+            cs.left_justify = (flags & 1) != 0;
+            if(cs.left_justify)
+                format += '-';
+            cs.pad_with_zeroes = (flags & 2) != 0;
+            if(cs.pad_with_zeroes)
+                format += '0';
+            cs.plus_sign = (flags & 4)? '+' : (flags & 8)? ' ' : 0;
+            if(cs.plus_sign)
+                format += cs.plus_sign;
+            cs.minimum_field_width = (flags & 16)? (flags >> 8) % 26 : 0;
+            if(cs.minimum_field_width)
+                format += std::to_string(cs.minimum_field_width);
+            if(flags & 32) {
+                cs.precision = (flags >> 16) % 24;
+                format += '.' + std::to_string(cs.precision);
+            }
+
+            char expected[64];
+            std::snprintf(expected, sizeof(expected), (format + "lld").c_str(), sv);
+            TEST(convert(sv, cs) == expected);
+
+            // printf ignores the sign flags for unsigned conversions.
+            cs.plus_sign = 0;
+            format.erase(std::remove(format.begin(), format.end(), '+'), format.end());
+            format.erase(std::remove(format.begin(), format.end(), ' '), format.end());
+            std::snprintf(expected, sizeof(expected), (format + "llu").c_str(),
+                static_cast<unsigned long long>(uv));
+            TEST(convert(static_cast<unsigned long long>(uv), cs) == expected);
+            std::snprintf(expected, sizeof(expected), (format + "u").c_str(),
+                static_cast<unsigned>(uv));
+            TEST(convert(static_cast<unsigned>(uv), cs) == expected);
+        }
+    }
+
 private:
     template <class T>
     std::string convert(T v)
@@ -1366,6 +1730,7 @@ private:
 
         itoa_base10(&output_buffer_, v, cs);
 
+        output_buffer_.frame_end();
         output_buffer_.flush();
         return writer_.str();
     }
@@ -1381,7 +1746,9 @@ unit_test::suite<itoa_base10_suite> itoa_base10_tests = {
     TESTCASE(itoa_base10_suite::left_justify),
     TESTCASE(itoa_base10_suite::precision),
     TESTCASE(itoa_base10_suite::sign),
-    TESTCASE(itoa_base10_suite::precision_and_padding)
+    TESTCASE(itoa_base10_suite::precision_and_padding),
+    TESTCASE(itoa_base10_suite::digit_boundaries),
+    TESTCASE(itoa_base10_suite::random)
 };
 
 class itoa_base16_suite
@@ -1586,6 +1953,7 @@ private:
 
         itoa_base16(&output_buffer_, v, cs);
 
+        output_buffer_.frame_end();
         output_buffer_.flush();
         return writer_.str();
     }
@@ -1618,26 +1986,26 @@ public:
         TEST(convert(1.5, 2) == "1.50");
         TEST(convert(1.234567890, 4) == "1.2346");
         TEST(convert(1.2345678901234567, 16) == "1.2345678901234567");
-        TEST(convert(1.2345678901234567, 17) == "1.23456789012345670");
-        TEST(convert(1.2345678901234567, 25) == "1.2345678901234567000000000");
-        TEST(convert(1.7976931348623157e308, 3) == "179769313486231563000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000.000");
+        TEST(convert(1.2345678901234567, 17) == "1.23456789012345669");
+        TEST(convert(1.2345678901234567, 25) == "1.2345678901234566904321355");
+        TEST(convert(1.7976931348623157e308, 3) == "179769313486231570814527423731704356798070567525844996598917476803157260780028538760589558632766878171540458953514382464234321326889464182768467546703537516986049910576551282076245490090389328944075868508455133942304583236903222948165808559332123348274797826204144723168738177180919299881250404026184124858368.000");
         TEST(convert(1234.5678, 0) == "1235");
         TEST(convert(1234.5678, 1) == "1234.6");
 
         TEST(convert(0.3, 1) == "0.3");
         TEST(convert(0.3, 2) == "0.30");
-        TEST(convert(0.3, 20) == "0.29999999999999999000");
+        TEST(convert(0.3, 20) == "0.29999999999999998890");
 
         TEST(convert(1.2345e20, 5) == "123450000000000000000.00000");
         TEST(convert(1.2345e20, 0) == "123450000000000000000");
         TEST(convert(1.2345e2, 5) == "123.45000");
         TEST(convert(1.2345e-20, 5) == "0.00000");
-        TEST(convert(0.5, 0) == "1");
+        TEST(convert(0.5, 0) == "0");
         TEST(convert(0.05, 1) == "0.1");
         TEST(convert(9.9, 0) == "10");
         TEST(convert(0, 0) == "0");
-        TEST(convert(1.23456789012345670, 20) == "1.23456789012345670000");
-        TEST(convert(0.123456789012345670, 20) == "0.12345678901234566300");
+        TEST(convert(1.23456789012345670, 20) == "1.23456789012345669043");
+        TEST(convert(0.123456789012345670, 20) == "0.12345678901234566349");
 
         TEST(convert(0.000123, 6) == "0.000123");
     }
@@ -1671,6 +2039,7 @@ private:
     {
         writer_.reset();
         reckless::ftoa_base10_f(&output_buffer_, number, cs);
+        output_buffer_.frame_end();
         output_buffer_.flush();
         //std::cout << '[' << writer_.str() << ']' << std::endl;
         return writer_.str();
@@ -1698,6 +2067,148 @@ unit_test::suite<ftoa_base10_f> ftoa_base10_precision_tests = {
     TESTCASE(ftoa_base10_f::padding),
 };
 
+// Compares %f, %e and %g output with stdio for random values and flags.
+// Every digit must match, not just the ones needed to round-trip the value.
+class ftoa_stdio_suite
+{
+public:
+    ftoa_stdio_suite() :
+        output_buffer_(&writer_, 4096)
+    {
+    }
+
+    void boundaries()
+    {
+        double const values[] = {0.0, -0.0, 0.5, 1.5, 2.5, 0.125, 9.5, 99.5,
+            999999.5, 0.05, 0.15, 0.25, 0.35, 1e15, 1e16, 1e17, 1e22, 1e23,
+            5e-324, 2.2250738585072009e-308, 2.2250738585072014e-308,
+            1.7976931348623157e308, 9.9999999999999995e-5, 0.0001, 9.9999995,
+            123456789012345678.0, 0.1, 1.0/3};
+        char const conversions[] = "feg";
+        for(double v : values) {
+            for(char const* c = conversions; *c; ++c) {
+                for(unsigned precision : {0u, 1u, 2u, 5u, 6u, 17u, 20u, 40u}) {
+                    conversion_specification cs;
+                    cs.precision = precision;
+                    check(v, cs, "%." + std::to_string(precision), *c);
+                }
+            }
+        }
+    }
+
+    // Denormals have the smallest binary exponents, which is where the
+    // error estimate in round_scaled_fast needs shifts of 64 bits or more.
+    void denormals()
+    {
+        std::mt19937_64 rng;
+        char const conversions[] = "feg";
+        for(unsigned i=0; i!=20000; ++i) {
+            // Zero exponent bits and a random significand, with a random
+            // number of its top bits cleared to reach the smallest ones.
+            std::uint64_t bits = rng();
+            std::uint64_t significand = (bits & ((std::uint64_t(1) << 52) - 1))
+                >> ((bits >> 52) % 52);
+            if(significand == 0)
+                significand = 1;
+            double v;
+            std::memcpy(&v, &significand, sizeof(v));
+            if(bits >> 63)
+                v = -v;
+            conversion_specification cs;
+            cs.precision = static_cast<unsigned>((bits >> 56) % 30);
+            char conversion = conversions[i % 3];
+            if(conversion == 'f')
+                cs.precision += 300;
+            check(v, cs, "%." + std::to_string(cs.precision), conversion);
+        }
+    }
+
+    void random()
+    {
+        std::mt19937_64 rng;
+        for(unsigned i=0; i!=300000; ++i) {
+            std::uint64_t bits = rng();
+            double v;
+            if(i % 3 == 0) {
+                // A "nice" value with few digits, which tends to land on
+                // rounding ties.
+                std::int64_t mantissa = static_cast<std::int64_t>(bits % 2000001) - 1000000;
+                v = static_cast<double>(mantissa);
+                for(unsigned j=0; j!=(bits >> 32) % 8; ++j)
+                    v /= 10;
+            } else {
+                std::memcpy(&v, &bits, sizeof(v));
+                if(std::isnan(v))
+                    continue;
+            }
+
+            conversion_specification cs;
+            std::uint64_t flags = rng();
+            std::string format = "%";
+            cs.left_justify = (flags & 1) != 0;
+            if(cs.left_justify)
+                format += '-';
+            cs.pad_with_zeroes = (flags & 2) != 0;
+            if(cs.pad_with_zeroes)
+                format += '0';
+            cs.plus_sign = (flags & 4)? '+' : (flags & 8)? ' ' : 0;
+            if(cs.plus_sign)
+                format += cs.plus_sign;
+            cs.alternative_form = (flags & 64) != 0;
+            if(cs.alternative_form)
+                format += '#';
+            cs.minimum_field_width = (flags & 16)? (flags >> 8) % 30 : 0;
+            if(cs.minimum_field_width)
+                format += std::to_string(cs.minimum_field_width);
+            if(flags & 32) {
+                cs.precision = (flags >> 16) % 30;
+                format += '.' + std::to_string(cs.precision);
+            }
+            cs.uppercase = (flags & 128) != 0;
+            char const conversion = "feg"[(flags >> 24) % 3];
+            // Huge values in %f notation are slow and exercise the same code
+            // as the boundaries test.
+            if(conversion == 'f' && std::fabs(v) > 1e60)
+                continue;
+            check(v, cs, format, conversion);
+        }
+    }
+
+private:
+    void check(double v, conversion_specification const& cs,
+        std::string const& format, char conversion)
+    {
+        char c = cs.uppercase? static_cast<char>(conversion - 'a' + 'A') : conversion;
+        char expected[2048];
+        std::snprintf(expected, sizeof(expected), (format + c).c_str(), v);
+
+        writer_.reset();
+        if(conversion == 'f')
+            reckless::ftoa_base10_f(&output_buffer_, v, cs);
+        else if(conversion == 'e')
+            reckless::ftoa_base10_e(&output_buffer_, v, cs);
+        else
+            reckless::ftoa_base10_g(&output_buffer_, v, cs);
+        output_buffer_.frame_end();
+        output_buffer_.flush();
+        if(writer_.str() != expected) {
+            std::ostringstream ostr;
+            ostr << (format + c) << " of " << std::setprecision(17) << v
+                << ": got " << writer_.str() << ", expected " << expected;
+            throw unit_test::error(ostr.str(), __FILE__, __LINE__);
+        }
+    }
+
+    string_writer writer_;
+    whitebox_output_buffer output_buffer_;
+};
+
+unit_test::suite<ftoa_stdio_suite> ftoa_stdio_tests = {
+    TESTCASE(ftoa_stdio_suite::boundaries),
+    TESTCASE(ftoa_stdio_suite::denormals),
+    TESTCASE(ftoa_stdio_suite::random)
+};
+
 #define TEST_FTOA(number) test_conversion_quality(number, __FILE__, __LINE__)
 
 class ftoa_base10_g
@@ -1943,6 +2454,7 @@ private:
     {
         writer_.reset();
         reckless::ftoa_base10_g(&output_buffer_, number, cs);
+        output_buffer_.frame_end();
         output_buffer_.flush();
         return writer_.str();
     }
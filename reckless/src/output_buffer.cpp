@@ -33,6 +33,10 @@
 #include <cassert>
 #include <algorithm>    // max, min
 
+#if defined(__linux__)
+#include <sys/mman.h>   // mmap, munmap, madvise
+#endif
+
 namespace reckless {
 
 #ifdef RECKLESS_ENABLE_TRACE_LOG
@@ -87,9 +91,40 @@ output_buffer::output_buffer(writer* pwriter, std::size_t max_capacity)
     reset(pwriter, max_capacity);
 }
 
-void output_buffer::reset() noexcept
+// When the writer accepts page gifts (see writer::enable_page_gifts()), the
+// buffer is allocated directly with mmap() so that it is page-aligned and so
+// that we can drop individual pages from it after the writer has taken them.
+char* output_buffer::allocate_buffer(std::size_t& capacity, bool page_gifts)
+{
+#if defined(__linux__)
+    if(page_gifts) {
+        capacity = (capacity + detail::page_size - 1) & ~std::size_t(detail::page_size - 1);
+        void* p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED? nullptr : static_cast<char*>(p);
+    }
+#else
+    (void)page_gifts;
+#endif
+    return static_cast<char*>(std::malloc(capacity));
+}
+
+void output_buffer::free_buffer() noexcept
 {
+#if defined(__linux__)
+    if(page_gifts_) {
+        if(pbuffer_)
+            munmap(pbuffer_, pbuffer_end_ - pbuffer_);
+        return;
+    }
+#endif
     std::free(pbuffer_);
+}
+
+void output_buffer::reset() noexcept
+{
+    free_buffer();
+    page_gifts_ = false;
     pwriter_ = nullptr;
     pbuffer_ = nullptr;
     pcommit_end_ = nullptr;
@@ -100,11 +135,13 @@ void output_buffer::reset() noexcept
 void output_buffer::reset(writer* pwriter, std::size_t max_capacity)
 {
     using namespace detail;
-    auto pbuffer = static_cast<char*>(std::malloc(max_capacity));
+    bool page_gifts = pwriter->enable_page_gifts();
+    auto pbuffer = allocate_buffer(max_capacity, page_gifts);
     if(!pbuffer)
         throw std::bad_alloc();
-    std::free(pbuffer_);
+    free_buffer();
     pbuffer_ = pbuffer;
+    page_gifts_ = page_gifts;
 
     pwriter_ = pwriter;
     pframe_end_ = pbuffer_;
@@ -114,7 +151,7 @@ void output_buffer::reset(writer* pwriter, std::size_t max_capacity)
 
 output_buffer::~output_buffer()
 {
-    std::free(pbuffer_);
+    free_buffer();
 }
 
 // FIXME I think this code is wrong. Review and check it against the invariants
@@ -205,10 +242,22 @@ void output_buffer::flush()
         // or if there is an error in the writer.
         // TODO On the other hand when the buffer does fill up, that's when we are under
         // the highest load. Shouldn't we perform as efficiently as possible then?
+#if defined(__linux__)
+        // The writer owns the complete pages that it has written now, so
+        // replace them before we reuse the buffer. MADV_DONTNEED drops our
+        // reference to the pages and maps zero-filled pages in their place
+        // on the next access.
+        if(page_gifts_) {
+            std::size_t gifted = written & ~std::size_t(page_size - 1);
+            if(gifted != 0)
+                madvise(pbuffer_, gifted, MADV_DONTNEED);
+        }
+#endif
         std::size_t remaining_data = (pcommit_end_ - pbuffer_) - written;
         std::memmove(pbuffer_, pbuffer_+written, remaining_data);
         pframe_end_ -= written;
         pcommit_end_ -= written;
+        remaining -= written;
 
         if(likely(!error)) {
             error_code_.clear();
@@ -307,6 +356,43 @@ void output_buffer::flush()
     }
 }
 
+void output_buffer::insert_before_frame(char const* s, std::size_t size)
+{
+    if(partial_frame_) {
+        write(s, size);
+        return;
+    }
+    std::size_t frame_size = pcommit_end_ - pframe_end_;
+    // This may flush complete frames and move the current one, so don't look
+    // at pframe_end_ until afterwards.
+    reserve(size);
+    std::memmove(pframe_end_ + size, pframe_end_, frame_size);
+    std::memcpy(pframe_end_, s, size);
+    commit(size);
+}
+
+bool output_buffer::copy_frame_for_comparison(char* p, std::size_t capacity,
+    std::size_t* psize) const
+{
+    if(partial_frame_ || excluded_count_ > MAX_EXCLUDED_RANGES)
+        return false;
+    std::size_t frame_size = pcommit_end_ - pframe_end_;
+    std::size_t offset = 0;
+    std::size_t copied = 0;
+    for(unsigned i=0; i<=excluded_count_; ++i) {
+        std::size_t end = i == excluded_count_? frame_size : excluded_[i].begin;
+        std::size_t size = end - offset;
+        if(size > capacity - copied)
+            return false;
+        std::memcpy(p + copied, pframe_end_ + offset, size);
+        copied += size;
+        if(i != excluded_count_)
+            offset = excluded_[i].end;
+    }
+    *psize = copied;
+    return true;
+}
+
 char* output_buffer::reserve_slow_path(std::size_t size)
 {
     std::size_t frame_size = (pcommit_end_ - pframe_end_) + size;
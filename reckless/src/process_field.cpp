@@ -0,0 +1,125 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/process_field.hpp>
+
+#include <algorithm>    // min
+#include <cstring>      // strlen, strrchr, memcpy
+#include <mutex>
+#include <string>       // to_string
+
+#if defined(__linux__)
+#include <errno.h>          // program_invocation_short_name
+#include <unistd.h>         // getpid, gethostname
+#elif defined(__unix__) || defined(__APPLE__)
+#include <stdlib.h>         // getprogname
+#include <unistd.h>         // getpid, gethostname
+#elif defined(_WIN32)
+#include <Windows.h>        // GetCurrentProcessId, GetComputerNameA, GetModuleFileNameA
+#endif
+
+namespace reckless {
+namespace detail {
+
+process_field_text pid_text;
+process_field_text hostname_text;
+std::atomic<process_field_text const*> app_name_text(nullptr);
+
+namespace {
+    std::mutex render_mutex;
+    unsigned long rendered_pid = 0;
+
+    void set_text(process_field_text* ptext, char const* s)
+    {
+        ptext->size = std::min(std::strlen(s), sizeof(ptext->text));
+        std::memcpy(ptext->text, s, ptext->size);
+    }
+
+    void publish_app_name(char const* s)
+    {
+        auto ptext = new process_field_text;
+        set_text(ptext, s);
+        app_name_text.store(ptext, std::memory_order_release);
+    }
+
+    unsigned long current_pid()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        return static_cast<unsigned long>(getpid());
+#elif defined(_WIN32)
+        return GetCurrentProcessId();
+#else
+        static_assert(false, "current_pid is not implemented for this OS");
+#endif
+    }
+
+    void render_app_name()
+    {
+#if defined(__linux__)
+        char const* name = program_invocation_short_name;
+#elif defined(__unix__) || defined(__APPLE__)
+        char const* name = getprogname();
+#elif defined(_WIN32)
+        char path[MAX_PATH] = {0};
+        GetModuleFileNameA(nullptr, path, sizeof(path));
+        char const* name = std::strrchr(path, '\\');
+        name = name? name + 1 : path;
+#endif
+        publish_app_name(name? name : "");
+    }
+
+    void render_hostname()
+    {
+        char name[256] = {0};
+#if defined(__unix__) || defined(__APPLE__)
+        gethostname(name, sizeof(name) - 1);
+#elif defined(_WIN32)
+        DWORD size = sizeof(name);
+        GetComputerNameA(name, &size);
+#endif
+        set_text(&hostname_text, name);
+    }
+}
+
+void render_process_fields()
+{
+    std::lock_guard<std::mutex> lock(render_mutex);
+    unsigned long pid = current_pid();
+    if(pid == rendered_pid)
+        return;
+    set_text(&pid_text, std::to_string(pid).c_str());
+    render_hostname();
+    // The name stays the same in a child process.
+    if(!app_name_text.load(std::memory_order_relaxed))
+        render_app_name();
+    rendered_pid = pid;
+}
+
+}   // namespace detail
+
+void set_app_name(char const* name)
+{
+    using namespace detail;
+    std::lock_guard<std::mutex> lock(render_mutex);
+    publish_app_name(name);
+}
+
+}   // namespace reckless
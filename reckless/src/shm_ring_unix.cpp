@@ -0,0 +1,272 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/shm_writer.hpp>
+#include <reckless/shm_reader.hpp>
+#include <reckless/detail/shm_ring.hpp>
+#include <reckless/detail/platform.hpp> // get_page_size
+
+#include <algorithm>    // min
+#include <cassert>
+#include <cstring>      // memcpy
+#include <new>          // placement new
+#include <system_error>
+
+#include <errno.h>
+#include <fcntl.h>          // O_* constants
+#include <linux/futex.h>
+#include <sys/mman.h>       // shm_open, mmap
+#include <sys/stat.h>       // fstat
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>         // ftruncate, close, syscall
+
+namespace {
+    void close_fd(int fd)
+    {
+        while(-1 == close(fd)) {
+            if(errno != EINTR)
+                break;
+        }
+    }
+}
+
+namespace reckless {
+namespace detail {
+
+shm_ring_header* map_shm_ring(int fd, std::size_t header_size,
+    std::size_t capacity)
+{
+    // Reserve address space for the header and two copies of the data area,
+    // then map the shared-memory object over it, with the data area twice.
+    std::size_t total_size = header_size + 2*capacity;
+    void* pbase = mmap(nullptr, total_size, PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(pbase == MAP_FAILED)
+        throw std::system_error(errno, std::system_category());
+    char* p = static_cast<char*>(pbase);
+
+    if(MAP_FAILED == mmap(p, header_size + capacity, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_FIXED, fd, 0)
+        || MAP_FAILED == mmap(p + header_size + capacity, capacity,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, header_size))
+    {
+        int error = errno;
+        munmap(pbase, total_size);
+        throw std::system_error(error, std::system_category());
+    }
+    return reinterpret_cast<shm_ring_header*>(p);
+}
+
+void unmap_shm_ring(shm_ring_header* pheader)
+{
+    munmap(pheader, pheader->header_size + 2*pheader->capacity);
+}
+
+// The futex word lives in memory shared between processes, so unlike
+// spsc_event we can't use the private futex operations here.
+void shm_ring_wake(std::atomic<std::uint32_t>* pword)
+{
+    syscall(SYS_futex, pword, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+void shm_ring_wait(std::atomic<std::uint32_t>* pword, std::uint32_t value,
+    unsigned milliseconds)
+{
+    timespec timeout;
+    timeout.tv_sec = milliseconds/1000;
+    timeout.tv_nsec = static_cast<long>(milliseconds%1000)*1000000;
+    syscall(SYS_futex, pword, FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+}   // namespace detail
+
+shm_writer::shm_writer(char const* name, std::size_t capacity) :
+    name_(name)
+{
+    std::size_t page_size = detail::get_page_size();
+    capacity = std::max<std::size_t>(capacity, 1);
+    capacity_ = (capacity + page_size - 1)/page_size*page_size;
+
+    // Unlink first so that a reader that still has an old ring open doesn't
+    // see it being reinitialized under its feet.
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+        S_IRUSR | S_IWUSR);
+    if(fd == -1)
+        throw std::system_error(errno, std::system_category());
+    if(-1 == ftruncate(fd, page_size + capacity_)) {
+        int error = errno;
+        close_fd(fd);
+        shm_unlink(name);
+        throw std::system_error(error, std::system_category());
+    }
+    try {
+        pheader_ = detail::map_shm_ring(fd, page_size, capacity_);
+    } catch(...) {
+        close_fd(fd);
+        shm_unlink(name);
+        throw;
+    }
+    close_fd(fd);
+
+    // The object is zero-filled by ftruncate, which is a valid initial state
+    // for the atomics. The magic is written last so that a reader that opens
+    // the ring early doesn't accept a half-initialized header.
+    new (pheader_) detail::shm_ring_header();
+    pheader_->version = detail::shm_ring_header::VERSION;
+    pheader_->header_size = static_cast<std::uint32_t>(page_size);
+    pheader_->capacity = capacity_;
+    std::atomic_thread_fence(std::memory_order_release);
+    pheader_->magic = detail::shm_ring_header::MAGIC;
+    pdata_ = reinterpret_cast<char*>(pheader_) + page_size;
+}
+
+shm_writer::~shm_writer()
+{
+    pheader_->writer_closed.store(1, std::memory_order_release);
+    pheader_->write_sequence.fetch_add(1, std::memory_order_seq_cst);
+    detail::shm_ring_wake(&pheader_->write_sequence);
+    detail::unmap_shm_ring(pheader_);
+    shm_unlink(name_.c_str());
+}
+
+std::size_t shm_writer::write(void const* pbuffer, std::size_t count,
+    std::error_code& ec) noexcept
+{
+    std::uint64_t write_position = pheader_->write_position.load(
+        std::memory_order_relaxed);
+    std::uint64_t read_position = pheader_->read_position.load(
+        std::memory_order_acquire);
+    std::size_t available = capacity_ - static_cast<std::size_t>(
+        write_position - read_position);
+    std::size_t n = std::min(count, available);
+
+    if(n != 0) {
+        // Thanks to the double mapping this never needs to be split in two.
+        std::size_t offset = static_cast<std::size_t>(write_position % capacity_);
+        std::memcpy(pdata_ + offset, pbuffer, n);
+        pheader_->write_position.store(write_position + n,
+            std::memory_order_release);
+        // Only wake the reader if it is sleeping, to avoid a system call per
+        // write while it is keeping up. See shm_reader::wait() for the other
+        // half of this handshake.
+        pheader_->write_sequence.fetch_add(1, std::memory_order_seq_cst);
+        if(pheader_->reader_waiting.load(std::memory_order_seq_cst))
+            detail::shm_ring_wake(&pheader_->write_sequence);
+    }
+
+    if(n != count)
+        ec.assign(writer::temporary_failure, writer::error_category());
+    else
+        ec.clear();
+    return n;
+}
+
+shm_reader::shm_reader(char const* name)
+{
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    if(fd == -1)
+        throw std::system_error(errno, std::system_category());
+
+    // Check the header through a temporary mapping before we trust the
+    // capacity it claims.
+    std::size_t page_size = detail::get_page_size();
+    struct stat st;
+    void* p = MAP_FAILED;
+    if(0 == fstat(fd, &st) && static_cast<std::size_t>(st.st_size) > page_size)
+        p = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd, 0);
+    auto pheader = static_cast<detail::shm_ring_header const*>(p);
+    bool valid = p != MAP_FAILED
+        && pheader->magic == detail::shm_ring_header::MAGIC
+        && pheader->version == detail::shm_ring_header::VERSION
+        && pheader->header_size == page_size
+        && pheader->capacity + page_size == static_cast<std::uint64_t>(st.st_size);
+    std::size_t capacity = valid? pheader->capacity : 0;
+    if(p != MAP_FAILED)
+        munmap(p, page_size);
+    if(!valid) {
+        close_fd(fd);
+        throw std::system_error(EPROTO, std::system_category());
+    }
+
+    try {
+        pheader_ = detail::map_shm_ring(fd, page_size, capacity);
+    } catch(...) {
+        close_fd(fd);
+        throw;
+    }
+    close_fd(fd);
+    pdata_ = reinterpret_cast<char const*>(pheader_) + page_size;
+    capacity_ = capacity;
+}
+
+shm_reader::~shm_reader()
+{
+    detail::unmap_shm_ring(pheader_);
+}
+
+std::size_t shm_reader::peek(char const** ppdata) const
+{
+    std::uint64_t read_position = pheader_->read_position.load(
+        std::memory_order_relaxed);
+    std::uint64_t write_position = pheader_->write_position.load(
+        std::memory_order_acquire);
+    *ppdata = pdata_ + read_position % capacity_;
+    return static_cast<std::size_t>(write_position - read_position);
+}
+
+void shm_reader::consume(std::size_t count)
+{
+    std::uint64_t read_position = pheader_->read_position.load(
+        std::memory_order_relaxed);
+    assert(count <= pheader_->write_position.load(std::memory_order_relaxed)
+        - read_position);
+    pheader_->read_position.store(read_position + count,
+        std::memory_order_release);
+}
+
+bool shm_reader::wait(unsigned milliseconds)
+{
+    char const* p;
+    std::uint32_t sequence = pheader_->write_sequence.load(
+        std::memory_order_seq_cst);
+    if(peek(&p) != 0)
+        return true;
+    if(writer_closed())
+        return false;
+
+    // Announce that we are going to sleep, then check again. Either the
+    // writer sees reader_waiting and wakes us, or we see the new sequence
+    // number and the futex wait returns immediately.
+    pheader_->reader_waiting.store(1, std::memory_order_seq_cst);
+    if(pheader_->write_sequence.load(std::memory_order_seq_cst) == sequence)
+        detail::shm_ring_wait(&pheader_->write_sequence, sequence, milliseconds);
+    pheader_->reader_waiting.store(0, std::memory_order_relaxed);
+    return peek(&p) != 0;
+}
+
+bool shm_reader::writer_closed() const
+{
+    return pheader_->writer_closed.load(std::memory_order_acquire) != 0;
+}
+
+}   // namespace reckless
@@ -0,0 +1,285 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/structured_log.hpp>
+#include <reckless/ntoa.hpp>
+
+#include <cmath>    // isfinite
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RECKLESS_STRUCTURED_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>     // _BitScanForward
+#endif
+#endif
+
+namespace reckless {
+namespace {
+
+using detail::likely;
+
+// Characters that must be escaped inside a quoted string.
+inline bool needs_escape(char c)
+{
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Characters that force a logfmt value to be quoted.
+inline bool needs_logfmt_quotes(char c)
+{
+    return needs_escape(c) || c == ' ' || c == '=';
+}
+
+#if defined(RECKLESS_STRUCTURED_SSE2)
+// Returns a mask with a bit set for each of the 16 bytes at p that is a quote,
+// a backslash or a control character. If LogfmtQuotes is true, spaces and '='
+// are included as well.
+template <bool LogfmtQuotes>
+inline unsigned special_character_mask(char const* p)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+    __m128i special = _mm_or_si128(
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    // v <= 0x1f as unsigned bytes if max(v, 0x1f) == 0x1f.
+    __m128i control = _mm_set1_epi8(0x1f);
+    special = _mm_or_si128(special,
+        _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+    if(LogfmtQuotes) {
+        special = _mm_or_si128(special, _mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('='))));
+    }
+    return static_cast<unsigned>(_mm_movemask_epi8(special));
+}
+
+inline unsigned count_trailing_zeroes(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// Returns a pointer to the first character in [p, pend) that needs escaping
+// (or quoting, for LogfmtQuotes), or pend if there is none. Strings in log
+// records rarely need escaping, so this is mostly a scan of the whole
+// string, which we do 16 bytes at a time.
+template <bool LogfmtQuotes>
+char const* find_special_character(char const* p, char const* pend)
+{
+#if defined(RECKLESS_STRUCTURED_SSE2)
+    while(pend - p >= 16) {
+        unsigned mask = special_character_mask<LogfmtQuotes>(p);
+        if(mask != 0)
+            return p + count_trailing_zeroes(mask);
+        p += 16;
+    }
+#endif
+    for(; p != pend; ++p) {
+        if(LogfmtQuotes? needs_logfmt_quotes(*p) : needs_escape(*p))
+            return p;
+    }
+    return pend;
+}
+
+void write_raw(output_buffer* pbuffer, char const* s, std::size_t size)
+{
+    char* p = pbuffer->reserve(size);
+    std::memcpy(p, s, size);
+    pbuffer->commit(size);
+}
+
+// Writes the string with quotes and backslashes escaped, and control
+// characters written as \n, \t etc. or \u00XX. This is valid in both JSON
+// and logfmt. Bytes >= 0x80 are passed through, i.e. the string is assumed
+// to be UTF-8.
+void write_escaped(output_buffer* pbuffer, char const* s, std::size_t size)
+{
+    static char const hex_digits[] = "0123456789abcdef";
+    char const* pend = s + size;
+    while(true) {
+        char const* pspecial = find_special_character<false>(s, pend);
+        write_raw(pbuffer, s, pspecial - s);
+        if(likely(pspecial == pend))
+            return;
+        char c = *pspecial;
+        char* p = pbuffer->reserve(6);
+        p[0] = '\\';
+        std::size_t length = 2;
+        switch(c) {
+        case '"': p[1] = '"'; break;
+        case '\\': p[1] = '\\'; break;
+        case '\n': p[1] = 'n'; break;
+        case '\r': p[1] = 'r'; break;
+        case '\t': p[1] = 't'; break;
+        case '\b': p[1] = 'b'; break;
+        case '\f': p[1] = 'f'; break;
+        default:
+            p[1] = 'u';
+            p[2] = '0';
+            p[3] = '0';
+            p[4] = hex_digits[(static_cast<unsigned char>(c) >> 4) & 0xf];
+            p[5] = hex_digits[static_cast<unsigned char>(c) & 0xf];
+            length = 6;
+        }
+        pbuffer->commit(length);
+        s = pspecial + 1;
+    }
+}
+
+void write_quoted(output_buffer* pbuffer, char const* s, std::size_t size)
+{
+    pbuffer->write('"');
+    write_escaped(pbuffer, s, size);
+    pbuffer->write('"');
+}
+
+void write_floating(output_buffer* pbuffer, double value,
+    unsigned significant_digits)
+{
+    conversion_specification cs;
+    cs.precision = significant_digits;
+    ftoa_base10_g(pbuffer, value, cs);
+}
+
+void write_end_of_line(output_buffer* pbuffer)
+{
+#if defined(_WIN32)
+    write_raw(pbuffer, "\r\n", 2);
+#else
+    pbuffer->write('\n');
+#endif
+}
+
+}   // anonymous namespace
+
+void json_encoder::begin_record(output_buffer* pbuffer)
+{
+    pbuffer->write('{');
+}
+
+void json_encoder::key(output_buffer* pbuffer, char const* key, bool first)
+{
+    if(!first)
+        pbuffer->write(',');
+    write_quoted(pbuffer, key, std::strlen(key));
+    pbuffer->write(':');
+}
+
+void json_encoder::string(output_buffer* pbuffer, char const* s,
+    std::size_t size)
+{
+    write_quoted(pbuffer, s, size);
+}
+
+void json_encoder::integer(output_buffer* pbuffer, long long value)
+{
+    itoa_base10(pbuffer, value, conversion_specification());
+}
+
+void json_encoder::integer(output_buffer* pbuffer, unsigned long long value)
+{
+    itoa_base10(pbuffer, value, conversion_specification());
+}
+
+void json_encoder::floating(output_buffer* pbuffer, double value,
+    unsigned significant_digits)
+{
+    // JSON has no representation for infinity or NaN.
+    if(std::isfinite(value))
+        write_floating(pbuffer, value, significant_digits);
+    else
+        write_raw(pbuffer, "null", 4);
+}
+
+void json_encoder::boolean(output_buffer* pbuffer, bool value)
+{
+    if(value)
+        write_raw(pbuffer, "true", 4);
+    else
+        write_raw(pbuffer, "false", 5);
+}
+
+void json_encoder::end_record(output_buffer* pbuffer)
+{
+    pbuffer->write('}');
+    write_end_of_line(pbuffer);
+}
+
+void logfmt_encoder::begin_record(output_buffer*)
+{
+}
+
+void logfmt_encoder::key(output_buffer* pbuffer, char const* key, bool first)
+{
+    if(!first)
+        pbuffer->write(' ');
+    // Keys are nearly always identifiers, but a key with a space or '=' in
+    // it would otherwise make the line impossible to split into pairs.
+    string(pbuffer, key, std::strlen(key));
+    pbuffer->write('=');
+}
+
+void logfmt_encoder::string(output_buffer* pbuffer, char const* s,
+    std::size_t size)
+{
+    if(size != 0 && find_special_character<true>(s, s + size) == s + size)
+        write_raw(pbuffer, s, size);
+    else
+        write_quoted(pbuffer, s, size);
+}
+
+void logfmt_encoder::integer(output_buffer* pbuffer, long long value)
+{
+    itoa_base10(pbuffer, value, conversion_specification());
+}
+
+void logfmt_encoder::integer(output_buffer* pbuffer, unsigned long long value)
+{
+    itoa_base10(pbuffer, value, conversion_specification());
+}
+
+void logfmt_encoder::floating(output_buffer* pbuffer, double value,
+    unsigned significant_digits)
+{
+    write_floating(pbuffer, value, significant_digits);
+}
+
+void logfmt_encoder::boolean(output_buffer* pbuffer, bool value)
+{
+    if(value)
+        write_raw(pbuffer, "true", 4);
+    else
+        write_raw(pbuffer, "false", 5);
+}
+
+void logfmt_encoder::end_record(output_buffer* pbuffer)
+{
+    write_end_of_line(pbuffer);
+}
+
+}   // namespace reckless
@@ -0,0 +1,337 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/tcp_writer.hpp>
+#include <reckless/detail/platform.hpp> // set_thread_name
+
+#include <algorithm>    // min, max
+#include <cassert>
+#include <chrono>
+#include <cstdio>       // snprintf
+#include <cstring>      // memset
+#include <system_error>
+
+#include <errno.h>
+#include <fcntl.h>      // open
+#include <netdb.h>      // getaddrinfo
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>   // S_IRUSR, S_IWUSR
+#include <unistd.h>     // close, pread, pwrite, ftruncate
+
+namespace {
+    // Largest chunk that the helper thread reads from the spool file and
+    // sends in one go.
+    std::size_t const SPOOL_CHUNK_SIZE = 64*1024;
+
+    // How long a single connection attempt, or a send that makes no
+    // progress, may take before we give up on it.
+    int const NETWORK_TIMEOUT_MS = 1000;
+
+    void close_fd(int fd)
+    {
+        while(-1 == close(fd)) {
+            if(errno != EINTR)
+                break;
+        }
+    }
+
+    // Wait for the socket to become writable. Returns false on timeout.
+    bool wait_writable(int fd, int timeout_ms)
+    {
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        while(true) {
+            int result = poll(&pfd, 1, timeout_ms);
+            if(result == -1 && errno == EINTR)
+                continue;
+            return result > 0;
+        }
+    }
+}
+
+namespace reckless {
+
+tcp_writer::tcp_writer(char const* host, unsigned short port,
+    char const* spool_path, std::size_t spool_capacity) :
+    spool_capacity_(spool_capacity),
+    statistics_()
+{
+    assert(spool_capacity != 0);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    char service[8];
+    std::snprintf(service, sizeof(service), "%u", port);
+
+    addrinfo* paddresses;
+    int result = getaddrinfo(host, service, &hints, &paddresses);
+    if(result != 0) {
+        if(result == EAI_SYSTEM)
+            throw std::system_error(errno, std::system_category());
+        throw std::system_error(EADDRNOTAVAIL, std::system_category(),
+            gai_strerror(result));
+    }
+    // Reconnects always go to the first address. Resolving the name again
+    // on every reconnect would mean blocking on DNS in the helper thread.
+    address_.assign(reinterpret_cast<char const*>(paddresses->ai_addr),
+        paddresses->ai_addrlen);
+    address_family_ = paddresses->ai_family;
+    freeaddrinfo(paddresses);
+
+    spool_fd_ = open(spool_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+        S_IRUSR | S_IWUSR);
+    if(spool_fd_ == -1)
+        throw std::system_error(errno, std::system_category());
+
+    thread_ = std::thread(&tcp_writer::run, this);
+}
+
+tcp_writer::~tcp_writer()
+{
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        shutdown_ = true;
+    }
+    spool_changed_.notify_all();
+    thread_.join();
+    if(socket_fd_ != -1)
+        close_fd(socket_fd_);
+    close_fd(spool_fd_);
+}
+
+tcp_writer::tcp_statistics tcp_writer::statistics() const
+{
+    std::lock_guard<std::mutex> lk(mutex_);
+    tcp_statistics s = statistics_;
+    s.spool_size = spool_used();
+    s.connected = socket_fd_ != -1;
+    return s;
+}
+
+std::size_t tcp_writer::write(void const* pbuffer, std::size_t count,
+    std::error_code& ec) noexcept
+{
+    char const* p = static_cast<char const*>(pbuffer);
+    std::size_t remaining = count;
+    std::lock_guard<std::mutex> lk(mutex_);
+
+    // Fresh data may only go straight to the socket if nothing is waiting in
+    // the spool, or it would overtake older data. When the spool is empty the
+    // helper thread is not using the socket, so we can send from here.
+    if(socket_fd_ != -1 && spool_used() == 0) {
+        while(remaining != 0) {
+            ssize_t sent = send(socket_fd_, p, remaining,
+                MSG_DONTWAIT | MSG_NOSIGNAL);
+            if(sent == -1) {
+                if(errno == EINTR)
+                    continue;
+                if(errno != EAGAIN && errno != EWOULDBLOCK)
+                    disconnect();
+                break;
+            }
+            p += sent;
+            remaining -= sent;
+            statistics_.sent_bytes += sent;
+        }
+    }
+
+    if(remaining != 0) {
+        std::size_t spooled = append_to_spool(p, remaining);
+        remaining -= spooled;
+        spool_changed_.notify_all();
+    }
+
+    if(remaining != 0)
+        ec.assign(writer::temporary_failure, writer::error_category());
+    else
+        ec.clear();
+    return count - remaining;
+}
+
+// Must be called with mutex_ held. Only write() appends to the spool and only
+// the helper thread reads from it, and they always touch disjoint regions of
+// the file, so the helper thread does not need to hold the lock while reading.
+std::size_t tcp_writer::append_to_spool(char const* pdata, std::size_t count)
+{
+    count = std::min(count, spool_capacity_ - spool_used());
+    std::size_t appended = 0;
+    while(appended != count) {
+        std::size_t offset = static_cast<std::size_t>(
+            (spool_write_position_ + appended) % spool_capacity_);
+        std::size_t n = std::min(count - appended, spool_capacity_ - offset);
+        ssize_t written = pwrite(spool_fd_, pdata + appended, n, offset);
+        if(written == -1) {
+            if(errno == EINTR)
+                continue;
+            // Most likely the disk is full. Report what we managed to
+            // append and let the log retry the rest later.
+            break;
+        }
+        appended += written;
+    }
+    spool_write_position_ += appended;
+    statistics_.spooled_bytes += appended;
+    return appended;
+}
+
+// Must be called with mutex_ held.
+void tcp_writer::disconnect()
+{
+    if(socket_fd_ != -1) {
+        close_fd(socket_fd_);
+        socket_fd_ = -1;
+    }
+    spool_changed_.notify_all();
+}
+
+// Returns a connected socket, or -1 if the connection attempt failed or timed
+// out.
+int tcp_writer::connect_to_peer()
+{
+    int fd = socket(address_family_, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1)
+        return -1;
+    auto paddress = reinterpret_cast<sockaddr const*>(address_.data());
+    int result = connect(fd, paddress, static_cast<socklen_t>(address_.size()));
+    if(result == -1 && errno == EINPROGRESS) {
+        if(wait_writable(fd, NETWORK_TIMEOUT_MS)) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            result = error == 0? 0 : -1;
+        }
+    }
+    if(result == -1) {
+        close_fd(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send up to count bytes from the head of the spool on the given socket.
+// Called by the helper thread without holding the lock. Returns the number of
+// bytes sent; error is set if the connection should be considered broken.
+std::size_t tcp_writer::send_from_spool(int fd, std::uint64_t position,
+    std::size_t count, bool& error)
+{
+    char buffer[SPOOL_CHUNK_SIZE];
+    count = std::min(count, sizeof(buffer));
+    std::size_t offset = static_cast<std::size_t>(position % spool_capacity_);
+    count = std::min(count, spool_capacity_ - offset);
+
+    std::size_t read = 0;
+    while(read != count) {
+        ssize_t n = pread(spool_fd_, buffer + read, count - read, offset + read);
+        if(n == -1 && errno == EINTR)
+            continue;
+        if(n <= 0) {
+            // We can't make sense of the spool anymore; don't send garbage.
+            error = true;
+            return 0;
+        }
+        read += n;
+    }
+
+    std::size_t sent = 0;
+    error = false;
+    while(sent != count) {
+        ssize_t n = send(fd, buffer + sent, count - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(n == -1) {
+            if(errno == EINTR)
+                continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                error = true;
+                break;
+            }
+            // A peer that is slow is not an error, but if we are shutting
+            // down we don't wait for it indefinitely.
+            if(!wait_writable(fd, NETWORK_TIMEOUT_MS) && shutdown_)
+                break;
+            continue;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+void tcp_writer::run()
+{
+    detail::set_thread_name("reckless tcp");
+    unsigned retry_time_ms = 0;
+    std::unique_lock<std::mutex> lk(mutex_);
+    while(true) {
+        if(socket_fd_ == -1) {
+            if(shutdown_)
+                return;     // Nowhere to send what's left in the spool.
+            lk.unlock();
+            int fd = connect_to_peer();
+            lk.lock();
+            if(fd == -1) {
+                ++statistics_.connect_failures;
+                // Back off like output_buffer does in error_policy::block
+                // mode, but wake up immediately on shutdown.
+                spool_changed_.wait_for(lk,
+                    std::chrono::milliseconds(retry_time_ms),
+                    [this] { return shutdown_.load(); });
+                retry_time_ms += std::max(1u, retry_time_ms/4);
+                retry_time_ms = std::min(retry_time_ms, 1000u);
+            } else {
+                ++statistics_.connects;
+                retry_time_ms = 0;
+                socket_fd_ = fd;
+            }
+            continue;
+        }
+
+        if(spool_used() == 0) {
+            if(shutdown_)
+                return;
+            // The file is empty, so give the disk space back.
+            if(spool_write_position_ != 0) {
+                spool_read_position_ = spool_write_position_ = 0;
+                while(-1 == ftruncate(spool_fd_, 0) && errno == EINTR) {
+                }
+            }
+            spool_changed_.wait(lk);
+            continue;
+        }
+
+        int fd = socket_fd_;
+        std::uint64_t position = spool_read_position_;
+        std::size_t count = spool_used();
+        lk.unlock();
+        bool error;
+        std::size_t sent = send_from_spool(fd, position, count, error);
+        lk.lock();
+        spool_read_position_ += sent;
+        statistics_.sent_bytes += sent;
+        if(error)
+            disconnect();
+        else if(sent == 0 && shutdown_)
+            return;     // The peer stopped accepting data.
+    }
+}
+
+}   // namespace reckless
@@ -0,0 +1,261 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/tee_writer.hpp>
+#include <reckless/detail/platform.hpp> // set_thread_name
+
+#include <algorithm>    // min, max
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>      // memcpy
+#include <mutex>
+#include <thread>
+
+namespace reckless {
+
+// A bounded byte queue that is filled by tee_writer::write() and drained to
+// the child writer by a helper thread. Positions are 64-bit counters that
+// never wrap, just like in mpsc_ring_buffer, and the physical offset is
+// obtained modulo the capacity.
+class tee_writer::sink {
+public:
+    sink(writer* pwriter, std::size_t capacity, error_policy policy) :
+        pwriter_(pwriter),
+        policy_(policy),
+        buffer_(new char[capacity]),
+        capacity_(capacity),
+        statistics_()
+    {
+        thread_ = std::thread(&sink::run, this);
+    }
+
+    ~sink()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex_);
+            shutdown_ = true;
+        }
+        data_available_.notify_one();
+        thread_.join();
+    }
+
+    void push(char const* pdata, std::size_t count)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        if(statistics_.failed) {
+            discard(count);
+            return;
+        }
+
+        if(policy_ != error_policy::block) {
+            if(count > capacity_ - used()) {
+                discard(count);
+                return;
+            }
+            copy_in(pdata, count);
+            data_available_.notify_one();
+            return;
+        }
+
+        // In blocking mode we hand over the data in pieces as space becomes
+        // available, so that a single write larger than the sink buffer still
+        // gets through.
+        bool delayed = false;
+        std::chrono::steady_clock::time_point wait_start;
+        while(count != 0) {
+            std::size_t available = capacity_ - used();
+            if(available == 0) {
+                if(!delayed) {
+                    delayed = true;
+                    wait_start = std::chrono::steady_clock::now();
+                    ++statistics_.delayed_writes;
+                }
+                space_available_.wait(lk);
+                if(statistics_.failed) {
+                    discard(count);
+                    break;
+                }
+                continue;
+            }
+            std::size_t n = std::min(available, count);
+            copy_in(pdata, n);
+            data_available_.notify_one();
+            pdata += n;
+            count -= n;
+        }
+        if(delayed) {
+            auto waited = std::chrono::steady_clock::now() - wait_start;
+            statistics_.delay_microseconds += std::chrono::duration_cast<
+                std::chrono::microseconds>(waited).count();
+        }
+    }
+
+    void drain()
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        while(used() != 0 && !statistics_.failed)
+            space_available_.wait(lk);
+    }
+
+    sink_statistics statistics() const
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return statistics_;
+    }
+
+private:
+    std::size_t used() const
+    {
+        return static_cast<std::size_t>(write_position_ - read_position_);
+    }
+
+    void discard(std::size_t count)
+    {
+        statistics_.dropped_bytes += count;
+        ++statistics_.dropped_writes;
+    }
+
+    void copy_in(char const* pdata, std::size_t count)
+    {
+        std::size_t offset = static_cast<std::size_t>(write_position_ % capacity_);
+        std::size_t first = std::min(count, capacity_ - offset);
+        std::memcpy(buffer_.get() + offset, pdata, first);
+        std::memcpy(buffer_.get(), pdata + first, count - first);
+        write_position_ += count;
+    }
+
+    void run()
+    {
+        detail::set_thread_name("reckless tee sink");
+        unsigned retry_time_ms = 0;
+        std::unique_lock<std::mutex> lk(mutex_);
+        while(true) {
+            while(used() == 0 && !shutdown_)
+                data_available_.wait(lk);
+            if(used() == 0)
+                return;     // Shutdown requested and everything is written.
+
+            // Write the contiguous part of the buffered data. The producer
+            // never touches this region until read_position_ moves past it,
+            // so we don't need to hold the lock while writing.
+            std::size_t offset = static_cast<std::size_t>(read_position_ % capacity_);
+            std::size_t count = std::min(used(), capacity_ - offset);
+            lk.unlock();
+
+            std::error_code error;
+            std::size_t written;
+            try {
+                written = pwriter_->write(buffer_.get() + offset, count, error);
+            } catch(...) {
+                // Same reasoning as in output_buffer::flush(); a throwing
+                // writer leaves us not knowing what was written.
+                error.assign(writer::permanent_failure, writer::error_category());
+                written = 0;
+            }
+            assert(written <= count);
+
+            lk.lock();
+            read_position_ += written;
+            statistics_.written_bytes += written;
+            if(!error) {
+                retry_time_ms = 0;
+            } else if(error == writer::temporary_failure) {
+                ++statistics_.temporary_errors;
+                if(shutdown_) {
+                    // Don't hold up destruction of the tee_writer waiting for
+                    // a writer that might never recover.
+                    statistics_.dropped_bytes += used();
+                    read_position_ = write_position_;
+                } else {
+                    // Poll the writer with an increasing interval, like
+                    // output_buffer does in error_policy::block mode. New
+                    // data arriving is no reason to retry sooner, but a
+                    // shutdown request is.
+                    data_available_.wait_for(lk,
+                        std::chrono::milliseconds(retry_time_ms),
+                        [this] { return shutdown_; });
+                    retry_time_ms += std::max(1u, retry_time_ms/4);
+                    retry_time_ms = std::min(retry_time_ms, 1000u);
+                }
+            } else {
+                statistics_.failed = true;
+                statistics_.dropped_bytes += used();
+                read_position_ = write_position_;
+            }
+            space_available_.notify_all();
+        }
+    }
+
+    writer* const pwriter_;
+    error_policy const policy_;
+    std::unique_ptr<char[]> const buffer_;
+    std::size_t const capacity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable data_available_;
+    std::condition_variable space_available_;
+    std::uint64_t read_position_ = 0;   // access synchronized by mutex_
+    std::uint64_t write_position_ = 0;  // access synchronized by mutex_
+    bool shutdown_ = false;             // access synchronized by mutex_
+    sink_statistics statistics_;        // access synchronized by mutex_
+    std::thread thread_;
+};
+
+tee_writer::tee_writer()
+{
+}
+
+tee_writer::~tee_writer()
+{
+}
+
+void tee_writer::add_sink(writer* pwriter, std::size_t buffer_capacity,
+    error_policy full_buffer_policy)
+{
+    assert(buffer_capacity != 0);
+    assert(full_buffer_policy == error_policy::block
+        || full_buffer_policy == error_policy::ignore);
+    sinks_.emplace_back(new sink(pwriter, buffer_capacity, full_buffer_policy));
+}
+
+tee_writer::sink_statistics tee_writer::statistics(std::size_t sink_index) const
+{
+    return sinks_[sink_index]->statistics();
+}
+
+void tee_writer::drain()
+{
+    for(auto& psink : sinks_)
+        psink->drain();
+}
+
+std::size_t tee_writer::write(void const* pbuffer, std::size_t count,
+    std::error_code& ec) noexcept
+{
+    auto pdata = static_cast<char const*>(pbuffer);
+    for(auto& psink : sinks_)
+        psink->push(pdata, count);
+    ec.clear();
+    return count;
+}
+
+}   // namespace reckless
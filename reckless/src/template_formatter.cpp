@@ -21,13 +21,40 @@
  */
 #include <reckless/template_formatter.hpp>
 #include <reckless/ntoa.hpp>
+#include <reckless/detail/utf8.hpp>
+#include <reckless/detail/platform.hpp> // RECKLESS_TLS, likely
 
 #include <cstdio>
 #include <cstring>
 #include <cstdint>
+#include <limits>
+#include <atomic>
+#include <vector>
+
+#if defined(__linux__) && !defined(RECKLESS_DISABLE_FORMAT_CACHE)
+#include <link.h>       // dl_iterate_phdr
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RECKLESS_HAVE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// GCC and clang can compile the AVX2 version without -mavx2 by using the
+// target attribute, so we only need to check for support at run time.
+#define RECKLESS_HAVE_AVX2
+#include <immintrin.h>
+#define RECKLESS_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#define RECKLESS_HAVE_AVX2
+#include <immintrin.h>
+#include <intrin.h>     // __cpuid, _xgetbv
+#define RECKLESS_TARGET_AVX2
+#endif
+#endif
 
 namespace reckless {
 namespace {
+    using detail::likely;
 
     unsigned atou(char const*& s)
     {
@@ -52,7 +79,7 @@ namespace {
     // TODO for people writing custom format functions, it would be nice to
     // have access to this. Also being able to just skip past the conversion
     // specification so they can check the format character.
-    char const* parse_conversion_specification(conversion_specification* pspec, char const* pformat)
+    char const* parse_conversion_specification_uncached(conversion_specification* pspec, char const* pformat)
     {
         bool left_justify = false;
         bool alternative_form = false;
@@ -98,6 +125,166 @@ namespace {
         return pformat;
     }
         
+#ifndef RECKLESS_DISABLE_FORMAT_CACHE
+    // Format strings are nearly always string literals, so the same pointers
+    // come back to the formatter over and over again. To avoid scanning for
+    // '%' and parsing the same conversion specifications for every record,
+    // we remember the outcome in a small table per formatting thread (i.e.
+    // per log worker), keyed by the format pointer. Tables are direct-mapped
+    // with a short linear probe, and a full probe window evicts the entry in
+    // the home slot. Define RECKLESS_DISABLE_FORMAT_CACHE to always parse.
+    //
+    // The cache assumes that the characters at a given address never change,
+    // which only holds for memory that can't be written to. We therefore only
+    // add format strings that live in the read-only segments of the images
+    // that were loaded when the cache was first used. Anything else, such as
+    // format strings in heap or stack buffers, or in libraries loaded later,
+    // is parsed every time. Unloading a library while its format strings are
+    // still in use by a log is not supported. On platforms where we can't
+    // find the read-only segments nothing is cached.
+    unsigned const LITERAL_CACHE_BITS = 7;
+    unsigned const SPECIFICATION_CACHE_BITS = 6;
+    unsigned const CACHE_PROBE_LENGTH = 4;
+
+    enum class segment_end : unsigned char {
+        string_end,         // The literal text ends the format string.
+        specifier,          // The literal text is followed by a specifier.
+        escaped_percent     // The literal text is followed by "%%".
+    };
+
+    // These need to be trivially constructible to live in RECKLESS_TLS
+    // storage, which is why the conversion_specification is kept as bytes.
+    struct literal_cache_entry {
+        char const* pformat;
+        std::uint32_t length;
+        segment_end end;
+    };
+
+    struct specification_cache_entry {
+        char const* pformat;
+        std::uint32_t length;
+        char spec[sizeof(conversion_specification)];
+    };
+
+    RECKLESS_TLS literal_cache_entry g_literal_cache[1u << LITERAL_CACHE_BITS];
+    RECKLESS_TLS specification_cache_entry g_specification_cache[1u << SPECIFICATION_CACHE_BITS];
+
+    // Returns the entry for pformat if there is one. Otherwise returns the
+    // slot that a new entry for pformat should go in, with its pformat
+    // member not equal to the key.
+    template <class Entry, std::size_t Size>
+    Entry* find_cache_entry(Entry (&table)[Size], char const* pformat)
+    {
+        static_assert((Size & (Size-1)) == 0, "cache size must be a power of two");
+        std::uint64_t hash = static_cast<std::uint64_t>(
+            reinterpret_cast<std::uintptr_t>(pformat))*0x9e3779b97f4a7c15ull;
+        std::size_t home = static_cast<std::size_t>(hash >> 40) & (Size-1);
+        for(unsigned i=0; i!=CACHE_PROBE_LENGTH; ++i) {
+            Entry* pentry = &table[(home + i) & (Size-1)];
+            if(pentry->pformat == pformat || pentry->pformat == nullptr)
+                return pentry;
+        }
+        return &table[home];
+    }
+
+    struct address_range {
+        std::uintptr_t begin;
+        std::uintptr_t end;
+    };
+
+#if defined(__linux__)
+    int add_read_only_segments(dl_phdr_info* pinfo, std::size_t, void* pdata)
+    {
+        auto pranges = static_cast<std::vector<address_range>*>(pdata);
+        for(ElfW(Half) i=0; i!=pinfo->dlpi_phnum; ++i) {
+            ElfW(Phdr) const& phdr = pinfo->dlpi_phdr[i];
+            if(phdr.p_type != PT_LOAD || (phdr.p_flags & PF_W) != 0)
+                continue;
+            std::uintptr_t begin = pinfo->dlpi_addr + phdr.p_vaddr;
+            pranges->push_back(address_range{begin, begin + phdr.p_memsz});
+        }
+        return 0;
+    }
+
+    std::vector<address_range> find_read_only_segments()
+    {
+        std::vector<address_range> ranges;
+        dl_iterate_phdr(&add_read_only_segments, &ranges);
+        return ranges;
+    }
+#else
+    std::vector<address_range> find_read_only_segments()
+    {
+        return std::vector<address_range>();
+    }
+#endif
+
+    // Only called when adding an entry, so that a cache hit implies that the
+    // format string is read-only and the hit path needs no further checks.
+    bool is_cacheable(char const* pformat)
+    {
+        static std::vector<address_range> const ranges = find_read_only_segments();
+        auto address = reinterpret_cast<std::uintptr_t>(pformat);
+        for(address_range const& range : ranges) {
+            if(address >= range.begin && address < range.end)
+                return true;
+        }
+        return false;
+    }
+
+    std::size_t scan_literal(char const* pformat, segment_end* pend)
+    {
+        char const* p = detail::find_specifier(pformat);
+        if(*p == '\0')
+            *pend = segment_end::string_end;
+        else if(p[1] == '%')
+            *pend = segment_end::escaped_percent;
+        else
+            *pend = segment_end::specifier;
+        return p - pformat;
+    }
+
+    std::size_t find_literal(char const* pformat, segment_end* pend)
+    {
+        literal_cache_entry* pentry = find_cache_entry(g_literal_cache, pformat);
+        if(likely(pentry->pformat == pformat)) {
+            *pend = pentry->end;
+            return pentry->length;
+        }
+
+        std::size_t length = scan_literal(pformat, pend);
+        if(length <= std::numeric_limits<std::uint32_t>::max()
+                && is_cacheable(pformat)) {
+            pentry->pformat = pformat;
+            pentry->length = static_cast<std::uint32_t>(length);
+            pentry->end = *pend;
+        }
+        return length;
+    }
+
+    char const* parse_conversion_specification(conversion_specification* pspec, char const* pformat)
+    {
+        specification_cache_entry* pentry = find_cache_entry(g_specification_cache, pformat);
+        if(likely(pentry->pformat == pformat)) {
+            std::memcpy(pspec, pentry->spec, sizeof(conversion_specification));
+            return pformat + pentry->length;
+        }
+
+        char const* pend = parse_conversion_specification_uncached(pspec, pformat);
+        if(!is_cacheable(pformat))
+            return pend;
+        pentry->pformat = pformat;
+        pentry->length = static_cast<std::uint32_t>(pend - pformat);
+        std::memcpy(pentry->spec, pspec, sizeof(conversion_specification));
+        return pend;
+    }
+#else
+    char const* parse_conversion_specification(conversion_specification* pspec, char const* pformat)
+    {
+        return parse_conversion_specification_uncached(pspec, pformat);
+    }
+#endif  // RECKLESS_DISABLE_FORMAT_CACHE
+
     template <typename T>
     char const* generic_format_int(output_buffer* pbuffer, char const* pformat, T v)
     {
@@ -129,10 +316,15 @@ namespace {
         conversion_specification cs;
         pformat = parse_conversion_specification(&cs, pformat);
         char f = *pformat;
-        if(f != 'f')
+        cs.uppercase = f == 'F' || f == 'E' || f == 'G';
+        if(f == 'f' || f == 'F')
+            ftoa_base10_f(pbuffer, static_cast<double>(v), cs);
+        else if(f == 'e' || f == 'E')
+            ftoa_base10_e(pbuffer, static_cast<double>(v), cs);
+        else if(f == 'g' || f == 'G')
+            ftoa_base10_g(pbuffer, static_cast<double>(v), cs);
+        else
             return nullptr;
-        
-        ftoa_base10_f(pbuffer, static_cast<double>(v), cs);
         return pformat + 1;
     }
 
@@ -140,7 +332,7 @@ namespace {
     char const* generic_format_char(output_buffer* pbuffer, char const* pformat, T v)
     {
         char f = *pformat;
-        if(f == 's') {
+        if(f == 's' || f == 'c') {
             char* p = pbuffer->reserve(1);
             *p = static_cast<char>(v);
             pbuffer->commit(1);
@@ -150,6 +342,30 @@ namespace {
         }
     }
 
+    template <typename T>
+    char const* generic_format_wide_char(output_buffer* pbuffer,
+            char const* pformat, T v)
+    {
+        char f = *pformat;
+        if(f == 's' || f == 'c') {
+            detail::write_utf8(pbuffer, &v, 1);
+            return pformat + 1;
+        } else {
+            return generic_format_int(pbuffer, pformat,
+                    static_cast<std::uint32_t>(v));
+        }
+    }
+
+    template <typename T>
+    char const* generic_format_wide_string(output_buffer* pbuffer,
+            char const* pformat, T const* s, std::size_t size)
+    {
+        if(*pformat != 's')
+            return nullptr;
+        detail::write_utf8(pbuffer, s, size);
+        return pformat + 1;
+    }
+
 }   // anonymous namespace
 
 char const* format(output_buffer* pbuffer, char const* pformat, char v)
@@ -167,9 +383,20 @@ char const* format(output_buffer* pbuffer, char const* pformat, unsigned char v)
     return generic_format_char(pbuffer, pformat, v);
 }
 
-//char const* format(output_buffer* pbuffer, char const* pformat, wchar_t v);
-//char const* format(output_buffer* pbuffer, char const* pformat, char16_t v);
-//char const* format(output_buffer* pbuffer, char const* pformat, char32_t v);
+char const* format(output_buffer* pbuffer, char const* pformat, wchar_t v)
+{
+    return generic_format_wide_char(pbuffer, pformat, v);
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, char16_t v)
+{
+    return generic_format_wide_char(pbuffer, pformat, v);
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, char32_t v)
+{
+    return generic_format_wide_char(pbuffer, pformat, v);
+}
 
 char const* format(output_buffer* pbuffer, char const* pformat, short v)
 {
@@ -262,6 +489,45 @@ char const* format(output_buffer* pbuffer, char const* pformat, std::string cons
     return pformat + 1;
 }
 
+char const* format(output_buffer* pbuffer, char const* pformat, wchar_t const* v)
+{
+    if(*pformat == 'p')
+        return format(pbuffer, pformat, static_cast<void const*>(v));
+    return generic_format_wide_string(pbuffer, pformat, v,
+            std::char_traits<wchar_t>::length(v));
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, char16_t const* v)
+{
+    if(*pformat == 'p')
+        return format(pbuffer, pformat, static_cast<void const*>(v));
+    return generic_format_wide_string(pbuffer, pformat, v,
+            std::char_traits<char16_t>::length(v));
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, char32_t const* v)
+{
+    if(*pformat == 'p')
+        return format(pbuffer, pformat, static_cast<void const*>(v));
+    return generic_format_wide_string(pbuffer, pformat, v,
+            std::char_traits<char32_t>::length(v));
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, std::wstring const& v)
+{
+    return generic_format_wide_string(pbuffer, pformat, v.data(), v.size());
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, std::u16string const& v)
+{
+    return generic_format_wide_string(pbuffer, pformat, v.data(), v.size());
+}
+
+char const* format(output_buffer* pbuffer, char const* pformat, std::u32string const& v)
+{
+    return generic_format_wide_string(pbuffer, pformat, v.data(), v.size());
+}
+
 char const* format(output_buffer* pbuffer, char const* pformat, void const* p)
 {
     char c = *pformat;
@@ -281,6 +547,123 @@ char const* format(output_buffer* pbuffer, char const* pformat, void const* p)
     return pformat+1;
 }
 
+namespace detail {
+namespace {
+    char const* find_specifier_generic(char const* s)
+    {
+        char c = *s;
+        while(c != '%' && c != '\0')
+            c = *(++s);
+        return s;
+    }
+
+#ifdef RECKLESS_HAVE_SSE2
+    unsigned count_trailing_zeroes(unsigned v)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(v);
+#else
+        unsigned long index;
+        _BitScanForward(&index, v);
+        return index;
+#endif
+    }
+
+    // The vector versions only use aligned loads. An aligned block never
+    // straddles a page boundary, so even though we may read past the end of
+    // the string (or before its start, in the first block) we never touch a
+    // page that the string isn't on. Matches before the start of the string
+    // are masked off.
+    char const* find_specifier_sse2(char const* s)
+    {
+        __m128i const percent = _mm_set1_epi8('%');
+        __m128i const zero = _mm_setzero_si128();
+        unsigned misalignment = reinterpret_cast<std::uintptr_t>(s) & 15;
+        __m128i const* p = reinterpret_cast<__m128i const*>(s - misalignment);
+        __m128i v = _mm_load_si128(p);
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, zero))));
+        mask &= ~0u << misalignment;
+        while(mask == 0) {
+            v = _mm_load_si128(++p);
+            mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(
+                _mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, zero))));
+        }
+        return reinterpret_cast<char const*>(p) + count_trailing_zeroes(mask);
+    }
+#endif  // RECKLESS_HAVE_SSE2
+
+#ifdef RECKLESS_HAVE_AVX2
+    RECKLESS_TARGET_AVX2
+    char const* find_specifier_avx2(char const* s)
+    {
+        __m256i const percent = _mm256_set1_epi8('%');
+        __m256i const zero = _mm256_setzero_si256();
+        unsigned misalignment = reinterpret_cast<std::uintptr_t>(s) & 31;
+        __m256i const* p = reinterpret_cast<__m256i const*>(s - misalignment);
+        __m256i v = _mm256_load_si256(p);
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, percent), _mm256_cmpeq_epi8(v, zero))));
+        mask &= ~0u << misalignment;
+        while(mask == 0) {
+            v = _mm256_load_si256(++p);
+            mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(
+                _mm256_cmpeq_epi8(v, percent), _mm256_cmpeq_epi8(v, zero))));
+        }
+        return reinterpret_cast<char const*>(p) + count_trailing_zeroes(mask);
+    }
+
+    bool cpu_has_avx2()
+    {
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#else
+        int info[4];
+        __cpuid(info, 0);
+        if(info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        // The OS must save the YMM registers on context switches.
+        if(!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#endif
+    }
+#endif  // RECKLESS_HAVE_AVX2
+
+    typedef char const* (*find_specifier_function)(char const*);
+    char const* find_specifier_resolve(char const* s);
+
+    // Starts out pointing at the resolver, which picks the best version for
+    // the CPU on the first call. This way it works even when formatting
+    // happens before static initialization of this translation unit.
+    std::atomic<find_specifier_function> g_find_specifier(&find_specifier_resolve);
+
+    char const* find_specifier_resolve(char const* s)
+    {
+        find_specifier_function f = &find_specifier_generic;
+#ifdef RECKLESS_HAVE_SSE2
+        f = &find_specifier_sse2;
+#endif
+#ifdef RECKLESS_HAVE_AVX2
+        if(cpu_has_avx2())
+            f = &find_specifier_avx2;
+#endif
+        g_find_specifier.store(f, std::memory_order_relaxed);
+        return f(s);
+    }
+}   // anonymous namespace
+
+char const* find_specifier(char const* s)
+{
+    return g_find_specifier.load(std::memory_order_relaxed)(s);
+}
+}   // namespace detail
+
 void template_formatter::append_percent(output_buffer* pbuffer)
 {
     auto p = pbuffer->reserve(1u);
@@ -291,11 +674,28 @@ void template_formatter::append_percent(output_buffer* pbuffer)
 char const* template_formatter::next_specifier(output_buffer* pbuffer,
         char const* pformat)
 {
+#ifndef RECKLESS_DISABLE_FORMAT_CACHE
     while(true) {
-        char const* pspecifier = pformat;
-        char c = *pspecifier;
-        while(c != '%' && c != '\0')
-            c = *(++pspecifier);
+        segment_end end;
+        auto len = find_literal(pformat, &end);
+        auto p = pbuffer->reserve(len);
+        std::memcpy(p, pformat, len);
+        pbuffer->commit(len);
+        if(end == segment_end::string_end)
+            return nullptr;
+
+        pformat += len + 1;
+
+        if(end == segment_end::specifier)
+            return pformat;
+
+        // Found "%%". Add a single '%' and continue.
+        ++pformat;
+        append_percent(pbuffer);
+    }
+#else
+    while(true) {
+        char const* pspecifier = detail::find_specifier(pformat);
 
         auto len = pspecifier - pformat;
         auto p = pbuffer->reserve(len);
@@ -313,6 +713,8 @@ char const* template_formatter::next_specifier(output_buffer* pbuffer,
         ++pformat;
         append_percent(pbuffer);
     }
+#endif
+
 }
 
 void template_formatter::format(output_buffer* pbuffer, char const* pformat)
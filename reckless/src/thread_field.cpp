@@ -0,0 +1,163 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/thread_field.hpp>
+#include <reckless/source_location.hpp>
+#include <reckless/output_buffer.hpp>
+#include <reckless/ntoa.hpp>    // itoa_base10
+
+#include <algorithm>    // min
+#include <cstring>  // strrchr, memcpy
+#include <mutex>
+#include <set>
+#include <string>   // to_string
+
+#if defined(__linux__)
+#include <pthread.h>        // pthread_getname_np, pthread_atfork
+#include <sys/syscall.h>    // SYS_gettid
+#include <unistd.h>         // syscall
+#elif defined(__APPLE__)
+#include <pthread.h>        // pthread_threadid_np, pthread_getname_np, pthread_atfork
+#elif defined(__unix__)
+#include <pthread.h>        // pthread_self, pthread_atfork
+#elif defined(_WIN32)
+#include <Windows.h>        // GetCurrentThreadId
+#endif
+
+namespace reckless {
+namespace detail {
+
+RECKLESS_TLS std::uint64_t thread_id;
+RECKLESS_TLS char os_thread_name[THREAD_NAME_SIZE];
+RECKLESS_TLS char const* log_thread_name;
+
+namespace {
+    // Names given with set_log_thread_name(). They are never removed, since
+    // records may refer to them after the thread is gone. std::set doesn't
+    // move its elements, so the pointers stay valid.
+    std::mutex log_thread_names_mutex;
+    std::set<std::string> log_thread_names;
+
+    char const* intern_name(char const* name)
+    {
+        std::lock_guard<std::mutex> lk(log_thread_names_mutex);
+        return log_thread_names.insert(name).first->c_str();
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // The thread that calls fork() is the only thread in the child, and it
+    // has a different id there, so it has to look everything up again.
+    void clear_thread_cache()
+    {
+        thread_id = 0;
+        os_thread_name[0] = '\0';
+    }
+#endif
+
+    // Called before anything is put in the cache.
+    void register_fork_handler()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        static int const result = pthread_atfork(nullptr, nullptr,
+            &clear_thread_cache);
+        (void)result;
+#endif
+    }
+}
+
+std::uint64_t lookup_thread_id()
+{
+#if defined(__linux__)
+    std::uint64_t id = static_cast<std::uint64_t>(syscall(SYS_gettid));
+#elif defined(__APPLE__)
+    std::uint64_t id;
+    pthread_threadid_np(nullptr, &id);
+#elif defined(__unix__)
+    std::uint64_t id = reinterpret_cast<std::uintptr_t>(pthread_self());
+#elif defined(_WIN32)
+    std::uint64_t id = GetCurrentThreadId();
+#else
+    static_assert(false, "lookup_thread_id is not implemented for this OS");
+#endif
+    register_fork_handler();
+    thread_id = id;
+    return id;
+}
+
+void lookup_os_thread_name()
+{
+    char name[THREAD_NAME_SIZE] = {0};
+#if defined(__linux__) || defined(__APPLE__)
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+#endif
+    register_fork_handler();
+    if(name[0] == '\0') {
+        std::string id = std::to_string(current_thread_id());
+        std::size_t size = std::min(id.size(), sizeof(name) - 1);
+        std::memcpy(name, id.data(), size);
+        name[size] = '\0';
+    }
+    std::memcpy(os_thread_name, name, sizeof(name));
+}
+
+}   // namespace detail
+
+void set_log_thread_name(char const* name)
+{
+    detail::log_thread_name = detail::intern_name(name);
+}
+
+void thread_id_field::format(output_buffer* pbuffer) const
+{
+    itoa_base10(pbuffer, static_cast<unsigned long long>(id_),
+        conversion_specification());
+}
+
+void thread_name_field::format(output_buffer* pbuffer) const
+{
+    pbuffer->write(plog_name_? plog_name_ : os_name_);
+}
+
+void source_location_field::format(output_buffer* pbuffer) const
+{
+    if(!plocation_) {
+        pbuffer->write('?');
+        return;
+    }
+
+    char const* file = plocation_->file;
+    char const* separator = std::strrchr(file, '/');
+#if defined(_WIN32)
+    char const* backslash = std::strrchr(file, '\\');
+    if(backslash && (!separator || backslash > separator))
+        separator = backslash;
+#endif
+    if(separator)
+        file = separator + 1;
+
+    pbuffer->write(file);
+    pbuffer->write(':');
+    itoa_base10(pbuffer, plocation_->line, conversion_specification());
+    pbuffer->write(':');
+    pbuffer->write(plocation_->function);
+}
+
+}   // namespace reckless
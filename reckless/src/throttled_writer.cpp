@@ -0,0 +1,155 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/throttled_writer.hpp>
+
+#include <algorithm>    // min
+#include <cassert>
+#include <cstring>      // memchr
+#include <thread>
+
+namespace reckless {
+
+throttled_writer::throttled_writer(writer* pwriter,
+    std::uint64_t bytes_per_second, std::size_t burst_bytes,
+    error_policy excess_policy) :
+    pwriter_(pwriter),
+    bytes_per_second_(static_cast<double>(bytes_per_second)),
+    burst_bytes_(static_cast<double>(burst_bytes)),
+    excess_policy_(excess_policy),
+    tokens_(static_cast<double>(burst_bytes)),
+    last_refill_(clock::now()),
+    statistics_()
+{
+    assert(bytes_per_second != 0);
+    assert(burst_bytes != 0);
+    assert(excess_policy == error_policy::block
+        || excess_policy == error_policy::ignore);
+}
+
+throttled_writer::throttle_statistics throttled_writer::statistics() const
+{
+    std::lock_guard<std::mutex> lk(statistics_mutex_);
+    return statistics_;
+}
+
+void throttled_writer::refill()
+{
+    auto now = clock::now();
+    double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+    last_refill_ = now;
+    tokens_ = std::min(burst_bytes_, tokens_ + elapsed*bytes_per_second_);
+}
+
+std::size_t throttled_writer::forward(char const* p, std::size_t count,
+    std::error_code& ec)
+{
+    std::size_t written;
+    try {
+        written = pwriter_->write(p, count, ec);
+    } catch(...) {
+        // Same reasoning as in output_buffer::flush().
+        ec.assign(writer::permanent_failure, writer::error_category());
+        written = 0;
+    }
+    tokens_ -= written;
+    std::lock_guard<std::mutex> lk(statistics_mutex_);
+    statistics_.written_bytes += written;
+    return written;
+}
+
+std::size_t throttled_writer::write(void const* pbuffer, std::size_t count,
+    std::error_code& ec) noexcept
+{
+    char const* const pstart = static_cast<char const*>(pbuffer);
+    ec.clear();
+    refill();
+
+    if(excess_policy_ == error_policy::ignore) {
+        if(count <= tokens_)
+            return forward(pstart, count, ec);
+
+        // Pass on the complete lines that we have tokens for and shed the
+        // rest, so that the wrapped writer never sees a partial line.
+        std::size_t allowed = static_cast<std::size_t>(tokens_);
+        while(allowed != 0 && pstart[allowed-1] != '\n')
+            --allowed;
+        std::size_t written = 0;
+        if(allowed != 0) {
+            written = forward(pstart, allowed, ec);
+            if(ec)
+                return written;
+        }
+        std::lock_guard<std::mutex> lk(statistics_mutex_);
+        statistics_.shed_bytes += count - written;
+        ++statistics_.shed_writes;
+        return count;
+    }
+
+    // error_policy::block: pass the data on in pieces as the tokens arrive,
+    // cutting each piece after a newline so that the wrapped writer never
+    // sees a partial line. Each wait is for at most a bucket's worth of
+    // tokens, so that the data keeps flowing at the configured rate even
+    // when the write is larger than the burst size.
+    char const* p = pstart;
+    std::size_t remaining = count;
+    clock::duration delay(0);
+    while(remaining != 0) {
+        auto pnewline = static_cast<char const*>(
+            std::memchr(p, '\n', remaining));
+        std::size_t line = pnewline? pnewline - p + 1 : remaining;
+        double wanted = std::min(static_cast<double>(line), burst_bytes_);
+        if(tokens_ < wanted) {
+            auto wait = std::chrono::duration<double>(
+                (wanted - tokens_)/bytes_per_second_);
+            auto wait_start = clock::now();
+            std::this_thread::sleep_for(wait);
+            delay += clock::now() - wait_start;
+            refill();
+            continue;
+        }
+        std::size_t n;
+        if(line > tokens_) {
+            // The line is longer than the bucket. Let the tokens go negative
+            // to pass it on in one piece; the next wait makes up for it.
+            n = line;
+        } else {
+            n = std::min(remaining, static_cast<std::size_t>(tokens_));
+            while(n != remaining && p[n-1] != '\n')
+                --n;
+        }
+        std::size_t written = forward(p, n, ec);
+        p += written;
+        remaining -= written;
+        if(ec)
+            break;
+    }
+
+    if(delay != clock::duration(0)) {
+        std::lock_guard<std::mutex> lk(statistics_mutex_);
+        statistics_.delay_microseconds += std::chrono::duration_cast<
+            std::chrono::microseconds>(delay).count();
+        ++statistics_.delayed_writes;
+    }
+    return p - pstart;
+}
+
+}   // namespace reckless
@@ -0,0 +1,229 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/timestamp_format.hpp>
+#include <reckless/clock.hpp>           // realtime_clock
+#include <reckless/ntoa.hpp>            // decimal_digits
+#include <reckless/detail/platform.hpp> // RECKLESS_TLS, likely
+
+#include <cstring>  // memcpy
+#include <ctime>    // localtime_r, timegm
+
+namespace reckless {
+namespace detail {
+
+namespace {
+    std::uint64_t const SECONDS_PER_HOUR = 3600;
+    std::uint64_t const SECONDS_PER_DAY = 86400;
+    std::size_t const DATE_TIME_SIZE = 19;
+
+    std::uint32_t const POWERS_OF_TEN[10] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+        1000000000
+    };
+
+    std::uint64_t const g_start_time = realtime_clock::now();
+
+    // These need to be trivially constructible to live in RECKLESS_TLS
+    // storage, so an empty entry is marked by valid == false.
+    struct date_time_cache {
+        std::uint64_t second;
+        bool valid;
+        char text[DATE_TIME_SIZE];
+    };
+
+    struct utc_offset_cache {
+        std::uint64_t hour;
+        std::int32_t offset;
+        bool valid;
+    };
+
+    RECKLESS_TLS date_time_cache g_local_date_time;
+    RECKLESS_TLS date_time_cache g_utc_date_time;
+    RECKLESS_TLS utc_offset_cache g_utc_offset;
+
+    void write_digit_pair(char* p, unsigned value)
+    {
+        p[0] = decimal_digits[2*value];
+        p[1] = decimal_digits[2*value + 1];
+    }
+
+    std::int32_t lookup_utc_offset(std::uint64_t seconds)
+    {
+        std::time_t t = static_cast<std::time_t>(seconds);
+        struct tm tm;
+#if defined(_WIN32)
+        localtime_s(&tm, &t);
+        return static_cast<std::int32_t>(_mkgmtime(&tm) - t);
+#else
+        localtime_r(&t, &tm);
+        return static_cast<std::int32_t>(timegm(&tm) - t);
+#endif
+    }
+
+    // localtime_r() is slow and takes a lock in glibc, so we only call it
+    // when the hour changes. Time zones change their offset at the start of
+    // an hour, but as a precaution we don't cache an hour in which the
+    // offset changes.
+    std::int32_t utc_offset(std::uint64_t seconds)
+    {
+        std::uint64_t hour = seconds/SECONDS_PER_HOUR;
+        utc_offset_cache& cache = g_utc_offset;
+        if(likely(cache.valid && cache.hour == hour))
+            return cache.offset;
+
+        std::int32_t offset = lookup_utc_offset(hour*SECONDS_PER_HOUR);
+        if(offset == lookup_utc_offset(hour*SECONDS_PER_HOUR + SECONDS_PER_HOUR - 1)) {
+            cache.hour = hour;
+            cache.offset = offset;
+            cache.valid = true;
+            return offset;
+        } else {
+            cache.valid = false;
+            return lookup_utc_offset(seconds);
+        }
+    }
+
+    // Converts days since 1970-01-01 to a date in the proleptic Gregorian
+    // calendar. See Howard Hinnant, "chrono-Compatible Low-Level Date
+    // Algorithms".
+    void civil_from_days(std::int64_t days, unsigned* pyear, unsigned* pmonth,
+        unsigned* pday)
+    {
+        days += 719468;
+        std::int64_t era = (days >= 0? days : days - 146096)/146097;
+        unsigned day_of_era = static_cast<unsigned>(days - era*146097);
+        unsigned year_of_era = (day_of_era - day_of_era/1460 +
+            day_of_era/36524 - day_of_era/146096)/365;
+        unsigned day_of_year = day_of_era -
+            (365*year_of_era + year_of_era/4 - year_of_era/100);
+        unsigned mp = (5*day_of_year + 2)/153;
+        unsigned month = mp < 10? mp + 3 : mp - 9;
+        *pyear = static_cast<unsigned>(year_of_era + era*400 + (month <= 2));
+        *pmonth = month;
+        *pday = day_of_year - (153*mp + 2)/5 + 1;
+    }
+
+    void render_date_time(char* p, std::int64_t seconds)
+    {
+        std::int64_t days = seconds/static_cast<std::int64_t>(SECONDS_PER_DAY);
+        std::int64_t second_of_day = seconds - days*SECONDS_PER_DAY;
+        if(second_of_day < 0) {
+            second_of_day += SECONDS_PER_DAY;
+            days -= 1;
+        }
+        unsigned year, month, day;
+        civil_from_days(days, &year, &month, &day);
+        unsigned time = static_cast<unsigned>(second_of_day);
+
+        write_digit_pair(p, year/100%100);
+        write_digit_pair(p + 2, year%100);
+        p[4] = '-';
+        write_digit_pair(p + 5, month);
+        p[7] = '-';
+        write_digit_pair(p + 8, day);
+        p[10] = ' ';
+        write_digit_pair(p + 11, time/3600);
+        p[13] = ':';
+        write_digit_pair(p + 14, time/60%60);
+        p[16] = ':';
+        write_digit_pair(p + 17, time%60);
+    }
+}   // anonymous namespace
+
+char* write_date_time(char* p, std::uint64_t seconds, bool local,
+    char separator)
+{
+    date_time_cache& cache = local? g_local_date_time : g_utc_date_time;
+    if(unlikely(!cache.valid || cache.second != seconds)) {
+        std::int64_t adjusted = static_cast<std::int64_t>(seconds);
+        if(local)
+            adjusted += utc_offset(seconds);
+        render_date_time(cache.text, adjusted);
+        cache.second = seconds;
+        cache.valid = true;
+    }
+    std::memcpy(p, cache.text, DATE_TIME_SIZE);
+    p[10] = separator;
+    return p + DATE_TIME_SIZE;
+}
+
+char* write_utc_offset(char* p, std::uint64_t seconds)
+{
+    std::int32_t offset = utc_offset(seconds);
+    if(offset < 0) {
+        p[0] = '-';
+        offset = -offset;
+    } else {
+        p[0] = '+';
+    }
+    unsigned minutes = static_cast<unsigned>(offset)/60;
+    write_digit_pair(p + 1, minutes/60%100);
+    p[3] = ':';
+    write_digit_pair(p + 4, minutes%60);
+    return p + 6;
+}
+
+char* write_fraction(char* p, std::uint32_t nanoseconds, unsigned digits)
+{
+    if(digits == 0)
+        return p;
+    *p = '.';
+    std::uint32_t value = nanoseconds/POWERS_OF_TEN[9 - digits];
+    char* pend = p + 1 + digits;
+    char* q = pend;
+    while(q - p > 2) {
+        q -= 2;
+        write_digit_pair(q, value%100);
+        value /= 100;
+    }
+    if(q - p == 2)
+        q[-1] = decimal_digits[2*value + 1];
+    return pend;
+}
+
+char* write_decimal(char* p, std::uint64_t value)
+{
+    char digits[MAX_DECIMAL_SIZE];
+    char* q = digits + MAX_DECIMAL_SIZE;
+    while(value >= 100) {
+        q -= 2;
+        write_digit_pair(q, static_cast<unsigned>(value%100));
+        value /= 100;
+    }
+    if(value >= 10) {
+        q -= 2;
+        write_digit_pair(q, static_cast<unsigned>(value));
+    } else {
+        *--q = static_cast<char>('0' + value);
+    }
+    std::size_t size = digits + MAX_DECIMAL_SIZE - q;
+    std::memcpy(p, q, size);
+    return p + size;
+}
+
+std::uint64_t start_time()
+{
+    return g_start_time;
+}
+
+}   // namespace detail
+}   // namespace reckless
@@ -0,0 +1,204 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/detail/utf8.hpp>
+#include <reckless/output_buffer.hpp>
+
+#include <cstdint>
+#include <algorithm>    // min
+#include <type_traits>  // integral_constant
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RECKLESS_UTF8_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace reckless {
+namespace detail {
+namespace {
+
+// We transcode in chunks so that the space we reserve in the output buffer
+// for the worst case stays well below its capacity.
+std::size_t const CHUNK_SIZE = 1024;
+
+char32_t const REPLACEMENT_CHARACTER = 0xfffd;
+
+inline bool is_high_surrogate(char32_t c)
+{
+    return (c & 0xfffffc00) == 0xd800;
+}
+
+inline bool is_low_surrogate(char32_t c)
+{
+    return (c & 0xfffffc00) == 0xdc00;
+}
+
+inline char* encode(char* p, char32_t c)
+{
+    if(c < 0x80) {
+        *p++ = static_cast<char>(c);
+    } else if(c < 0x800) {
+        *p++ = static_cast<char>(0xc0 | (c >> 6));
+        *p++ = static_cast<char>(0x80 | (c & 0x3f));
+    } else if(c < 0x10000) {
+        *p++ = static_cast<char>(0xe0 | (c >> 12));
+        *p++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        *p++ = static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+        *p++ = static_cast<char>(0xf0 | (c >> 18));
+        *p++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+        *p++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        *p++ = static_cast<char>(0x80 | (c & 0x3f));
+    }
+    return p;
+}
+
+#if defined(RECKLESS_UTF8_SSE2)
+// Copy runs of ASCII characters eight code units at a time, narrowing them to
+// bytes. Stops at the first block that contains anything else.
+template <class Char>
+inline void copy_ascii(char*& p, Char const*& s, Char const* pend,
+        std::integral_constant<std::size_t, 2>)
+{
+    __m128i const non_ascii = _mm_set1_epi16(static_cast<short>(0xff80));
+    __m128i const zero = _mm_setzero_si128();
+    while(pend - s >= 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+        __m128i t = _mm_cmpeq_epi16(_mm_and_si128(v, non_ascii), zero);
+        if(_mm_movemask_epi8(t) != 0xffff)
+            break;
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(v, v));
+        p += 8;
+        s += 8;
+    }
+}
+
+template <class Char>
+inline void copy_ascii(char*& p, Char const*& s, Char const* pend,
+        std::integral_constant<std::size_t, 4>)
+{
+    __m128i const non_ascii = _mm_set1_epi32(static_cast<int>(0xffffff80));
+    __m128i const zero = _mm_setzero_si128();
+    while(pend - s >= 8) {
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + 4));
+        __m128i t = _mm_cmpeq_epi32(
+            _mm_and_si128(_mm_or_si128(v1, v2), non_ascii), zero);
+        if(_mm_movemask_epi8(t) != 0xffff)
+            break;
+        // All values are below 0x80, so the saturating packs are exact.
+        __m128i v = _mm_packs_epi32(v1, v2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(v, v));
+        p += 8;
+        s += 8;
+    }
+}
+#else
+template <class Char, std::size_t Size>
+inline void copy_ascii(char*&, Char const*&, Char const*,
+        std::integral_constant<std::size_t, Size>)
+{
+}
+#endif
+
+// Decode one code point from a UTF-16 string. The low half of a surrogate pair
+// is read even if it is past the end of the current chunk.
+template <class Char>
+inline char32_t decode(Char const*& s, Char const* pend,
+        std::integral_constant<std::size_t, 2>)
+{
+    char32_t c = static_cast<char16_t>(*s++);
+    if(c < 0xd800 || c > 0xdfff)
+        return c;
+    if(is_high_surrogate(c) && s != pend) {
+        char32_t c2 = static_cast<char16_t>(*s);
+        if(is_low_surrogate(c2)) {
+            ++s;
+            return 0x10000 + ((c - 0xd800) << 10) + (c2 - 0xdc00);
+        }
+    }
+    return REPLACEMENT_CHARACTER;
+}
+
+template <class Char>
+inline char32_t decode(Char const*& s, Char const*,
+        std::integral_constant<std::size_t, 4>)
+{
+    char32_t c = static_cast<char32_t>(*s++);
+    if(c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+        return REPLACEMENT_CHARACTER;
+    return c;
+}
+
+template <class Char>
+void generic_write_utf8(output_buffer* pbuffer, Char const* s,
+        std::size_t size)
+{
+    // A UTF-16 code unit gives at most three bytes of UTF-8 and a surrogate
+    // pair gives four. A UTF-32 code unit gives at most four bytes. The extra
+    // byte is for a surrogate pair that straddles the end of the chunk.
+    std::size_t const MAX_BYTES_PER_UNIT = sizeof(Char) == 2? 3 : 4;
+    using unit_size = std::integral_constant<std::size_t, sizeof(Char)>;
+
+    Char const* pend = s + size;
+    while(s != pend) {
+        std::size_t chunk_size = std::min(static_cast<std::size_t>(pend - s),
+                CHUNK_SIZE);
+        Char const* pchunk_end = s + chunk_size;
+        char* pstart = pbuffer->reserve(MAX_BYTES_PER_UNIT*chunk_size + 1);
+        char* p = pstart;
+        while(s < pchunk_end) {
+            copy_ascii(p, s, pchunk_end, unit_size());
+            // Stay on the scalar path until we're back to ASCII, so that
+            // text without any ASCII doesn't pay for a failed vector test
+            // on every code point.
+            while(s < pchunk_end) {
+                char32_t c = decode(s, pend, unit_size());
+                p = encode(p, c);
+                if(c < 0x80)
+                    break;
+            }
+        }
+        pbuffer->commit(p - pstart);
+    }
+}
+
+}   // anonymous namespace
+
+void write_utf8(output_buffer* pbuffer, char16_t const* s, std::size_t size)
+{
+    generic_write_utf8(pbuffer, s, size);
+}
+
+void write_utf8(output_buffer* pbuffer, char32_t const* s, std::size_t size)
+{
+    generic_write_utf8(pbuffer, s, size);
+}
+
+void write_utf8(output_buffer* pbuffer, wchar_t const* s, std::size_t size)
+{
+    static_assert(sizeof(wchar_t) == 2 || sizeof(wchar_t) == 4,
+        "wchar_t must be either UTF-16 or UTF-32");
+    generic_write_utf8(pbuffer, s, size);
+}
+
+}   // namespace detail
+}   // namespace reckless
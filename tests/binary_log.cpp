@@ -0,0 +1,157 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Writes the same records to a text log and a binary log, decodes the binary
+// log and checks that the text is identical apart from the timestamps. The
+// binary stream is fed to the decoder in small pieces to exercise records
+// that are split between calls. Also checks that a corrupt record leaves no
+// partial line in the output.
+#include "memory_writer.hpp"
+#include "eol.hpp"
+#include <reckless/binary_log.hpp>
+#include <reckless/policy_log.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+typedef reckless::policy_log<reckless::no_indent, ' ',
+    reckless::timestamp_field> text_log;
+
+int g_pointee;
+
+template <class Log>
+void write_records(Log& log, unsigned round)
+{
+    std::string name("binary");
+    log.write("plain text");
+    log.write("%d %u %x %X", -static_cast<int>(round), round, round, round);
+    log.write("%5d|%-5d|%05d|%+d", round, round, round, round);
+    log.write("%lld %llu", -1234567890123456789LL, 18446744073709551615ULL);
+    log.write("%hd %hu", static_cast<short>(-12), static_cast<unsigned short>(65535));
+    log.write("%c%c%c %d", 'a', static_cast<signed char>('b'),
+        static_cast<unsigned char>('c'), static_cast<signed char>(-5));
+    log.write("%.3f %g %e %f", 1.5, 0.1f, 12345.678, 3.0L);
+    log.write("%s and %s", "literal", name);
+    log.write("%p", &g_pointee);
+    log.write("100%% of %d%%", 100);
+    log.write("missing %d %s");
+    log.write("extra %d", 1, 2, "three");
+    log.write("mismatch %s", 42);
+    log.write("%d", true);
+    log.write("");
+}
+
+// Removes the timestamp at the start of each line.
+std::string strip_timestamps(std::string const& text)
+{
+    std::string result;
+    std::size_t pos = 0;
+    while(pos != text.size()) {
+        std::size_t end = text.find('\n', pos) + 1;
+        result.append(text, pos + 24, end - pos - 24);
+        pos = end;
+    }
+    return result;
+}
+
+bool test_corrupt_record()
+{
+    memory_writer<std::string> binary_writer;
+    memory_writer<std::string> next_binary_writer;
+    {
+        reckless::binary_log blog(&binary_writer);
+        blog.write("ok");
+        blog.write("%d %s", 7, "text");
+        reckless::binary_log next_blog(&next_binary_writer);
+        next_blog.write("next");
+    }
+    // Make the length of the string argument run past the end of the record,
+    // after the timestamp and the first argument have been formatted.
+    std::string binary = binary_writer.container;
+    std::size_t pos = binary.rfind("text");
+    binary.replace(pos - 4, 4, 4, '\xff');
+
+    memory_writer<std::string> decoded_writer;
+    reckless::binary_log_decoder decoder(&decoded_writer);
+    bool thrown = false;
+    try {
+        decoder.decode(binary.data(), binary.size());
+    } catch(reckless::decode_error const&) {
+        thrown = true;
+    }
+    // Decoding can go on with another stream, e.g. from the next file.
+    std::string const& next_binary = next_binary_writer.container;
+    decoder.decode(next_binary.data(), next_binary.size());
+    decoder.flush();
+    std::string const& decoded = decoded_writer.container;
+    bool ok = thrown && strip_timestamps(decoded) == eol("ok\nnext\n");
+    if(!ok)
+        std::cerr << "corrupt record: decoded \"" << decoded << '"' << std::endl;
+    return ok;
+}
+
+int main()
+{
+    unsigned const ROUNDS = 500;
+    memory_writer<std::string> text_writer;
+    memory_writer<std::string> binary_writer;
+    {
+        text_log tlog(&text_writer);
+        reckless::binary_log blog(&binary_writer);
+        for(unsigned i=0; i!=ROUNDS; ++i) {
+            write_records(tlog, i);
+            write_records(blog, i);
+        }
+        // Reopening starts a new stream with its own definitions.
+        blog.close();
+        blog.open(&binary_writer);
+        write_records(tlog, ROUNDS);
+        write_records(blog, ROUNDS);
+    }
+
+    memory_writer<std::string> decoded_writer;
+    reckless::binary_log_decoder decoder(&decoded_writer);
+    std::string const& binary = binary_writer.container;
+    std::string pending;
+    std::size_t pos = 0;
+    std::uint32_t rng = 1;
+    while(pos != binary.size()) {
+        rng = rng*1103515245 + 12345;
+        std::size_t n = std::min<std::size_t>((rng >> 16) % 64 + 1,
+            binary.size() - pos);
+        pending.append(binary, pos, n);
+        pos += n;
+        pending.erase(0, decoder.decode(pending.data(), pending.size()));
+    }
+    decoder.flush();
+
+    std::string const& decoded = decoded_writer.container;
+    bool ok = pending.empty()
+        && decoder.undefined_record_count() == 0
+        && strip_timestamps(decoded) == strip_timestamps(text_writer.container)
+        && decoded.size() == text_writer.container.size();
+    ok = test_corrupt_record() && ok;
+    std::cerr << "text " << text_writer.container.size() << " bytes, binary "
+        << binary.size() << " bytes" << std::endl;
+    std::cerr << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks the "{}"-style format strings of brace_log, both parsed at run time
+// and at compile time with RECKLESS_FORMAT.
+#include "memory_writer.hpp"
+#include <reckless/brace_log.hpp>
+
+#include <iostream>
+#include <string>
+
+using reckless::kv;
+
+// Both kinds of format string must give the same output, so each record is
+// written twice.
+#define WRITE(log, fmt, ...) \
+    do { \
+        log.write(fmt, ##__VA_ARGS__); \
+        log.write(RECKLESS_FORMAT(fmt), ##__VA_ARGS__); \
+    } while(false)
+
+struct point {
+    int x;
+    int y;
+};
+
+char const* format(reckless::output_buffer* pbuffer, char const* pformat,
+    point const& p)
+{
+    if(*pformat != 's')
+        return nullptr;
+    char* s = pbuffer->reserve(64);
+    pbuffer->commit(std::sprintf(s, "(%d, %d)", p.x, p.y));
+    return pformat + 1;
+}
+
+std::string const expected[] = {
+    "plain text",
+    "escaped {braces} and }}",
+    "1 2 3",
+    "3 1 2 1",
+    "x=7 y=text",
+    "[   42|42   |  42  |00042|-0042|+42| 42]",
+    "[**42|42**|*42*|xxxxx]",
+    "[2a|2A|0x2a|0X2A|0x0000002a]",
+    "[-1|4294967295|-2|18446744073709551615]",
+    "[1.5|1.500|1.500000e+00|1.5E+10|   1.25|+0.5]",
+    "[text|text      |      text|   text   |x|y]",
+    "[true|false|1|  true]",
+    "[(1, 2)|   (3, 4)]",
+    "[wide|\xc3\xa5]",
+    "[ok {9} {missing} {0:q}]",
+};
+
+int main()
+{
+    memory_writer<std::string> writer;
+    {
+        reckless::brace_log<> log(&writer);
+        WRITE(log, "plain text");
+        WRITE(log, "escaped {{braces}} and }}}}");
+        WRITE(log, "{} {} {}", 1, 2, 3);
+        WRITE(log, "{2} {0} {1} {0}", 1, 2, 3);
+        WRITE(log, "x={x} y={y}", kv("y", "text"), kv("x", 7));
+        WRITE(log, "[{0:5}|{0:<5}|{0:^6}|{0:05}|{1:05}|{0:+}|{0: }]", 42, -42);
+        WRITE(log, "[{0:*>4}|{0:*<4}|{0:*^4}|{1:x^5}]", 42, "");
+        WRITE(log, "[{0:x}|{0:X}|{0:#x}|{0:#X}|{0:#010x}]", 42);
+        WRITE(log, "[{}|{}|{}|{}]", -1, 4294967295u, static_cast<short>(-2),
+            18446744073709551615ull);
+        WRITE(log, "[{}|{:.3f}|{:e}|{:G}|{:7}|{:+}]", 1.5, 1.5, 1.5, 1.5e10,
+            1.25f, 0.5);
+        WRITE(log, "[{0}|{0:10}|{0:>10}|{0:^10}|{1}|{2:c}]", "text",
+            'x', 'y');
+        WRITE(log, "[{}|{}|{:d}|{:>6}]", true, false, true, true);
+        WRITE(log, "[{}|{:>9}]", point{1, 2}, point{3, 4});
+        WRITE(log, "[{}|{}]", L"wide", U'å');
+    }
+    // Fields that can't be formatted are written as they are. The compiled
+    // variant rejects missing positional arguments, so this one is only
+    // tested at run time.
+    {
+        reckless::brace_log<> log(&writer);
+        log.write("[ok {9} {missing} {0:q}]", 1);
+    }
+
+    std::string expected_output;
+    for(auto const& line : expected) {
+        if(&line != &expected[sizeof(expected)/sizeof(expected[0])-1])
+            expected_output += line + "\n" + line + "\n";
+        else
+            expected_output += line + "\n";
+    }
+
+    bool ok = writer.container == expected_output;
+    if(!ok)
+        std::cout << writer.container << std::endl;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,173 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks hex formatting of byte buffers against a reference implementation
+// built on sprintf, including dumps that are many times larger than the
+// output buffer.
+#include "memory_writer.hpp"
+#include <reckless/policy_log.hpp>
+#include <reckless/byte_buffer.hpp>
+
+#include <cstdio>   // sprintf
+#include <cstring>  // memcmp
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+memory_writer<std::string> g_writer;
+
+std::string reference_hex(std::vector<unsigned char> const& data,
+    char const* byte_format, char const* separator)
+{
+    std::string s;
+    char buffer[8];
+    for(std::size_t i=0; i!=data.size(); ++i) {
+        if(i != 0)
+            s += separator;
+        std::sprintf(buffer, byte_format, data[i]);
+        s += buffer;
+    }
+    return s;
+}
+
+std::string reference_dump(std::vector<unsigned char> const& data)
+{
+    std::string s;
+    char buffer[80];
+    bool squeezing = false;
+    for(std::size_t offset=0; offset < data.size(); offset += 16) {
+        std::size_t n = std::min(data.size() - offset, std::size_t(16));
+        if(n == 16 && offset != 0 &&
+                std::memcmp(&data[offset-16], &data[offset], 16) == 0)
+        {
+            if(!squeezing)
+                s += "\n*";
+            squeezing = true;
+            continue;
+        }
+        squeezing = false;
+        std::sprintf(buffer, "\n%08x  ", static_cast<unsigned>(offset));
+        s += buffer;
+        for(std::size_t i=0; i!=16; ++i) {
+            if(i < n)
+                std::sprintf(buffer, "%02x ", data[offset+i]);
+            else
+                std::sprintf(buffer, "   ");
+            s += buffer;
+            if(i == 7)
+                s += ' ';
+        }
+        s += " |";
+        for(std::size_t i=0; i!=n; ++i) {
+            unsigned char c = data[offset+i];
+            s += (c >= 0x20 && c < 0x7f)? static_cast<char>(c) : '.';
+        }
+        s += '|';
+    }
+    if(!data.empty()) {
+        std::sprintf(buffer, "\n%08x", static_cast<unsigned>(data.size()));
+        s += buffer;
+    }
+    return s;
+}
+
+bool check(char const* name, std::string const& expected)
+{
+    bool ok = g_writer.container == expected;
+    if(!ok) {
+        std::cout << name << ":\n" << g_writer.container.substr(0, 400)
+            << "\nexpected:\n" << expected.substr(0, 400) << std::endl;
+    }
+    g_writer.container.clear();
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    {
+        reckless::policy_log<> log(&g_writer);
+        char const hello[] = "Hello, world!\n";
+        log.write("%x", reckless::bytes(hello, 5));
+        log.write("%X|% x", reckless::copy_bytes("\xab\xcd\xef", 3),
+            reckless::bytes("\x01\x02\x03", 3));
+        log.write("%.2x|%x|%#x", reckless::bytes(hello, 5),
+            reckless::bytes(hello, 0), reckless::bytes(hello, 0));
+        log.write("payload:%#x", reckless::bytes(hello, 14));
+        log.flush();
+        ok &= check("basic",
+            "48656c6c6f\n"
+            "ABCDEF|01 02 03\n"
+            "4865||\n"
+            "payload:\n"
+            "00000000  48 65 6c 6c 6f 2c 20 77  6f 72 6c 64 21 0a        |Hello, world!.|\n"
+            "0000000e\n");
+
+        std::vector<unsigned char> zeroes(40);
+        log.write("%#x", reckless::bytes(zeroes.data(), zeroes.size()));
+        log.flush();
+        ok &= check("squeeze",
+            "\n"
+            "00000000  00 00 00 00 00 00 00 00  00 00 00 00 00 00 00 00  |................|\n"
+            "*\n"
+            "00000020  00 00 00 00 00 00 00 00                           |........|\n"
+            "00000028\n");
+
+        std::mt19937 rng(1234);
+        for(std::size_t size=0; size!=300; ++size) {
+            std::vector<unsigned char> data(size);
+            for(auto& c : data)
+                c = static_cast<unsigned char>(rng() % 4 == 0? 0 : rng());
+            log.write("%x", reckless::bytes(data.data(), size));
+            log.write("% X", reckless::copy_bytes(data.data(), size));
+            log.write("%#x", reckless::bytes(data.data(), size));
+            log.flush();
+            std::string expected = reference_hex(data, "%02x", "") + "\n" +
+                reference_hex(data, "%02X", " ") + "\n" +
+                reference_dump(data) + "\n";
+            if(!check("random", expected)) {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // A buffer that gives several times more output than the output buffer
+    // holds.
+    {
+        reckless::policy_log<> log(&g_writer, 64*1024, 16*1024);
+        std::mt19937 rng(5678);
+        std::vector<unsigned char> data(100000);
+        for(auto& c : data)
+            c = static_cast<unsigned char>(rng());
+        log.write("%x", reckless::bytes(data.data(), data.size()));
+        log.write("% x", reckless::bytes(data.data(), data.size()));
+        log.write("%#x", reckless::copy_bytes(data.data(), data.size()));
+        log.flush();
+        ok &= check("streaming", reference_hex(data, "%02x", "") + "\n" +
+            reference_hex(data, "%02x", " ") + "\n" +
+            reference_dump(data) + "\n");
+    }
+
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks that categories follow the most specific minimum severity that was
+// set for them, fall back to the log's minimum severity otherwise, and are
+// written by category_field.
+#include "memory_writer.hpp"
+#include <reckless/severity_log.hpp>
+#include <reckless/structured_log.hpp>
+#include <reckless/call_site.hpp>
+#include <reckless/category.hpp>
+
+#include <algorithm>    // sort
+#include <iostream>
+#include <string>
+#include <vector>
+
+using reckless::kv;
+
+reckless::category g_net("net");
+reckless::category g_retransmit("net.tcp.retransmit");
+reckless::category g_db("db");
+
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::severity_field, reckless::category_field> log_t;
+
+bool check(std::string const& actual, std::string const& expected)
+{
+    if(actual == expected)
+        return true;
+    std::cout << "expected:\n" << expected << "actual:\n" << actual;
+    return false;
+}
+
+bool test_rules()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        log.set_min_severity('I');
+        log.info("direct");
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, debug, "dropped by log");
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, info, "seq %d", 1);
+
+        reckless::set_category_min_severity("net", 'D');
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, debug, "seq %d", 2);
+        RECKLESS_LOG_CATEGORY(log, g_net, debug, "up");
+        RECKLESS_LOG_CATEGORY(log, g_db, debug, "dropped by log");
+
+        reckless::set_category_min_severity("net.tcp", 'E');
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, warn, "dropped by net.tcp");
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, error, "seq %d", 3);
+        RECKLESS_LOG_CATEGORY(log, g_net, debug, "still up");
+
+        // A name that only shares a prefix with a category, without a dot,
+        // doesn't apply to it.
+        reckless::set_category_min_severity("d", 'E');
+        RECKLESS_LOG_CATEGORY(log, g_db, info, "query");
+
+        reckless::clear_category_min_severity("net.tcp");
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, debug, "seq %d", 4);
+        reckless::clear_category_min_severity("net");
+        RECKLESS_LOG_CATEGORY(log, g_retransmit, debug, "dropped by log");
+        reckless::clear_category_min_severity("d");
+    }
+    return check(writer.container,
+        "I - direct\n"
+        "I net.tcp.retransmit seq 1\n"
+        "D net.tcp.retransmit seq 2\n"
+        "D net up\n"
+        "E net.tcp.retransmit seq 3\n"
+        "D net still up\n"
+        "I db query\n"
+        "D net.tcp.retransmit seq 4\n");
+}
+
+bool test_structured_log()
+{
+    memory_writer<std::string> writer;
+    {
+        reckless::structured_log<reckless::json_encoder,
+            reckless::category_field> log(&writer);
+        RECKLESS_LOG_CATEGORY(log, g_db, info, "query", kv("ms", 3));
+        log.info("direct");
+    }
+    return check(writer.container,
+        "{\"category\":\"db\",\"msg\":\"query\",\"ms\":3}\n"
+        "{\"category\":\"-\",\"msg\":\"direct\"}\n");
+}
+
+bool test_names()
+{
+    std::vector<std::string> names = reckless::category_names();
+    std::sort(names.begin(), names.end());
+    std::vector<std::string> expected = {"db", "net", "net.tcp.retransmit"};
+    {
+        reckless::category temporary("temporary");
+        if(reckless::category_names().size() != 4)
+            return false;
+    }
+    return names == expected && reckless::category_names().size() == 3;
+}
+
+int main()
+{
+    bool ok = test_rules();
+    ok = test_structured_log() && ok;
+    ok = test_names() && ok;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,83 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks that each clock source converts its raw times to wall-clock times
+// that agree with the system clock, and that timestamp fields using them can
+// be formatted.
+#include "memory_writer.hpp"
+#include <reckless/policy_log.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Allow for the coarse clock's resolution and a scheduler hiccup.
+std::int64_t const TOLERANCE = 20000000;
+
+template <class Clock>
+bool check_clock(char const* name)
+{
+    bool ok = true;
+    for(int i=0; i!=3; ++i) {
+        std::uint64_t raw = Clock::now();
+        std::uint64_t reference = reckless::realtime_clock::now();
+        std::uint64_t converted = Clock::to_realtime(raw);
+        std::int64_t difference = static_cast<std::int64_t>(converted - reference);
+        if(difference > TOLERANCE || difference < -TOLERANCE) {
+            std::cout << name << " differs from realtime_clock by "
+                << difference << " ns" << std::endl;
+            ok = false;
+        }
+        // Cross a recalibration.
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    }
+    return ok;
+}
+
+template <class Clock>
+std::size_t timestamp_length()
+{
+    memory_writer<std::string> writer;
+    {
+        reckless::policy_log<reckless::no_indent, ' ',
+            reckless::basic_timestamp_field<Clock>> log(&writer);
+        log.write("x");
+    }
+    // YYYY-MM-DD HH:MM:SS.FFF x
+    return writer.container.size();
+}
+
+int main()
+{
+    bool ok = check_clock<reckless::coarse_realtime_clock>("coarse_realtime_clock");
+    ok = check_clock<reckless::realtime_clock>("realtime_clock") && ok;
+    ok = check_clock<reckless::monotonic_clock>("monotonic_clock") && ok;
+    ok = check_clock<reckless::tsc_clock>("tsc_clock") && ok;
+
+    ok = timestamp_length<reckless::coarse_realtime_clock>() == 26 && ok;
+    ok = timestamp_length<reckless::monotonic_clock>() == 26 && ok;
+    ok = timestamp_length<reckless::tsc_clock>() == 26 && ok;
+
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,287 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/datagram_writer.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>  // htonl, ntohs
+#include <netinet/in.h> // sockaddr_in
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Stand-in for a syslog daemon or log collector: receives datagrams on a
+// socket until it has seen the expected number of them.
+class receiver {
+public:
+    explicit receiver(int fd) : fd_(fd)
+    {
+    }
+    ~receiver()
+    {
+        close(fd_);
+    }
+
+    void receive(unsigned count)
+    {
+        thread_ = std::thread([this, count]() {
+            char buffer[65536];
+            for(unsigned i=0; i!=count; ++i) {
+                ssize_t size = recv(fd_, buffer, sizeof(buffer), 0);
+                if(size < 0)
+                    break;
+                datagrams.emplace_back(buffer, size);
+            }
+        });
+    }
+
+    void join()
+    {
+        thread_.join();
+    }
+
+    std::vector<std::string> datagrams;
+
+private:
+    int fd_;
+    std::thread thread_;
+};
+
+bool check_lines(receiver const& r, unsigned lines, std::size_t header_size)
+{
+    if(r.datagrams.size() != lines)
+        return false;
+    for(unsigned i=0; i!=lines; ++i) {
+        std::string expected = "line " + std::to_string(i);
+        std::string const& datagram = r.datagrams[i];
+        if(datagram.size() < header_size
+                || datagram.compare(header_size, std::string::npos, expected) != 0)
+            return false;
+    }
+    return true;
+}
+
+bool test_unix_socket()
+{
+    char const* path = "datagram_writer.sock";
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path);
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    receiver r(fd);
+
+    unsigned const LINES = 10000;
+    r.receive(LINES);
+    {
+        reckless::datagram_writer writer(path);
+        writer.rfc5424_framing("test", reckless::datagram_writer::facility_local0,
+            reckless::datagram_writer::severity_notice);
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d", i);
+    }
+    r.join();
+    unlink(path);
+
+    std::cout << "first datagram: " << r.datagrams.front() << std::endl;
+    // "<133>1 2020-01-01T00:00:00.000000Z host test 1234 - - line 0"
+    std::string const& first = r.datagrams.front();
+    if(first.compare(0, 7, "<133>1 ") != 0)
+        return false;
+    std::size_t header_size = first.find("- - ") + 4;
+    // The timestamp changes between datagrams but its width doesn't.
+    bool ok = check_lines(r, LINES, header_size);
+    std::cout << "unix socket: received " << r.datagrams.size() << " of "
+        << LINES << " datagrams" << std::endl;
+    return ok;
+}
+
+bool test_udp()
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    // Make room for the whole test so nothing is dropped by the kernel.
+    int receive_buffer = 4*1024*1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+    receiver r(fd);
+
+    unsigned const LINES = 100;
+    // The log stores the pointer rather than a copy of the string, so it
+    // must outlive the log.
+    std::string long_line(1000, 'x');
+    r.receive(LINES+1);
+    {
+        reckless::datagram_writer writer("127.0.0.1", ntohs(address.sin_port));
+        writer.max_datagram_size(64);
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d", i);
+        // Should be truncated to the maximum datagram size.
+        log.write("%s", long_line.c_str());
+    }
+    r.join();
+
+    bool ok = r.datagrams.size() == LINES+1
+        && r.datagrams.back() == std::string(64, 'x');
+    r.datagrams.pop_back();
+    ok = ok && check_lines(r, LINES, 0);
+    std::cout << "udp: received " << r.datagrams.size()+1 << " of "
+        << LINES+1 << " datagrams" << std::endl;
+    return ok;
+}
+
+// Binds a UDP socket on the loopback interface and returns it, with its port
+// in *pport.
+int bind_udp_socket(unsigned short* pport)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    *pport = ntohs(address.sin_port);
+    return fd;
+}
+
+// A flush in the middle of a record must not split its line into two
+// datagrams.
+bool test_split_lines()
+{
+    unsigned short port;
+    receiver r(bind_udp_socket(&port));
+    r.receive(3);
+    {
+        reckless::datagram_writer writer("127.0.0.1", port);
+        char const* chunks[] = {"first ha", "lf\nsec", "o", "nd\nthird\n"};
+        for(char const* chunk : chunks) {
+            std::error_code ec;
+            writer.write(chunk, std::strlen(chunk), ec);
+        }
+    }
+    r.join();
+    bool ok = r.datagrams.size() == 3 && r.datagrams[0] == "first half"
+        && r.datagrams[1] == "second" && r.datagrams[2] == "third";
+    std::cout << "split lines: " << (ok? "ok" : "failed") << std::endl;
+    return ok;
+}
+
+// Binds a unix datagram socket at path and returns it.
+int bind_unix_socket(char const* path)
+{
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path);
+    bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    return fd;
+}
+
+// When the rest of a kept line can't be sent, and the output buffer discards
+// it as it does with error_policy::ignore, the start of the line must not end
+// up in front of the next line.
+bool test_failed_continuation()
+{
+    char const* path = "datagram_writer_fail.sock";
+    int fd = bind_unix_socket(path);
+    reckless::datagram_writer writer(path);
+    std::error_code ec;
+    writer.write("lost ha", 7, ec);
+    // The peer goes away and nothing is listening when the writer tries to
+    // reconnect.
+    close(fd);
+    unlink(path);
+    writer.write("lf\n", 3, ec);
+    bool ok = static_cast<bool>(ec);
+
+    receiver r(bind_unix_socket(path));
+    r.receive(1);
+    writer.write("next\n", 5, ec);
+    ok = ok && !ec;
+    r.join();
+    unlink(path);
+    ok = ok && r.datagrams.size() == 1 && r.datagrams[0] == "next";
+    std::cout << "failed continuation: " << (ok? "ok" : "failed") << std::endl;
+    return ok;
+}
+
+// Sizes that leave no room for the line after the header are rejected.
+bool test_size_validation()
+{
+    unsigned short port;
+    int fd = bind_udp_socket(&port);
+    reckless::datagram_writer writer("127.0.0.1", port);
+    bool ok = true;
+    try {
+        writer.max_datagram_size(0);
+        ok = false;
+    } catch(std::invalid_argument const&) {
+    }
+    writer.max_datagram_size(1);
+    try {
+        writer.rfc5424_framing("test");
+        ok = false;
+    } catch(std::invalid_argument const&) {
+    }
+    writer.max_datagram_size(2048);
+    writer.rfc5424_framing("test");
+    try {
+        writer.max_datagram_size(40);
+        ok = false;
+    } catch(std::invalid_argument const&) {
+    }
+    close(fd);
+    std::cout << "size validation: " << (ok? "ok" : "failed") << std::endl;
+    return ok;
+}
+
+int main()
+{
+    bool ok = test_unix_socket();
+    ok = test_udp() && ok;
+    ok = test_split_lines() && ok;
+    ok = test_failed_continuation() && ok;
+    ok = test_size_validation() && ok;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
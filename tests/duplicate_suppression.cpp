@@ -0,0 +1,170 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks that the worker collapses runs of identical records, ignoring
+// volatile header fields such as timestamps, and reports how many were
+// dropped.
+#include "memory_writer.hpp"
+#include "eol.hpp"
+#include <reckless/policy_log.hpp>
+#include <reckless/severity_log.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// A header field that differs for every record, like a timestamp would.
+class sequence_field {
+public:
+    sequence_field() :
+        sequence_(++next_sequence_)
+    {
+    }
+
+    bool format(reckless::output_buffer* pbuffer)
+    {
+        pbuffer->write(std::to_string(sequence_).c_str());
+        return true;
+    }
+
+private:
+    unsigned sequence_;
+    static unsigned next_sequence_;
+};
+
+unsigned sequence_field::next_sequence_ = 0;
+
+namespace reckless {
+template <>
+struct volatile_field<sequence_field> : std::true_type {
+};
+}
+
+typedef reckless::policy_log<reckless::indent<2>, ' ', sequence_field> log_t;
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::timestamp_field, reckless::severity_field> severity_log_t;
+
+bool check(std::string const& actual, std::string const& expected)
+{
+    if(actual == eol(expected))
+        return true;
+    std::cout << "expected:\n" << expected << "actual:\n" << actual;
+    return false;
+}
+
+bool test_runs()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        log.suppress_duplicates(60000);
+        for(int i=0; i!=5; ++i)
+            log.write("connection refused by %s", "db1");
+        log.write("connection refused by %s", "db2");
+        log.write("connection refused by %s", "db2");
+        {
+            // Different indentation is a different record.
+            reckless::scoped_indent indent;
+            log.write("connection refused by %s", "db2");
+        }
+        log.write("connection refused by %s", "db1");
+        log.write("connection refused by %s", "db1");
+        log.write("connection refused by %s", "db1");
+    }
+    return check(writer.container,
+        "1 connection refused by db1\n"
+        "last message repeated 4 times\n"
+        "6 connection refused by db2\n"
+        "last message repeated 1 time\n"
+        "8   connection refused by db2\n"
+        "9 connection refused by db1\n"
+        "last message repeated 2 times\n");
+}
+
+// Records that differ only in a header field that isn't volatile are not
+// duplicates.
+bool test_severity()
+{
+    memory_writer<std::string> writer;
+    {
+        severity_log_t log(&writer);
+        log.suppress_duplicates(60000);
+        log.info("db down");
+        log.error("db down");
+        log.error("db down");
+    }
+    // Remove the timestamps, which are the same length on every line that
+    // has one.
+    std::string output;
+    std::size_t const timestamp_size = sizeof("2020-01-01 00:00:00.000");
+    std::size_t pos = 0;
+    while(pos != writer.container.size()) {
+        std::size_t end = writer.container.find('\n', pos) + 1;
+        std::string line = writer.container.substr(pos, end - pos);
+        if(line.size() > timestamp_size && line[4] == '-')
+            line.erase(0, timestamp_size);
+        output += line;
+        pos = end;
+    }
+    return check(output,
+        "I db down\n"
+        "E db down\n"
+        "last message repeated 1 time\n");
+}
+
+bool test_timeout()
+{
+    memory_writer<std::string> writer;
+    log_t log(&writer);
+    log.suppress_duplicates(50);
+    for(int i=0; i!=3; ++i)
+        log.write("disk full");
+    log.flush();
+    // The worker writes the summary on its own once the timeout has passed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::string output = writer.container;
+    log.close();
+    return check(output,
+        "12 disk full\n"
+        "last message repeated 2 times\n");
+}
+
+bool test_disabled()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        log.write("same");
+        log.write("same");
+    }
+    return writer.container.find("repeated") == std::string::npos;
+}
+
+int main()
+{
+    bool ok = test_runs();
+    ok = test_severity() && ok;
+    ok = test_timeout() && ok;
+    ok = test_disabled() && ok;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
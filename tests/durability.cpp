@@ -0,0 +1,80 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/file_writer.hpp>
+
+#include <chrono>
+#include <cstdio>   // remove
+#include <iostream>
+#include <thread>
+
+// Wait for the sync thread to catch up with everything that was written.
+bool wait_durable(reckless::file_writer const& writer)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(writer.durable_offset() != writer.written_offset()) {
+        if(std::chrono::steady_clock::now() > deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool test(char const* name, reckless::durability policy)
+{
+    std::size_t const THRESHOLD = 64*1024;
+    char const* path = "durability.txt";
+    std::remove(path);
+    reckless::file_writer writer(path);
+    writer.durability_policy(policy, 10, THRESHOLD);
+    {
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=100000; ++i)
+            log.write("line %d", i);
+    }
+
+    bool ok;
+    if(policy == reckless::durability::periodic) {
+        ok = wait_durable(writer);
+    } else {
+        // The data since the last threshold crossing (and, for background
+        // writeback, the chunk whose writeback was started last) is only
+        // synced when the writer is destroyed. A chunk can exceed the
+        // threshold by up to one write, i.e. one output buffer.
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::uint64_t lag = writer.written_offset() - writer.durable_offset();
+        ok = writer.durable_offset() <= writer.written_offset() && lag < 4*THRESHOLD;
+    }
+    std::cout << name << ": written=" << writer.written_offset()
+        << " durable=" << writer.durable_offset() << std::endl;
+    return ok;
+}
+
+int main()
+{
+    bool ok = test("periodic", reckless::durability::periodic);
+    ok = test("every_n_bytes", reckless::durability::every_n_bytes) && ok;
+    ok = test("background_writeback", reckless::durability::background_writeback) && ok;
+    std::remove("durability.txt");
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
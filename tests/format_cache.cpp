@@ -0,0 +1,108 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Formats the same format strings many times over, so that they are served
+// from the formatter's format cache, and checks that the output matches the
+// output of the first, uncached, round.
+#include "memory_writer.hpp"
+#include <reckless/policy_log.hpp>
+
+#include <cstdio>   // sprintf
+#include <cstring>  // strcpy
+#include <iostream>
+#include <string>
+
+memory_writer<std::string> g_writer;
+
+void write_round(reckless::policy_log<>& log, unsigned i)
+{
+    log.write("plain text");
+    log.write("%d%%", i);
+    log.write("100%% of %s", "the time");
+    log.write("[%5d|%-5d|%05d|%+d]", i, i, i, i);
+    log.write("%x %X %#x", i, i, i);
+    log.write("%.3f %s", 1.5, std::string("done"));
+    log.write("unused %d %s");
+}
+
+std::string expected_round(unsigned i)
+{
+    char buffer[256];
+    std::string s;
+    s += "plain text\n";
+    s += std::to_string(i) + "%\n";
+    s += "100% of the time\n";
+    std::sprintf(buffer, "[%5u|%-5u|%05u|%+d]\n", i, i, i, i);
+    s += buffer;
+    std::sprintf(buffer, "%x %X %#x\n", i, i, i);
+    s += buffer;
+    s += "1.500 done\n";
+    s += "unused %d %s\n";
+    return s;
+}
+
+int main()
+{
+    unsigned const ROUNDS = 1000;
+    // The log stores the pointer, so the buffer must outlive the log.
+    static char reused[32];
+    std::string expected;
+    {
+        reckless::policy_log<> log(&g_writer);
+        for(unsigned i=0; i!=ROUNDS; ++i) {
+            write_round(log, i);
+            expected += expected_round(i);
+        }
+        log.flush();
+
+        // A format string that changes at the same address must not be
+        // formatted according to the old contents.
+        std::strcpy(reused, "first %d");
+        log.write(reused, 1);
+        log.flush();
+        std::strcpy(reused, "second string %d");
+        log.write(reused, 2);
+        log.flush();
+        expected += "first 1\nsecond string 2\n";
+
+        // The same for a heap buffer that is reused for a shorter string,
+        // whose terminator comes before the end of the old literal text and
+        // its conversion specification.
+        char* heap = new char[32];
+        std::strcpy(heap, "long literal text %5d end");
+        log.write(heap, 3);
+        log.flush();
+        std::strcpy(heap, "short %d");
+        log.write(heap, 4);
+        log.flush();
+        std::strcpy(heap, "%d");
+        log.write(heap, 5);
+        log.flush();
+        delete[] heap;
+        expected += "long literal text     3 end\nshort 4\n5\n";
+    }
+
+    bool ok = g_writer.container == expected;
+    if(!ok)
+        std::cout << g_writer.container.substr(0, 400) << std::endl;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
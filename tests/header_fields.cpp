@@ -0,0 +1,213 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks the thread id, thread name, source location and process header
+// fields, in policy_log, severity_log and structured_log, with records written
+// both directly and through call sites, and that the cached thread id is
+// looked up again after fork().
+#include "memory_writer.hpp"
+#include <reckless/policy_log.hpp>
+#include <reckless/severity_log.hpp>
+#include <reckless/structured_log.hpp>
+#include <reckless/thread_field.hpp>
+#include <reckless/process_field.hpp>
+#include <reckless/call_site.hpp>
+
+#include <iostream>
+#include <string>
+#include <thread>
+
+#if defined(__unix__)
+#include <unistd.h>     // getpid, gethostname, fork, _exit
+#include <sys/wait.h>   // waitpid
+#include <pthread.h>    // pthread_setname_np
+#endif
+
+using reckless::kv;
+
+typedef reckless::policy_log<reckless::no_indent, ' ',
+    reckless::thread_id_field, reckless::thread_name_field,
+    reckless::source_location_field> policy_log;
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::severity_field, reckless::source_location_field> severity_log;
+typedef reckless::structured_log<reckless::json_encoder,
+    reckless::severity_field, reckless::thread_name_field,
+    reckless::source_location_field> structured_log;
+
+bool check(std::string const& actual, std::string const& expected)
+{
+    if(actual == expected)
+        return true;
+    std::cout << "expected:\n" << expected << "actual:\n" << actual;
+    return false;
+}
+
+std::string location(unsigned line, char const* function)
+{
+    return "header_fields.cpp:" + std::to_string(line) + ":" + function;
+}
+
+bool test_policy_log()
+{
+    memory_writer<std::string> writer;
+    std::string id = std::to_string(reckless::current_thread_id());
+    std::string expected;
+    unsigned line;
+    {
+        policy_log log(&writer);
+        log.write("no location");
+        expected += id + " " + reckless::current_thread_name() + " ? no location\n";
+        reckless::set_log_thread_name("main");
+        RECKLESS_WRITE(log, "x=%d", 1); line = __LINE__;
+        expected += id + " main " + location(line, "test_policy_log") + " x=1\n";
+
+        std::string other_id;
+        std::thread thread([&]
+        {
+            reckless::set_log_thread_name("worker");
+            other_id = std::to_string(reckless::current_thread_id());
+            log.write("from %s", "worker");
+        });
+        thread.join();
+        expected += other_id + " worker ? from worker\n";
+        if(other_id == id) {
+            std::cout << "threads have the same id" << std::endl;
+            return false;
+        }
+#if defined(__linux__)
+        // The OS name is copied into the record, so it survives the thread.
+        std::thread pool_thread([&]
+        {
+            pthread_setname_np(pthread_self(), "pool-7");
+            other_id = std::to_string(reckless::current_thread_id());
+            log.write("from %s", "pool");
+        });
+        pool_thread.join();
+        expected += other_id + " pool-7 ? from pool\n";
+#endif
+    }
+    return check(writer.container, expected);
+}
+
+bool test_severity_log()
+{
+    memory_writer<std::string> writer;
+    std::string expected;
+    unsigned line;
+    {
+        severity_log log(&writer);
+        log.info("no location");
+        expected += "I ? no location\n";
+        RECKLESS_LOG(log, error, "failed: %s", "timeout"); line = __LINE__;
+        expected += "E " + location(line, "test_severity_log") + " failed: timeout\n";
+        RECKLESS_LOG(log, debug, "plain"); line = __LINE__;
+        expected += "D " + location(line, "test_severity_log") + " plain\n";
+    }
+    return check(writer.container, expected);
+}
+
+bool test_structured_log()
+{
+    memory_writer<std::string> writer;
+    std::string expected;
+    unsigned line;
+    reckless::set_log_thread_name("main");
+    {
+        structured_log log(&writer);
+        RECKLESS_LOG(log, warn, "slow", kv("ms", 250)); line = __LINE__;
+        expected += "{\"level\":\"W\",\"thread\":\"main\",\"source\":\""
+            + location(line, "test_structured_log")
+            + "\",\"msg\":\"slow\",\"ms\":250}\n";
+    }
+    return check(writer.container, expected);
+}
+
+// Fields with a MAX_SIZE are written in runs, so mix them with ones that
+// have none.
+typedef reckless::severity_log<reckless::no_indent, '|',
+    reckless::severity_field, reckless::pid_field,
+    reckless::source_location_field, reckless::app_name_field,
+    reckless::thread_id_field> mixed_log;
+
+bool test_process_fields()
+{
+#if defined(__unix__)
+    memory_writer<std::string> writer;
+    std::string pid = std::to_string(getpid());
+    char hostname[256] = {0};
+    gethostname(hostname, sizeof(hostname) - 1);
+    std::string id = std::to_string(reckless::current_thread_id());
+    std::string expected;
+    unsigned line;
+    reckless::set_app_name("tester");
+    {
+        mixed_log log(&writer);
+        log.warn("direct");
+        expected += "W|" + pid + "|?|tester|" + id + "|direct\n";
+        RECKLESS_LOG(log, info, "from %s", "call site"); line = __LINE__;
+        expected += "I|" + pid + "|" + location(line, "test_process_fields")
+            + "|tester|" + id + "|from call site\n";
+    }
+    {
+        reckless::policy_log<reckless::no_indent, ' ',
+            reckless::hostname_field> log(&writer);
+        log.write("up");
+        expected += std::string(hostname) + " up\n";
+    }
+    return check(writer.container, expected);
+#else
+    return true;
+#endif
+}
+
+bool test_fork()
+{
+#if defined(__linux__)
+    // Make sure the parent's id is cached before forking. In the child, the
+    // only thread has the same id as the process.
+    reckless::current_thread_id();
+    pid_t child = fork();
+    if(child == 0) {
+        bool ok = reckless::current_thread_id()
+            == static_cast<std::uint64_t>(getpid());
+        _exit(ok? 0 : 1);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        return true;
+    std::cout << "thread id was not looked up again after fork" << std::endl;
+    return false;
+#else
+    return true;
+#endif
+}
+
+int main()
+{
+    bool ok = test_policy_log();
+    ok = test_severity_log() && ok;
+    ok = test_structured_log() && ok;
+    ok = test_process_fields() && ok;
+    ok = test_fork() && ok;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,187 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks which calls the sampling macros write, and the suppressed counts
+// that they append to the messages.
+#include "memory_writer.hpp"
+#include <reckless/severity_log.hpp>
+#include <reckless/sampling.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::severity_field> log_t;
+
+bool check(std::string const& actual, std::string const& expected)
+{
+    if(actual == expected)
+        return true;
+    std::cout << "expected:\n" << expected << "actual:\n" << actual;
+    return false;
+}
+
+bool test_every_n()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        for(int i=0; i!=25; ++i)
+            RECKLESS_LOG_EVERY_N(log, 10, info, "i=%d", i);
+    }
+    return check(writer.container,
+        "I i=0\n"
+        "I i=10 (9 suppressed)\n"
+        "I i=20 (9 suppressed)\n");
+}
+
+bool test_first_n_then_every_m()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        for(int i=0; i!=15; ++i)
+            RECKLESS_LOG_FIRST_N_THEN_EVERY_M(log, 3, 5, warn, "i=%d", i);
+    }
+    return check(writer.container,
+        "W i=0\n"
+        "W i=1\n"
+        "W i=2\n"
+        "W i=7 (4 suppressed)\n"
+        "W i=12 (4 suppressed)\n");
+}
+
+void write_rate_limited(reckless::policy_log<>& log, int i)
+{
+    // One call per 250 ms, in bursts of up to four calls.
+    RECKLESS_LOG_RATE_LIMITED(log, 4, write, "i=%d", i);
+}
+
+bool test_rate_limited()
+{
+    memory_writer<std::string> writer;
+    {
+        reckless::policy_log<> log(&writer);
+        for(int i=0; i!=100; ++i)
+            write_rate_limited(log, i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        for(int i=100; i!=110; ++i)
+            write_rate_limited(log, i);
+    }
+    return check(writer.container,
+        "i=0\n"
+        "i=1\n"
+        "i=2\n"
+        "i=3\n"
+        "i=100 (96 suppressed)\n");
+}
+
+void write_never(reckless::policy_log<>& log, int i)
+{
+    // A rate of 0 must suppress every call rather than divide by zero.
+    RECKLESS_LOG_RATE_LIMITED(log, 0, write, "i=%d", i);
+}
+
+bool test_rate_limited_zero()
+{
+    memory_writer<std::string> writer;
+    {
+        reckless::policy_log<> log(&writer);
+        for(int i=0; i!=10; ++i)
+            write_never(log, i);
+    }
+    return check(writer.container, "");
+}
+
+void write_every_third(log_t& log, int i)
+{
+    RECKLESS_LOG_EVERY_N(log, 3, info, "i=%d", i);
+}
+
+bool test_disabled_not_counted()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        log.set_min_severity('W');
+        for(int i=0; i!=5; ++i)
+            write_every_third(log, i);
+        log.set_min_severity('D');
+        for(int i=5; i!=9; ++i)
+            write_every_third(log, i);
+    }
+    return check(writer.container,
+        "I i=5\n"
+        "I i=8 (2 suppressed)\n");
+}
+
+bool test_threads()
+{
+    memory_writer<std::string> writer;
+    {
+        log_t log(&writer);
+        std::vector<std::thread> threads;
+        for(int t=0; t!=4; ++t) {
+            threads.emplace_back([&log]
+            {
+                for(int i=0; i!=1000; ++i)
+                    RECKLESS_LOG_EVERY_N(log, 100, debug, "sampled");
+            });
+        }
+        for(auto& thread : threads)
+            thread.join();
+    }
+    // Under contention the calls that get written can drift a little, but
+    // every call up to the last written one is either written or counted as
+    // suppressed, and the ones after it are fewer than n.
+    std::istringstream lines(writer.container);
+    std::string line;
+    unsigned long written = 0;
+    unsigned long suppressed = 0;
+    while(std::getline(lines, line)) {
+        ++written;
+        auto pos = line.find(" (");
+        if(pos != std::string::npos)
+            suppressed += std::stoul(line.substr(pos + 2));
+    }
+    unsigned long accounted = written + suppressed;
+    if(written >= 36 && accounted > 3900 && accounted <= 4000)
+        return true;
+    std::cout << written << " lines and " << suppressed
+        << " suppressed calls from threads" << std::endl;
+    return false;
+}
+
+int main()
+{
+    bool ok = test_every_n();
+    ok = test_first_n_then_every_m() && ok;
+    ok = test_rate_limited() && ok;
+    ok = test_rate_limited_zero() && ok;
+    ok = test_disabled_not_counted() && ok;
+    ok = test_threads() && ok;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
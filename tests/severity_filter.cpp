@@ -0,0 +1,92 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks that severity_log discards records below the compile-time minimum
+// severity and below the severity set at run time, and that RECKLESS_LOG
+// doesn't evaluate the arguments of discarded records. Calls that pass a call
+// site directly, without the macro, must be checked as well.
+#define RECKLESS_MIN_SEVERITY 'I'
+
+#include "memory_writer.hpp"
+#include <reckless/severity_log.hpp>
+#include <reckless/call_site.hpp>
+
+#include <iostream>
+#include <string>
+
+typedef reckless::severity_log<reckless::no_indent, ' ',
+    reckless::severity_field> log_t;
+
+unsigned g_evaluations = 0;
+
+int evaluate(int value)
+{
+    ++g_evaluations;
+    return value;
+}
+
+reckless::call_site const g_info_site = {
+    {__FILE__, __LINE__, "main"}, "direct call site %d", 'I', nullptr};
+
+int main()
+{
+    memory_writer<std::string> writer;
+    bool ok = true;
+    {
+        log_t log(&writer);
+        log.debug("direct debug");
+        RECKLESS_LOG(log, debug, "macro debug %d", evaluate(1));
+        log.info("direct info");
+        RECKLESS_LOG(log, info, "macro info %d", evaluate(2));
+
+        log.set_min_severity('W');
+        ok = ok && !log.severity_enabled('I') && log.severity_enabled('W');
+        log.info("direct info");
+        RECKLESS_LOG(log, info, "macro info %d", evaluate(3));
+        log.info(&g_info_site, "direct call site %d", 1);
+        log.warn("direct warn");
+        RECKLESS_LOG(log, error, "macro error %d", evaluate(4));
+
+        log.set_min_severity('D');
+        ok = ok && log.severity_enabled('D');
+        RECKLESS_LOG(log, debug, "macro debug %d", evaluate(5));
+        RECKLESS_LOG(log, info, "macro info %d", evaluate(6));
+        log.info(&g_info_site, "direct call site %d", 2);
+    }
+
+    std::string expected =
+        "I direct info\n"
+        "I macro info 2\n"
+        "W direct warn\n"
+        "E macro error 4\n"
+        "I macro info 6\n"
+        "I direct call site 2\n";
+    if(writer.container != expected) {
+        std::cout << writer.container;
+        ok = false;
+    }
+    if(g_evaluations != 3) {
+        std::cout << g_evaluations << " evaluations" << std::endl;
+        ok = false;
+    }
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,89 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/shm_writer.hpp>
+#include <reckless/shm_reader.hpp>
+
+#include <iostream>
+#include <memory>     // unique_ptr
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+char const RING_NAME[] = "/reckless-shm-writer-test";
+unsigned const LINES = 100000;
+
+// The log shipper: runs in a child process, reads everything from the ring
+// and checks that it is exactly what the parent logged.
+int consume()
+{
+    std::string expected;
+    for(unsigned i=0; i!=LINES; ++i)
+        expected += "line " + std::to_string(i) + '\n';
+
+    reckless::shm_reader reader(RING_NAME);
+    std::string received;
+    while(true) {
+        char const* p;
+        std::size_t size = reader.peek(&p);
+        if(size == 0) {
+            if(reader.writer_closed())
+                break;
+            reader.wait(100);
+            continue;
+        }
+        received.append(p, size);
+        reader.consume(size);
+    }
+    std::cout << "reader received " << received.size() << " of "
+        << expected.size() << " bytes" << std::endl;
+    return received == expected? 0 : 1;
+}
+
+int main()
+{
+    // A small ring so that the writer has to wait for the reader now and
+    // then, which tests the back-pressure.
+    std::unique_ptr<reckless::shm_writer> pwriter(
+        new reckless::shm_writer(RING_NAME, 64*1024));
+    pid_t child = fork();
+    if(child == -1)
+        return 1;
+    if(child == 0)
+        _exit(consume());   // Don't run the writer's destructor in the child.
+
+    {
+        reckless::policy_log<> log(pwriter.get());
+        log.temporary_error_policy(reckless::error_policy::block);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d", i);
+    }
+    // Closing the ring tells the reader that there is nothing more to come.
+    pwriter.reset();
+
+    int status;
+    waitpid(child, &status, 0);
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks the JSON and logfmt encodings of structured_log records, including
+// escaping of strings long enough to be scanned in vector-sized blocks and of
+// header fields.
+#include "memory_writer.hpp"
+#include <reckless/structured_log.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+
+using reckless::kv;
+
+template <class Encoder, class... Fields>
+std::string encode_records(void (*write_records)(reckless::structured_log<Encoder, Fields...>&))
+{
+    memory_writer<std::string> writer;
+    {
+        reckless::structured_log<Encoder, Fields...> log(&writer);
+        write_records(log);
+    }
+    return writer.container;
+}
+
+template <class Log>
+void write_records(Log& log)
+{
+    log.write("plain");
+    log.write("types", kv("int", -42), kv("unsigned", 42u),
+        kv("big", std::numeric_limits<std::uint64_t>::max()),
+        kv("double", 0.1), kv("float", 0.5f), kv("bool", true),
+        kv("char", 'x'), kv("string", std::string("text")));
+    log.write("special", kv("inf", std::numeric_limits<double>::infinity()),
+        kv("empty", ""), kv("spaces", "a b"), kv("equals", "a=b"));
+    log.write("escapes", kv("quote", "say \"hi\""), kv("backslash", "a\\b"),
+        kv("control", "line1\nline2\ttab\x01"));
+    log.write("long", kv("s", "0123456789abcdef0123456789abcdef\"0123456789abcdef\n"));
+    // Keys are escaped too, and quoted in logfmt when needed.
+    log.write("keys", kv("a b", 1), kv("a=b", 2), kv("say \"hi\"", 3));
+}
+
+void write_severity_records(reckless::structured_log<reckless::json_encoder,
+    reckless::severity_field>& log)
+{
+    log.info("started", kv("port", 8080));
+    log.error("failed", kv("reason", "timeout"));
+}
+
+// Header fields are escaped like other strings.
+template <class Log>
+void write_thread_name_records(Log& log)
+{
+    reckless::set_log_thread_name("say \"hi\"");
+    log.write("named");
+}
+
+std::string const expected_json =
+    "{\"msg\":\"plain\"}\n"
+    "{\"msg\":\"types\",\"int\":-42,\"unsigned\":42,\"big\":18446744073709551615,"
+        "\"double\":0.10000000000000001,\"float\":0.5,\"bool\":true,"
+        "\"char\":\"x\",\"string\":\"text\"}\n"
+    "{\"msg\":\"special\",\"inf\":null,\"empty\":\"\",\"spaces\":\"a b\","
+        "\"equals\":\"a=b\"}\n"
+    "{\"msg\":\"escapes\",\"quote\":\"say \\\"hi\\\"\",\"backslash\":\"a\\\\b\","
+        "\"control\":\"line1\\nline2\\ttab\\u0001\"}\n"
+    "{\"msg\":\"long\",\"s\":\"0123456789abcdef0123456789abcdef\\\"0123456789abcdef\\n\"}\n"
+    "{\"msg\":\"keys\",\"a b\":1,\"a=b\":2,\"say \\\"hi\\\"\":3}\n";
+
+std::string const expected_logfmt =
+    "msg=plain\n"
+    "msg=types int=-42 unsigned=42 big=18446744073709551615 "
+        "double=0.10000000000000001 float=0.5 bool=true char=x string=text\n"
+    "msg=special inf=inf empty=\"\" spaces=\"a b\" equals=\"a=b\"\n"
+    "msg=escapes quote=\"say \\\"hi\\\"\" backslash=\"a\\\\b\" "
+        "control=\"line1\\nline2\\ttab\\u0001\"\n"
+    "msg=long s=\"0123456789abcdef0123456789abcdef\\\"0123456789abcdef\\n\"\n"
+    "msg=keys \"a b\"=1 \"a=b\"=2 \"say \\\"hi\\\"\"=3\n";
+
+std::string const expected_severity =
+    "{\"level\":\"I\",\"msg\":\"started\",\"port\":8080}\n"
+    "{\"level\":\"E\",\"msg\":\"failed\",\"reason\":\"timeout\"}\n";
+
+std::string const expected_thread_name_json =
+    "{\"thread\":\"say \\\"hi\\\"\",\"msg\":\"named\"}\n";
+
+std::string const expected_thread_name_logfmt =
+    "thread=\"say \\\"hi\\\"\" msg=named\n";
+
+bool check(char const* name, std::string const& actual, std::string const& expected)
+{
+    if(actual == expected)
+        return true;
+    std::cerr << name << ": got\n" << actual << "expected\n" << expected;
+    return false;
+}
+
+int main()
+{
+    bool ok = check("json", encode_records<reckless::json_encoder>(&write_records),
+        expected_json);
+    ok = check("logfmt", encode_records<reckless::logfmt_encoder>(&write_records),
+        expected_logfmt) && ok;
+    ok = check("severity", encode_records(&write_severity_records),
+        expected_severity) && ok;
+    ok = check("thread name json", encode_records<reckless::json_encoder,
+        reckless::thread_name_field>(&write_thread_name_records),
+        expected_thread_name_json) && ok;
+    ok = check("thread name logfmt", encode_records<reckless::logfmt_encoder,
+        reckless::thread_name_field>(&write_thread_name_records),
+        expected_thread_name_logfmt) && ok;
+    std::cerr << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/tcp_writer.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>  // htonl, ntohs
+#include <netinet/in.h> // sockaddr_in
+#include <sys/socket.h>
+#include <unistd.h>
+
+void print_statistics(reckless::tcp_writer::tcp_statistics const& s)
+{
+    std::cout << "sent=" << s.sent_bytes << " spooled=" << s.spooled_bytes
+        << " spool_size=" << s.spool_size << " connects=" << s.connects
+        << " connect_failures=" << s.connect_failures
+        << " connected=" << s.connected << std::endl;
+}
+
+int main()
+{
+    // Bind the collector's port but don't listen on it yet, so that the
+    // writer's connection attempts are refused and everything is spooled.
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(server, reinterpret_cast<sockaddr*>(&address), &length);
+
+    unsigned const LINES = 100000;
+    std::string expected;
+    for(unsigned i=0; i!=LINES; ++i)
+        expected += "line " + std::to_string(i) + '\n';
+
+    std::string received;
+    std::thread collector;
+    bool ok;
+    {
+        reckless::tcp_writer writer("127.0.0.1", ntohs(address.sin_port),
+            "tcp_writer.spool");
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=LINES/2; ++i)
+            log.write("line %d", i);
+        log.flush();
+        std::cout << "while the collector is down: ";
+        print_statistics(writer.statistics());
+        bool spooled = writer.statistics().spool_size != 0;
+
+        // Bring the collector up. The spool is drained while the second
+        // half of the lines are written.
+        listen(server, 1);
+        collector = std::thread([&]() {
+            int fd = accept(server, nullptr, nullptr);
+            char buffer[65536];
+            while(received.size() < expected.size()) {
+                ssize_t n = read(fd, buffer, sizeof(buffer));
+                if(n <= 0)
+                    break;
+                received.append(buffer, n);
+            }
+            close(fd);
+        });
+        for(unsigned i=LINES/2; i!=LINES; ++i)
+            log.write("line %d", i);
+        log.flush();
+        collector.join();
+        std::cout << "after the collector came up: ";
+        print_statistics(writer.statistics());
+        ok = spooled && writer.statistics().spool_size == 0;
+    }
+    close(server);
+    unlink("tcp_writer.spool");
+
+    ok = ok && received == expected;
+    std::cout << "received " << received.size() << " of " << expected.size()
+        << " bytes" << std::endl;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,102 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/tee_writer.hpp>
+
+#include "memory_writer.hpp"
+
+#include <algorithm>    // count
+#include <atomic>
+#include <cstdint>    // uint64_t
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+// Simulates a pipe whose reader has stopped reading: write() does not return
+// until the test releases it.
+class stuck_writer : public reckless::writer {
+public:
+    std::size_t write(void const* data, std::size_t size, std::error_code& ec) noexcept override
+    {
+        while(stuck.load())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        output.append(static_cast<char const*>(data), size);
+        ec.clear();
+        return size;
+    }
+
+    std::atomic<bool> stuck{true};
+    std::string output;
+};
+
+void print_statistics(char const* name, reckless::tee_writer::sink_statistics const& s)
+{
+    std::cout << name << ": written=" << s.written_bytes
+        << " dropped=" << s.dropped_bytes << " (" << s.dropped_writes << " writes)"
+        << " delayed=" << s.delayed_writes << " writes"
+        << " failed=" << s.failed << std::endl;
+}
+
+int main()
+{
+    unsigned const LINES = 10000;
+    memory_writer<std::string> file;
+    stuck_writer pipe;
+    reckless::tee_writer tee;
+    tee.add_sink(&file);
+    tee.add_sink(&pipe, 16*1024, reckless::error_policy::ignore);
+
+    {
+        reckless::policy_log<> log(&tee);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d", i);
+        log.flush();
+    }
+    // The pipe sink is still stuck, so we can't use drain() here. Give the
+    // file sink a moment to catch up instead.
+    std::uint64_t expected_bytes = 0;
+    for(unsigned i=0; i!=LINES; ++i)
+        expected_bytes += std::to_string(i).size() + sizeof("line \n") - 1;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(tee.statistics(0).written_bytes != expected_bytes
+            && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto file_lines = std::count(file.container.begin(), file.container.end(), '\n');
+    std::cout << "file sink received " << file_lines << " of " << LINES
+        << " lines while the pipe sink was stuck" << std::endl;
+
+    pipe.stuck = false;
+    tee.drain();
+    auto pipe_lines = std::count(pipe.output.begin(), pipe.output.end(), '\n');
+    std::cout << "pipe sink received " << pipe_lines << " lines" << std::endl;
+
+    print_statistics("file", tee.statistics(0));
+    print_statistics("pipe", tee.statistics(1));
+    auto pipe_statistics = tee.statistics(1);
+    bool consistent = pipe_statistics.written_bytes + pipe_statistics.dropped_bytes
+        == tee.statistics(0).written_bytes;
+    std::cout << (file_lines == LINES && consistent? "OK" : "FAILED") << std::endl;
+    return file_lines == LINES && consistent? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/throttled_writer.hpp>
+
+#include "memory_writer.hpp"
+
+#include <algorithm>    // count
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+unsigned const LINES = 20000;
+std::uint64_t const RATE = 1024*1024;   // bytes per second
+std::size_t const BURST = 64*1024;
+
+void print_statistics(reckless::throttled_writer::throttle_statistics const& s)
+{
+    std::cout << "  written=" << s.written_bytes << " shed=" << s.shed_bytes
+        << " (" << s.shed_writes << " writes) delay="
+        << s.delay_microseconds/1000 << " ms (" << s.delayed_writes
+        << " writes)" << std::endl;
+}
+
+// In block mode everything should get through, at the configured rate.
+bool test_block()
+{
+    memory_writer<std::string> target;
+    reckless::throttled_writer writer(&target, RATE, BURST);
+    auto start = std::chrono::steady_clock::now();
+    {
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d %s", i, std::string(40, 'x'));
+    }
+    double seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    auto lines = std::count(target.container.begin(), target.container.end(), '\n');
+    double expected_seconds = static_cast<double>(target.container.size() - BURST)/RATE;
+    std::cout << "block: " << lines << " lines in " << seconds << " s (expected "
+        << expected_seconds << " s)" << std::endl;
+    print_statistics(writer.statistics());
+    return lines == LINES && seconds > 0.9*expected_seconds
+        && seconds < 1.5*expected_seconds + 0.1;
+}
+
+// In ignore mode the log should never be held up, and whatever is not shed
+// should be complete lines.
+bool test_ignore()
+{
+    memory_writer<std::string> target;
+    reckless::throttled_writer writer(&target, RATE, BURST,
+        reckless::error_policy::ignore);
+    {
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d %s", i, std::string(40, 'x'));
+    }
+    auto statistics = writer.statistics();
+    bool complete_lines = target.container.empty() || target.container.back() == '\n';
+    std::cout << "ignore: " << std::count(target.container.begin(),
+        target.container.end(), '\n') << " lines written" << std::endl;
+    print_statistics(statistics);
+    return complete_lines && statistics.shed_bytes != 0
+        && statistics.written_bytes == target.container.size()
+        && statistics.delay_microseconds == 0;
+}
+
+// Records every write() call separately.
+class chunk_writer : public reckless::writer {
+public:
+    std::size_t write(void const* pbuffer, std::size_t count,
+        std::error_code& ec) noexcept override
+    {
+        chunks.emplace_back(static_cast<char const*>(pbuffer), count);
+        ec.clear();
+        return count;
+    }
+
+    std::vector<std::string> chunks;
+};
+
+// In block mode the data should be passed on in whole lines, also when a
+// line is longer than the burst size.
+bool test_block_lines()
+{
+    chunk_writer target;
+    reckless::throttled_writer writer(&target, 20000, 100);
+    std::string data;
+    for(unsigned i=0; i!=40; ++i)
+        data += "line " + std::to_string(i) + " " + std::string(i%30, 'x') + "\n";
+    data += std::string(250, 'y') + "\n";
+    data += "last\n";
+    std::error_code ec;
+    std::size_t written = writer.write(data.data(), data.size(), ec);
+
+    std::string joined;
+    bool whole_lines = true;
+    for(std::string const& chunk : target.chunks) {
+        whole_lines = whole_lines && !chunk.empty() && chunk.back() == '\n';
+        joined += chunk;
+    }
+    std::cout << "block lines: " << target.chunks.size() << " pieces" << std::endl;
+    return !ec && written == data.size() && joined == data && whole_lines
+        && target.chunks.size() > 1;
+}
+
+int main()
+{
+    bool ok = test_block();
+    ok = test_block_lines() && ok;
+    ok = test_ignore() && ok;
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
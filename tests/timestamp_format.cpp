@@ -0,0 +1,153 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Compares the timestamp formats with strftime() for a sequence of times that
+// crosses daylight saving time transitions, in small steps so that the cached
+// date and UTC offset are both reused and invalidated.
+#include <reckless/timestamp_format.hpp>
+
+#include <cstdint>
+#include <cstdio>   // snprintf
+#include <cstdlib>  // setenv
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <string>
+
+std::uint64_t const NS = 1000000000u;
+
+template <class Format>
+std::string render(std::uint64_t time)
+{
+    char buffer[Format::MAX_SIZE];
+    char* pend = Format::write(buffer, time);
+    return std::string(buffer, pend);
+}
+
+std::string strftime_string(char const* format, struct tm const& tm)
+{
+    char buffer[64];
+    std::size_t size = std::strftime(buffer, sizeof(buffer), format, &tm);
+    return std::string(buffer, size);
+}
+
+std::string fraction(std::uint64_t time, unsigned digits)
+{
+    char buffer[16];
+    unsigned long divisor = 1;
+    for(unsigned i=digits; i!=9; ++i)
+        divisor *= 10;
+    std::snprintf(buffer, sizeof(buffer), ".%0*lu", static_cast<int>(digits),
+        static_cast<unsigned long>(time%NS/divisor));
+    return buffer;
+}
+
+bool check(std::string const& name, std::string const& actual,
+    std::string const& expected)
+{
+    if(actual == expected)
+        return true;
+    std::cout << name << ": got " << actual << ", expected " << expected
+        << std::endl;
+    return false;
+}
+
+bool check_time(std::uint64_t time)
+{
+    std::time_t seconds = static_cast<std::time_t>(time/NS);
+    struct tm local;
+    struct tm utc;
+    localtime_r(&seconds, &local);
+    gmtime_r(&seconds, &utc);
+
+    long offset_minutes = local.tm_gmtoff/60;
+    char offset[32];
+    std::snprintf(offset, sizeof(offset), "%c%02ld:%02ld",
+        offset_minutes < 0? '-' : '+', std::labs(offset_minutes)/60,
+        std::labs(offset_minutes)%60);
+
+    char decimal[32];
+    bool ok = check("local_time_format<3>",
+        render<reckless::local_time_format<3>>(time),
+        strftime_string("%Y-%m-%d %H:%M:%S", local) + fraction(time, 3));
+    ok = check("local_time_format<0>",
+        render<reckless::local_time_format<0>>(time),
+        strftime_string("%Y-%m-%d %H:%M:%S", local)) && ok;
+    ok = check("iso8601_format<6>",
+        render<reckless::iso8601_format<6>>(time),
+        strftime_string("%Y-%m-%dT%H:%M:%S", local) + fraction(time, 6) +
+        offset) && ok;
+    ok = check("iso8601_utc_format<9>",
+        render<reckless::iso8601_utc_format<9>>(time),
+        strftime_string("%Y-%m-%dT%H:%M:%S", utc) + fraction(time, 9) + "Z")
+        && ok;
+    std::snprintf(decimal, sizeof(decimal), "%llu",
+        static_cast<unsigned long long>(time/NS));
+    ok = check("epoch_format<0>", render<reckless::epoch_format<0>>(time),
+        decimal) && ok;
+    ok = check("epoch_format<1>", render<reckless::epoch_format<1>>(time),
+        decimal + fraction(time, 1)) && ok;
+    std::snprintf(decimal, sizeof(decimal), "%llu",
+        static_cast<unsigned long long>(time));
+    ok = check("epoch_nanoseconds_format",
+        render<reckless::epoch_nanoseconds_format>(time), decimal) && ok;
+    return ok;
+}
+
+bool check_zone(char const* tz, std::uint64_t begin)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+    std::mt19937_64 rng;
+    bool ok = true;
+    // Steps of up to ten minutes over a year cover two transitions.
+    std::uint64_t time = begin;
+    for(unsigned i=0; i!=200000 && ok; ++i) {
+        ok = check_time(time);
+        time += rng() % (600*NS);
+    }
+    // Random times from 1970 to 2200.
+    for(unsigned i=0; i!=20000 && ok; ++i)
+        ok = check_time(rng() % (7258118400u*NS));
+    if(!ok)
+        std::cout << "in time zone " << tz << std::endl;
+    return ok;
+}
+
+int main()
+{
+    // 2020-01-01 00:00:00 UTC.
+    std::uint64_t const begin = 1577836800u*NS;
+    bool ok = check_zone("UTC0", begin);
+    ok = check_zone("CET-1CEST,M3.5.0,M10.5.0/3", begin) && ok;
+    ok = check_zone("EST5EDT,M3.2.0,M11.1.0", begin) && ok;
+    // Changes by half an hour, at a half hour UTC.
+    ok = check_zone("<+1030>-10:30<+11>-11,M10.1.0,M4.1.0", begin) && ok;
+
+    ok = check("elapsed_format<3>",
+        render<reckless::elapsed_format<3>>(reckless::detail::start_time() + 1500000000u),
+        "1.500") && ok;
+    ok = check("elapsed_format<0> before start",
+        render<reckless::elapsed_format<0>>(0), "0") && ok;
+
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Checks that wide characters and strings are transcoded to UTF-8, including
+// replacement of invalid surrogates, by comparing against a straightforward
+// reference encoder.
+#include "memory_writer.hpp"
+#include <reckless/policy_log.hpp>
+
+#include <iostream>
+#include <random>
+#include <string>
+
+memory_writer<std::string> g_writer;
+
+void encode_utf8(std::string& s, char32_t c)
+{
+    if(c < 0x80) {
+        s += static_cast<char>(c);
+    } else if(c < 0x800) {
+        s += static_cast<char>(0xc0 | (c >> 6));
+        s += static_cast<char>(0x80 | (c & 0x3f));
+    } else if(c < 0x10000) {
+        s += static_cast<char>(0xe0 | (c >> 12));
+        s += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        s += static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+        s += static_cast<char>(0xf0 | (c >> 18));
+        s += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+        s += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        s += static_cast<char>(0x80 | (c & 0x3f));
+    }
+}
+
+void encode_utf16(std::u16string& s, char32_t c)
+{
+    if(c < 0x10000) {
+        s += static_cast<char16_t>(c);
+    } else {
+        c -= 0x10000;
+        s += static_cast<char16_t>(0xd800 + (c >> 10));
+        s += static_cast<char16_t>(0xdc00 + (c & 0x3ff));
+    }
+}
+
+// Mostly ASCII with runs of other characters, so that both the vectorized
+// and the scalar paths get exercised with all kinds of alignments.
+char32_t random_code_point(std::mt19937& rng)
+{
+    switch(rng() % 8) {
+    case 0: return 0x80 + rng() % 0x780;
+    case 1: return 0x800 + rng() % (0xd800 - 0x800);
+    case 2: return 0xe000 + rng() % 0x2000;
+    case 3: return 0x10000 + rng() % 0x100000;
+    default: return 0x20 + rng() % 0x5f;
+    }
+}
+
+bool check(char const* name, std::string const& expected)
+{
+    bool ok = g_writer.container == expected;
+    if(!ok)
+        std::cout << name << ": " << g_writer.container.substr(0, 200)
+            << std::endl;
+    g_writer.container.clear();
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    reckless::policy_log<> log(&g_writer);
+
+    log.write("%s %s %s", L"wide", u"utf-16", U"utf-32");
+    log.write("%s|%s|%s", std::wstring(L"åäö"),
+        std::u16string(u"€\U0001F600"),
+        std::u32string(U"€\U0001F600"));
+    log.write("%c%c%c%s", L'x', u'é', U'\U00010348', L'!');
+    log.write("%d %x", U'A', u'€');
+    log.write("%c", 'n');
+    log.flush();
+    ok &= check("basic",
+        "wide utf-16 utf-32\n"
+        "\xc3\xa5\xc3\xa4\xc3\xb6|\xe2\x82\xac\xf0\x9f\x98\x80"
+        "|\xe2\x82\xac\xf0\x9f\x98\x80\n"
+        "x\xc3\xa9\xf0\x90\x8d\x88!\n"
+        "65 20ac\n"
+        "n\n");
+
+    // Unpaired surrogates and values above U+10FFFF are replaced.
+    std::string const fffd = "\xef\xbf\xbd";
+    char16_t const lone_high[] = {u'a', 0xd800, u'b', 0};
+    char16_t const lone_low[] = {0xdc00, u'a', 0};
+    char16_t const reversed[] = {0xdc00, 0xd800, 0};
+    char16_t const trailing_high[] = {u'a', 0xdbff, 0};
+    char32_t const bad32[] = {0xd800, 0x110000, U'z', 0};
+    log.write("%s", lone_high);
+    log.write("%s", lone_low);
+    log.write("%s", reversed);
+    log.write("%s", trailing_high);
+    log.write("%s", bad32);
+    log.write("%c", static_cast<char16_t>(0xdfff));
+    log.flush();
+    ok &= check("invalid",
+        "a" + fffd + "b\n" +
+        fffd + "a\n" +
+        fffd + fffd + "\n" +
+        "a" + fffd + "\n" +
+        fffd + fffd + "z\n" +
+        fffd + "\n");
+
+    // Random strings, including ones long enough to span several chunks.
+    std::mt19937 rng(4711);
+    for(unsigned i=0; i!=2000; ++i) {
+        std::size_t length = i < 1900? rng() % 64 : rng() % 5000;
+        std::u16string s16;
+        std::u32string s32;
+        std::string expected;
+        for(std::size_t j=0; j!=length; ++j) {
+            char32_t c = random_code_point(rng);
+            encode_utf16(s16, c);
+            s32 += c;
+            encode_utf8(expected, c);
+        }
+        log.write("%s", s16);
+        log.write("%s", s32);
+        log.flush();
+        if(!check("random", expected + "\n" + expected + "\n")) {
+            ok = false;
+            break;
+        }
+    }
+
+    std::cout << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
@@ -0,0 +1,85 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <reckless/policy_log.hpp>
+#include <reckless/stdout_writer.hpp>
+
+#include <iostream>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+unsigned const LINES = 200000;
+
+// Reads everything from the pipe and checks that it is exactly what the
+// parent logged. If the output buffer pages were reused while the pipe still
+// referenced them, lines would come out garbled.
+int consume(int fd)
+{
+    std::string expected;
+    for(unsigned i=0; i!=LINES; ++i)
+        expected += "line " + std::to_string(i) + " " + std::string(i%200, 'x') + '\n';
+
+    std::string received;
+    char buffer[65536];
+    while(true) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if(n <= 0)
+            break;
+        received.append(buffer, n);
+    }
+    std::cerr << "received " << received.size() << " of " << expected.size()
+        << " bytes" << std::endl;
+    return received == expected? 0 : 1;
+}
+
+int main()
+{
+    int fds[2];
+    if(0 != pipe(fds))
+        return 1;
+    pid_t child = fork();
+    if(child == -1)
+        return 1;
+    if(child == 0) {
+        close(fds[1]);
+        return consume(fds[0]);
+    }
+    close(fds[0]);
+    dup2(fds[1], 1);
+    close(fds[1]);
+
+    {
+        reckless::stdout_writer writer;
+        writer.zero_copy_pipe(true);
+        reckless::policy_log<> log(&writer);
+        for(unsigned i=0; i!=LINES; ++i)
+            log.write("line %d %s", i, std::string(i%200, 'x'));
+    }
+    close(1);
+
+    int status;
+    waitpid(child, &status, 0);
+    bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    std::cerr << (ok? "OK" : "FAILED") << std::endl;
+    return ok? 0 : 1;
+}
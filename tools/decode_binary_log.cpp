@@ -0,0 +1,98 @@
+/* This file is part of reckless logging
+ * Copyright 2015-2020 Mattias Flodin <git@codepentry.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+// Renders the output of a binary_log as text on stdout.
+//
+// Usage: decode_binary_log [file...]
+//
+// Reads from stdin if no files are given.
+#include <reckless/binary_log.hpp>
+#include <reckless/stdout_writer.hpp>
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+bool decode(reckless::binary_log_decoder& decoder, std::FILE* file)
+{
+    std::vector<char> buffer(1024*1024);
+    std::size_t pending = 0;
+    while(true) {
+        std::size_t n = std::fread(buffer.data() + pending, 1,
+            buffer.size() - pending, file);
+        if(n == 0)
+            break;
+        pending += n;
+        std::size_t consumed = decoder.decode(buffer.data(), pending);
+        pending -= consumed;
+        std::copy(buffer.begin() + consumed, buffer.begin() + consumed + pending,
+            buffer.begin());
+        // A single record didn't fit in the buffer.
+        if(pending == buffer.size())
+            buffer.resize(2*buffer.size());
+    }
+    if(std::ferror(file))
+        return false;
+    if(pending != 0)
+        std::cerr << "decode_binary_log: ignoring incomplete record at end of input"
+            << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    reckless::stdout_writer writer;
+    reckless::binary_log_decoder decoder(&writer);
+    int status = 0;
+    try {
+        if(argc == 1) {
+            if(!decode(decoder, stdin)) {
+                std::perror("decode_binary_log: stdin");
+                status = 1;
+            }
+        }
+        for(int i=1; i!=argc; ++i) {
+            std::FILE* file = std::fopen(argv[i], "rb");
+            if(!file || !decode(decoder, file)) {
+                std::perror(argv[i]);
+                status = 1;
+            }
+            if(file)
+                std::fclose(file);
+        }
+    } catch(std::exception const& e) {
+        // Still output what was decoded before the error.
+        std::cerr << "decode_binary_log: " << e.what() << std::endl;
+        status = 1;
+    }
+    try {
+        decoder.flush();
+    } catch(std::exception const& e) {
+        std::cerr << "decode_binary_log: " << e.what() << std::endl;
+        return 1;
+    }
+    if(decoder.undefined_record_count() != 0) {
+        std::cerr << "decode_binary_log: " << decoder.undefined_record_count()
+            << " records refer to a format string that was never defined"
+            << std::endl;
+    }
+    return status;
+}